@@ -18,6 +18,7 @@
 
 #include "VJSClass.h"
 #include "VJSValue.h"
+#include "VJSCodeCache.h"
 #include "JSDebugger/Interfaces/CJSWDebuggerFactory.h"
 
 using namespace v8;
@@ -27,6 +28,7 @@ BEGIN_TOOLBOX_NAMESPACE
 
 XBOX::VCriticalSection						V4DContext::sLock;
 V4DContext::NativeClassesMap_t				V4DContext::sNativeClassesMap;
+sLONG										V4DContext::sContextCount = 0;
 
 
 
@@ -285,6 +287,12 @@ fThrIdStack.pop();
 		delete fLocker;
 		fLocker = NULL;
 	}
+
+	{
+		StLocker<VCriticalSection>	lock(&sLock);
+		if (--sContextCount == 0)
+			VJSCodeCache::DeInit();
+	}
 }
 
 bool V4DContext::HasDebuggerAttached()
@@ -381,6 +389,11 @@ V4DContext::V4DContext(v8::Isolate* isolate, JS4D::ClassRef inGlobalClassRef)
 		V8::SetArrayBufferAllocator(&sArrayBufferAllocator);
 		sIsV8Initialized = true;
 	}
+	{
+		StLocker<VCriticalSection>	lock(&sLock);
+		if (sContextCount++ == 0)
+			VJSCodeCache::Init();
+	}
 	//XBOX::VPtr	stackAddr = VTask::GetCurrent()->GetStackAddress();
 	//size_t		stackSize = VTask::GetCurrent()->GetStackSize();
 #if V8_CHECK_CONTEXT_REUSE
@@ -1242,6 +1255,50 @@ bool V4DContext::CheckScriptSyntax(const XBOX::VString& inScript, const VString&
 	return ok;
 }
 
+Handle<Script> V4DContext::CompileCachedScript(const VString& inScript, const VString& inUrl, Handle<String>& inScriptStr, Handle<String>& inFileStr)
+{
+	VJSCodeCache*			codeCache = VJSCodeCache::Get();
+	VJSCodeCacheData*		data = (codeCache != NULL) ? codeCache->RetainData(inUrl, inScript) : NULL;
+	VMicrosecondsCounter	counter;
+	Handle<Script>			compiledScript;
+
+	counter.Start();
+	if (data != NULL)
+	{
+		// the source does not own the cached data buffer
+		ScriptCompiler::CachedData*	cachedData = new ScriptCompiler::CachedData((const uint8_t*)data->GetDataPtr(), (int)data->GetDataSize());
+		ScriptCompiler::Source		source(inScriptStr, ScriptOrigin(inFileStr), cachedData);
+		compiledScript = ScriptCompiler::Compile(fIsolate, &source, ScriptCompiler::kConsumeCodeCache);
+		if (source.GetCachedData()->rejected)
+		{
+			// produced by another V8 version or with other flags
+			codeCache->ReportRejected(data);
+		}
+		else if (!compiledScript.IsEmpty())
+		{
+			codeCache->ReportUsed(data, counter.Stop());
+		}
+		ReleaseRefCountable(&data);
+	}
+	else if (codeCache == NULL)
+	{
+		ScriptCompiler::Source		source(inScriptStr, ScriptOrigin(inFileStr));
+		compiledScript = ScriptCompiler::Compile(fIsolate, &source);
+	}
+	else
+	{
+		ScriptCompiler::Source		source(inScriptStr, ScriptOrigin(inFileStr));
+		compiledScript = ScriptCompiler::Compile(fIsolate, &source, ScriptCompiler::kProduceCodeCache);
+		sLONG8	compileTime = counter.Stop();
+		const ScriptCompiler::CachedData*	cachedData = source.GetCachedData();
+		if (!compiledScript.IsEmpty() && (cachedData != NULL) && (cachedData->length > 0))
+		{
+			codeCache->StoreData(inUrl, inScript, cachedData->data, cachedData->length, compileTime);
+		}
+	}
+	return compiledScript;
+}
+
 bool V4DContext::EvaluateScript(const VString& inScript, const VString& inUrl, VJSValue *outResult, bool inCacheScript, VJSException* outException)
 {
 	bool	ok=false;
@@ -1296,7 +1353,7 @@ bool V4DContext::EvaluateScript(const VString& inScript, const VString& inUrl, V
 			Handle<String> scriptStr = String::NewFromTwoByte(fIsolate, inScript.GetCPointer(), v8::String::kNormalString, inScript.GetLength());
 			Handle<String> fileStr = String::NewFromTwoByte(fIsolate, inUrl.GetCPointer(), v8::String::kNormalString, inUrl.GetLength());
 			// here either we do not cache or the script his a new one
-			compiledScript = Script::Compile(scriptStr, fileStr);
+			compiledScript = CompileCachedScript(inScript, inUrl, scriptStr, fileStr);
 			if (!compiledScript.IsEmpty())
 			{
 				// if old script
@@ -1854,8 +1911,10 @@ void V4DContext::VChromeDebugContext::DebugMessageHandler2(const v8::Debug::Mess
 			v8::String::Value	jsonVal(jsonStr);
 			VString	tmp(*jsonVal);
 			DebugMsg("debugMessageHandler2 on Exc <%S>\n", &tmp);
+			// the parsed message only lives in this scope: its objects are allocated in an arena released at once
+			VArena		arena(4 * 1024);
 			VJSONValue	jsonMsg;
-			VError err = VJSONImporter::ParseString(tmp, jsonMsg);
+			VError err = VJSONImporter::ParseString(tmp, jsonMsg, VJSONImporter::EJSI_Default, &arena);
 			VJSONValue	jsonBody = jsonMsg.GetProperty("body");
 			bool shouldAbort = false;
 			if (jsonBody.IsObject())
@@ -1933,8 +1992,10 @@ void V4DContext::VChromeDebugContext::DebugMessageHandler2(const v8::Debug::Mess
 			v8::String::Value	jsonVal(jsonStr);
 			VString	tmp(*jsonVal);
 			DebugMsg("debugMessageHandler2 on Break <%S>\n", &tmp);
+			// the parsed message only lives in this scope: its objects are allocated in an arena released at once
+			VArena		arena(4 * 1024);
 			VJSONValue	jsonMsg;
-			VError err = VJSONImporter::ParseString(tmp, jsonMsg);
+			VError err = VJSONImporter::ParseString(tmp, jsonMsg, VJSONImporter::EJSI_Default, &arena);
 			VJSONValue	jsonBody = jsonMsg.GetProperty("body");
 			bool shouldAbort = false;
 			if (jsonBody.IsObject())
@@ -172,6 +172,8 @@ private:
 			ScriptIDsByURLMap_t															fScriptIDsMap;
 
 			void						UpdateContext();
+			// compiles using the shared code cache, producing cached data if there's none for this source
+			v8::Handle<v8::Script>		CompileCachedScript(const XBOX::VString& inScript, const VString& inUrl, v8::Handle<v8::String>& inScriptStr, v8::Handle<v8::String>& inFileStr);
 			void						AddNativeFunctionTemplate(	const xbox::VString& inName,
 																	v8::Handle<v8::FunctionTemplate>& inFuncTemp);
 
@@ -194,6 +196,8 @@ private:
 
 	static	XBOX::VCriticalSection											sLock;
 
+	static	sLONG															sContextCount;	// the code cache lives while a context exists, protected by sLock
+
 	static	NativeClassesMap_t												sNativeClassesMap;
 
 
@@ -0,0 +1,425 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#include "VJavaScriptPrecompiled.h"
+
+#include "VJSCodeCache.h"
+#include "Kernel/Sources/MurmurHash.h"
+
+USING_TOOLBOX_NAMESPACE
+
+
+// header of cache files, followed by the data
+typedef struct CodeCacheFileHeader
+{
+	uLONG		fSignature;
+	uLONG		fVersion;
+	uLONG8		fKey;
+	sLONG8		fCompileTime;
+	uLONG		fSourceLength;
+	uLONG		fDataSize;
+} CodeCacheFileHeader;
+
+static const uLONG	kCODE_CACHE_SIGNATURE	= 'JScc';
+static const uLONG	kCODE_CACHE_VERSION		= 1;
+static const uLONG	kCODE_CACHE_HASH_SEED	= 0x4A53;
+
+
+VJSCodeCacheData::VJSCodeCacheData( uLONG8 inKey, const void *inData, VSize inSize, sLONG8 inCompileTime)
+: fKey( inKey)
+, fCompileTime( inCompileTime)
+, fLastUse( 0)
+{
+	fData.PutData( 0, inData, inSize);
+}
+
+
+VJSCodeCacheData::~VJSCodeCacheData()
+{
+}
+
+
+
+VJSCodeCache* VJSCodeCache::sInstance = NULL;
+
+
+/* static */
+void VJSCodeCache::Init()
+{
+	if (sInstance == NULL)
+		sInstance = new VJSCodeCache();
+}
+
+
+/* static */
+void VJSCodeCache::DeInit()
+{
+	delete sInstance;
+	sInstance = NULL;
+}
+
+
+VJSCodeCache::VJSCodeCache()
+: fFolder( NULL)
+, fMaxMemorySize( kDEFAULT_MAX_MEMORY_SIZE)
+, fUseCounter( 0)
+{
+	::memset( &fStatistics, 0, sizeof( fStatistics));
+}
+
+
+VJSCodeCache::~VJSCodeCache()
+{
+	for (MapOfData::iterator i = fData.begin() ; i != fData.end() ; ++i)
+		i->second->Release();
+
+	ReleaseRefCountable( &fFolder);
+}
+
+
+//static
+uLONG8 VJSCodeCache::ComputeKey( const VString& inSource)
+{
+	return MurmurHash64A( inSource.GetCPointer(), (int) (inSource.GetLength() * sizeof( UniChar)), kCODE_CACHE_HASH_SEED);
+}
+
+
+void VJSCodeCache::SetFolder( VFolder *inFolder)
+{
+	StLocker<VCriticalSection> lock( &fLock);
+
+	CopyRefCountable( &fFolder, inFolder);
+	if ( (fFolder != NULL) && !fFolder->Exists())
+		fFolder->CreateRecursive();
+}
+
+
+VFolder* VJSCodeCache::RetainFolder() const
+{
+	StLocker<VCriticalSection> lock( &fLock);
+
+	return RetainRefCountable( fFolder);
+}
+
+
+void VJSCodeCache::SetMaxMemorySize( VSize inMaxSize)
+{
+	StLocker<VCriticalSection> lock( &fLock);
+
+	fMaxMemorySize = inMaxSize;
+	_Purge();
+}
+
+
+VJSCodeCacheData* VJSCodeCache::RetainData( const VString& inUrl, const VString& inSource)
+{
+	uLONG8 key = ComputeKey( inSource);
+	uLONG8 staleKey = 0;
+	bool removeStaleFile = false;
+	VJSCodeCacheData *data = NULL;
+	VFolder *folder = NULL;
+
+	{
+		StLocker<VCriticalSection> lock( &fLock);
+
+		// the source of this url changed: its previous code is useless, unless another url has the same source
+		unordered_map_VString<uLONG8>::iterator i = fKeysByUrl.find( inUrl);
+		if (i == fKeysByUrl.end())
+		{
+			fKeysByUrl.insert( unordered_map_VString<uLONG8>::value_type( inUrl, key));
+		}
+		else if (i->second != key)
+		{
+			staleKey = i->second;
+			i->second = key;
+			if (!_IsKeyUsed( staleKey))
+			{
+				_Remove( staleKey);
+				removeStaleFile = true;
+			}
+		}
+
+		MapOfData::iterator found = fData.find( key);
+		if (found != fData.end())
+		{
+			data = RetainRefCountable( found->second);
+			data->fLastUse = ++fUseCounter;
+		}
+
+		folder = RetainRefCountable( fFolder);
+	}
+
+	if (folder != NULL)
+	{
+		if (removeStaleFile)
+			_Delete( *folder, staleKey);
+
+		if (data == NULL)
+		{
+			data = _Load( *folder, key, inSource);
+			if (data != NULL)
+			{
+				StLocker<VCriticalSection> lock( &fLock);
+
+				// another context may have loaded it meanwhile
+				MapOfData::iterator found = fData.find( key);
+				if (found != fData.end())
+				{
+					CopyRefCountable( &data, found->second);
+				}
+				else
+				{
+					_Insert( data);
+					fStatistics.fDiskLoads++;
+					_Purge();
+				}
+				data->fLastUse = ++fUseCounter;
+			}
+		}
+		folder->Release();
+	}
+
+	if (data == NULL)
+	{
+		StLocker<VCriticalSection> lock( &fLock);
+		fStatistics.fMisses++;
+	}
+
+	return data;
+}
+
+
+void VJSCodeCache::StoreData( const VString& inUrl, const VString& inSource, const void *inData, VSize inSize, sLONG8 inCompileTime)
+{
+	uLONG8 key = ComputeKey( inSource);
+	VJSCodeCacheData *data = new VJSCodeCacheData( key, inData, inSize, inCompileTime);
+	if ( (data == NULL) || (data->GetDataSize() != inSize) )
+	{
+		ReleaseRefCountable( &data);
+		return;
+	}
+
+	VFolder *folder = NULL;
+
+	{
+		StLocker<VCriticalSection> lock( &fLock);
+
+		fStatistics.fCompileTime += inCompileTime;
+
+		// another context may have stored it meanwhile
+		if (fData.find( key) == fData.end())
+		{
+			fKeysByUrl[inUrl] = key;
+			data->fLastUse = ++fUseCounter;
+			_Insert( data);
+			_Purge();
+
+			folder = RetainRefCountable( fFolder);
+		}
+	}
+
+	if (folder != NULL)
+	{
+		if (_Save( *folder, data, inSource))
+		{
+			StLocker<VCriticalSection> lock( &fLock);
+			fStatistics.fDiskStores++;
+		}
+		folder->Release();
+	}
+	data->Release();
+}
+
+
+void VJSCodeCache::ReportUsed( VJSCodeCacheData *inData, sLONG8 inCompileTime)
+{
+	StLocker<VCriticalSection> lock( &fLock);
+
+	fStatistics.fHits++;
+	if (inData->GetCompileTime() > inCompileTime)
+		fStatistics.fCompileTimeSaved += inData->GetCompileTime() - inCompileTime;
+}
+
+
+void VJSCodeCache::ReportRejected( VJSCodeCacheData *inData)
+{
+	VFolder *folder = NULL;
+
+	{
+		StLocker<VCriticalSection> lock( &fLock);
+
+		fStatistics.fRejections++;
+		MapOfData::iterator found = fData.find( inData->GetKey());
+		if ( (found != fData.end()) && (found->second == inData) )
+		{
+			_Remove( inData->GetKey());
+			folder = RetainRefCountable( fFolder);
+		}
+	}
+
+	if (folder != NULL)
+	{
+		_Delete( *folder, inData->GetKey());
+		folder->Release();
+	}
+}
+
+
+void VJSCodeCache::Clear()
+{
+	StLocker<VCriticalSection> lock( &fLock);
+
+	while (!fData.empty())
+		_Remove( fData.begin()->first);
+	fKeysByUrl.clear();
+}
+
+
+void VJSCodeCache::GetStatistics( Statistics& outStatistics) const
+{
+	StLocker<VCriticalSection> lock( &fLock);
+
+	outStatistics = fStatistics;
+}
+
+
+void VJSCodeCache::_Insert( VJSCodeCacheData *inData)
+{
+	std::pair<MapOfData::iterator, bool> result = fData.insert( MapOfData::value_type( inData->GetKey(), inData));
+	if (result.second)
+	{
+		inData->Retain();
+		fStatistics.fEntryCount++;
+		fStatistics.fMemorySize += inData->GetDataSize();
+	}
+}
+
+
+void VJSCodeCache::_Remove( uLONG8 inKey)
+{
+	MapOfData::iterator found = fData.find( inKey);
+	if (found != fData.end())
+	{
+		fStatistics.fEntryCount--;
+		fStatistics.fMemorySize -= found->second->GetDataSize();
+		found->second->Release();
+		fData.erase( found);
+	}
+}
+
+
+bool VJSCodeCache::_IsKeyUsed( uLONG8 inKey) const
+{
+	for (unordered_map_VString<uLONG8>::const_iterator i = fKeysByUrl.begin() ; i != fKeysByUrl.end() ; ++i)
+	{
+		if (i->second == inKey)
+			return true;
+	}
+	return false;
+}
+
+
+void VJSCodeCache::_Purge()
+{
+	// files are kept, the entries will be reloaded when needed
+	while ( (fStatistics.fMemorySize > fMaxMemorySize) && !fData.empty())
+	{
+		MapOfData::iterator oldest = fData.begin();
+		for (MapOfData::iterator i = fData.begin() ; i != fData.end() ; ++i)
+		{
+			if (i->second->fLastUse < oldest->second->fLastUse)
+				oldest = i;
+		}
+		_Remove( oldest->first);
+	}
+}
+
+
+//static
+VFile* VJSCodeCache::_RetainFile( const VFolder& inFolder, uLONG8 inKey)
+{
+	VString name;
+	name.FromHexLong( inKey);
+	name.AppendString( CVSTR( ".jscache"));
+
+	return new VFile( inFolder, name);
+}
+
+
+//static
+void VJSCodeCache::_Delete( const VFolder& inFolder, uLONG8 inKey)
+{
+	StErrorContextInstaller errorContext( false);
+	VFile *file = _RetainFile( inFolder, inKey);
+	if ( (file != NULL) && file->Exists())
+		file->Delete();
+	ReleaseRefCountable( &file);
+}
+
+
+//static
+VJSCodeCacheData* VJSCodeCache::_Load( const VFolder& inFolder, uLONG8 inKey, const VString& inSource)
+{
+	VJSCodeCacheData *data = NULL;
+	VFile *file = _RetainFile( inFolder, inKey);
+
+	if ( (file != NULL) && file->Exists())
+	{
+		StErrorContextInstaller errorContext( false);
+		VMemoryBuffer<> content;
+
+		if (file->GetContent( content) == VE_OK)
+		{
+			const CodeCacheFileHeader *header = (const CodeCacheFileHeader*) content.GetDataPtr();
+			if ( (content.GetDataSize() >= sizeof( CodeCacheFileHeader))
+				&& (header->fSignature == kCODE_CACHE_SIGNATURE)
+				&& (header->fVersion == kCODE_CACHE_VERSION)
+				&& (header->fKey == inKey)
+				&& (header->fSourceLength == (uLONG) inSource.GetLength())
+				&& (header->fDataSize == content.GetDataSize() - sizeof( CodeCacheFileHeader)) )
+			{
+				data = new VJSCodeCacheData( inKey, header + 1, header->fDataSize, header->fCompileTime);
+			}
+		}
+	}
+	ReleaseRefCountable( &file);
+
+	return data;
+}
+
+
+//static
+bool VJSCodeCache::_Save( const VFolder& inFolder, const VJSCodeCacheData *inData, const VString& inSource)
+{
+	VMemoryBuffer<> content;
+
+	CodeCacheFileHeader header;
+	header.fSignature = kCODE_CACHE_SIGNATURE;
+	header.fVersion = kCODE_CACHE_VERSION;
+	header.fKey = inData->GetKey();
+	header.fCompileTime = inData->GetCompileTime();
+	header.fSourceLength = (uLONG) inSource.GetLength();
+	header.fDataSize = (uLONG) inData->GetDataSize();
+
+	if ( !content.PutData( 0, &header, sizeof( header)) || !content.PutData( sizeof( header), inData->GetDataPtr(), inData->GetDataSize()) )
+		return false;
+
+	StErrorContextInstaller errorContext( false);
+	VFile *file = _RetainFile( inFolder, inData->GetKey());
+	bool ok = (file != NULL) && (file->SetContent( content.GetDataPtr(), content.GetDataSize()) == VE_OK);
+	ReleaseRefCountable( &file);
+
+	return ok;
+}
@@ -0,0 +1,138 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#ifndef __VJSCodeCache__
+#define __VJSCodeCache__
+
+BEGIN_TOOLBOX_NAMESPACE
+
+/*
+	@brief	Compiled code produced by the engine for a script source (V8 "cached data").
+*/
+class XTOOLBOX_API VJSCodeCacheData : public VObject, public IRefCountable
+{
+public:
+									VJSCodeCacheData( uLONG8 inKey, const void *inData, VSize inSize, sLONG8 inCompileTime);
+
+			uLONG8					GetKey() const				{ return fKey; }
+			const void*				GetDataPtr() const			{ return fData.GetDataPtr(); }
+			VSize					GetDataSize() const			{ return fData.GetDataSize(); }
+
+			// microseconds spent to compile the source when the data was produced
+			sLONG8					GetCompileTime() const		{ return fCompileTime; }
+
+private:
+	friend class VJSCodeCache;
+
+									~VJSCodeCacheData();
+
+			uLONG8					fKey;
+			VMemoryBuffer<>			fData;
+			sLONG8					fCompileTime;
+			sLONG8					fLastUse;
+};
+
+
+/*
+	@brief	Compiled code cache shared by all the global contexts of the process.
+
+	Entries are keyed by a hash of the script source (MurmurHash64A), so that a changed source never gets stale code.
+	When a URL is evaluated with a new source, the entry of its previous source is dropped.
+	If a folder is set, entries are also written to disk and reloaded after a restart.
+
+	Only the V8 engine produces cached data (see V4DContext::EvaluateScript).
+*/
+class XTOOLBOX_API VJSCodeCache : public VObject
+{
+public:
+	enum {
+		kDEFAULT_MAX_MEMORY_SIZE = 64 * 1024 * 1024
+	};
+
+	typedef struct Statistics
+	{
+		sLONG8						fHits;					// compilations that used cached data
+		sLONG8						fMisses;
+		sLONG8						fRejections;			// cached data refused by the engine (version or flags changed)
+		sLONG8						fDiskLoads;
+		sLONG8						fDiskStores;
+		sLONG8						fCompileTime;			// microseconds spent producing cached data
+		sLONG8						fCompileTimeSaved;		// microseconds saved by using cached data
+		sLONG						fEntryCount;
+		VSize						fMemorySize;
+	} Statistics;
+
+	// created with the first V4DContext and deleted with the last one, as the JavaScript component has no init entry point.
+	static	void					Init();
+	static	void					DeInit();
+
+	// returns NULL when no context exists, in which case scripts are compiled without cache.
+	static	VJSCodeCache*			Get()						{ return sInstance; }
+
+			// the folder where entries are persisted, NULL to keep them in memory only.
+			void					SetFolder( VFolder *inFolder);
+			VFolder*				RetainFolder() const;
+
+			// least recently used entries are dropped from memory above this size.
+			void					SetMaxMemorySize( VSize inMaxSize);
+
+			// returns the cached data for a source, or NULL. Looks on disk if not found in memory.
+			VJSCodeCacheData*		RetainData( const VString& inUrl, const VString& inSource);
+
+			// stores the data produced by compiling a source.
+			void					StoreData( const VString& inUrl, const VString& inSource, const void *inData, VSize inSize, sLONG8 inCompileTime);
+
+			// reports how cached data was used by the engine. Rejected data is dropped.
+			void					ReportUsed( VJSCodeCacheData *inData, sLONG8 inCompileTime);
+			void					ReportRejected( VJSCodeCacheData *inData);
+
+			void					Clear();
+
+			void					GetStatistics( Statistics& outStatistics) const;
+
+	static	uLONG8					ComputeKey( const VString& inSource);
+
+private:
+	typedef std::map<uLONG8, VJSCodeCacheData*>		MapOfData;
+
+									VJSCodeCache();
+	virtual							~VJSCodeCache();
+
+			// fLock must be held
+			void					_Insert( VJSCodeCacheData *inData);
+			void					_Remove( uLONG8 inKey);
+			void					_Purge();
+			bool					_IsKeyUsed( uLONG8 inKey) const;
+
+			// file I/O, called without fLock
+	static	VFile*					_RetainFile( const VFolder& inFolder, uLONG8 inKey);
+	static	void					_Delete( const VFolder& inFolder, uLONG8 inKey);
+	static	VJSCodeCacheData*		_Load( const VFolder& inFolder, uLONG8 inKey, const VString& inSource);
+	static	bool					_Save( const VFolder& inFolder, const VJSCodeCacheData *inData, const VString& inSource);
+
+	static	VJSCodeCache*			sInstance;
+
+	mutable	VCriticalSection		fLock;
+			MapOfData				fData;
+			unordered_map_VString<uLONG8>	fKeysByUrl;
+			VFolder*				fFolder;
+			VSize					fMaxMemorySize;
+			sLONG8					fUseCounter;
+			Statistics				fStatistics;
+};
+
+END_TOOLBOX_NAMESPACE
+
+#endif
@@ -435,6 +435,302 @@ UniChar VJSContext::GetWildChar() const
 //======================================================
 
 
+VJSContextGroup::VJSContextGroup()
+: fPoolSize( 0)
+, fHits( 0)
+, fMisses( 0)
+, fDiscarded( 0)
+, fRefillTask( NULL)
+, fIsRefilling( false)
+{
+}
+
+
+VJSContextGroup::~VJSContextGroup()
+{
+	VTask *refillTask = NULL;
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		// the context being created, if any, won't be pooled
+		fPrewarmedDelegates.clear();
+		fPendingRefills.clear();
+		refillTask = fRefillTask;
+		fRefillTask = NULL;
+	}
+
+	if (refillTask != NULL)
+	{
+		refillTask->WaitForDeath( kMAX_sLONG);
+		refillTask->Release();
+	}
+
+	SetPoolSize( 0);
+}
+
+
+void VJSContextGroup::SetPoolSize( sLONG inPoolSize)
+{
+	VectorOfContexts contexts;
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		fPoolSize = (inPoolSize > 0) ? inPoolSize : 0;
+		while (fIdleContexts.size() > (size_t) fPoolSize)
+		{
+			contexts.push_back( fIdleContexts.back());
+			fIdleContexts.pop_back();
+		}
+	}
+
+	// released outside the lock, destroying a context may take some time
+	for (VectorOfContexts::iterator i = contexts.begin() ; i != contexts.end() ; ++i)
+		i->second->Release();
+}
+
+
+sLONG VJSContextGroup::GetPoolSize() const
+{
+	StLocker<VCriticalSection> lock( &fPoolMutex);
+
+	return fPoolSize;
+}
+
+
+void VJSContextGroup::Prewarm( IJSRuntimeDelegate *inRuntimeDelegate)
+{
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		if (!_IsPrewarmed( inRuntimeDelegate))
+			fPrewarmedDelegates.push_back( inRuntimeDelegate);
+	}
+
+	while (_AddIdleContext( inRuntimeDelegate))
+		;
+}
+
+
+void VJSContextGroup::PurgeRuntimeDelegate( IJSRuntimeDelegate *inRuntimeDelegate)
+{
+	VectorOfContexts contexts;
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		VectorOfRuntimeDelegates::iterator found = std::find( fPrewarmedDelegates.begin(), fPrewarmedDelegates.end(), inRuntimeDelegate);
+		if (found != fPrewarmedDelegates.end())
+			fPrewarmedDelegates.erase( found);
+
+		fPendingRefills.erase( std::remove( fPendingRefills.begin(), fPendingRefills.end(), inRuntimeDelegate), fPendingRefills.end());
+	}
+
+	{
+		// waits for the context the refill task may be creating for inRuntimeDelegate, it won't be pooled
+		StLocker<VCriticalSection> lock( &fRefillMutex);
+	}
+
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		for (VectorOfContexts::iterator i = fIdleContexts.begin() ; i != fIdleContexts.end() ; )
+		{
+			if (i->first == inRuntimeDelegate)
+			{
+				contexts.push_back( *i);
+				i = fIdleContexts.erase( i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	for (VectorOfContexts::iterator i = contexts.begin() ; i != contexts.end() ; ++i)
+		i->second->Release();
+}
+
+
+VJSGlobalContext* VJSContextGroup::RetainContext( IJSRuntimeDelegate *inRuntimeDelegate)
+{
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		for (VectorOfContexts::reverse_iterator i = fIdleContexts.rbegin() ; i != fIdleContexts.rend() ; ++i)
+		{
+			if (i->first == inRuntimeDelegate)
+			{
+				VJSGlobalContext *context = i->second;
+				fIdleContexts.erase( (++i).base());
+				fHits++;
+				return context;
+			}
+		}
+		fMisses++;
+	}
+
+	return _CreateContext( inRuntimeDelegate);
+}
+
+
+void VJSContextGroup::ReleaseContext( VJSGlobalContext *inContext)
+{
+	if (inContext == NULL)
+		return;
+
+	// the scripts that ran left their globals and the user state of the global object: never pool it again
+	IJSRuntimeDelegate *runtimeDelegate = NULL;
+	{
+		VJSContext context( inContext);
+		VJSGlobalObject *globalObject = context.GetGlobalObjectPrivateInstance();
+		if ( (globalObject != NULL) && (globalObject->GetContextGroup() == this) )
+			runtimeDelegate = globalObject->GetRuntimeDelegate();
+	}
+
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+		fDiscarded++;
+	}
+	inContext->Release();
+
+	if (runtimeDelegate != NULL)
+		_ScheduleRefill( runtimeDelegate);
+}
+
+
+void VJSContextGroup::GetPoolStatistics( PoolStatistics& outStatistics) const
+{
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		outStatistics.fPoolSize = fPoolSize;
+		outStatistics.fIdleCount = (sLONG) fIdleContexts.size();
+		outStatistics.fHits = fHits;
+		outStatistics.fMisses = fMisses;
+		outStatistics.fDiscarded = fDiscarded;
+	}
+	fCreationLatency.GetSnapshot( outStatistics.fCreationLatency);
+}
+
+
+Real VJSContextGroup::GetPoolHitRate() const
+{
+	StLocker<VCriticalSection> lock( &fPoolMutex);
+
+	return (fHits + fMisses > 0) ? (100.0 * fHits) / (fHits + fMisses) : 0.0;
+}
+
+
+VJSGlobalContext* VJSContextGroup::_CreateContext( IJSRuntimeDelegate *inRuntimeDelegate)
+{
+	StProfilerTimer timer( &fCreationLatency);
+
+	return VJSGlobalContext::Create( inRuntimeDelegate, VJSGlobalClass::Class(), this);
+}
+
+
+bool VJSContextGroup::_AddIdleContext( IJSRuntimeDelegate *inRuntimeDelegate)
+{
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		if ( (fIdleContexts.size() >= (size_t) fPoolSize) || !_IsPrewarmed( inRuntimeDelegate) )
+			return false;
+	}
+
+	VJSGlobalContext *context = _CreateContext( inRuntimeDelegate);
+	if (context == NULL)
+		return false;
+
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		// the pool may have been filled or the delegate purged meanwhile
+		if ( (fIdleContexts.size() < (size_t) fPoolSize) && _IsPrewarmed( inRuntimeDelegate) )
+		{
+			fIdleContexts.push_back( VectorOfContexts::value_type( inRuntimeDelegate, context));
+			return true;
+		}
+	}
+
+	context->Release();
+
+	return false;
+}
+
+
+bool VJSContextGroup::_IsPrewarmed( IJSRuntimeDelegate *inRuntimeDelegate) const
+{
+	return std::find( fPrewarmedDelegates.begin(), fPrewarmedDelegates.end(), inRuntimeDelegate) != fPrewarmedDelegates.end();
+}
+
+
+void VJSContextGroup::_ScheduleRefill( IJSRuntimeDelegate *inRuntimeDelegate)
+{
+	VTask *refillTask = NULL;
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+
+		if ( (fIdleContexts.size() + fPendingRefills.size() >= (size_t) fPoolSize) || !_IsPrewarmed( inRuntimeDelegate) )
+			return;
+
+		fPendingRefills.push_back( inRuntimeDelegate);
+		if (fIsRefilling)
+			return;
+
+		// the previous task has left its loop, the task manager keeps it until it is dead
+		ReleaseRefCountable( &fRefillTask);
+
+		fRefillTask = new VTask( NULL, 0, eTaskStylePreemptive, &VJSContextGroup::_RefillTaskProc);
+		if (fRefillTask == NULL)
+		{
+			fPendingRefills.clear();
+			return;
+		}
+		fRefillTask->SetName( CVSTR( "JS context pool refill"));
+		fRefillTask->SetKindData( (sLONG_PTR) this);
+		fIsRefilling = true;
+		refillTask = fRefillTask;
+	}
+
+	if (!refillTask->Run())
+	{
+		StLocker<VCriticalSection> lock( &fPoolMutex);
+		fPendingRefills.clear();
+		fIsRefilling = false;
+	}
+}
+
+
+//static
+sLONG VJSContextGroup::_RefillTaskProc( VTask *inTask)
+{
+	VJSContextGroup *group = (VJSContextGroup*) inTask->GetKindData();
+
+	for (;;)
+	{
+		StLocker<VCriticalSection> refillLock( &group->fRefillMutex);
+
+		IJSRuntimeDelegate *runtimeDelegate = NULL;
+		{
+			StLocker<VCriticalSection> lock( &group->fPoolMutex);
+
+			if (group->fPendingRefills.empty())
+			{
+				group->fIsRefilling = false;
+				break;
+			}
+			runtimeDelegate = group->fPendingRefills.front();
+			group->fPendingRefills.erase( group->fPendingRefills.begin());
+		}
+
+		group->_AddIdleContext( runtimeDelegate);
+	}
+
+	return 0;
+}
+
+
 VJSGlobalContext::~VJSGlobalContext()
 {
 	if (fContext != NULL) {
@@ -553,7 +849,7 @@ static void MemAllocCallback(v8::ObjectSpace inSpace, v8::AllocationAction inAll
 /*
 	static
 */
-VJSGlobalContext *VJSGlobalContext::Create( IJSRuntimeDelegate *inRuntimeDelegate, JS4D::ClassRef inGlobalClassRef)
+VJSGlobalContext *VJSGlobalContext::Create( IJSRuntimeDelegate *inRuntimeDelegate, JS4D::ClassRef inGlobalClassRef, VJSContextGroup *inContextGroup)
 {
 #if USE_V8_ENGINE
 	static v8::Isolate*		sDefaultIsolate = NULL;
@@ -581,7 +877,7 @@ VJSGlobalContext *VJSGlobalContext::Create( IJSRuntimeDelegate *inRuntimeDelegat
 			VTask::GetCurrent()->GetID());
 
 		V4DContext*			v8Ctx = new V4DContext(ref,inGlobalClassRef);
-		VJSGlobalObject*	globalObject = new VJSGlobalObject( ref, NULL, inRuntimeDelegate);
+		VJSGlobalObject*	globalObject = new VJSGlobalObject( ref, inContextGroup, inRuntimeDelegate);
 		v8Ctx->SetGlobalObjectPrivateInstance(globalObject);
 
 		HandleScope handle_scope(ref);
@@ -599,7 +895,7 @@ VJSGlobalContext *VJSGlobalContext::Create( IJSRuntimeDelegate *inRuntimeDelegat
 	JSGlobalContextRef ref = JSGlobalContextCreateInGroup( NULL, inGlobalClassRef);
 	if (ref != NULL)
 	{
-		VJSGlobalObject *globalObject = new VJSGlobalObject( ref, NULL, inRuntimeDelegate);
+		VJSGlobalObject *globalObject = new VJSGlobalObject( ref, inContextGroup, inRuntimeDelegate);
 		JSObjectSetPrivate( JSContextGetGlobalObject( ref), globalObject);
 
 		return new VJSGlobalContext( ref);
@@ -76,19 +76,85 @@ mutable JS4D::ExceptionRef		fException;
 
 
 /*
-	not thread safe.
+	A group keeps a pool of ready global contexts, so that a context can be had without paying
+	for the class registrations and bootstrap scripts of its creation.
+
+	Pooled contexts never ran any script: a context given back keeps the globals and the user state
+	of its scripts, so it is released and replaced with a new one, out of the next request.
 	
+	The pool is thread safe. It is empty until a pool size is set.
+	Runtime delegates are not retained: PurgeRuntimeDelegate() must be called before a delegate is destroyed.
 */
 class XTOOLBOX_API VJSContextGroup : public XBOX::VObject, public XBOX::IRefCountable
 {
 public:
+	typedef struct PoolStatistics
+	{
+		sLONG								fPoolSize;
+		sLONG								fIdleCount;			// contexts ready in the pool
+		sLONG8								fHits;				// contexts given from the pool
+		sLONG8								fMisses;			// contexts created on demand
+		sLONG8								fDiscarded;			// contexts given back, all released
+		VProfilerHistogram::Snapshot		fCreationLatency;	// microseconds
+	} PoolStatistics;
+
 											VJSContextGroup();
 											~VJSContextGroup();
-	
+
+			// maximum number of idle contexts kept in the pool. 0 disables the pool.
+			void							SetPoolSize( sLONG inPoolSize);
+			sLONG							GetPoolSize() const;
+
+			// creates contexts for inRuntimeDelegate until the pool is full.
+			// Typically called at startup or from a background task, to keep creations out of the requests.
+			// The contexts of inRuntimeDelegate given back are replaced until PurgeRuntimeDelegate() is called.
+			void							Prewarm( IJSRuntimeDelegate *inRuntimeDelegate);
+
+			// releases the idle contexts of inRuntimeDelegate and stops replacing its contexts.
+			// To be called once all its contexts are given back, before inRuntimeDelegate is destroyed.
+			void							PurgeRuntimeDelegate( IJSRuntimeDelegate *inRuntimeDelegate);
+
+			// returns a context of inRuntimeDelegate taken from the pool, or a new one.
+			VJSGlobalContext*				RetainContext( IJSRuntimeDelegate *inRuntimeDelegate);
+
+			// gives back a context given by RetainContext(), consuming the caller reference.
+			// The context is released. If its runtime delegate was prewarmed, a new context is created in its place by a background task when there's room for it.
+			void							ReleaseContext( VJSGlobalContext *inContext);
+
+			void							GetPoolStatistics( PoolStatistics& outStatistics) const;
+
+			// percentage of RetainContext() calls served by the pool
+			Real							GetPoolHitRate() const;
+
 private:
+	typedef std::vector<std::pair<IJSRuntimeDelegate*, VJSGlobalContext*> >	VectorOfContexts;
+	typedef std::vector<IJSRuntimeDelegate*>									VectorOfRuntimeDelegates;
+
 											VJSContextGroup( const VJSContextGroup&);	// forbidden
 											VJSContextGroup& operator=( const VJSContextGroup&);	// forbidden
 
+			VJSGlobalContext*				_CreateContext( IJSRuntimeDelegate *inRuntimeDelegate);
+
+			// creates an idle context for inRuntimeDelegate if there's room for it and the delegate was prewarmed.
+			bool							_AddIdleContext( IJSRuntimeDelegate *inRuntimeDelegate);
+			bool							_IsPrewarmed( IJSRuntimeDelegate *inRuntimeDelegate) const;
+
+			// queues the replacement of a given back context, created by the refill task out of the request.
+			void							_ScheduleRefill( IJSRuntimeDelegate *inRuntimeDelegate);
+	static	sLONG							_RefillTaskProc( VTask *inTask);
+
+	mutable	VCriticalSection				fPoolMutex;
+			VectorOfContexts				fIdleContexts;
+			VectorOfRuntimeDelegates		fPrewarmedDelegates;
+			sLONG							fPoolSize;
+			sLONG8							fHits;
+			sLONG8							fMisses;
+			sLONG8							fDiscarded;
+			VProfilerHistogram				fCreationLatency;
+			VectorOfRuntimeDelegates		fPendingRefills;
+			VTask*							fRefillTask;
+			bool							fIsRefilling;		// the refill task is in its loop
+			VCriticalSection				fRefillMutex;		// held by the refill task while it creates a context
 };
 
 //======================================================
@@ -233,7 +299,9 @@ private:
 											VJSGlobalContext( const VJSGlobalContext&);	// forbidden
 											VJSGlobalContext& operator=( const VJSGlobalContext&);	// forbidden
 
-	static	VJSGlobalContext*				Create( IJSRuntimeDelegate *inRuntimeDelegate, JS4D::ClassRef inGlobalClassRef);
+	friend class VJSContextGroup;
+
+	static	VJSGlobalContext*				Create( IJSRuntimeDelegate *inRuntimeDelegate, JS4D::ClassRef inGlobalClassRef, VJSContextGroup *inContextGroup = NULL);
 
 	JS4D::GlobalContextRef					fContext;
 
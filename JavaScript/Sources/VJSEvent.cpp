@@ -58,6 +58,164 @@ bool IJSEvent::InsertEvent (std::list<IJSEvent *> *ioEventQueue, IJSEvent *inEve
 	return isFirstPosition;
 }
 
+sLONG VJSEventQueue::sDefaultSlack = 0;
+
+VJSEventQueue::VJSEventQueue ()
+{
+	fNextSequence = 0;
+	fSlack = sDefaultSlack;
+}
+
+VJSEventQueue::~VJSEventQueue ()
+{
+	// Worker must have discarded all its events.
+
+	xbox_assert(fHeap.empty());
+}
+
+void VJSEventQueue::Push (IJSEvent *inEvent)
+{
+	xbox_assert(inEvent != NULL && inEvent->fQueueIndex < 0);
+
+	Entry	entry;
+
+	if (fSlack > 0 && inEvent->GetType() == IJSEvent::eTYPE_TIMER) {
+
+		XBOX::VTime	coalescedTime;
+		sLONG8		milliseconds;
+
+		milliseconds = inEvent->GetTriggerTime().GetMilliseconds();
+		milliseconds = (milliseconds + fSlack - 1) / fSlack * fSlack;
+		coalescedTime.FromMilliseconds(milliseconds);
+		entry.fTime = coalescedTime.GetStamp();
+
+	} else
+
+		entry.fTime = inEvent->GetTriggerTime().GetStamp();
+
+	entry.fSequence = fNextSequence++;
+	entry.fEvent = inEvent;
+
+	fHeap.push_back(entry);
+	inEvent->fQueueIndex = (sLONG) (fHeap.size() - 1);
+	_SiftUp(fHeap.size() - 1);
+}
+
+void VJSEventQueue::GetTopTime (XBOX::VTime &outTime) const
+{
+	xbox_assert(!fHeap.empty());
+
+	outTime.FromStamp(fHeap.front().fTime);
+}
+
+IJSEvent *VJSEventQueue::PopTop ()
+{
+	xbox_assert(!fHeap.empty());
+
+	IJSEvent	*event;
+
+	event = fHeap.front().fEvent;
+	_RemoveAt(0);
+
+	return event;
+}
+
+bool VJSEventQueue::Remove (IJSEvent *inEvent)
+{
+	xbox_assert(inEvent != NULL);
+
+	size_t	index;
+
+	if (inEvent->fQueueIndex < 0)
+
+		return false;
+
+	index = (size_t) inEvent->fQueueIndex;
+	xbox_assert(index < fHeap.size() && fHeap[index].fEvent == inEvent);
+
+	_RemoveAt(index);
+
+	return true;
+}
+
+void VJSEventQueue::_SiftUp (size_t inIndex)
+{
+	Entry	entry;
+
+	entry = fHeap[inIndex];
+	while (inIndex > 0) {
+
+		size_t	parent;
+
+		parent = (inIndex - 1) / 2;
+		if (!_IsBefore(entry, fHeap[parent]))
+
+			break;
+
+		_Set(inIndex, fHeap[parent]);
+		inIndex = parent;
+
+	}
+	_Set(inIndex, entry);
+}
+
+void VJSEventQueue::_SiftDown (size_t inIndex)
+{
+	Entry	entry;
+	size_t	count;
+
+	entry = fHeap[inIndex];
+	count = fHeap.size();
+	for ( ; ; ) {
+
+		size_t	child;
+
+		child = 2 * inIndex + 1;
+		if (child >= count)
+
+			break;
+
+		if (child + 1 < count && _IsBefore(fHeap[child + 1], fHeap[child]))
+
+			child++;
+
+		if (!_IsBefore(fHeap[child], entry))
+
+			break;
+
+		_Set(inIndex, fHeap[child]);
+		inIndex = child;
+
+	}
+	_Set(inIndex, entry);
+}
+
+void VJSEventQueue::_RemoveAt (size_t inIndex)
+{
+	fHeap[inIndex].fEvent->fQueueIndex = -1;
+
+	size_t	last;
+
+	last = fHeap.size() - 1;
+	if (inIndex != last) {
+
+		// Move last entry to the hole, then restore heap order in the right direction.
+
+		_Set(inIndex, fHeap[last]);
+		fHeap.pop_back();
+		if (inIndex > 0 && _IsBefore(fHeap[inIndex], fHeap[(inIndex - 1) / 2]))
+
+			_SiftUp(inIndex);
+
+		else
+
+			_SiftDown(inIndex);
+
+	} else
+
+		fHeap.pop_back();
+}
+
 VJSMessageEvent *VJSMessageEvent::Create (VJSMessagePort *inMessagePort, VJSStructuredClone *inMessage)
 {
 	xbox_assert(inMessagePort != NULL && inMessage != NULL);
@@ -389,6 +547,8 @@ VJSTimerEvent *VJSTimerEvent::Create (VJSTimer *inTimer, XBOX::VTime &inTriggerT
 	timerEvent->fTimer = inTimer;
 	timerEvent->fArguments = inArguments;
 
+	inTimer->fTimerEvent = timerEvent;
+
 	return timerEvent;
 }
 
@@ -424,25 +584,21 @@ void VJSTimerEvent::Process (XBOX::VJSContext inContext, VJSWorker *inWorker)
 
 void VJSTimerEvent::Discard ()
 {
+	fTimer->fTimerEvent = NULL;
 	fTimer->_ReleaseIfCleared();
 	delete fArguments;
 	Release();
 }
 
-void VJSTimerEvent::RemoveTimerEvent (std::list<IJSEvent *> *ioEventQueue, VJSTimer *inTimer)
+void VJSTimerEvent::RemoveTimerEvent (VJSEventQueue *ioEventQueue, VJSTimer *inTimer)
 {
-	std::list<IJSEvent *>::iterator	i;
-
-	for (i = ioEventQueue->begin(); i != ioEventQueue->end(); i++)
+	VJSTimerEvent	*timerEvent;
 
-		if ((*i)->GetType() == eTYPE_TIMER 
-		&& ((VJSTimerEvent *) (*i))->fTimer == inTimer) {
+	// If the timer event isn't queued, it is currently executing and Process() will discard it.
 
-			(*i)->Discard();
-			ioEventQueue->erase(i);
-			break;
+	if ((timerEvent = inTimer->fTimerEvent) != NULL && ioEventQueue->Remove(timerEvent))
 
-		}
+		timerEvent->Discard();
 }
 
 VJSSystemWorkerEvent *VJSSystemWorkerEvent::Create (VJSSystemWorker *inSystemWorker, sLONG inType, XBOX::VJSObject &inObjectRef, uBYTE *inData, sLONG inSize)
@@ -90,13 +90,83 @@ public:
 
 protected:
 
+friend class VJSEventQueue;
+
 	uLONG			fType;
 	XBOX::VTime		fTriggerTime;
+	sLONG			fQueueIndex;		// Position in VJSEventQueue heap, -1 if not queued.
 
-					IJSEvent ()	{}
+					IJSEvent () : fQueueIndex(-1)	{}
 	virtual			~IJSEvent()	{}
 };
 
+// Event queue of a worker, ordered by trigger time. Events with identical trigger time are processed in queuing order.
+// Implemented as an indexed binary heap: push, pop, and removal of a given event are O(log n).
+// Timer events can be coalesced: their trigger time is rounded up to a multiple of the slack, so that timers 
+// expiring close to each other are processed in the same wake-up. An event can only be in one queue at a time.
+
+class XTOOLBOX_API VJSEventQueue : public XBOX::VObject
+{
+public:
+
+					VJSEventQueue ();
+	virtual			~VJSEventQueue ();
+
+	// Slack is in milliseconds, zero (default) means no coalescing.
+
+	void			SetSlack (sLONG inSlack)	{	fSlack = inSlack > 0 ? inSlack : 0;	}
+	sLONG			GetSlack () const			{	return fSlack;						}
+
+	static void		SetDefaultSlack (sLONG inSlack)	{	sDefaultSlack = inSlack > 0 ? inSlack : 0;	}
+	static sLONG	GetDefaultSlack ()				{	return sDefaultSlack;						}
+
+	bool			IsEmpty () const			{	return fHeap.empty();				}
+	size_t			GetCount () const			{	return fHeap.size();				}
+
+	void			Push (IJSEvent *inEvent);
+
+	// Return first event to process and time at which it must be (coalesced trigger time). Queue must not be empty.
+
+	IJSEvent		*GetTop () const			{	return fHeap.front().fEvent;		}
+	void			GetTopTime (XBOX::VTime &outTime) const;
+
+	IJSEvent		*PopTop ();
+
+	// Remove given event, return false if it isn't queued (already popped).
+
+	bool			Remove (IJSEvent *inEvent);
+
+private:
+
+	typedef struct Entry
+	{
+		uLONG8		fTime;			// VTime stamp.
+		uLONG8		fSequence;		// Queuing order.
+		IJSEvent	*fEvent;
+	} Entry;
+
+	static sLONG		sDefaultSlack;
+
+	std::vector<Entry>	fHeap;
+	uLONG8				fNextSequence;
+	sLONG				fSlack;
+
+	static bool		_IsBefore (const Entry &inA, const Entry &inB)
+	{
+		return inA.fTime < inB.fTime || (inA.fTime == inB.fTime && inA.fSequence < inB.fSequence);
+	}
+
+	void			_Set (size_t inIndex, const Entry &inEntry)
+	{
+		fHeap[inIndex] = inEntry;
+		inEntry.fEvent->fQueueIndex = (sLONG) inIndex;
+	}
+
+	void			_SiftUp (size_t inIndex);
+	void			_SiftDown (size_t inIndex);
+	void			_RemoveAt (size_t inIndex);
+};
+
 // Interface to an event generator.
 
 class XTOOLBOX_API IJSEventGenerator : public XBOX::VObject, public XBOX::IRefCountable
@@ -229,7 +299,7 @@ public:
 
 	// Remove a timer event from an event queue.
 
-	static void					RemoveTimerEvent (std::list<IJSEvent *> *ioEventQueue, VJSTimer *inTimer);
+	static void					RemoveTimerEvent (VJSEventQueue *ioEventQueue, VJSTimer *inTimer);
 
 private:
 
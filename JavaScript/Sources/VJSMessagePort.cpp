@@ -233,8 +233,20 @@ void VJSMessagePort::PostMessageMethod (XBOX::VJSParms_callStaticFunction &ioPar
 
 	}
 
+	// Optional second argument is an array of ArrayBuffer objects to transfer.
+
 	XBOX::VJSValue		value		= ioParms.GetParamValue(1);
-	VJSStructuredClone	*message	= VJSStructuredClone::RetainClone(value);
+	XBOX::VJSArray		transferList(ioParms.GetContext());
+	bool				hasTransfer	= ioParms.CountParams() >= 2 && !ioParms.IsNullOrUndefinedParam(2);
+
+	if (hasTransfer && !ioParms.GetParamArray(2, transferList)) {
+
+		XBOX::vThrowError(XBOX::VE_JVSC_WRONG_PARAMETER_TYPE_ARRAY, "2");
+		return;
+
+	}
+
+	VJSStructuredClone	*message	= VJSStructuredClone::RetainClone(value, hasTransfer ? &transferList : NULL);
 
 	if (message != NULL) {
 
@@ -19,271 +19,291 @@
 
 #include "VJSContext.h"
 #include "VJSGlobalClass.h"
+#include "VJSBuffer.h"
+#include "VJSW3CArrayBuffer.h"
 
 USING_TOOLBOX_NAMESPACE
 
 
-VJSStructuredClone *VJSStructuredClone::RetainClone (const XBOX::VJSValue& inValue)
+class VJSStructuredClone::VWriter
 {
-	ValueNodeSet_t	alreadyCreated;
+public:
 
-	std::list<SEntry>					toDoList;
-	SNode								*root;
+					VWriter (std::vector<uBYTE> *ioData, const std::vector<VJSArrayBufferObject *> &inTransferList);
 
-	if ((root = _ValueToNode(inValue, &alreadyCreated, &toDoList)) == NULL)
+	// Write a JavaScript value, objects and arrays are only announced and queued, see WritePendingProperties().
+	// Return false if the value cannot be cloned.
 
-		return NULL;
-
-	while (!toDoList.empty()) {
-
-		// Property iterator will also iterate Array object indexes (they are converted into string).
+	bool			WriteValue (XBOX::VJSValue inValue);
 
-		XBOX::VJSValue				value = toDoList.front().fValue;
-		XBOX::VJSPropertyIterator	i(value.GetObject());
-		SNode						*p, *q, *r;
-
-		p = toDoList.front().fNode;
-		xbox_assert(p->fType == eNODE_OBJECT || p->fType == eNODE_ARRAY);
-		
-		toDoList.pop_front();
+	// Write properties of queued objects and arrays, until the queue is empty.
 
-		// Object or Array with no attributes?
+	bool			WritePendingProperties (const XBOX::VJSValue &inRootValue);
 
-		if (!i.IsValid()) 
+	void			WriteValueSingle (const XBOX::VValueSingle &inValue);
 
-			continue;
+	// Same for bags: a bag is written as an object, a bag array as an array.
 
-		// Get prototype and dump its attribute names.
+	void			WriteBag (const XBOX::VValueBag &inBag);
+	void			WriteBagArray (const XBOX::VBagArray &inBagArray);
+	void			WritePendingBags (bool inUniqueElementsAreNotArrays);
 
-		XBOX::VJSObject	prototypeObject	= value.GetObject().GetPrototype(inValue.GetContext());
-		bool			hasPrototype	= prototypeObject.IsObject();
+	void			PutTag (uBYTE inTag)					{	fData->push_back(inTag);	}
+	void			PutVarint (uLONG8 inValue);
+	void			PutReal (Real inValue)					{	PutBytes(&inValue, sizeof(inValue));	}
+	void			PutBytes (const void *inBytes, VSize inSize);
+	void			PutString (const XBOX::VString &inString);
+	void			PutNumber (Real inNumber);
 
-		// Iterate child(s).
+private:
 
-		for ( ; i.IsValid(); ++i) {
+	struct SPendingBag {
 
-			XBOX::VString	name;
+		const XBOX::VValueBag	*fBag;
+		const XBOX::VBagArray	*fBagArray;
 
-			i.GetPropertyName(name);
-	
-			// Check attribute name: If it is part of prototype, do not clone it.
+	};
 
-			if (hasPrototype && prototypeObject.HasProperty(name))
+	std::vector<uBYTE>							*fData;
+	XBOX::unordered_map_VString<sLONG>			fStrings;
 
-				continue;
+	// Objects and arrays already written, with their number.
+	// On V8, two handles of the same object don't have the same pointer: objects are indexed by identity hash,
+	// and VJSValue::operator== tells apart objects with the same hash.
 
-			value = i.GetProperty();
-			if ((r = _ValueToNode(value, &alreadyCreated, &toDoList)) == NULL) 
+#if USE_V8_ENGINE
+	typedef NAMESPACE_TR1::unordered_multimap<sLONG, std::pair<XBOX::VJSValue, sLONG> >	MapOfClonedObjects;
 
-				break;
+	MapOfClonedObjects									fAlreadyCloned;
+#else
+	NAMESPACE_TR1::unordered_map<JS4D::ValueRef, sLONG>	fAlreadyCloned;
+#endif
+	sLONG										fObjectCount;
 
-			else if (p->fValue.fFirstChild != NULL) 
-				
-				q->fNextSibling = r;
-						
-			else
-				
-				p->fValue.fFirstChild = r;
+	std::deque<XBOX::VJSValue>					fPendingValues;
+	std::deque<SPendingBag>						fPendingBags;
 
-			r->fName = name;
-			q = r;
+	const std::vector<VJSArrayBufferObject *>	&fTransferList;
 
-		}
+	bool			_FindAlreadyCloned (const XBOX::VJSValue &inValue, sLONG *outNumber) const;
+	void			_AddAlreadyCloned (const XBOX::VJSValue &inValue);
+	bool			_WriteArrayBuffer (VJSArrayBufferObject *inArrayBuffer);
+};
 
-		if (p->fValue.fFirstChild != NULL) 
+class VJSStructuredClone::VReader
+{
+public:
 
-			q->fNextSibling = NULL;
+					VReader (const std::vector<uBYTE> &inData, const std::vector<VJSBufferObject *> &inTransferred, XBOX::VJSContext inContext);
 
-		if (i.IsValid()) {
+	// Read a value, objects and arrays are created empty and queued, see ReadPendingProperties().
+	// Return false if data is corrupted.
 
-			_FreeNode(root);
-			root = NULL;
-			break;
+	bool			ReadValue (XBOX::VJSValue *outValue);
+	bool			ReadPendingProperties ();
 
-		} 	
+private:
 
-	}
+	const uBYTE							*fPosition;
+	const uBYTE							*fEnd;
+	const std::vector<VJSBufferObject*>	&fTransferred;
+	XBOX::VJSContext					fContext;
+	std::vector<XBOX::VString>			fStrings;
+	std::vector<XBOX::VJSValue>			fObjects;
+	std::deque<XBOX::VJSValue>			fPendingValues;
 
-	if (root != NULL) {
+	bool			_GetVarint (uLONG8 *outValue);
+	bool			_GetReal (Real *outValue);
+	bool			_GetString (XBOX::VString *outString);
+	void			_AddObject (const XBOX::VJSValue &inValue)	{	fObjects.push_back(inValue);	}
+};
 
-		VJSStructuredClone	*structuredClone;
+VJSStructuredClone::VWriter::VWriter (std::vector<uBYTE> *ioData, const std::vector<VJSArrayBufferObject *> &inTransferList)
+: fData(ioData)
+, fObjectCount(0)
+, fTransferList(inTransferList)
+{
+}
 
-		if ((structuredClone = new VJSStructuredClone()) != NULL)
+void VJSStructuredClone::VWriter::PutVarint (uLONG8 inValue)
+{
+	while (inValue >= 0x80) {
 
-			structuredClone->fRoot = root;
+		fData->push_back((uBYTE) (inValue | 0x80));
+		inValue >>= 7;
 
-		else
+	}
+	fData->push_back((uBYTE) inValue);
+}
 
-			_FreeNode(root);
+void VJSStructuredClone::VWriter::PutBytes (const void *inBytes, VSize inSize)
+{
+	if (inSize > 0) {
 
-		return structuredClone;
+		size_t	position	= fData->size();
 
-	} else
+		fData->resize(position + inSize);
+		::memcpy(&(*fData)[position], inBytes, inSize);
 
-		return NULL;
+	}
 }
 
-VJSStructuredClone* VJSStructuredClone::RetainCloneForVValueSingle( const XBOX::VValueSingle& inValue)
+void VJSStructuredClone::VWriter::PutString (const XBOX::VString &inString)
 {
-	VJSStructuredClone *structuredClone = NULL;
-
-	SNode *valueNode = _VValueSingleToNode( inValue);
-	if (valueNode != NULL)
-	{	
-		valueNode->fNextSibling = NULL;
-		if ((structuredClone = new VJSStructuredClone()) != NULL)
-			structuredClone->fRoot = valueNode;
-		else
-			_FreeNode( valueNode);
-	}
+	XBOX::unordered_map_VString<sLONG>::iterator	i;
 
-	return structuredClone;
-}
+	if ((i = fStrings.find(inString)) != fStrings.end()) {
 
-VJSStructuredClone* VJSStructuredClone::RetainCloneForVBagArray( const XBOX::VBagArray& inBagArray, bool inUniqueElementsAreNotArrays)
-{
-	VJSStructuredClone *structuredClone = NULL;
-
-	SNode *arrayNode = _VBagArrayToNode( inBagArray, inUniqueElementsAreNotArrays);
-	if (arrayNode != NULL)
-	{	
-		arrayNode->fNextSibling = NULL;
-		if ((structuredClone = new VJSStructuredClone()) != NULL)
-			structuredClone->fRoot = arrayNode;
-		else
-			_FreeNode( arrayNode);
-	}
+		PutVarint(((uLONG8) i->second) << 1);
 
-	return structuredClone;
-}
-	
-VJSStructuredClone* VJSStructuredClone::RetainCloneForVValueBag( const XBOX::VValueBag& inBag, bool inUniqueElementsAreNotArrays)
-{
-	VJSStructuredClone *structuredClone = NULL;
+	} else {
 
-	SNode *bagNode = _VValueBagToNode( inBag, inUniqueElementsAreNotArrays);
-	if (bagNode != NULL)
-	{
-		bagNode->fNextSibling = NULL;
-		if ((structuredClone = new VJSStructuredClone()) != NULL)
-			structuredClone->fRoot = bagNode;
-		else
-			_FreeNode( bagNode);
-	}
+		sLONG	index	= (sLONG) fStrings.size();
 
-	return structuredClone;
+		fStrings.insert(XBOX::unordered_map_VString<sLONG>::value_type(inString, index));
+		PutVarint((((uLONG8) index) << 1) | 1);
+		PutVarint(inString.GetLength());
+		PutBytes(inString.GetCPointer(), inString.GetLength() * sizeof(UniChar));
 
+	}
 }
 
-XBOX::VJSValue VJSStructuredClone::MakeValue (XBOX::VJSContext inContext)
+void VJSStructuredClone::VWriter::PutNumber (Real inNumber)
 {
-	XBOX::VJSValue	root(inContext);
+	// Most numbers are small integers, avoid 8 bytes for them. -0 must stay a Real.
 
-	if (fRoot == NULL)
+	if (inNumber >= kMIN_sLONG && inNumber <= kMAX_sLONG && (Real) (sLONG) inNumber == inNumber && (inNumber != 0 || 1 / inNumber > 0)) {
 
-		root.SetUndefined();
+		sLONG	value	= (sLONG) inNumber;
 
-	else {
-		std::map<SNode *, XBOX::VJSValue>	alreadyCreated;
-		std::list<SEntry>					toDoList;
+		PutTag(eTAG_INTEGER);
+		PutVarint(((uLONG) value << 1) ^ (uLONG) (value >> 31));
 
-		xbox_assert(fRoot->fType != eNODE_REFERENCE);
-		root = _NodeToValue(inContext, fRoot, &alreadyCreated, &toDoList);
-		while (!toDoList.empty()) {
+	} else {
 
-			XBOX::VJSObject	object = toDoList.front().fValue.GetObject((VJSException*)NULL);
-			SNode			*p;
+		PutTag(eTAG_NUMBER);
+		PutReal(inNumber);
+
+	}
+}
 
-			p = toDoList.front().fNode;
-			xbox_assert(p->fType == eNODE_OBJECT || p->fType == eNODE_ARRAY);
+bool VJSStructuredClone::VWriter::_FindAlreadyCloned (const XBOX::VJSValue &inValue, sLONG *outNumber) const
+{
+#if USE_V8_ENGINE
+	std::pair<MapOfClonedObjects::const_iterator, MapOfClonedObjects::const_iterator>	range;
 
-			p = p->fValue.fFirstChild;
-			while (p != NULL) {
+	range = fAlreadyCloned.equal_range(inValue.GetIdentityHash());
+	for (MapOfClonedObjects::const_iterator i = range.first; i != range.second; ++i) {
 
-				object.SetProperty(p->fName, _NodeToValue(inContext, p, &alreadyCreated, &toDoList));
-				p = p->fNextSibling;
+		if (i->second.first == inValue) {
 
-			}
-			
-			toDoList.pop_front();
+			*outNumber = i->second.second;
+			return true;
 
 		}
 
-	} 
+	}
+	return false;
+#else
+	NAMESPACE_TR1::unordered_map<JS4D::ValueRef, sLONG>::const_iterator	i;
 
-	return root;
+	if ((i = fAlreadyCloned.find(inValue.GetValueRef())) != fAlreadyCloned.end()) {
+
+		*outNumber = i->second;
+		return true;
+
+	} else
+
+		return false;
+#endif
 }
 
-VJSStructuredClone::VJSStructuredClone ()
+void VJSStructuredClone::VWriter::_AddAlreadyCloned (const XBOX::VJSValue &inValue)
 {
-	fRoot = NULL;
+#if USE_V8_ENGINE
+	fAlreadyCloned.insert(MapOfClonedObjects::value_type(inValue.GetIdentityHash(), std::pair<XBOX::VJSValue, sLONG>(inValue, fObjectCount++)));
+#else
+	fAlreadyCloned[inValue.GetValueRef()] = fObjectCount++;
+#endif
 }
 
-VJSStructuredClone::~VJSStructuredClone ()
+bool VJSStructuredClone::VWriter::_WriteArrayBuffer (VJSArrayBufferObject *inArrayBuffer)
 {
-	if (fRoot != NULL)
+	// A neutered ArrayBuffer cannot be cloned.
 
-		_FreeNode(fRoot);
-}
+	if (inArrayBuffer->IsNeutered())
 
-// _ValueToNode() allocate memory for the node, then set fType member, and if needed, set fValue. fName and fNextSibling are untouched.
-VJSStructuredClone::SNode *VJSStructuredClone::_ValueToNode(XBOX::VJSValue inValue, ValueNodeSet_t *ioAlreadyCloned, std::list<SEntry> *ioToDoList)
-{
-	xbox_assert(ioAlreadyCloned != NULL && ioToDoList != NULL);
+		return false;
 
-	SNode	*p;
+	std::vector<VJSArrayBufferObject *>::const_iterator	i;
 
-	if ((p = new SNode()) == NULL)
+	i = std::find(fTransferList.begin(), fTransferList.end(), inArrayBuffer);
+	if (i != fTransferList.end()) {
 
-		return NULL;
+		PutTag(eTAG_TRANSFERRED_ARRAY_BUFFER);
+		PutVarint(i - fTransferList.begin());
+
+	} else {
+
+		PutTag(eTAG_ARRAY_BUFFER);
+		PutVarint(inArrayBuffer->GetDataSize());
+		PutBytes(inArrayBuffer->GetDataPtr(), inArrayBuffer->GetDataSize());
+
+	}
+	return true;
+}
 
+bool VJSStructuredClone::VWriter::WriteValue (XBOX::VJSValue inValue)
+{
 	switch (inValue.GetType()) {
 
 		case JS4D::eTYPE_UNDEFINED: 
 
-			p->fType = eNODE_UNDEFINED;
-			break;
+			PutTag(eTAG_UNDEFINED);
+			return true;
 
 		case JS4D::eTYPE_NULL:
 
-			p->fType = eNODE_NULL;
-			break;
+			PutTag(eTAG_NULL);
+			return true;
 
-		case JS4D::eTYPE_BOOLEAN:
+		case JS4D::eTYPE_BOOLEAN: {
 
-			p->fType = eNODE_BOOLEAN;
-			if (!inValue.GetBool(&p->fValue.fBoolean)) {
+			bool	boolean;
 
-				delete p;
-				p = NULL;
+			if (!inValue.GetBool(&boolean))
 
-			}
-			break;
+				return false;
+
+			PutTag(boolean ? eTAG_TRUE : eTAG_FALSE);
+			return true;
+
+		}
     	
-		case JS4D::eTYPE_NUMBER:
+		case JS4D::eTYPE_NUMBER: {
 
-			p->fType = eNODE_NUMBER;
-			if (!inValue.GetReal(&p->fValue.fNumber)) {
+			Real	number;
 
-				delete p;
-				p = NULL;
+			if (!inValue.GetReal(&number))
 
-			}
-			break;
+				return false;
+
+			PutNumber(number);
+			return true;
+
+		}
 
 		case JS4D::eTYPE_STRING: {
 
 			XBOX::VString	string;
 
-			p->fType = eNODE_STRING;
-			if (!inValue.GetString(string) || (p->fValue.fString = new XBOX::VString(string)) == NULL) {
-
-				delete p;
-				p = NULL;
+			if (!inValue.GetString(string))
 
-			}
+				return false;
 
-			break;
+			PutTag(eTAG_STRING);
+			PutString(string);
+			return true;
 
 		}
 
@@ -291,180 +311,180 @@ VJSStructuredClone::SNode *VJSStructuredClone::_ValueToNode(XBOX::VJSValue inVal
 
 			std::vector<VJSValue>	emptyArgument;	
 			XBOX::VString			string;
+			sLONG					number;
 
 			if (inValue.IsInstanceOfBoolean()) {
 
-				p->fType = eNODE_BOOLEAN_OBJECT;
+				bool	boolean;
+
 				if (!inValue.GetObject().CallMemberFunction("valueOf", &emptyArgument, &inValue)
-				|| !inValue.GetBool(&p->fValue.fBoolean)) {
+				|| !inValue.GetBool(&boolean))
 
-					delete p;
-					p = NULL;
+					return false;
 
-				}
+				PutTag(eTAG_BOOLEAN_OBJECT);
+				PutTag(boolean ? 1 : 0);
 
 			}
 			else if (inValue.IsInstanceOfNumber()) {
 
-				p->fType = eNODE_NUMBER_OBJECT;
+				Real	real;
+
 				if (!inValue.GetObject().CallMemberFunction("valueOf", &emptyArgument, &inValue)
-				|| !inValue.GetReal(&p->fValue.fNumber)) {
+				|| !inValue.GetReal(&real))
 
-					delete p;
-					p = NULL;
+					return false;
 
-				}
+				PutTag(eTAG_NUMBER_OBJECT);
+				PutReal(real);
 
 			}
 			else if (inValue.IsInstanceOfString()) {
 
-				p->fType = eNODE_STRING_OBJECT;
 				if (!inValue.GetObject().CallMemberFunction("valueOf", &emptyArgument, &inValue)
-				|| !inValue.GetString(string)
-				|| (p->fValue.fString = new XBOX::VString(string)) == NULL) {
-			
-					delete p;
-					p = NULL;
+				|| !inValue.GetString(string))
 
-				}
+					return false;
+
+				PutTag(eTAG_STRING_OBJECT);
+				PutString(string);
 
 			}
 			else if (inValue.IsInstanceOfDate()) {
 
 				// getTime() will return the date as milliseconds since 1-01-1970 (UNIX time).
 
-				p->fType = eNODE_DATE_OBJECT;
+				Real	time;
+
 				if (!inValue.GetObject().CallMemberFunction("getTime", &emptyArgument, &inValue)
-				|| !inValue.GetReal(&p->fValue.fNumber)) {
-			
-					delete p;
-					p = NULL;
+				|| !inValue.GetReal(&time))
 
-				}
+					return false;
+
+				PutTag(eTAG_DATE_OBJECT);
+				PutReal(time);
 
 			}
 			else if (inValue.IsInstanceOfRegExp()) {
 
 				// toString() will return the "complete" (along with modifier flag(s)) regular expression. 
 			
-				p->fType = eNODE_REG_EXP_OBJECT;
 				if (!inValue.GetObject().CallMemberFunction("toString", &emptyArgument, &inValue)
-				|| !inValue.GetString(string)
-				|| (p->fValue.fString = new XBOX::VString(string)) == NULL) {
-			
-					delete p;
-					p = NULL;
+				|| !inValue.GetString(string))
 
-				}
+					return false;
+
+				PutTag(eTAG_REG_EXP_OBJECT);
+				PutString(string);
 				
 			} else if (_IsSerializable(inValue)) {
 				
 				// Serialize object if possible.
+
+				XBOX::VString	constructorName;
 				
-				p->fType = eNODE_SERIALIZABLE;
-				if ((p->fValue.fSerializationData.fConstructorName = new XBOX::VString()) == NULL) {
-					
-					delete p;
-					p = NULL;
-				
-				} else if ((p->fValue.fSerializationData.fJSON = new XBOX::VString()) == NULL) {
-					
-					delete p->fValue.fSerializationData.fConstructorName;
-					delete p;
-					p = NULL;
-				
-				} else {
-					
-					if (!inValue.GetObject().GetPropertyAsString("constructorName", NULL, *p->fValue.fSerializationData.fConstructorName)
-					|| !inValue.GetObject().CallMemberFunction("serialize", &emptyArgument, &inValue)
-					|| !inValue.GetString(*p->fValue.fSerializationData.fJSON)) {
-					
-						_FreeNode(p);
-						p = NULL;
-						
-					}					
-					
-				}				
+				if (!inValue.GetObject().GetPropertyAsString("constructorName", NULL, constructorName)
+				|| !inValue.GetObject().CallMemberFunction("serialize", &emptyArgument, &inValue)
+				|| !inValue.GetString(string))
+
+					return false;
+
+				PutTag(eTAG_SERIALIZABLE);
+				PutString(constructorName);
+				PutString(string);
 
 			} else if (inValue.IsFunction()) {
 
-				delete p;
-				p = NULL;
+				return false;
+
+			} else if (_FindAlreadyCloned(inValue, &number)) {
+
+				xbox_assert(inValue.IsObject());
+
+				PutTag(eTAG_REFERENCE);
+				PutVarint(number);
 
 			} else {
 
-				// Object or Array.
-#if USE_V8_ENGINE
-				SNode*	foundNode = NULL;
-				// search if value has already been cloned
-				for (ValueNodeSet_t::iterator iter = ioAlreadyCloned->begin(); iter != ioAlreadyCloned->end(); ++iter)
-				{
-					// use the v8 equals operator (implemented in VJSValue::operator== )
-					if ((*iter).value == inValue)
-					{
-						foundNode = (*iter).snode;
-						break;
-					}
-				}
+				VJSArrayBufferObject	*arrayBuffer;
 
-				if (foundNode)
-#else
-				ValueNodeSet_t::iterator	j;
-				if ((j = ioAlreadyCloned->find(inValue)) != ioAlreadyCloned->end())
-#endif
-				{
+				if ((arrayBuffer = inValue.GetObject().GetPrivateData<VJSArrayBufferClass>()) != NULL) {
 
-					// Already cloned.
+					if (!_WriteArrayBuffer(arrayBuffer))
 
-					xbox_assert(inValue.IsObject());
+						return false;
 
-					p->fType = eNODE_REFERENCE;
-#if USE_V8_ENGINE
-					p->fValue.fReference = foundNode;
-#else
-					p->fValue.fReference = j->second;
-#endif
 				} else {
 
-					SEntry	entry(inValue.GetContext());
+					// Object or Array, properties are written when dequeued.
 
-					p->fType = inValue.IsArray() ? eNODE_ARRAY : eNODE_OBJECT;
-					p->fValue.fFirstChild = NULL;
-			
-					// Mark as already cloned and add to "todo" list.
-#if USE_V8_ENGINE
-					ioAlreadyCloned->push_back( ValueNode_st( inValue,p ) );
-#else
-					ioAlreadyCloned->insert( std::pair<VJSValue,SNode*>( inValue,p ) );
-#endif
-					entry.fValue = inValue;
-					entry.fNode = p;
-					ioToDoList->push_back(entry);
+					PutTag(inValue.IsArray() ? eTAG_ARRAY : eTAG_OBJECT);
+					fPendingValues.push_back(inValue);
 
 				}
-	
+				_AddAlreadyCloned(inValue);
+
 			}
-			break;
+			return true;
 
 		}
 
 		default:
 
 			xbox_assert(false);
-			break;
+			return false;
 
 	}
-
-	return p;
 }
 
-VJSStructuredClone::SNode* VJSStructuredClone::_VValueSingleToNode( const XBOX::VValueSingle& inValue)
+bool VJSStructuredClone::VWriter::WritePendingProperties (const XBOX::VJSValue &inRootValue)
 {
-	SNode *valueNode;
+	while (!fPendingValues.empty()) {
 
-	if ((valueNode = new SNode()) == NULL)
-		return NULL;
+		// Property iterator will also iterate Array object indexes (they are converted into string).
+
+		XBOX::VJSValue				value	= fPendingValues.front();
+		XBOX::VJSPropertyIterator	i(value.GetObject());
+
+		fPendingValues.pop_front();
+
+		// Object or Array with no attributes?
+
+		if (i.IsValid()) {
+
+			// Get prototype and dump its attribute names.
+
+			XBOX::VJSObject	prototypeObject	= value.GetObject().GetPrototype(inRootValue.GetContext());
+			bool			hasPrototype	= prototypeObject.IsObject();
 
+			for ( ; i.IsValid(); ++i) {
+
+				XBOX::VString	name;
+
+				i.GetPropertyName(name);
+	
+				// Check attribute name: If it is part of prototype, do not clone it.
+
+				if (hasPrototype && prototypeObject.HasProperty(name))
+
+					continue;
+
+				PutString(name);
+				if (!WriteValue(i.GetProperty()))
+
+					return false;
+
+			}
+
+		}
+		PutTag(eTAG_END);
+
+	}
+	return true;
+}
+
+void VJSStructuredClone::VWriter::WriteValueSingle (const XBOX::VValueSingle &inValue)
+{
 	switch (inValue.GetValueKind())
 	{
 		case VK_STRING:
@@ -472,19 +492,14 @@ VJSStructuredClone::SNode* VJSStructuredClone::_VValueSingleToNode( const XBOX::
 		{
 			XBOX::VString val;
 
-			valueNode->fType = eNODE_STRING;
 			inValue.GetString( val);
-			if ((valueNode->fValue.fString = new XBOX::VString( val)) == NULL)
-			{
-				delete valueNode;
-				valueNode = NULL;
-			}
+			PutTag( eTAG_STRING);
+			PutString( val);
 			break;
 		}
 
 		case VK_BOOLEAN:
-			valueNode->fType = eNODE_BOOLEAN;
-			valueNode->fValue.fBoolean = (inValue.GetBoolean()) ? true : false;
+			PutTag( inValue.GetBoolean() ? eTAG_TRUE : eTAG_FALSE);
 			break;
 
 		case VK_BYTE:
@@ -495,283 +510,567 @@ VJSStructuredClone::SNode* VJSStructuredClone::_VValueSingleToNode( const XBOX::
 		case VK_FLOAT:
 		case VK_TIME:
 		case VK_DURATION:
-			valueNode->fType = eNODE_NUMBER;
-			valueNode->fValue.fNumber = inValue.GetReal();
+			PutNumber( inValue.GetReal());
 			break;
 
 		default:
 			xbox_assert( false);
+			PutTag( eTAG_UNDEFINED);
 			break;
 	}
+}
+
+void VJSStructuredClone::VWriter::WriteBag (const XBOX::VValueBag& inBag)
+{
+	SPendingBag	pending = { &inBag, NULL };
 
-	return valueNode;
+	PutTag( eTAG_OBJECT);
+	fPendingBags.push_back( pending);
+	fObjectCount++;
 }
 
-VJSStructuredClone::SNode* VJSStructuredClone::_VBagArrayToNode( const XBOX::VBagArray& inBagArray, bool inUniqueElementsAreNotArrays)
+void VJSStructuredClone::VWriter::WriteBagArray (const XBOX::VBagArray& inBagArray)
 {
-	SNode *arrayNode;
-	
-	if ((arrayNode = new SNode()) == NULL)
-		return NULL;
-	
-	arrayNode->fType = eNODE_ARRAY;
-	arrayNode->fValue.fFirstChild = NULL;
+	SPendingBag	pending = { NULL, &inBagArray };
 
-	SNode *curNode = NULL;
+	PutTag( eTAG_ARRAY);
+	fPendingBags.push_back( pending);
+	fObjectCount++;
+}
 
-	VIndex elementsCount = inBagArray.GetCount();
-	VIndex jsArrayIndex = 0;
-	VString propertyName;
-	for (VIndex elementIter = 1 ; elementIter <= elementsCount ; ++elementIter)
+void VJSStructuredClone::VWriter::WritePendingBags (bool inUniqueElementsAreNotArrays)
+{
+	while (!fPendingBags.empty())
 	{
-		const VValueBag *elementBag = inBagArray.GetNth( elementIter);
-		if (elementBag != NULL)
+		SPendingBag pending = fPendingBags.front();
+		fPendingBags.pop_front();
+
+		if (pending.fBagArray != NULL)
 		{
-			SNode *elemNode = _VValueBagToNode( *elementBag, inUniqueElementsAreNotArrays);
-			if (elemNode != NULL)
+			VIndex elementsCount = pending.fBagArray->GetCount();
+			VIndex jsArrayIndex = 0;
+			VString propertyName, indexName;
+			for (VIndex elementIter = 1 ; elementIter <= elementsCount ; ++elementIter)
 			{
-				elemNode->fName.FromLong( jsArrayIndex++);
-				elemNode->fNextSibling = NULL;
+				const VValueBag *elementBag = pending.fBagArray->GetNth( elementIter);
+				if (elementBag != NULL)
+				{
+					indexName.FromLong( jsArrayIndex++);
+					PutString( indexName);
 
-				if (curNode == NULL)
-					curNode = arrayNode->fValue.fFirstChild = elemNode;
-				else
-					curNode = curNode->fNextSibling = elemNode;
+					sLONG elementNumber = fObjectCount;
+					WriteBag( *elementBag);
 
-				if (elementBag->GetAttribute( L"____property_name_in_jsarray", propertyName))
-				{
-					// Append a property which reference the array element
-					elemNode = new SNode();
-					if (elemNode != NULL)
+					if (elementBag->GetAttribute( L"____property_name_in_jsarray", propertyName))
 					{
-						elemNode->fType = eNODE_REFERENCE;
-						elemNode->fName.FromString( propertyName);
-						elemNode->fValue.fReference = curNode;
-						elemNode->fNextSibling = NULL;
-
-						curNode = curNode->fNextSibling = elemNode;
+						// Append a property which reference the array element
+						PutString( propertyName);
+						PutTag( eTAG_REFERENCE);
+						PutVarint( elementNumber);
 					}
 				}
 			}
 		}
-	}
-		
-	return arrayNode;
-}
-
-VJSStructuredClone::SNode* VJSStructuredClone::_VValueBagToNode( const XBOX::VValueBag& inBag, bool inUniqueElementsAreNotArrays)
-{
-	// inspired from VValueBag::GetJSONString
-	SNode *bagNode = NULL;
-	
-	if ((bagNode = new SNode()) == NULL)
-		return NULL;
-	
-	bagNode->fType = eNODE_OBJECT;
-	bagNode->fValue.fFirstChild = NULL;
-	
-	SNode *curNode = NULL;
-
-	// Iterate the attributes
-	VString attName;
-	VIndex attCount = inBag.GetAttributesCount();
-	for (VIndex attIndex = 1 ; attIndex <= attCount ; ++attIndex)
-	{
-		const VValueSingle *attValue = inBag.GetNthAttribute( attIndex, &attName);
-		if ((attName != L"____objectunic") && (attName != L"____property_name_in_jsarray"))
+		else
 		{
-			SNode *attNode = NULL;
+			// inspired from VValueBag::GetJSONString
+			const VValueBag& bag = *pending.fBag;
 
-			if (attValue != NULL)
+			// Iterate the attributes
+			VString attName;
+			VIndex attCount = bag.GetAttributesCount();
+			for (VIndex attIndex = 1 ; attIndex <= attCount ; ++attIndex)
 			{
-				attNode = _VValueSingleToNode( *attValue);
-			}
-			else
-			{
-				VString emptyString;
-				attNode = _VValueSingleToNode( emptyString);
+				const VValueSingle *attValue = bag.GetNthAttribute( attIndex, &attName);
+				if ((attName != L"____objectunic") && (attName != L"____property_name_in_jsarray"))
+				{
+					VValueBag::StKey CDataBagKey( attName);
+					if (CDataBagKey.Equal( VValueBag::CDataAttributeName()))
+						attName = "__cdata";
+
+					PutString( attName);
+					if (attValue != NULL)
+						WriteValueSingle( *attValue);
+					else
+						WriteValueSingle( VString());
+				}
 			}
 
-			if (attNode != NULL)
+			// Iterate the elements
+			VString elementName;
+			VIndex elementNamesCount = bag.GetElementNamesCount();
+			for (VIndex elementNamesIndex = 1 ; elementNamesIndex <= elementNamesCount ; ++elementNamesIndex)
 			{
-				VValueBag::StKey CDataBagKey( attName);
-				if (CDataBagKey.Equal( VValueBag::CDataAttributeName()))
-					attName = "__cdata";
-
-				attNode->fName.FromString( attName);
-				attNode->fNextSibling = NULL;
-				if (curNode == NULL)
-					curNode = bagNode->fValue.fFirstChild = attNode;
-				else
-					curNode = curNode->fNextSibling = attNode;
+				const VBagArray* bagArray = bag.GetNthElementName( elementNamesIndex, &elementName);
+				if (bagArray != NULL)
+				{
+					PutString( elementName);
+
+					if ((bagArray->GetCount() == 1) && inUniqueElementsAreNotArrays)
+						WriteBag( *bagArray->GetNth(1));
+					else if ((bagArray->GetCount() > 0) && (bagArray->GetNth(1)->GetAttribute("____objectunic") != NULL))
+						WriteBag( *bagArray->GetNth(1));
+					else
+						WriteBagArray( *bagArray);
+				}
 			}
 		}
+
+		PutTag( eTAG_END);
 	}
+}
 
-	// Iterate the elements
-	VString elementName;
-	VIndex elementNamesCount = inBag.GetElementNamesCount();
-	for (VIndex elementNamesIndex = 1 ; elementNamesIndex <= elementNamesCount ; ++elementNamesIndex)
-	{
-		const VBagArray* bagArray = inBag.GetNthElementName( elementNamesIndex, &elementName);
-		if (bagArray != NULL)
-		{
-			SNode *elemNode = NULL;
+VJSStructuredClone::VReader::VReader (const std::vector<uBYTE> &inData, const std::vector<VJSBufferObject *> &inTransferred, XBOX::VJSContext inContext)
+: fPosition(inData.empty() ? NULL : &inData[0])
+, fEnd(inData.empty() ? NULL : &inData[0] + inData.size())
+, fTransferred(inTransferred)
+, fContext(inContext)
+{
+}
 
-			if ((bagArray->GetCount() == 1) && inUniqueElementsAreNotArrays)
-			{
-				elemNode = _VValueBagToNode( *bagArray->GetNth(1), inUniqueElementsAreNotArrays);
-			}
-			else if (bagArray->GetNth(1)->GetAttribute("____objectunic") != NULL)
-			{
-				elemNode = _VValueBagToNode( *bagArray->GetNth(1), inUniqueElementsAreNotArrays);
-			}
-			else
-			{
-				elemNode = _VBagArrayToNode( *bagArray, inUniqueElementsAreNotArrays);
-			}
+bool VJSStructuredClone::VReader::_GetVarint (uLONG8 *outValue)
+{
+	uLONG8	value	= 0;
+	sLONG	shift	= 0;
 
-			if (elemNode != NULL)
-			{
-				elemNode->fName.FromString( elementName);
-				elemNode->fNextSibling = NULL;
+	for ( ; ; ) {
+
+		if (fPosition >= fEnd || shift >= 64)
+
+			return false;
+
+		uBYTE	byte	= *fPosition++;
+
+		value |= ((uLONG8) (byte & 0x7f)) << shift;
+		if (!(byte & 0x80))
+
+			break;
+
+		shift += 7;
 
-				if (curNode == NULL)
-					curNode = bagNode->fValue.fFirstChild = elemNode;
-				else
-					curNode = curNode->fNextSibling = elemNode;
-			}
-		}
 	}
+	*outValue = value;
+	return true;
+}
+
+bool VJSStructuredClone::VReader::_GetReal (Real *outValue)
+{
+	if (fEnd - fPosition < (sLONG) sizeof(Real))
+
+		return false;
 
-	return bagNode;
+	::memcpy(outValue, fPosition, sizeof(Real));
+	fPosition += sizeof(Real);
+	return true;
 }
 
+bool VJSStructuredClone::VReader::_GetString (XBOX::VString *outString)
+{
+	uLONG8	reference, length;
+
+	if (!_GetVarint(&reference))
+
+		return false;
+
+	if (reference & 1) {
+
+		if (!_GetVarint(&length) || (uLONG8) (fEnd - fPosition) < length * sizeof(UniChar))
 
-XBOX::VJSValue VJSStructuredClone::_NodeToValue(XBOX::VJSContext inContext, SNode *inNode, std::map<SNode *, XBOX::VJSValue> *ioAlreadyCreated, std::list<SEntry> *ioToDoList)
+			return false;
+
+		outString->FromBlock(fPosition, (VSize) length * sizeof(UniChar), XBOX::VTC_UTF_16);
+		fPosition += length * sizeof(UniChar);
+		fStrings.push_back(*outString);
+		return true;
+
+	} else if ((reference >> 1) < fStrings.size()) {
+
+		*outString = fStrings[(size_t) (reference >> 1)];
+		return true;
+
+	} else
+
+		return false;
+}
+
+bool VJSStructuredClone::VReader::ReadValue (XBOX::VJSValue *outValue)
 {
-	xbox_assert(ioAlreadyCreated != NULL && ioToDoList != NULL);
+	if (fPosition >= fEnd)
 
-	XBOX::VJSValue	value(inContext);
+		return false;
+
+	uBYTE			tag		= *fPosition++;
+	XBOX::VString	string;
+	Real			number;
+	uLONG8			varint;
 
-	switch (inNode->fType) {
+	switch (tag) {
 
-		case eNODE_UNDEFINED:
+		case eTAG_UNDEFINED:
 	
-			value.SetUndefined();
-			break;
+			outValue->SetUndefined();
+			return true;
 
-		case eNODE_NULL:
+		case eTAG_NULL:
 
-			value.SetNull();
-			break;
+			outValue->SetNull();
+			return true;
 
-		case eNODE_BOOLEAN:
+		case eTAG_FALSE:
+		case eTAG_TRUE:
 				
-			value.SetBool(inNode->fValue.fBoolean);
-			break;
+			outValue->SetBool(tag == eTAG_TRUE);
+			return true;
 
-		case eNODE_NUMBER:
+		case eTAG_INTEGER:
 
-			value.SetNumber<Real>(inNode->fValue.fNumber);
-			break;
+			if (!_GetVarint(&varint))
 
-		case eNODE_STRING:
+				return false;
 
-			value.SetString(*inNode->fValue.fString);
-			break;
+			outValue->SetNumber<sLONG>((sLONG) ((uLONG) varint >> 1) ^ -(sLONG) (varint & 1));
+			return true;
 
-		case eNODE_BOOLEAN_OBJECT: 
+		case eTAG_NUMBER:
 
-			value.SetBool(inNode->fValue.fBoolean);
-			value = _ConstructObject(inContext, "Boolean", value);
-			break;
+			if (!_GetReal(&number))
 
-		case eNODE_NUMBER_OBJECT:
+				return false;
 
-			value.SetNumber(inNode->fValue.fNumber);
-			value = _ConstructObject(inContext, "Number", value);
-			break;
+			outValue->SetNumber<Real>(number);
+			return true;
 
-		case eNODE_STRING_OBJECT:
-		case eNODE_REG_EXP_OBJECT: 
+		case eTAG_STRING:
 
-			value.SetString(*inNode->fValue.fString);
-			value = _ConstructObject(inContext, inNode->fType == eNODE_STRING_OBJECT ? "String" : "RegExp", value);
-			break;
+			if (!_GetString(&string))
 
-		case eNODE_DATE_OBJECT: 
+				return false;
 
-			value.SetNumber(inNode->fValue.fNumber);
-			value = _ConstructObject(inContext, "Date", value);
-			break;
+			outValue->SetString(string);
+			return true;
+
+		case eTAG_BOOLEAN_OBJECT: 
+
+			if (fPosition >= fEnd)
+
+				return false;
+
+			outValue->SetBool(*fPosition++ != 0);
+			*outValue = _ConstructObject(fContext, "Boolean", *outValue);
+			return true;
+
+		case eTAG_NUMBER_OBJECT:
+		case eTAG_DATE_OBJECT: 
+
+			if (!_GetReal(&number))
+
+				return false;
+
+			outValue->SetNumber(number);
+			*outValue = _ConstructObject(fContext, tag == eTAG_NUMBER_OBJECT ? "Number" : "Date", *outValue);
+			return true;
+
+		case eTAG_STRING_OBJECT:
+		case eTAG_REG_EXP_OBJECT:
+
+			if (!_GetString(&string))
+
+				return false;
+
+			outValue->SetString(string);
+			*outValue = _ConstructObject(fContext, tag == eTAG_STRING_OBJECT ? "String" : "RegExp", *outValue);
+			return true;
 			
-		case eNODE_SERIALIZABLE:
+		case eTAG_SERIALIZABLE: {
+
+			XBOX::VString	constructorName;
+
+			if (!_GetString(&constructorName) || !_GetString(&string))
+
+				return false;
 			
-			value.SetString(*inNode->fValue.fSerializationData.fJSON);
-			value = _ConstructObject(inContext, *inNode->fValue.fSerializationData.fConstructorName, value);
-			break;
+			outValue->SetString(string);
+			*outValue = _ConstructObject(fContext, constructorName, *outValue);
+			return true;
 
-		case eNODE_OBJECT: {
+		}
 
-			XBOX::VJSObject	emptyObject(inContext);
-			SEntry			entry(inContext);
+		case eTAG_OBJECT: {
+
+			XBOX::VJSObject	emptyObject(fContext);
 
 			emptyObject.MakeEmpty();
-			value = emptyObject;
+			*outValue = emptyObject;
 
-			xbox_assert(ioAlreadyCreated->find(inNode->fValue.fReference) == ioAlreadyCreated->end());
+			_AddObject(*outValue);
+			fPendingValues.push_back(*outValue);
+			return true;
 
-			ioAlreadyCreated->insert( std::pair<SNode *, XBOX::VJSValue>( inNode, value ) );
+		}
 
-			entry.fValue = value;
-			entry.fNode = inNode;
-			ioToDoList->push_back(entry);
+		case eTAG_ARRAY: {
 
-			break;
+			XBOX::VJSArray	emptyArray(fContext);
+
+			*outValue = emptyArray;
+
+			_AddObject(*outValue);
+			fPendingValues.push_back(*outValue);
+			return true;
 
 		}
 
-		case eNODE_ARRAY: {
+		case eTAG_REFERENCE:
 
-			XBOX::VJSArray	emptyArray(inContext);
-			SEntry			entry(inContext);
+			if (!_GetVarint(&varint) || varint >= fObjects.size())
 
-			value = emptyArray;
+				return false;
 
-			xbox_assert(ioAlreadyCreated->find(inNode->fValue.fReference) == ioAlreadyCreated->end());
+			*outValue = fObjects[(size_t) varint];
+			return true;
 
-			ioAlreadyCreated->insert( std::pair<SNode *, XBOX::VJSValue>( inNode, value ) );
+		case eTAG_ARRAY_BUFFER: {
 
-			entry.fValue = value;
-			entry.fNode = inNode;
-			ioToDoList->push_back(entry);
-			
-			break;
+			void	*buffer	= NULL;
+
+			if (!_GetVarint(&varint) || (uLONG8) (fEnd - fPosition) < varint)
+
+				return false;
+
+			// ArrayBuffer takes ownership of the ::malloc()-ed buffer.
+
+			if (varint > 0) {
+
+				if ((buffer = ::malloc((size_t) varint)) == NULL) {
+
+					XBOX::vThrowError(XBOX::VE_MEMORY_FULL);
+					return false;
+
+				}
+				::memcpy(buffer, fPosition, (size_t) varint);
+				fPosition += varint;
+
+			}
+			*outValue = VJSArrayBufferClass::NewInstance(fContext, (VSize) varint, buffer);
+
+			_AddObject(*outValue);
+			return true;
 
 		}
 
-		case eNODE_REFERENCE: {
-			std::map<SNode *, XBOX::VJSValue>::iterator it;
+		case eTAG_TRANSFERRED_ARRAY_BUFFER: {
 
-			it = ioAlreadyCreated->find(inNode->fValue.fReference);
-			xbox_assert(it != ioAlreadyCreated->end());
+			VJSArrayBufferObject	*arrayBuffer;
 
-			value = it->second;
+			if (!_GetVarint(&varint) || varint >= fTransferred.size())
 
-			break;
+				return false;
+
+			if ((arrayBuffer = new VJSArrayBufferObject(fTransferred[(size_t) varint])) == NULL) {
+
+				XBOX::vThrowError(XBOX::VE_MEMORY_FULL);
+				return false;
+
+			}
+			*outValue = VJSArrayBufferClass::CreateInstance(fContext, arrayBuffer);
+			arrayBuffer->Release();
+
+			_AddObject(*outValue);
+			return true;
 
 		}
 
 		default:
 
 			xbox_assert(false);
-			value.SetNull();
-			break;
+			return false;
 		
 	}
+}
+
+bool VJSStructuredClone::VReader::ReadPendingProperties ()
+{
+	while (!fPendingValues.empty()) {
+
+		XBOX::VJSObject	object	= fPendingValues.front().GetObject((VJSException*)NULL);
+
+		fPendingValues.pop_front();
+		for ( ; ; ) {
+
+			if (fPosition >= fEnd)
+
+				return false;
+
+			if (*fPosition == eTAG_END) {
+
+				fPosition++;
+				break;
+
+			}
+
+			XBOX::VString	name;
+			XBOX::VJSValue	value(fContext);
+
+			if (!_GetString(&name) || !ReadValue(&value))
+
+				return false;
+
+			object.SetProperty(name, value);
+
+		}
+
+	}
+	return true;
+}
+
+VJSStructuredClone *VJSStructuredClone::RetainClone (const XBOX::VJSValue& inValue, const XBOX::VJSArray *inTransferList)
+{
+	std::vector<VJSArrayBufferObject *>	transferList;
+
+	if (inTransferList != NULL) {
+
+		// Only ArrayBuffers can be transferred, and only once.
+
+		for (size_t i = 0; i < inTransferList->GetLength(); i++) {
+
+			XBOX::VJSValue			value		= inTransferList->GetValueAt(i);
+			VJSArrayBufferObject	*arrayBuffer;
+
+			if (!value.IsObject()
+			|| (arrayBuffer = value.GetObject().GetPrivateData<VJSArrayBufferClass>()) == NULL
+			|| arrayBuffer->IsNeutered()
+			|| std::find(transferList.begin(), transferList.end(), arrayBuffer) != transferList.end())
+
+				return NULL;
+
+			transferList.push_back(arrayBuffer);
+
+		}
+
+	}
+
+	VJSStructuredClone	*structuredClone;
+
+	if ((structuredClone = new VJSStructuredClone()) == NULL)
+
+		return NULL;
+
+	VWriter	writer(&structuredClone->fData, transferList);
+
+	if (!writer.WriteValue(inValue) || !writer.WritePendingProperties(inValue)) {
+
+		structuredClone->Release();
+		return NULL;
+
+	}
+
+	// Move content of transferred ArrayBuffers, neutering them. If the content is shared with a Buffer object,
+	// it is still visible from this context and has to be copied.
+
+	for (std::vector<VJSArrayBufferObject *>::iterator i = transferList.begin(); i != transferList.end(); ++i) {
+
+		VJSBufferObject	*bufferObject	= (*i)->GetBufferObject();
+
+		if (bufferObject->GetRefCount() > 1) {
+
+			VJSBufferObject	*copy;
+
+			if ((copy = new VJSBufferObject(bufferObject->GetDataSize())) == NULL
+			|| (bufferObject->GetDataSize() > 0 && copy->GetDataPtr() == NULL)) {
+
+				XBOX::ReleaseRefCountable<VJSBufferObject>(&copy);
+				structuredClone->Release();
+				XBOX::vThrowError(XBOX::VE_MEMORY_FULL);
+				return NULL;
+
+			}
+			::memcpy(copy->GetDataPtr(), bufferObject->GetDataPtr(), bufferObject->GetDataSize());
+			structuredClone->fTransferred.push_back(copy);
+
+		} else 
+
+			structuredClone->fTransferred.push_back(XBOX::RetainRefCountable<VJSBufferObject>(bufferObject));
+
+	}
+	for (std::vector<VJSArrayBufferObject *>::iterator i = transferList.begin(); i != transferList.end(); ++i) {
+
+		VJSBufferObject	*bufferObject	= (*i)->Neuter();
+
+		XBOX::ReleaseRefCountable<VJSBufferObject>(&bufferObject);
+
+	}
+
+	return structuredClone;
+}
+
+VJSStructuredClone* VJSStructuredClone::RetainCloneForVValueSingle( const XBOX::VValueSingle& inValue)
+{
+	VJSStructuredClone *structuredClone = new VJSStructuredClone();
+	if (structuredClone != NULL)
+	{
+		std::vector<VJSArrayBufferObject *> transferList;
+		VWriter writer( &structuredClone->fData, transferList);
+
+		writer.WriteValueSingle( inValue);
+	}
+
+	return structuredClone;
+}
+
+VJSStructuredClone* VJSStructuredClone::RetainCloneForVBagArray( const XBOX::VBagArray& inBagArray, bool inUniqueElementsAreNotArrays)
+{
+	VJSStructuredClone *structuredClone = new VJSStructuredClone();
+	if (structuredClone != NULL)
+	{
+		std::vector<VJSArrayBufferObject *> transferList;
+		VWriter writer( &structuredClone->fData, transferList);
+
+		writer.WriteBagArray( inBagArray);
+		writer.WritePendingBags( inUniqueElementsAreNotArrays);
+	}
+
+	return structuredClone;
+}
 	
-	return value;
+VJSStructuredClone* VJSStructuredClone::RetainCloneForVValueBag( const XBOX::VValueBag& inBag, bool inUniqueElementsAreNotArrays)
+{
+	VJSStructuredClone *structuredClone = new VJSStructuredClone();
+	if (structuredClone != NULL)
+	{
+		std::vector<VJSArrayBufferObject *> transferList;
+		VWriter writer( &structuredClone->fData, transferList);
+
+		writer.WriteBag( inBag);
+		writer.WritePendingBags( inUniqueElementsAreNotArrays);
+	}
+
+	return structuredClone;
+}
+
+XBOX::VJSValue VJSStructuredClone::MakeValue (XBOX::VJSContext inContext)
+{
+	XBOX::VJSValue	root(inContext);
+	VReader			reader(fData, fTransferred, inContext);
+
+	if (!reader.ReadValue(&root) || !reader.ReadPendingProperties()) {
+
+		xbox_assert(fData.empty());
+		root.SetUndefined();
+
+	}
+
+	return root;
+}
+
+VJSStructuredClone::VJSStructuredClone ()
+{
+}
+
+VJSStructuredClone::~VJSStructuredClone ()
+{
+	for (std::vector<VJSBufferObject *>::iterator i = fTransferred.begin(); i != fTransferred.end(); ++i)
+
+		XBOX::ReleaseRefCountable<VJSBufferObject>(&*i);
 }
 
 bool VJSStructuredClone::_IsSerializable (XBOX::VJSValue inValue)
@@ -807,73 +1106,3 @@ XBOX::VJSValue VJSStructuredClone::_ConstructObject (XBOX::VJSContext inContext,
 
 	return value;
 }
-
-// Tree "under" the root SNode inNode, must be fully correct (all pointers properly set in particular).
-
-void VJSStructuredClone::_FreeNode (SNode *inNode)
-{
-	xbox_assert(inNode != NULL);
-
-	std::list<SNode *>	toFree;
-	SNode				*p, *q;
-
-	p = inNode;
-	for ( ; ; ) {
-		
-		switch (p->fType) {
-
-			case eNODE_UNDEFINED:
-			case eNODE_NULL:
-			case eNODE_BOOLEAN:
-			case eNODE_NUMBER:
-			case eNODE_BOOLEAN_OBJECT:
-			case eNODE_NUMBER_OBJECT:
-			case eNODE_DATE_OBJECT:
-			case eNODE_REFERENCE:
-
-				break;
-
-			case eNODE_STRING:
-			case eNODE_STRING_OBJECT:
-			case eNODE_REG_EXP_OBJECT:
-				
-				delete p->fValue.fString;
-				break;
-
-			case eNODE_SERIALIZABLE:		
-
-				delete p->fValue.fSerializationData.fConstructorName;
-				delete p->fValue.fSerializationData.fJSON;
-				break;
-				
-			case eNODE_OBJECT:
-			case eNODE_ARRAY:
-
-				q = p->fValue.fFirstChild;
-				while (q != NULL) {			
-			
-					toFree.push_front(q);
-					q = q->fNextSibling;
-
-				}
-				break;
-
-			default:	
-
-				xbox_assert(false);
-				break;
-		
-		}				
-
-		delete p;
-		if (!toFree.empty()) {
-
-			p = toFree.front();
-			toFree.pop_front();
-
-		} else
-			
-			break;
-
-	}
-}
\ No newline at end of file
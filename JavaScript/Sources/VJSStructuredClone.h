@@ -16,24 +16,30 @@
 #ifndef __VJS_STRUCTURED_CLONE__
 #define __VJS_STRUCTURED_CLONE__
 
-#if USE_V8_ENGINE
-#include <unordered_map>
-#endif
-
-
 #include "VJSClass.h"
 #include "VJSValue.h"
 
 
 BEGIN_TOOLBOX_NAMESPACE
 
+class VJSBufferObject;
+class VJSArrayBufferObject;
+
+// A structured clone is stored as a flat byte stream: a tag byte per value followed by its payload, integers and
+// lengths as varints. Objects and arrays are written breadth first (their properties follow once all the values
+// of the previous level are written) and numbered in order of appearance, so that cycles and shared objects are
+// back-references to that number. Strings go in a string table built along the stream: a string is written once,
+// then referenced by its index.
+
 class XTOOLBOX_API VJSStructuredClone : public XBOX::IRefCountable
 {
 public:
 
 	// Return NULL if unable to apply structured clone algorithm (DATA_CLONE_ERR).
+	// inTransferList is an optional array of ArrayBuffer objects to transfer rather than copy: their content is moved
+	// into the clone without copy and they are "neutered". Nothing is neutered if the clone fails.
 	
-	static VJSStructuredClone	*RetainClone (const XBOX::VJSValue& inValue);
+	static VJSStructuredClone	*RetainClone (const XBOX::VJSValue& inValue, const XBOX::VJSArray *inTransferList = NULL);
 
 	static VJSStructuredClone	*RetainCloneForVValueSingle( const XBOX::VValueSingle& inValue);
 
@@ -42,117 +48,72 @@ public:
 	static VJSStructuredClone	*RetainCloneForVValueBag( const XBOX::VValueBag& inBag, bool inUniqueElementsAreNotArrays);
 
 	// Make a JavaScript value in the given context. The created value is "undefined" if an error occured. 
+	// Transferred ArrayBuffers are not copied: if MakeValue() is called more than once, they share their content.
 	
 	XBOX::VJSValue				MakeValue (XBOX::VJSContext inContext);
 
+	// Size of serialized data.
+
+	VSize						GetDataSize () const		{	return fData.size();	}
+
 private:
 
 	enum {
 
 		// Primitive values.
 
-		eNODE_UNDEFINED,
-		eNODE_NULL,
-		eNODE_BOOLEAN,
-		eNODE_NUMBER,
-		eNODE_STRING,
+		eTAG_UNDEFINED,
+		eTAG_NULL,
+		eTAG_FALSE,
+		eTAG_TRUE,
+		eTAG_INTEGER,				// Zigzag varint, for numbers with an exact 32-bit integer value.
+		eTAG_NUMBER,				// Real.
+		eTAG_STRING,				// String reference.
 
 		// Primitive objects.
 
-		eNODE_BOOLEAN_OBJECT,
-		eNODE_NUMBER_OBJECT,
-		eNODE_STRING_OBJECT,
-		eNODE_DATE_OBJECT,
-		eNODE_REG_EXP_OBJECT,		
+		eTAG_BOOLEAN_OBJECT,		// Followed by a byte.
+		eTAG_NUMBER_OBJECT,			// Real.
+		eTAG_STRING_OBJECT,			// String reference.
+		eTAG_DATE_OBJECT,			// Real, UNIX time in milliseconds.
+		eTAG_REG_EXP_OBJECT,		// String reference.
 		
 		// A serializable object implements a serialize() method to convert its full state into a JSON string.
 		// It also has a constructorName attribute to use to re-create it from the JSON string.
 		
-		eNODE_SERIALIZABLE,
-
-		// Object or array.
+		eTAG_SERIALIZABLE,			// String references to constructor name and JSON.
 
-		eNODE_OBJECT,
-		eNODE_ARRAY,
+		// Object or array, their properties are (name, value) pairs ended by eTAG_END.
 
-		// Reference to an object or array.
+		eTAG_OBJECT,
+		eTAG_ARRAY,
+		eTAG_END,
 
-		eNODE_REFERENCE,
-		
-		// Native objects.
+		// Reference to an already written object or array, followed by its number.
 
-//**	TODO: Decide which native C++ objects to clone.
+		eTAG_REFERENCE,
 
-	};
+		// ArrayBuffer, either copied (length followed by content) or transferred (index in fTransferred).
 
-	struct SNode {
+		eTAG_ARRAY_BUFFER,
+		eTAG_TRANSFERRED_ARRAY_BUFFER,
 
-		sLONG					fType;
+	};
 
-		XBOX::VString			fName;				// "Root" node has empty name.
-	
-		union {
-
-			bool				fBoolean;			// Both primitive and object Boolean.
-			
-			Real				fNumber;			// Both primitive and object Number, also store Date in UNIX time.
-			
-			XBOX::VString		*fString;			// Both primitive and object String. also store RegExp.
-			
-			struct {
-				
-				XBOX::VString	*fConstructorName;	// Constructor name to use.
-				XBOX::VString	*fJSON;				// JSON argument (full state of the cloned object).
-				
-			} fSerializationData;
-			
-			struct SNode		*fFirstChild;		// First child of object or Array.
-			
-			struct SNode		*fReference;		// Reference to an object or an Array.
-			
-		} fValue;
-
-		struct SNode			*fNextSibling;		// Not used by "root" node.
+	// A string reference is a varint: index of string in table shifted left by one, lowest bit is set if the string
+	// is new. A new string is followed by its length and its UTF-16 code units.
 
-	};
-	
-	struct SEntry {
-		SEntry(const VJSContext& inContext) : fValue(inContext) {;}
-		XBOX::VJSValue			fValue;
-		SNode					*fNode;
+	class VWriter;
+	class VReader;
 
-	};
-	
-	SNode						*fRoot;
+	std::vector<uBYTE>				fData;
+	std::vector<VJSBufferObject *>	fTransferred;
 
 								VJSStructuredClone ();
 	virtual						~VJSStructuredClone ();
 
-	// Create a node from a value, return NULL if erroneous.
-#if USE_V8_ENGINE
-	struct ValueNode_st {
-		XBOX::VJSValue	value;
-		SNode*			snode;
-		ValueNode_st(const XBOX::VJSValue& inValue, SNode* inNode) :value(inValue), snode(inNode) {}
-	};
-	// on V8 neither VJSValue nor VJSValue.fValue (which is a  V8::Value*) can be used as key map 
-	// because the only way to know if two V8 handles are equal is to use V8::Value::Equals
-	//   typedef std::unordered_map<XBOX::VJSValue, SNode *> ValueNodeSet_t;  -> not relevant (see above)
-	typedef std::list<ValueNode_st> ValueNodeSet_t;
-#else
-	// on jsCore use VJSValue as key map
-	typedef std::map<XBOX::VJSValue, SNode *> ValueNodeSet_t;
-#endif
-	static SNode				*_ValueToNode(XBOX::VJSValue inValue, ValueNodeSet_t *ioAlreadyCloned, std::list<SEntry> *ioToDoList);
-	static SNode				*_VValueSingleToNode( const XBOX::VValueSingle& inValue);
-
-	static SNode				*_VBagArrayToNode( const XBOX::VBagArray& inBagArray, bool inUniqueElementsAreNotArrays);
-
-	static SNode				*_VValueBagToNode( const XBOX::VValueBag& inBag, bool inUniqueElementsAreNotArrays);
-
-	// Create a value from a node.
-	static XBOX::VJSValue		_NodeToValue (XBOX::VJSContext inContext, SNode *inNode, std::map<SNode *, XBOX::VJSValue> *ioAlreadyCreated, std::list<SEntry> *ioToDoList);
-
+	static void					_WriteBag (VWriter& ioWriter, const XBOX::VValueBag& inBag, bool inUniqueElementsAreNotArrays);
+	static void					_WriteBagArray (VWriter& ioWriter, const XBOX::VBagArray& inBagArray, bool inUniqueElementsAreNotArrays);
 
 	// Return true if VJSValue is serializable (has a constructorName attribute and a serialize() method);
 	
@@ -161,10 +122,6 @@ private:
 	// Call a constructor with a single argument, return constructed object or undefined if failed.
 
 	static XBOX::VJSValue		_ConstructObject (XBOX::VJSContext inContext, const XBOX::VString &inConstructorName, XBOX::VJSValue inArgument);
-
-	// Free a node and all its children (but not its sibling(s)).
-
-	static void					_FreeNode (SNode *inNode);
 };
 
 END_TOOLBOX_NAMESPACE
@@ -45,7 +45,7 @@ VJSTimerContext::~VJSTimerContext ()
 
 VJSTimer *VJSTimerContext::LookUpTimer (sLONG inID)
 {
-	std::map<sLONG, VRefPtr<VJSTimer> >::iterator	it;
+	TimerMap::iterator	it;
 
 	if ((it = fTimers.find(inID)) == fTimers.end()) 
 
@@ -88,7 +88,7 @@ void VJSTimerContext::RemoveTimer (sLONG inID)
 {
 	xbox_assert(!(inID & ~kCounterMask));
 
-	std::map<sLONG, VRefPtr<VJSTimer> >::iterator	it;
+	TimerMap::iterator	it;
 
 	it = fTimers.find(inID);
 
@@ -103,7 +103,7 @@ void VJSTimerContext::RemoveTimer (sLONG inID)
 
 void VJSTimerContext::ClearAll ()
 {
-	std::map<sLONG, VRefPtr<VJSTimer> >::iterator	it;
+	TimerMap::iterator	it;
 
 	for (it = fTimers.begin(); it != fTimers.end(); it++)
 
@@ -155,6 +155,7 @@ VJSTimer::VJSTimer (XBOX::VJSObject &inFunctionObject, sLONG inInterval)
 	fTimerContext = NULL;
 	fID = -1;
 	fInterval = inInterval;
+	fTimerEvent = NULL;
 	//fFunctionObject = new VJSObject(inFunctionObject);	
 }
 
@@ -28,6 +28,7 @@ class VJSGlobalObject;
 class VJSWorker;
 
 class VJSTimer;
+class VJSTimerEvent;
 
 // All timers (context) of a JavaScript execution.
 
@@ -50,8 +51,10 @@ private:
 
 	static const sLONG					kCounterMask	= 0x00ffffff;
 
+	typedef NAMESPACE_TR1::unordered_map<sLONG, VRefPtr<VJSTimer> >	TimerMap;
+
 	sLONG								fCounter;
-	std::map<sLONG, VRefPtr<VJSTimer> >	fTimers;
+	TimerMap							fTimers;
 };
 
 // A one-shot (setTimeout()) or periodic (setInterval()) timer function.
@@ -98,6 +101,7 @@ friend class VJSTimerEvent;
 	sLONG					fID;
 	sLONG					fInterval;
 	XBOX::VJSObject			fFunctionObject;	
+	VJSTimerEvent			*fTimerEvent;		// Pending or executing event, NULL if none.
 				
 				VJSTimer ();
 				VJSTimer (XBOX::VJSObject &inFunctionObject, sLONG inInterval);
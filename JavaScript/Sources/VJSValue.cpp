@@ -556,6 +556,18 @@ bool VJSValue::IsArray() const
 #endif
 }
 
+sLONG VJSValue::GetIdentityHash() const
+{
+	xbox_assert(IsObject());
+
+	HandleScope	handleScope(fContext);
+#if V8_USE_MALLOC_IN_PLACE
+	return (*ToV8Persistent(fValue))->ToObject()->GetIdentityHash();
+#else
+	return fValue->ToObject()->GetIdentityHash();
+#endif
+}
+
 bool VJSValue::IsInstanceOfBoolean() const
 {
 #if V8_USE_MALLOC_IN_PLACE
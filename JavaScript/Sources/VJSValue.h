@@ -48,8 +48,8 @@ public:
 
 			bool				operator==(const VJSValue& inOther) const;
 
-			// operator needed because VJSStructuredClone uses VJSValues as unordered_map indexes
-			//size_t				hash() const { return (size_t)fValue; }
+			// same for all handles of an object value, VJSStructuredClone uses it to index already cloned objects
+			sLONG				GetIdentityHash() const;
 			// operators "<" and "<=" cannot be implemented for V8 !! since 2 Handle<Value> representing the same object have 2
 			// different ptrs values
 
@@ -216,6 +216,7 @@ friend class VJSPictureContainer;
 friend class VJSJSON;
 friend class VJSContext;
 friend class JS4D;
+friend class VJSStructuredClone;
 
 private:
 friend class VJSObject;
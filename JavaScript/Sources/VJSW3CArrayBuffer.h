@@ -46,6 +46,11 @@ public:
 	VSize			GetDataSize () const		{	return fBufferObject != NULL ? fBufferObject->GetDataSize() : 0;	}
 	void			*GetDataPtr () const		{	return fBufferObject != NULL ? fBufferObject->GetDataPtr() : 0;		}
 
+					// Detach content (used by transfer), the ArrayBuffer is then "neutered".
+					// Caller gets the reference to returned buffer object, NULL if already neutered.
+
+	VJSBufferObject	*Neuter ()					{	VJSBufferObject *bufferObject = fBufferObject; fBufferObject = NULL; return bufferObject;	}
+
 private:
 
 friend class VJSArrayBufferClass;
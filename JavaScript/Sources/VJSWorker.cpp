@@ -345,12 +345,17 @@ sLONG VJSWorker::WaitFor (XBOX::VJSContext &inContext, sLONG inWaitingDuration,
 		
 		// If there is an event to be triggered, process it.
 		
-		if (!fEventQueue.empty() && currentTime >= fEventQueue.front()->GetTriggerTime()) {
+		XBOX::VTime	topTime;
+
+		if (!fEventQueue.IsEmpty())
+
+			fEventQueue.GetTopTime(topTime);
+
+		if (!fEventQueue.IsEmpty() && currentTime >= topTime) {
 
 			IJSEvent	*event;
 
-			event = fEventQueue.front();
-			fEventQueue.pop_front();
+			event = fEventQueue.PopTop();
 
 			// If an event generator and event type has been specified, check if the event to process is matching.
 
@@ -409,7 +414,7 @@ sLONG VJSWorker::WaitFor (XBOX::VJSContext &inContext, sLONG inWaitingDuration,
 		uLONG			waitDuration;
 						
 		isTimedOutWait = true;
-		if (fEventQueue.empty()) {
+		if (fEventQueue.IsEmpty()) {
 
 			if (inWaitingDuration > 0) {
 
@@ -430,7 +435,7 @@ sLONG VJSWorker::WaitFor (XBOX::VJSContext &inContext, sLONG inWaitingDuration,
 
 			XBOX::VTime	minimum;
 
-			minimum = fEventQueue.front()->GetTriggerTime();
+			minimum = topTime;
 			if (inWaitingDuration > 0 && minimum > endTime)
 
 				minimum = endTime;
@@ -619,17 +624,9 @@ void VJSWorker::QueueEvent (IJSEvent *inEvent)
 
 	}
 
-	std::list<IJSEvent *>::iterator	i;
-	
-	for (i = fEventQueue.begin(); i != fEventQueue.end(); i++) 
+	// If two events have identical trigger time, first queued will be processed first.
 
-		// If two events have identical trigger time, first queued will be processed first.
-		
-		if ((*i)->GetTriggerTime() > inEvent->GetTriggerTime())
-
-			break;
-
-	fEventQueue.insert(i, inEvent);	
+	fEventQueue.Push(inEvent);
 
 	// Send a VMessage to running VTask, only in studio and for SystemWorker events.
 
@@ -663,6 +660,22 @@ void VJSWorker::UnscheduleTimer (VJSTimer *inTimer)
 	VJSTimerEvent::RemoveTimerEvent(&fEventQueue, inTimer);	
 }
 
+void VJSWorker::SetTimerSlack (sLONG inSlack)
+{
+	XBOX::StLocker<XBOX::VCriticalSection>	lock(&fMutex);
+
+	// Already queued timers keep their trigger time.
+
+	fEventQueue.SetSlack(inSlack);
+}
+
+sLONG VJSWorker::GetTimerSlack ()
+{
+	XBOX::StLocker<XBOX::VCriticalSection>	lock(&fMutex);
+
+	return fEventQueue.GetSlack();
+}
+
 void VJSWorker::AddMessagePort (VJSMessagePort *inMessagePort)
 {
 	xbox_assert(inMessagePort != NULL);
@@ -803,7 +816,7 @@ void VJSWorker::ExecuteHasEventMessage (VJSHasEventMessage *inMessage)
 {
 	if (fWaitForMutex.TryToLock()) {
 	
-		if (!fInsideWaitCount && fEventQueue.size()) {
+		if (!fInsideWaitCount && !fEventQueue.IsEmpty()) {
 
 			XBOX::VJSContext		context((XBOX::JS4D::ContextRef) fRootGlobalContext);
 			XBOX::VJSGlobalObject	*globalObject	= context.GetGlobalObjectPrivateInstance();
@@ -912,7 +925,7 @@ VJSWorker::~VJSWorker ()
 
 	// All references should have been released.
 	
-	xbox_assert(fEventQueue.empty());
+	xbox_assert(fEventQueue.IsEmpty());
 
 	// Free VTask and remove worker from dedicated, shared, or root worker list.
 
@@ -1431,12 +1444,9 @@ void VJSWorker::_ReleaseAllReferences ()
 
 	// Discard all events.
 
-	while (!fEventQueue.empty()) {
+	while (!fEventQueue.IsEmpty())
 
-		fEventQueue.front()->Discard();
-		fEventQueue.pop_front();
-
-	}
+		fEventQueue.PopTop()->Discard();
 	
 	// Release all error ports, requesting termination of "child" dedicated workers if needed.
 
@@ -22,6 +22,7 @@
 #include "VJSClass.h"
 #include "VJSValue.h"
 #include "VJSTimer.h"
+#include "VJSEvent.h"
 
 #define VJSWORKER_WITH_PROJECT_INFO_RETAIN_JS	1
 
@@ -161,6 +162,12 @@ public:
 	
 	void				UnscheduleTimer (VJSTimer *inTimer);
 
+	// Timers expiring within the slack (milliseconds) of each other are triggered together. Zero to disable.
+	// Default for new workers is set by VJSEventQueue::SetDefaultSlack().
+
+	void				SetTimerSlack (sLONG inSlack);
+	sLONG				GetTimerSlack ();
+
 	// Add or remove a message port.
 
 	void				AddMessagePort (VJSMessagePort *inMessagePort);
@@ -240,7 +247,7 @@ private:
 	bool									fHasReleasedAll, fClosingFlag, fExitWaitFlag;
 	XBOX::VSyncEvent						fSyncEvent;
 	bool									fIsLockedWaiting;			// True if locked waiting on fSyncEvent.
-	std::list<IJSEvent *>					fEventQueue;		
+	VJSEventQueue							fEventQueue;		
 	std::list< VRefPtr<VJSMessagePort> >	fMessagePorts;				// List of all message ports (any type), they may be "duplicated" elsewhere.
 	VJSTimerContext							fTimerContext;				// All timers.
 	
@@ -34,6 +34,7 @@
 #include "Sources/VJSErrors.h"
 #include "Sources/VJSValue.h"
 #include "Sources/VJSContext.h"
+#include "Sources/VJSCodeCache.h"
 #include "Sources/VJSClass.h"
 #include "Sources/VJSRuntime_file.h"
 #include "Sources/VJSRuntime_stream.h"
@@ -56,6 +56,7 @@ namespace ILoggerBagKeys
 	CREATE_BAGKEY_NO_DEFAULT_SCALAR( debug_context, VLong8, sLONG8);
 	CREATE_BAGKEY_NO_DEFAULT( jobId, VString );
 	CREATE_BAGKEY_NO_DEFAULT_SCALAR( jobState, VLong, sLONG);
+	CREATE_BAGKEY_NO_DEFAULT_SCALAR( timestamp, VLong8, sLONG8);
 };
 
 
@@ -61,6 +61,7 @@ namespace ILoggerBagKeys
 	XTOOLBOX_API EXTERN_BAGKEY_NO_DEFAULT_SCALAR( debug_context, VLong8, sLONG8);	// number of bytes received
 	XTOOLBOX_API EXTERN_BAGKEY_NO_DEFAULT( jobId, VString);				// job id
 	XTOOLBOX_API EXTERN_BAGKEY_NO_DEFAULT_SCALAR( jobState, VLong, sLONG);				// job state
+	XTOOLBOX_API EXTERN_BAGKEY_NO_DEFAULT_SCALAR( timestamp, VLong8, sLONG8);			// VTime stamp (UTC) of the log call, listeners get the bag later
 }
 
 class XTOOLBOX_API ILogListener : public IRefCountable
@@ -0,0 +1,154 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#include "VKernelPrecompiled.h"
+#include "VArena.h"
+
+
+static inline char* _AlignPointer( char *inPointer)
+{
+	return (char*) (((uintptr_t) inPointer + VArena::kALIGNMENT - 1) & ~((uintptr_t) VArena::kALIGNMENT - 1));
+}
+
+
+VArena::VArena( VSize inChunkSize, VCppMemMgr *inMemMgr)
+: fMemMgr( (inMemMgr != NULL) ? inMemMgr : VObject::GetMainMemMgr())
+, fChunkSize( inChunkSize)
+, fFirstChunk( NULL)
+, fCurrent( NULL)
+, fEnd( NULL)
+{
+	::memset( &fStatistics, 0, sizeof( fStatistics));
+}
+
+
+VArena::~VArena()
+{
+	Purge();
+}
+
+
+void* VArena::_MallocInNewChunk( VSize inSize)
+{
+	// big blocks get their own chunk so that the current one is not wasted
+	VSize dataSize = (inSize > fChunkSize / 4) ? inSize : fChunkSize;
+	VSize chunkSize = sizeof( Chunk) + kALIGNMENT + dataSize;
+
+	Chunk *chunk = (Chunk*) fMemMgr->Malloc( chunkSize, false, 'aren');
+	if (chunk == NULL)
+		return NULL;
+
+	chunk->fSize = chunkSize;
+	fStatistics.fChunkAllocations++;
+	fStatistics.fFootprint += chunkSize;
+	if (fStatistics.fFootprint > fStatistics.fPeakFootprint)
+		fStatistics.fPeakFootprint = fStatistics.fFootprint;
+
+	char *data = _AlignPointer( (char*) (chunk + 1));
+	char *block;
+	if ( (dataSize == inSize) && (fFirstChunk != NULL) )
+	{
+		// keep bumping in the current chunk
+		chunk->fNext = fFirstChunk->fNext;
+		fFirstChunk->fNext = chunk;
+		block = data;
+	}
+	else
+	{
+		chunk->fNext = fFirstChunk;
+		fFirstChunk = chunk;
+		fCurrent = data + inSize;
+		fEnd = ((char*) chunk) + chunkSize;
+		block = data;
+	}
+
+	fStatistics.fAllocations++;
+	fStatistics.fAllocatedBytes += inSize;
+	fStatistics.fUsedBytes += inSize;
+	if (fStatistics.fUsedBytes > fStatistics.fPeakUsedBytes)
+		fStatistics.fPeakUsedBytes = fStatistics.fUsedBytes;
+
+	return block;
+}
+
+
+void VArena::_FreeChunks( Chunk *inFirst)
+{
+	while (inFirst != NULL)
+	{
+		Chunk *next = inFirst->fNext;
+		fStatistics.fFootprint -= inFirst->fSize;
+		fMemMgr->Free( inFirst);
+		inFirst = next;
+	}
+}
+
+
+void VArena::Reset()
+{
+	// keep one regular chunk for next use
+	Chunk *kept = NULL;
+	Chunk *others = NULL;
+	for (Chunk *chunk = fFirstChunk ; chunk != NULL ; )
+	{
+		Chunk *next = chunk->fNext;
+		if ( (kept == NULL) && (chunk->fSize == sizeof( Chunk) + kALIGNMENT + fChunkSize) )
+		{
+			kept = chunk;
+		}
+		else
+		{
+			chunk->fNext = others;
+			others = chunk;
+		}
+		chunk = next;
+	}
+	_FreeChunks( others);
+
+	fFirstChunk = kept;
+	if (kept != NULL)
+	{
+		kept->fNext = NULL;
+		fCurrent = _AlignPointer( (char*) (kept + 1));
+		fEnd = ((char*) kept) + kept->fSize;
+	}
+	else
+	{
+		fCurrent = fEnd = NULL;
+	}
+
+	fStatistics.fUsedBytes = 0;
+	fStatistics.fResets++;
+}
+
+
+void VArena::Purge()
+{
+	Reset();
+	_FreeChunks( fFirstChunk);
+	fFirstChunk = NULL;
+	fCurrent = fEnd = NULL;
+}
+
+
+bool VArena::Contains( const void *inBlock) const
+{
+	for (const Chunk *chunk = fFirstChunk ; chunk != NULL ; chunk = chunk->fNext)
+	{
+		if ( ((const char*) inBlock >= (const char*) (chunk + 1)) && ((const char*) inBlock < ((const char*) chunk) + chunk->fSize) )
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,174 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#ifndef __VArena__
+#define __VArena__
+
+#include "Kernel/Sources/VObject.h"
+#include "Kernel/Sources/VMemoryCpp.h"
+
+BEGIN_TOOLBOX_NAMESPACE
+
+/*
+	@brief	Bump pointer allocator for objects sharing the same lifetime, typically a request.
+
+	Memory is taken from chained chunks allocated in a VCppMemMgr. Blocks are never freed one by one,
+	everything is released at once by Reset() that keeps one chunk for next use.
+
+	An arena is not thread safe. It is strictly opt-in: only blocks asked for explicitly, directly or through
+	a container given a VArenaAllocator on this arena, come from it. Those blocks and containers must not
+	be used after the arena has been reset.
+
+	VArena arena;
+	std::vector<sLONG,VArenaAllocator<sLONG> > ids( (VArenaAllocator<sLONG>( &arena)));
+*/
+class XTOOLBOX_API VArena : public VObject
+{
+public:
+	enum {
+		kDEFAULT_CHUNK_SIZE = 64 * 1024,
+		kALIGNMENT = 16
+	};
+
+	typedef struct Statistics
+	{
+		sLONG8		fAllocations;			// Malloc calls since creation
+		sLONG8		fAllocatedBytes;		// bytes given by Malloc since creation
+		sLONG8		fChunkAllocations;		// calls to the memory manager since creation
+		sLONG8		fResets;
+		VSize		fUsedBytes;				// bytes given by Malloc since last reset
+		VSize		fPeakUsedBytes;
+		VSize		fFootprint;				// bytes held in chunks
+		VSize		fPeakFootprint;
+	} Statistics;
+
+								VArena( VSize inChunkSize = kDEFAULT_CHUNK_SIZE, VCppMemMgr *inMemMgr = NULL);
+	virtual						~VArena();
+
+			// returns NULL if the memory manager fails. Blocks are aligned on kALIGNMENT.
+			void*				Malloc( VSize inSize)
+			{
+				VSize size = (inSize + kALIGNMENT - 1) & ~((VSize) kALIGNMENT - 1);
+				if (size > (VSize) (fEnd - fCurrent))
+					return _MallocInNewChunk( size);
+				void *block = fCurrent;
+				fCurrent += size;
+				fStatistics.fAllocations++;
+				fStatistics.fAllocatedBytes += size;
+				fStatistics.fUsedBytes += size;
+				if (fStatistics.fUsedBytes > fStatistics.fPeakUsedBytes)
+					fStatistics.fPeakUsedBytes = fStatistics.fUsedBytes;
+				return block;
+			}
+
+			// releases all blocks at once
+			void				Reset();
+
+			// releases all blocks and the chunks
+			void				Purge();
+
+			bool				Contains( const void *inBlock) const;
+
+			const Statistics&	GetStatistics() const				{ return fStatistics; }
+			void				ClearPeaks()						{ fStatistics.fPeakUsedBytes = fStatistics.fUsedBytes; fStatistics.fPeakFootprint = fStatistics.fFootprint; }
+
+private:
+	typedef struct Chunk
+	{
+		Chunk*		fNext;
+		VSize		fSize;
+	} Chunk;
+
+								VArena( const VArena&);
+			VArena&				operator=( const VArena&);
+
+			void*				_MallocInNewChunk( VSize inSize);
+			void				_FreeChunks( Chunk *inFirst);
+
+			VCppMemMgr*			fMemMgr;
+			VSize				fChunkSize;
+			Chunk*				fFirstChunk;	// current chunk first, then previous ones
+			char*				fCurrent;
+			char*				fEnd;
+			Statistics			fStatistics;
+};
+
+
+/*
+	@brief	STL allocator taking its blocks in the arena it was given, or in the main memory manager without one.
+	Arena blocks are released with the arena, deallocate() does nothing for them.
+	Containers using the same arena compare equal and may exchange their blocks.
+*/
+template<class T>
+class VArenaAllocator
+{
+public:
+	typedef T					value_type;
+	typedef T*					pointer;
+	typedef const T*			const_pointer;
+	typedef T&					reference;
+	typedef const T&			const_reference;
+	typedef size_t				size_type;
+	typedef ptrdiff_t			difference_type;
+
+	template<class U> struct rebind { typedef VArenaAllocator<U> other; };
+
+								VArenaAllocator( VArena *inArena = NULL):fArena( inArena)	{}
+								VArenaAllocator( const VArenaAllocator& inOther):fArena( inOther.fArena)	{}
+	template<class U>			VArenaAllocator( const VArenaAllocator<U>& inOther):fArena( inOther.GetArena())	{}
+
+			VArena*				GetArena() const											{ return fArena; }
+
+			pointer				address( reference inValue) const							{ return &inValue; }
+			const_pointer		address( const_reference inValue) const						{ return &inValue; }
+
+			pointer				allocate( size_type inCount, const void* = 0)
+			{
+				void *p = (fArena != NULL) ? fArena->Malloc( inCount * sizeof(T)) : VObject::GetMainMemMgr()->Malloc( inCount * sizeof(T), false, 'aren');
+				if (p == NULL)
+					throw std::bad_alloc();
+				return static_cast<pointer>( p);
+			}
+
+			void				deallocate( pointer inBlock, size_type)
+			{
+				if ( (fArena == NULL) && (inBlock != NULL) )
+					VObject::GetMainMemMgr()->Free( inBlock);
+			}
+
+			size_type			max_size() const											{ return ((size_type) -1) / sizeof(T); }
+
+			void				construct( pointer inBlock, const T& inValue)				{ new( (void*) inBlock) T( inValue); }
+			void				destroy( pointer inBlock)									{ inBlock->~T(); }
+
+#if __cplusplus >= 201103L
+	template<class U, class... Args>
+			void				construct( U *inBlock, Args&&... inArgs)					{ new( (void*) inBlock) U( std::forward<Args>( inArgs)...); }
+	template<class U>
+			void				destroy( U *inBlock)										{ inBlock->~U(); }
+#endif
+
+	template<class U>
+			bool				operator==( const VArenaAllocator<U>& inOther) const		{ return fArena == inOther.GetArena(); }
+	template<class U>
+			bool				operator!=( const VArenaAllocator<U>& inOther) const		{ return fArena != inOther.GetArena(); }
+
+private:
+			VArena*				fArena;
+};
+
+END_TOOLBOX_NAMESPACE
+
+#endif
@@ -0,0 +1,892 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#include "VKernelPrecompiled.h"
+#include "VJSONBlob.h"
+#include "VTime.h"
+#include "VFile.h"
+#include "VError.h"
+
+BEGIN_TOOLBOX_NAMESPACE
+
+
+static const uLONG	kJSON_BLOB_SIGNATURE	= 'JSbv';
+static const uLONG	kJSON_BLOB_VERSION		= 1;
+static const uLONG	kJSON_BLOB_MAX_SIZE		= 0xFFFFFFFF;
+static const uLONG	kJSON_BLOB_MAX_DEPTH	= 1000;		// nesting of containers built by VJSONBlobValue::GetValue()
+
+
+// order of the object index: length first, then utf-16 code units.
+// only needs to be the same for the writer and the reader.
+static sLONG _CompareNames( const void *inChars1, uLONG inLength1, const void *inChars2, uLONG inLength2)
+{
+	if (inLength1 != inLength2)
+		return (inLength1 < inLength2) ? -1 : 1;
+	if (inLength1 == 0)
+		return 0;
+	return ::memcmp( inChars1, inChars2, inLength1 * sizeof( UniChar));
+}
+
+
+// tells if a number can be stored in a slot without changing its value (-0 cannot)
+static bool _IsInlineInteger( double inNumber, sLONG& outInteger)
+{
+	if ( (inNumber >= -2147483648.0) && (inNumber <= 2147483647.0) )
+	{
+		outInteger = (sLONG) inNumber;
+		if ( ((double) outInteger == inNumber) && ( (outInteger != 0) || !std::signbit( inNumber)) )
+			return true;
+	}
+	return false;
+}
+
+
+/*
+	Implementation of the lazy objects given by VJSONBlobValue::GetValue().
+
+	Properties are read from the blob until the owner is modified or iterated,
+	then they are all set as owner base properties and the blob is not used anymore.
+	Objects and arrays already given for a property are kept so that they are the same on next access
+	and they are the ones set on materialization.
+*/
+class VJSONBlobObject : public VObject, public IJSONObject
+{
+public:
+									VJSONBlobObject( const VJSONBlobValue& inValue, const VJSONBlob *inBlob)
+										: fValue( inValue), fBlob( RetainRefCountable( inBlob)), fMaterialized( false)	{}
+
+	virtual	EJSONStatus				IJSON_GetProperty( const VJSONObject *inOwner, const VString& inName, VJSONValue& outValue) const;
+	virtual	EJSONStatus				IJSON_SetProperty( VJSONObject *inOwner, const VString& inName, const VJSONValue& inValue);
+	virtual	EJSONStatus				IJSON_RemoveProperty( VJSONObject *inOwner, const VString& inName);
+	virtual	bool					IJSON_Clear( VJSONObject *inOwner);
+	virtual	bool					IJSON_IsEmpty( const VJSONObject *inOwner) const;
+	virtual	EJSONStatus				IJSON_Stringify( const VJSONObject *inOwner, VJSONWriter& inWriter, VString& outString, VError *outError) const;
+	virtual	EJSONStatus				IJSON_Clone( const VJSONObject *inOwner, VJSONCloner& inCloner, VJSONValue& outValue, VError *outError) const;
+	virtual	void					IJSON_Materialize( VJSONObject *inOwner);
+
+private:
+	virtual							~VJSONBlobObject()		{ ReleaseRefCountable( &fBlob);}
+
+			void					_Materialize( VJSONObject *inOwner);
+
+			VJSONBlobValue			fValue;
+			const VJSONBlob*		fBlob;
+			bool					fMaterialized;
+	mutable	unordered_map_VString<VJSONValue>	fChildren;
+};
+
+
+EJSONStatus VJSONBlobObject::IJSON_GetProperty( const VJSONObject* /*inOwner*/, const VString& inName, VJSONValue& outValue) const
+{
+	if (fMaterialized)
+		return EJSON_unhandled;
+
+	VJSONBlobValue value( fValue.GetProperty( inName));
+	if (value.IsObject() || value.IsArray())
+	{
+		unordered_map_VString<VJSONValue>::iterator i = fChildren.find( inName);
+		if (i != fChildren.end())
+		{
+			outValue = i->second;
+		}
+		else
+		{
+			value.GetValue( outValue, true);
+			fChildren.insert( unordered_map_VString<VJSONValue>::value_type( inName, outValue));
+		}
+	}
+	else
+	{
+		value.GetValue( outValue, true);
+	}
+
+	return EJSON_ok;
+}
+
+
+EJSONStatus VJSONBlobObject::IJSON_SetProperty( VJSONObject *inOwner, const VString& /*inName*/, const VJSONValue& /*inValue*/)
+{
+	_Materialize( inOwner);
+	return EJSON_unhandled;
+}
+
+
+EJSONStatus VJSONBlobObject::IJSON_RemoveProperty( VJSONObject *inOwner, const VString& /*inName*/)
+{
+	_Materialize( inOwner);
+	return EJSON_unhandled;
+}
+
+
+bool VJSONBlobObject::IJSON_Clear( VJSONObject* /*inOwner*/)
+{
+	fMaterialized = true;
+	fChildren.clear();
+	return true;
+}
+
+
+bool VJSONBlobObject::IJSON_IsEmpty( const VJSONObject* /*inOwner*/) const
+{
+	// only called when there's no base property
+	return fMaterialized || (fValue.GetCount() == 0);
+}
+
+
+EJSONStatus VJSONBlobObject::IJSON_Stringify( const VJSONObject *inOwner, VJSONWriter& /*inWriter*/, VString& /*outString*/, VError* /*outError*/) const
+{
+	const_cast<VJSONBlobObject*>( this)->_Materialize( const_cast<VJSONObject*>( inOwner));
+	return EJSON_unhandled;
+}
+
+
+EJSONStatus VJSONBlobObject::IJSON_Clone( const VJSONObject *inOwner, VJSONCloner& /*inCloner*/, VJSONValue& /*outValue*/, VError* /*outError*/) const
+{
+	const_cast<VJSONBlobObject*>( this)->_Materialize( const_cast<VJSONObject*>( inOwner));
+	return EJSON_unhandled;
+}
+
+
+void VJSONBlobObject::IJSON_Materialize( VJSONObject *inOwner)
+{
+	_Materialize( inOwner);
+}
+
+
+void VJSONBlobObject::_Materialize( VJSONObject *inOwner)
+{
+	if (fMaterialized)
+		return;
+
+	// set first so that SetProperty() below goes to base properties
+	fMaterialized = true;
+
+	size_t count = fValue.GetCount();
+	VString name;
+	VJSONBlobValue blobValue;
+	for( size_t i = 0 ; i < count ; ++i)
+	{
+		if (fValue.GetNthProperty( i, name, blobValue))
+		{
+			VJSONValue value;
+			unordered_map_VString<VJSONValue>::iterator found = fChildren.end();
+			if (blobValue.IsObject() || blobValue.IsArray())
+				found = fChildren.find( name);
+
+			if (found != fChildren.end())
+				value = found->second;
+			else
+				blobValue.GetValue( value, true);
+
+			inOwner->SetProperty( name, value);
+		}
+	}
+
+	fChildren.clear();
+	ReleaseRefCountable( &fBlob);
+	fValue = VJSONBlobValue();
+}
+
+
+#pragma mark -
+
+
+size_t VJSONBlobValue::GetCount() const
+{
+	if (IsObject() || IsArray())
+	{
+		VJSONBlob::Slot slot = { fType, fData };
+		return fBlob->_GetCount( slot);
+	}
+	return 0;
+}
+
+
+VJSONBlobValue VJSONBlobValue::GetProperty( const VString& inName) const
+{
+	return _GetProperty( inName.GetCPointer(), (uLONG) inName.GetLength());
+}
+
+
+VJSONBlobValue VJSONBlobValue::_GetProperty( const UniChar *inName, uLONG inLength) const
+{
+	uLONG count = (uLONG) GetCount();
+
+	// binary search in the sorted index
+	uLONG low = 0;
+	uLONG high = count;
+	while (low < high)
+	{
+		uLONG middle = low + (high - low) / 2;
+		uLONG entryIndex;
+		VJSONBlob::ObjectEntry entry;
+		if (!fBlob->_ReadULong( fData + sizeof( uLONG) + count * sizeof( VJSONBlob::ObjectEntry) + middle * sizeof( uLONG), entryIndex)
+			|| !fBlob->_ReadObjectEntry( fData, count, entryIndex, entry) )
+			break;
+
+		sLONG result = fBlob->_CompareString( entry.fName, inName, inLength);
+		if (result == 0)
+			return _GetChild( entry.fValue.fType, entry.fValue.fData);
+		if (result < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return VJSONBlobValue();
+}
+
+
+bool VJSONBlobValue::GetNthProperty( size_t inIndex, VString& outName, VJSONBlobValue& outValue) const
+{
+	uLONG count = IsObject() ? (uLONG) GetCount() : 0;
+	VJSONBlob::ObjectEntry entry;
+	if ( (inIndex >= count) || !fBlob->_ReadObjectEntry( fData, count, (uLONG) inIndex, entry))
+		return false;
+
+	fBlob->_GetString( entry.fName, outName);
+	outValue = _GetChild( entry.fValue.fType, entry.fValue.fData);
+	return true;
+}
+
+
+VJSONBlobValue VJSONBlobValue::GetNth( size_t inIndex) const
+{
+	if (IsArray() && (inIndex < GetCount()))
+	{
+		VJSONBlob::Slot slot;
+		if (fBlob->_ReadSlot( fData + sizeof( uLONG) + (uLONG) inIndex * sizeof( VJSONBlob::Slot), slot))
+			return _GetChild( slot.fType, slot.fData);
+	}
+	return VJSONBlobValue();
+}
+
+
+VJSONBlobValue VJSONBlobValue::_GetChild( uLONG inType, uLONG inData) const
+{
+	// the writer puts containers before their parent: a corrupted blob cannot make a cycle.
+	VJSONBlobValue child( fBlob, inType, inData);
+	if ( (child.IsObject() || child.IsArray()) && (inData >= fData) )
+		return VJSONBlobValue();
+
+	return child;
+}
+
+
+VJSONBlobValue VJSONBlobValue::GetPath( const VString& inPath) const
+{
+	VJSONBlobValue value( *this);
+
+	const UniChar *pos = inPath.GetCPointer();
+	const UniChar *end = pos + inPath.GetLength();
+	bool first = true;
+	while ( (pos < end) && !value.IsUndefined())
+	{
+		if (*pos == '[')
+		{
+			size_t index = 0;
+			const UniChar *digits = ++pos;
+			while ( (pos < end) && (*pos >= '0') && (*pos <= '9') )
+				index = index * 10 + (*pos++ - '0');
+			if ( (pos == digits) || (pos == end) || (*pos != ']') )
+				return VJSONBlobValue();
+			++pos;
+			value = value.GetNth( index);
+		}
+		else
+		{
+			if (*pos == '.')
+			{
+				if (first)
+					return VJSONBlobValue();
+				++pos;
+			}
+			const UniChar *name = pos;
+			while ( (pos < end) && (*pos != '.') && (*pos != '[') )
+				++pos;
+			value = value._GetProperty( name, (uLONG) (pos - name));
+		}
+		first = false;
+	}
+	return value;
+}
+
+
+double VJSONBlobValue::GetNumber() const
+{
+	double number = 0;
+	if (IsNumber())
+	{
+		if ( (fType & VJSONBlob::kSLOT_INLINE_INTEGER) != 0)
+			number = (sLONG) fData;
+		else if (fBlob->_IsInRange( fData, sizeof( number)))
+			::memcpy( &number, fBlob->fData + fData, sizeof( number));
+	}
+	return number;
+}
+
+
+void VJSONBlobValue::GetString( VString& outString) const
+{
+	if (IsString())
+		fBlob->_GetString( fData, outString);
+	else
+		outString.Clear();
+}
+
+
+void VJSONBlobValue::GetTime( VTime& outTime) const
+{
+	sLONG8 milliseconds;
+	if (IsDate() && fBlob->_IsInRange( fData, sizeof( milliseconds)))
+	{
+		::memcpy( &milliseconds, fBlob->fData + fData, sizeof( milliseconds));
+		outTime.FromMilliseconds( milliseconds);
+	}
+	else
+	{
+		outTime.Clear();
+	}
+}
+
+
+bool VJSONBlobValue::EqualsString( const VString& inString) const
+{
+	return IsString() && (fBlob->_CompareString( fData, inString.GetCPointer(), (uLONG) inString.GetLength()) == 0);
+}
+
+
+void VJSONBlobValue::GetValue( VJSONValue& outValue, bool inLazy) const
+{
+	_GetValue( outValue, inLazy, 0);
+}
+
+
+void VJSONBlobValue::_GetValue( VJSONValue& outValue, bool inLazy, uLONG inDepth) const
+{
+	// lazy objects start again from 0, their properties are read on access.
+	if ( (inDepth >= kJSON_BLOB_MAX_DEPTH) && (IsObject() || IsArray()) )
+	{
+		outValue.SetUndefined();
+		return;
+	}
+
+	switch( GetType())
+	{
+		case JSON_null:		outValue.SetNull(); break;
+		case JSON_true:		outValue.SetBool( true); break;
+		case JSON_false:	outValue.SetBool( false); break;
+		case JSON_number:	outValue.SetNumber( GetNumber()); break;
+
+		case JSON_string:
+			{
+				VString s;
+				GetString( s);
+				outValue.SetString( s);
+				break;
+			}
+
+		case JSON_date:
+			{
+				VTime time;
+				GetTime( time);
+				outValue.SetTime( time);
+				break;
+			}
+
+		case JSON_object:
+			{
+				VJSONObject *object;
+				if (inLazy)
+				{
+					VJSONBlobObject *impl = new VJSONBlobObject( *this, fBlob);
+					object = new VJSONObject( impl);
+					ReleaseRefCountable( &impl);
+				}
+				else
+				{
+					object = new VJSONObject;
+					size_t count = GetCount();
+					VString name;
+					VJSONBlobValue blobValue;
+					for( size_t i = 0 ; (i < count) && (object != NULL) ; ++i)
+					{
+						if (GetNthProperty( i, name, blobValue))
+						{
+							VJSONValue value;
+							blobValue._GetValue( value, false, inDepth + 1);
+							object->SetProperty( name, value);
+						}
+					}
+				}
+				outValue.SetObject( object);
+				ReleaseRefCountable( &object);
+				break;
+			}
+
+		case JSON_array:
+			{
+				// arrays have no virtual implementation, their objects are lazy though
+				VJSONArray *array = new VJSONArray;
+				if (array != NULL)
+				{
+					size_t count = GetCount();
+					for( size_t i = 0 ; i < count ; ++i)
+					{
+						VJSONValue value;
+						GetNth( i)._GetValue( value, inLazy, inDepth + 1);
+						array->Push( value);
+					}
+				}
+				outValue.SetArray( array);
+				ReleaseRefCountable( &array);
+				break;
+			}
+
+		default:
+			outValue.SetUndefined();
+			break;
+	}
+}
+
+
+#pragma mark -
+
+
+VJSONBlob::VJSONBlob()
+: fData( NULL)
+, fSize( 0)
+{
+	fRoot.fType = JSON_undefined;
+	fRoot.fData = 0;
+}
+
+
+VJSONBlob::~VJSONBlob()
+{
+}
+
+
+//static
+VJSONBlob* VJSONBlob::Create( const VJSONValue& inValue)
+{
+	VMemoryBuffer<> buffer;
+	VJSONBlobWriter writer;
+	if (writer.WriteValue( inValue, buffer) != VE_OK)
+		return NULL;
+
+	return Create( buffer);
+}
+
+
+//static
+VJSONBlob* VJSONBlob::Create( VMemoryBuffer<>& ioBuffer)
+{
+	VJSONBlob *blob = new VJSONBlob;
+	if (blob == NULL)
+	{
+		vThrowError( VE_MEMORY_FULL);
+		return NULL;
+	}
+
+	blob->fBuffer.SetDataPtr( ioBuffer.GetDataPtr(), ioBuffer.GetDataSize(), ioBuffer.GetAllocatedSize());
+	ioBuffer.ForgetData();
+	blob->fData = (const uBYTE*) blob->fBuffer.GetDataPtr();
+	blob->fSize = blob->fBuffer.GetDataSize();
+
+	if (!blob->_Init())
+	{
+		ReleaseRefCountable( &blob);
+		vThrowError( VE_STREAM_BAD_SIGNATURE);
+	}
+	return blob;
+}
+
+
+//static
+VJSONBlob* VJSONBlob::CreateWithExternalData( const void *inData, VSize inSize)
+{
+	VJSONBlob *blob = new VJSONBlob;
+	if (blob == NULL)
+	{
+		vThrowError( VE_MEMORY_FULL);
+		return NULL;
+	}
+
+	blob->fData = (const uBYTE*) inData;
+	blob->fSize = inSize;
+
+	if (!blob->_Init())
+	{
+		ReleaseRefCountable( &blob);
+		vThrowError( VE_STREAM_BAD_SIGNATURE);
+	}
+	return blob;
+}
+
+
+//static
+VJSONBlob* VJSONBlob::CreateFromFile( const VFile *inFile)
+{
+	VMemoryBuffer<> buffer;
+	if (inFile->GetContent( buffer) != VE_OK)
+		return NULL;
+
+	return Create( buffer);
+}
+
+
+VJSONBlobValue VJSONBlob::GetRoot() const
+{
+	return VJSONBlobValue( this, fRoot.fType, fRoot.fData);
+}
+
+
+VError VJSONBlob::SaveToFile( VFile *inFile) const
+{
+	return inFile->SetContent( fData, fSize);
+}
+
+
+bool VJSONBlob::_Init()
+{
+	Header header;
+	if ( (fData == NULL) || (fSize < sizeof( header)) || (fSize > kJSON_BLOB_MAX_SIZE) )
+		return false;
+
+	::memcpy( &header, fData, sizeof( header));
+	if ( (header.fSignature != kJSON_BLOB_SIGNATURE) || (header.fVersion != kJSON_BLOB_VERSION) || (header.fSize != fSize) )
+		return false;
+
+	return _ReadSlot( offsetof( Header, fRoot), fRoot);
+}
+
+
+bool VJSONBlob::_ReadULong( uLONG inOffset, uLONG& outValue) const
+{
+	if (!_IsInRange( inOffset, sizeof( outValue)))
+		return false;
+	::memcpy( &outValue, fData + inOffset, sizeof( outValue));
+	return true;
+}
+
+
+bool VJSONBlob::_ReadSlot( uLONG inOffset, Slot& outSlot) const
+{
+	if (!_IsInRange( inOffset, sizeof( outSlot)))
+		return false;
+	::memcpy( &outSlot, fData + inOffset, sizeof( outSlot));
+
+	// a corrupted type must not be taken for a valid one
+	if ( (outSlot.fType & 0xFF) > JSON_date)
+		outSlot.fType = JSON_undefined;
+	return true;
+}
+
+
+bool VJSONBlob::_ReadObjectEntry( uLONG inObject, uLONG inCount, uLONG inIndex, ObjectEntry& outEntry) const
+{
+	// _GetCount() checked that the entries are in range
+	if (inIndex >= inCount)
+		return false;
+	::memcpy( &outEntry, fData + inObject + sizeof( uLONG) + inIndex * sizeof( ObjectEntry), sizeof( outEntry));
+
+	if ( (outEntry.fValue.fType & 0xFF) > JSON_date)
+		outEntry.fValue.fType = JSON_undefined;
+	return true;
+}
+
+
+uLONG VJSONBlob::_GetCount( const Slot& inContainer) const
+{
+	uLONG count;
+	if (!_ReadULong( inContainer.fData, count))
+		return 0;
+
+	VSize itemSize = ((inContainer.fType & 0xFF) == JSON_object) ? sizeof( ObjectEntry) + sizeof( uLONG) : sizeof( Slot);
+	if ( (count > fSize / itemSize) || !_IsInRange( inContainer.fData + sizeof( uLONG), count * itemSize) )
+		return 0;
+
+	return count;
+}
+
+
+bool VJSONBlob::_GetStringRecord( uLONG inOffset, const void*& outChars, uLONG& outLength) const
+{
+	if (!_ReadULong( inOffset, outLength) || (outLength > fSize / sizeof( UniChar)) || !_IsInRange( inOffset + sizeof( uLONG), outLength * sizeof( UniChar)))
+		return false;
+
+	outChars = fData + inOffset + sizeof( uLONG);
+	return true;
+}
+
+
+void VJSONBlob::_GetString( uLONG inOffset, VString& outString) const
+{
+	const void *chars;
+	uLONG length;
+	if (_GetStringRecord( inOffset, chars, length))
+		outString.FromBlock( chars, length * sizeof( UniChar), VTC_UTF_16);
+	else
+		outString.Clear();
+}
+
+
+sLONG VJSONBlob::_CompareString( uLONG inOffset, const UniChar *inChars, uLONG inLength) const
+{
+	const void *chars;
+	uLONG length;
+	if (!_GetStringRecord( inOffset, chars, length))
+		return -1;
+
+	return _CompareNames( chars, length, inChars, inLength);
+}
+
+
+#pragma mark -
+
+
+VJSONBlobWriter::VJSONBlobWriter()
+: fBuffer( NULL)
+, fFailed( false)
+{
+}
+
+
+VJSONBlobWriter::~VJSONBlobWriter()
+{
+}
+
+
+VError VJSONBlobWriter::WriteValue( const VJSONValue& inValue, VMemoryBuffer<>& outBuffer)
+{
+	outBuffer.Clear();
+	fBuffer = &outBuffer;
+	fFailed = false;
+	fStrings.clear();
+	fStack.clear();
+
+	VJSONBlob::Header header;
+	::memset( &header, 0, sizeof( header));
+	_Append( &header, sizeof( header), 8);
+
+	VError err = _WriteValue( inValue, header.fRoot);
+	if ( (err == VE_OK) && fFailed)
+		err = vThrowError( VE_MEMORY_FULL);
+
+	if (err == VE_OK)
+	{
+		header.fSignature = kJSON_BLOB_SIGNATURE;
+		header.fVersion = kJSON_BLOB_VERSION;
+		header.fSize = (uLONG) outBuffer.GetDataSize();
+		outBuffer.PutData( 0, &header, sizeof( header));
+	}
+	else
+	{
+		outBuffer.Clear();
+	}
+
+	fStrings.clear();
+	fBuffer = NULL;
+
+	return err;
+}
+
+
+VError VJSONBlobWriter::_WriteValue( const VJSONValue& inValue, VJSONBlob::Slot& outSlot)
+{
+	VError err = VE_OK;
+	outSlot.fType = inValue.GetType();
+	outSlot.fData = 0;
+
+	switch( inValue.GetType())
+	{
+		case JSON_null:
+		case JSON_undefined:
+		case JSON_true:
+		case JSON_false:
+			break;
+
+		case JSON_string:
+			{
+				VString s;
+				inValue.GetString( s);
+				outSlot.fData = _WriteString( s);
+				break;
+			}
+
+		case JSON_number:
+			{
+				double number = inValue.GetNumber();
+				sLONG integer;
+				if (_IsInlineInteger( number, integer))
+				{
+					outSlot.fType |= VJSONBlob::kSLOT_INLINE_INTEGER;
+					outSlot.fData = (uLONG) integer;
+				}
+				else
+				{
+					outSlot.fData = _Append( &number, sizeof( number), sizeof( number));
+				}
+				break;
+			}
+
+		case JSON_date:
+			{
+				VTime time;
+				inValue.GetTime( time);
+				sLONG8 milliseconds = time.GetMilliseconds();
+				outSlot.fData = _Append( &milliseconds, sizeof( milliseconds), sizeof( milliseconds));
+				break;
+			}
+
+		case JSON_object:
+			err = _WriteObject( inValue.GetObject(), outSlot.fData);
+			break;
+
+		case JSON_array:
+			err = _WriteArray( inValue.GetArray(), outSlot.fData);
+			break;
+
+		default:
+			xbox_assert( false);
+			outSlot.fType = JSON_undefined;
+			break;
+	}
+
+	return err;
+}
+
+
+// sorts entry indexes on names
+class VJSONBlobNameLess
+{
+public:
+	VJSONBlobNameLess( const std::vector<const VString*>& inNames):fNames( inNames)	{}
+
+	bool operator()( uLONG inIndex1, uLONG inIndex2) const
+	{
+		const VString *name1 = fNames[inIndex1];
+		const VString *name2 = fNames[inIndex2];
+		return _CompareNames( name1->GetCPointer(), (uLONG) name1->GetLength(), name2->GetCPointer(), (uLONG) name2->GetLength()) < 0;
+	}
+
+private:
+	const std::vector<const VString*>&	fNames;
+};
+
+
+VError VJSONBlobWriter::_WriteObject( const VJSONObject *inObject, uLONG& outOffset)
+{
+	if (std::find( fStack.begin(), fStack.end(), inObject) != fStack.end())
+		return vThrowError( VE_JSON_STRINGIFY_CIRCULAR);
+
+	VError err = VE_OK;
+	std::vector<VJSONBlob::ObjectEntry> entries;
+	std::vector<const VString*> names;
+
+	fStack.push_back( inObject);
+	for( VJSONPropertyConstIterator i( inObject) ; i.IsValid() && (err == VE_OK) ; ++i)
+	{
+		VJSONBlob::ObjectEntry entry;
+		entry.fName = _WriteString( i.GetName());
+		err = _WriteValue( i.GetValue(), entry.fValue);
+		entries.push_back( entry);
+		names.push_back( &i.GetName());
+	}
+	fStack.pop_back();
+
+	if (err == VE_OK)
+	{
+		uLONG count = (uLONG) entries.size();
+		std::vector<uLONG> sorted( count);
+		for( uLONG i = 0 ; i < count ; ++i)
+			sorted[i] = i;
+		std::sort( sorted.begin(), sorted.end(), VJSONBlobNameLess( names));
+
+		outOffset = _Append( &count, sizeof( count), sizeof( uLONG));
+		if (count > 0)
+		{
+			_Append( &entries.front(), count * sizeof( VJSONBlob::ObjectEntry), 1);
+			_Append( &sorted.front(), count * sizeof( uLONG), 1);
+		}
+	}
+
+	return err;
+}
+
+
+VError VJSONBlobWriter::_WriteArray( const VJSONArray *inArray, uLONG& outOffset)
+{
+	if (std::find( fStack.begin(), fStack.end(), inArray) != fStack.end())
+		return vThrowError( VE_JSON_STRINGIFY_CIRCULAR);
+
+	VError err = VE_OK;
+	uLONG count = (uLONG) inArray->GetCount();
+	std::vector<VJSONBlob::Slot> slots( count);
+
+	fStack.push_back( inArray);
+	for( uLONG i = 0 ; (i < count) && (err == VE_OK) ; ++i)
+		err = _WriteValue( (*inArray)[i], slots[i]);
+	fStack.pop_back();
+
+	if (err == VE_OK)
+	{
+		outOffset = _Append( &count, sizeof( count), sizeof( uLONG));
+		if (count > 0)
+			_Append( &slots.front(), count * sizeof( VJSONBlob::Slot), 1);
+	}
+
+	return err;
+}
+
+
+uLONG VJSONBlobWriter::_WriteString( const VString& inString)
+{
+	unordered_map_VString<uLONG>::const_iterator found = fStrings.find( inString);
+	if (found != fStrings.end())
+		return found->second;
+
+	uLONG length = (uLONG) inString.GetLength();
+	uLONG offset = _Append( &length, sizeof( length), sizeof( uLONG));
+	if (length > 0)
+		_Append( inString.GetCPointer(), length * sizeof( UniChar), 1);
+
+	fStrings.insert( unordered_map_VString<uLONG>::value_type( inString, offset));
+	return offset;
+}
+
+
+uLONG VJSONBlobWriter::_Append( const void *inData, VSize inSize, VSize inAlignment)
+{
+	static const uBYTE sZeros[8] = { 0 };
+
+	if (fFailed)
+		return 0;
+
+	VSize offset = fBuffer->GetDataSize();
+	VSize padding = (inAlignment - offset % inAlignment) % inAlignment;
+	if ( (offset + padding + inSize > kJSON_BLOB_MAX_SIZE)
+		|| ( (padding > 0) && !fBuffer->AddData( sZeros, padding))
+		|| !fBuffer->AddData( inData, inSize) )
+	{
+		fFailed = true;
+		return 0;
+	}
+
+	return (uLONG) (offset + padding);
+}
+
+
+END_TOOLBOX_NAMESPACE
@@ -0,0 +1,225 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#ifndef __VJSONBlob__
+#define __VJSONBlob__
+
+#include "Kernel/Sources/VJSONValue.h"
+
+BEGIN_TOOLBOX_NAMESPACE
+
+class VJSONBlob;
+class VFile;
+class VTime;
+
+/*
+	@brief	Read-only cursor on a value stored in a VJSONBlob.
+
+	Nothing is decoded until asked for: looking up a property is a binary search in the object index,
+	getting an array element is an indexing in the array slots.
+	A cursor doesn't retain its blob, it must not be used once the blob has been released.
+
+	VJSONBlobValue root = blob->GetRoot();
+	VString name;
+	root.GetPath( CVSTR( "customers[12].name")).GetString( name);
+*/
+class XTOOLBOX_API VJSONBlobValue : public VObject
+{
+public:
+									VJSONBlobValue():fBlob( NULL), fType( JSON_undefined), fData( 0)	{}
+
+			JSONType				GetType() const		{ return (JSONType) (fType & 0xFF);}
+
+			bool					IsUndefined() const	{ return GetType() == JSON_undefined;}
+			bool					IsNull() const		{ return GetType() == JSON_null;}
+			bool					IsBool() const		{ return GetType() == JSON_false || GetType() == JSON_true;}
+			bool					IsString() const	{ return GetType() == JSON_string;}
+			bool					IsNumber() const	{ return GetType() == JSON_number;}
+			bool					IsObject() const	{ return GetType() == JSON_object;}
+			bool					IsArray() const		{ return GetType() == JSON_array;}
+			bool					IsDate() const		{ return GetType() == JSON_date;}
+
+			// number of properties of an object or elements of an array, else 0.
+			size_t					GetCount() const;
+
+			// property of an object, JSON_undefined if not found or not an object.
+			VJSONBlobValue			GetProperty( const VString& inName) const;
+
+			// nth property of an object in declaration order (0 based). Returns false if out of range.
+			bool					GetNthProperty( size_t inIndex, VString& outName, VJSONBlobValue& outValue) const;
+
+			// element of an array (0 based), JSON_undefined if out of range or not an array.
+			VJSONBlobValue			GetNth( size_t inIndex) const;
+
+			// follows a path made of property names separated by dots and array indexes between brackets,
+			// like "a.b[2].c" or "[0].name". JSON_undefined if some step is not found.
+			VJSONBlobValue			GetPath( const VString& inPath) const;
+
+			// getters return a default value if the type mismatches.
+			bool					GetBool() const		{ return GetType() == JSON_true;}
+			double					GetNumber() const;
+			void					GetString( VString& outString) const;
+			void					GetTime( VTime& outTime) const;
+
+			// tells if a string value equals inString without decoding it.
+			bool					EqualsString( const VString& inString) const;
+
+			// builds a VJSONValue.
+			// if inLazy is true, objects are views on the blob reading their properties on first access.
+			// they materialize themselves into regular VJSONObject properties when modified or iterated.
+			// a lazy object retains the blob.
+			void					GetValue( VJSONValue& outValue, bool inLazy = true) const;
+
+private:
+	friend class VJSONBlob;
+
+									VJSONBlobValue( const VJSONBlob *inBlob, uLONG inType, uLONG inData):fBlob( inBlob), fType( inType), fData( inData)	{}
+
+			VJSONBlobValue			_GetProperty( const UniChar *inName, uLONG inLength) const;
+			VJSONBlobValue			_GetChild( uLONG inType, uLONG inData) const;
+			void					_GetValue( VJSONValue& outValue, bool inLazy, uLONG inDepth) const;
+
+			const VJSONBlob*		fBlob;
+			uLONG					fType;
+			uLONG					fData;
+};
+
+
+/*
+	@brief	Random access binary JSON document.
+
+	Unlike VJSONBinaryWriter format, the layout is made of offset tables so that a value can be read in place:
+	objects keep their properties in declaration order followed by an index sorted on names,
+	arrays are a table of fixed size slots. Strings are stored once in UTF-16.
+
+	All offsets are relative to the beginning of the blob, which may be at any address
+	(a file content read once, or memory mapped by the caller). The content is checked against its size
+	on each access so that a corrupted blob cannot make a read go out of bounds.
+	The byte order is the native one: a blob written on a big endian machine is refused on a little endian one.
+
+	VJSONBlob *blob = VJSONBlob::Create( value);
+	...
+	VJSONValue lazyValue;
+	blob->GetRoot().GetValue( lazyValue);
+	ReleaseRefCountable( &blob);
+*/
+class XTOOLBOX_API VJSONBlob : public VObject, public IRefCountable
+{
+public:
+			// serializes a value. Returns NULL and throws an error on failure.
+	static	VJSONBlob*				Create( const VJSONValue& inValue);
+
+			// takes ownership of a buffer produced by VJSONBlobWriter or read from a file.
+			// Returns NULL and throws VE_STREAM_BAD_SIGNATURE if the content is not a valid blob.
+	static	VJSONBlob*				Create( VMemoryBuffer<>& ioBuffer);
+
+			// uses external memory without copying it. The memory must stay valid until the blob is destroyed.
+	static	VJSONBlob*				CreateWithExternalData( const void *inData, VSize inSize);
+
+			// reads the file content
+	static	VJSONBlob*				CreateFromFile( const VFile *inFile);
+
+			VJSONBlobValue			GetRoot() const;
+
+			const void*				GetDataPtr() const		{ return fData;}
+			VSize					GetDataSize() const		{ return fSize;}
+
+			VError					SaveToFile( VFile *inFile) const;
+
+private:
+	friend class VJSONBlobValue;
+	friend class VJSONBlobWriter;
+
+	// slot type flag for small integers stored in the slot itself
+	enum {
+		kSLOT_INLINE_INTEGER = 0x100
+	};
+
+	typedef struct Slot
+	{
+		uLONG			fType;		// JSONType, and kSLOT_INLINE_INTEGER
+		uLONG			fData;		// inline value or offset of the value record
+	} Slot;
+
+	typedef struct Header
+	{
+		uLONG			fSignature;
+		uLONG			fVersion;
+		uLONG			fSize;
+		Slot			fRoot;
+		uLONG			fReserved;
+	} Header;
+
+	// an object record is a count followed by that many entries then that many indexes of entries sorted by name
+	typedef struct ObjectEntry
+	{
+		uLONG			fName;		// offset of the name string record
+		Slot			fValue;
+	} ObjectEntry;
+
+									VJSONBlob();
+	virtual							~VJSONBlob();
+									VJSONBlob( const VJSONBlob&);				// forbidden
+			VJSONBlob&				operator=( const VJSONBlob&);				// forbidden
+
+			bool					_Init();
+
+			bool					_IsInRange( uLONG inOffset, VSize inSize) const		{ return (inOffset <= fSize) && (inSize <= fSize - inOffset);}
+			bool					_ReadULong( uLONG inOffset, uLONG& outValue) const;
+			bool					_ReadSlot( uLONG inOffset, Slot& outSlot) const;
+			bool					_ReadObjectEntry( uLONG inObject, uLONG inCount, uLONG inIndex, ObjectEntry& outEntry) const;
+			uLONG					_GetCount( const Slot& inContainer) const;
+			bool					_GetStringRecord( uLONG inOffset, const void*& outChars, uLONG& outLength) const;
+			void					_GetString( uLONG inOffset, VString& outString) const;
+			sLONG					_CompareString( uLONG inOffset, const UniChar *inChars, uLONG inLength) const;
+
+			VMemoryBuffer<>			fBuffer;		// empty for external data
+			const uBYTE*			fData;
+			VSize					fSize;
+			Slot					fRoot;
+};
+
+
+/*
+	@brief	Serializes a VJSONValue into the VJSONBlob format.
+	Cyclic structures are detected and throw error VE_JSON_STRINGIFY_CIRCULAR.
+*/
+class XTOOLBOX_API VJSONBlobWriter : public VObject
+{
+public:
+									VJSONBlobWriter();
+	virtual							~VJSONBlobWriter();
+
+			VError					WriteValue( const VJSONValue& inValue, VMemoryBuffer<>& outBuffer);
+
+private:
+									VJSONBlobWriter( const VJSONBlobWriter&);				// forbidden
+			VJSONBlobWriter&		operator=( const VJSONBlobWriter&);						// forbidden
+
+			VError					_WriteValue( const VJSONValue& inValue, VJSONBlob::Slot& outSlot);
+			VError					_WriteObject( const VJSONObject *inObject, uLONG& outOffset);
+			VError					_WriteArray( const VJSONArray *inArray, uLONG& outOffset);
+			uLONG					_WriteString( const VString& inString);
+			uLONG					_Append( const void *inData, VSize inSize, VSize inAlignment);
+
+			VMemoryBuffer<>*		fBuffer;
+			bool					fFailed;			// memory full or blob too big
+			unordered_map_VString<uLONG>	fStrings;	// offsets of the strings already written
+			std::vector<const void*>		fStack;		// objects and arrays being written, used to detect recursion
+};
+
+END_TOOLBOX_NAMESPACE
+
+#endif
@@ -0,0 +1,1015 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#include "VKernelPrecompiled.h"
+#include "VJSONStreamParser.h"
+#include "VTime.h"
+#include "VError.h"
+#include "VErrorContext.h"
+#include "VStream.h"
+
+#if ARCH_386 && (ARCH_64 || defined(__SSE2__) || (COMPIL_VISUAL && defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+	#define WITH_SSE2_SCANNING	1
+	#include <emmintrin.h>
+	#if COMPIL_VISUAL
+		#include <intrin.h>
+	#endif
+#endif
+
+BEGIN_TOOLBOX_NAMESPACE
+
+
+static const char	sExpectedValue[]		= "\" 0-9 null true false { [";
+static const char	sExpectedFirstValue[]	= "\" 0-9 null true false { [ ]";
+
+// exact powers of ten for the fast number conversion
+static const uLONG8	kMAX_MANTISSA = XBOX_LONG8(100000000000000000);
+static const Real	sPowersOfTen[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+static inline bool _IsDelimiter( char inChar)
+{
+	switch( inChar)
+	{
+		case '{':
+		case '}':
+		case '[':
+		case ']':
+		case ',':
+		case ':':
+		case '"':
+			return true;
+
+		default:
+			return (uBYTE) inChar <= 32;
+	}
+}
+
+
+// returns the position of the first '"' or '\' or inEnd
+static const char* _FindQuoteOrBackslash( const char *inPos, const char *inEnd)
+{
+#if WITH_SSE2_SCANNING
+	const __m128i quote = _mm_set1_epi8( '"');
+	const __m128i backslash = _mm_set1_epi8( '\\');
+
+	for ( ; inPos + 16 <= inEnd ; inPos += 16)
+	{
+		__m128i bytes = _mm_loadu_si128( (const __m128i*) inPos);
+		int mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( bytes, quote), _mm_cmpeq_epi8( bytes, backslash)));
+		if (mask != 0)
+		{
+		#if COMPIL_VISUAL
+			unsigned long index;
+			_BitScanForward( &index, (unsigned long) mask);
+			return inPos + index;
+		#else
+			return inPos + __builtin_ctz( (unsigned int) mask);
+		#endif
+		}
+	}
+#endif
+
+	while ( (inPos < inEnd) && (*inPos != '"') && (*inPos != '\\') )
+		++inPos;
+
+	return inPos;
+}
+
+
+static void _AppendUTF8( std::vector<char>& ioBuffer, uLONG inCodePoint)
+{
+	if (inCodePoint < 0x80)
+	{
+		ioBuffer.push_back( (char) inCodePoint);
+	}
+	else if (inCodePoint < 0x800)
+	{
+		ioBuffer.push_back( (char) (0xC0 | (inCodePoint >> 6)));
+		ioBuffer.push_back( (char) (0x80 | (inCodePoint & 0x3F)));
+	}
+	else if (inCodePoint < 0x10000)
+	{
+		ioBuffer.push_back( (char) (0xE0 | (inCodePoint >> 12)));
+		ioBuffer.push_back( (char) (0x80 | ((inCodePoint >> 6) & 0x3F)));
+		ioBuffer.push_back( (char) (0x80 | (inCodePoint & 0x3F)));
+	}
+	else
+	{
+		ioBuffer.push_back( (char) (0xF0 | (inCodePoint >> 18)));
+		ioBuffer.push_back( (char) (0x80 | ((inCodePoint >> 12) & 0x3F)));
+		ioBuffer.push_back( (char) (0x80 | ((inCodePoint >> 6) & 0x3F)));
+		ioBuffer.push_back( (char) (0x80 | (inCodePoint & 0x3F)));
+	}
+}
+
+
+static bool _ParseHex4( const char *inPos, const char *inEnd, uLONG& outValue)
+{
+	if (inEnd - inPos < 4)
+		return false;
+
+	outValue = 0;
+	for (sLONG i = 0 ; i < 4 ; ++i)
+	{
+		char c = inPos[i];
+		outValue <<= 4;
+		if (c >= '0' && c <= '9')
+			outValue += c - '0';
+		else if (c >= 'A' && c <= 'F')
+			outValue += c - 'A' + 10;
+		else if (c >= 'a' && c <= 'f')
+			outValue += c - 'a' + 10;
+		else
+			return false;
+	}
+	return true;
+}
+
+
+
+// ===========================================================
+#pragma mark -
+#pragma mark VJSONStreamBuilder
+// ===========================================================
+
+
+VJSONStreamBuilder::VJSONStreamBuilder()
+{
+}
+
+
+VJSONStreamBuilder::~VJSONStreamBuilder()
+{
+}
+
+
+void VJSONStreamBuilder::Clear()
+{
+	fValue.SetUndefined();
+	fContainers.clear();
+	fNames.clear();
+	fPropertyNames.Clear();
+}
+
+
+void VJSONStreamBuilder::_SetValue( const VJSONValue& inValue)
+{
+	if (fContainers.empty())
+		fValue = inValue;
+	else if (fContainers.back().IsObject())
+		fContainers.back().GetObject()->SetProperty( fNames.back(), inValue);
+	else
+		fContainers.back().GetArray()->Push( inValue);
+}
+
+
+VError VJSONStreamBuilder::BeginObject()
+{
+	VJSONValue value( JSON_object);
+	if (value.GetObject() == NULL)
+		return VE_MEMORY_FULL;
+
+	_SetValue( value);
+	fContainers.push_back( value);
+	fNames.push_back( VString());
+	return VE_OK;
+}
+
+
+VError VJSONStreamBuilder::EndObject()
+{
+	fContainers.pop_back();
+	fNames.pop_back();
+	return VE_OK;
+}
+
+
+VError VJSONStreamBuilder::BeginArray()
+{
+	VJSONValue value( JSON_array);
+	if (value.GetArray() == NULL)
+		return VE_MEMORY_FULL;
+
+	_SetValue( value);
+	fContainers.push_back( value);
+	fNames.push_back( VString());
+	return VE_OK;
+}
+
+
+VError VJSONStreamBuilder::EndArray()
+{
+	fContainers.pop_back();
+	fNames.pop_back();
+	return VE_OK;
+}
+
+
+VError VJSONStreamBuilder::SetPropertyName( const VString& inName)
+{
+	fNames.back() = fPropertyNames.Get( inName);
+	return VE_OK;
+}
+
+
+VError VJSONStreamBuilder::SetString( const VString& inValue)
+{
+	_SetValue( VJSONValue( inValue));
+	return VE_OK;
+}
+
+
+VError VJSONStreamBuilder::SetNumber( Real inValue)
+{
+	_SetValue( VJSONValue( inValue));
+	return VE_OK;
+}
+
+
+VError VJSONStreamBuilder::SetBool( bool inValue)
+{
+	_SetValue( inValue ? VJSONValue::sTrue : VJSONValue::sFalse);
+	return VE_OK;
+}
+
+
+VError VJSONStreamBuilder::SetNull()
+{
+	_SetValue( VJSONValue::sNull);
+	return VE_OK;
+}
+
+
+VError VJSONStreamBuilder::SetDate( const VTime& inValue)
+{
+	VJSONValue value;
+	value.SetTime( inValue);
+	_SetValue( value);
+	return VE_OK;
+}
+
+
+
+// ===========================================================
+#pragma mark -
+#pragma mark VJSONStreamParser
+// ===========================================================
+
+
+VJSONStreamParser::VJSONStreamParser( IJSONStreamHandler *inHandler, VJSONImporter::EJSONImporterOptions inOptions)
+: fHandler( inHandler)
+, fOptions( inOptions)
+, fIgnoreTrailingContent( false)
+{
+	Reset();
+}
+
+
+VJSONStreamParser::~VJSONStreamParser()
+{
+}
+
+
+void VJSONStreamParser::Reset()
+{
+	fError = VE_OK;
+	fState = eState_Value;
+	fContainers.clear();
+	fToken = eToken_None;
+	fPending.clear();
+	fPendingEscape = false;
+	fStringHasEscape = false;
+	fOffset = 0;
+	fTokenOffset = 0;
+	fLineStartOffset = 0;
+	fLine = 1;
+}
+
+
+VError VJSONStreamParser::Feed( const void *inData, VSize inSize)
+{
+	if (fError != VE_OK)
+		return fError;
+
+	const char *start = (const char*) inData;
+	const char *end = start + inSize;
+	const char *pos = start;
+
+	// finish the token cut by previous chunk
+	if (fToken == eToken_String)
+		pos = _ScanString( pos, end);
+	else if (fToken == eToken_Bare)
+		pos = _ScanBare( pos, end);
+
+	while ( (pos < end) && (fError == VE_OK) && !(fIgnoreTrailingContent && (fState == eState_Done)) )
+	{
+		char c = *pos;
+		if ((uBYTE) c <= 32)
+		{
+			if (c == '\n')
+			{
+				++fLine;
+				fLineStartOffset = fOffset + (pos - start) + 1;
+			}
+			++pos;
+			continue;
+		}
+
+		fTokenOffset = fOffset + (pos - start);
+
+		switch( c)
+		{
+			case '{':
+			case '}':
+			case '[':
+			case ']':
+			case ',':
+			case ':':
+				fError = _Structural( c);
+				++pos;
+				break;
+
+			case '"':
+				fToken = eToken_String;
+				fStringHasEscape = false;
+				pos = _ScanString( pos + 1, end);
+				break;
+
+			default:
+				fToken = eToken_Bare;
+				pos = _ScanBare( pos, end);
+				break;
+		}
+	}
+
+	fOffset += inSize;
+
+	return fError;
+}
+
+
+VError VJSONStreamParser::Finish()
+{
+	if (fError != VE_OK)
+		return fError;
+
+	if (fToken == eToken_Bare)
+	{
+		// a bare token is ended by the end of the document
+		fToken = eToken_None;
+		fError = _EndBare( fPending.empty() ? NULL : &fPending.front(), fPending.empty() ? NULL : &fPending.front() + fPending.size());
+		fPending.clear();
+	}
+	else if (fToken == eToken_String)
+	{
+		if ((fOptions & VJSONImporter::EJSI_QuotesMandatoryForString) != 0)
+		{
+			fError = _ThrowErrorUnterminated( "\"");
+		}
+		else
+		{
+			fToken = eToken_None;
+			fError = _EndString( fPending.empty() ? NULL : &fPending.front(), fPending.empty() ? NULL : &fPending.front() + fPending.size());
+			fPending.clear();
+		}
+	}
+
+	if ( (fError == VE_OK) && (fState != eState_Done) )
+	{
+		fTokenOffset = fOffset;
+		fError = _ThrowErrorInvalidToken( CVSTR( ""), _GetExpectedString());
+	}
+
+	return fError;
+}
+
+
+const char* VJSONStreamParser::_ScanString( const char *inPos, const char *inEnd)
+{
+	const char *begin = inPos;
+
+	if (fPendingEscape && (inPos < inEnd))
+	{
+		// the escaped char was in next chunk
+		fPendingEscape = false;
+		++inPos;
+	}
+
+	while (inPos < inEnd)
+	{
+		inPos = _FindQuoteOrBackslash( inPos, inEnd);
+		if (inPos == inEnd)
+			break;
+
+		if (*inPos == '\\')
+		{
+			fStringHasEscape = true;
+			if (inPos + 1 < inEnd)
+			{
+				inPos += 2;
+			}
+			else
+			{
+				fPendingEscape = true;
+				++inPos;
+			}
+		}
+		else
+		{
+			fToken = eToken_None;
+			if (fPending.empty())
+			{
+				// the whole string is in this chunk
+				fError = _EndString( begin, inPos);
+			}
+			else
+			{
+				fPending.insert( fPending.end(), begin, inPos);
+				fError = _EndString( &fPending.front(), &fPending.front() + fPending.size());
+				fPending.clear();
+			}
+			return inPos + 1;
+		}
+	}
+
+	fPending.insert( fPending.end(), begin, inEnd);
+	return inEnd;
+}
+
+
+const char* VJSONStreamParser::_ScanBare( const char *inPos, const char *inEnd)
+{
+	const char *begin = inPos;
+
+	while ( (inPos < inEnd) && !_IsDelimiter( *inPos))
+		++inPos;
+
+	if (inPos == inEnd)
+	{
+		fPending.insert( fPending.end(), begin, inEnd);
+	}
+	else
+	{
+		fToken = eToken_None;
+		if (fPending.empty())
+		{
+			fError = _EndBare( begin, inPos);
+		}
+		else
+		{
+			fPending.insert( fPending.end(), begin, inPos);
+			fError = _EndBare( &fPending.front(), &fPending.front() + fPending.size());
+			fPending.clear();
+		}
+	}
+
+	return inPos;
+}
+
+
+bool VJSONStreamParser::_DecodeString( const char *inBegin, const char *inEnd, VString& outString)
+{
+	if (!fStringHasEscape)
+	{
+		outString.FromBlock( inBegin, inEnd - inBegin, VTC_UTF_8);
+		return true;
+	}
+
+	fUnescaped.clear();
+	for (const char *p = inBegin ; p < inEnd ; ++p)
+	{
+		if (*p != '\\')
+		{
+			fUnescaped.push_back( *p);
+			continue;
+		}
+
+		if (++p == inEnd)
+			return false;
+
+		switch( *p)
+		{
+			case 't':	fUnescaped.push_back( 9); break;
+			case 'r':	fUnescaped.push_back( 13); break;
+			case 'n':	fUnescaped.push_back( 10); break;
+			case 'b':	fUnescaped.push_back( 8); break;
+			case 'f':	fUnescaped.push_back( 12); break;
+
+			case 'u':
+				{
+					uLONG codePoint;
+					if (!_ParseHex4( p + 1, inEnd, codePoint))
+						return false;
+					p += 4;
+
+					if ( (codePoint >= 0xD800) && (codePoint <= 0xDBFF) )
+					{
+						uLONG low;
+						if ( (inEnd - p > 2) && (p[1] == '\\') && (p[2] == 'u') && _ParseHex4( p + 3, inEnd, low) && (low >= 0xDC00) && (low <= 0xDFFF) )
+						{
+							codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+							p += 6;
+						}
+						else
+						{
+							codePoint = 0xFFFD;
+						}
+					}
+					else if ( (codePoint >= 0xDC00) && (codePoint <= 0xDFFF) )
+					{
+						codePoint = 0xFFFD;
+					}
+
+					// like VJSONImporter, \u0000 is dropped
+					if (codePoint != 0)
+						_AppendUTF8( fUnescaped, codePoint);
+					break;
+				}
+
+			default:
+				// \\ \" \/ and any other escaped char stands for itself
+				fUnescaped.push_back( *p);
+				break;
+		}
+	}
+
+	if (fUnescaped.empty())
+		outString.Clear();
+	else
+		outString.FromBlock( &fUnescaped.front(), fUnescaped.size(), VTC_UTF_8);
+
+	return true;
+}
+
+
+//static
+bool VJSONStreamParser::_ParseNumber( const char *inBegin, const char *inEnd, Real& outValue)
+{
+	const char *p = inBegin;
+
+	bool negative = (p < inEnd) && (*p == '-');
+	if (negative)
+		++p;
+
+	// integer part, no leading zero.
+	// digits that don't fit in the mantissa are left to the slow conversion.
+	uLONG8 mantissa = 0;
+	sLONG exponent = 0;
+	bool truncated = false;
+
+	if ( (p < inEnd) && (*p == '0') )
+	{
+		++p;
+	}
+	else if ( (p < inEnd) && (*p >= '1') && (*p <= '9') )
+	{
+		do
+		{
+			if (mantissa < kMAX_MANTISSA)
+				mantissa = mantissa * 10 + (*p - '0');
+			else
+				truncated = true;
+			++p;
+		} while ( (p < inEnd) && (*p >= '0') && (*p <= '9') );
+	}
+	else
+	{
+		return false;
+	}
+
+	if ( (p < inEnd) && (*p == '.') )
+	{
+		++p;
+		if ( (p == inEnd) || (*p < '0') || (*p > '9') )
+			return false;	// the dot must be followed by an integer
+
+		do
+		{
+			if (mantissa < kMAX_MANTISSA)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				--exponent;
+			}
+			else
+			{
+				truncated = true;
+			}
+			++p;
+		} while ( (p < inEnd) && (*p >= '0') && (*p <= '9') );
+	}
+
+	if ( (p < inEnd) && ((*p == 'e') || (*p == 'E')) )
+	{
+		++p;
+		bool negativeExponent = false;
+		if ( (p < inEnd) && ((*p == '+') || (*p == '-')) )
+		{
+			negativeExponent = (*p == '-');
+			++p;
+		}
+
+		if ( (p == inEnd) || (*p < '0') || (*p > '9') )
+			return false;	// 'e' or 'E' must be followed by an integer
+
+		sLONG value = 0;
+		do
+		{
+			if (value < 100000)
+				value = value * 10 + (*p - '0');
+			++p;
+		} while ( (p < inEnd) && (*p >= '0') && (*p <= '9') );
+
+		exponent += negativeExponent ? -value : value;
+	}
+
+	if (p != inEnd)
+		return false;
+
+	if (!truncated && (mantissa <= (XBOX_LONG8(1) << 53)) && (exponent >= -22) && (exponent <= 22) )
+	{
+		// both operands are exact, so is the result (Clinger's fast path)
+		Real value = (Real) mantissa;
+		if (exponent < 0)
+			value /= sPowersOfTen[-exponent];
+		else
+			value *= sPowersOfTen[exponent];
+		outValue = negative ? -value : value;
+	}
+	else
+	{
+		VString string;
+		string.FromBlock( inBegin, inEnd - inBegin, VTC_US_ASCII);
+		outValue = string.GetReal();
+	}
+
+	return true;
+}
+
+
+VError VJSONStreamParser::_EndString( const char *inBegin, const char *inEnd)
+{
+	VString string;
+	if ( (inBegin != inEnd) && !_DecodeString( inBegin, inEnd, string))
+	{
+		VString found;
+		found.FromBlock( inBegin, inEnd - inBegin, VTC_UTF_8);
+		return _ThrowErrorInvalidToken( found, "\\u0000-\\uFFFF");
+	}
+
+	if ( (fState == eState_FirstName) || (fState == eState_NextName) )
+	{
+		fState = eState_Colon;
+		return fHandler->SetPropertyName( string);
+	}
+
+	return _Value( string, true);
+}
+
+
+VError VJSONStreamParser::_EndBare( const char *inBegin, const char *inEnd)
+{
+	VSize length = inEnd - inBegin;
+
+	if ( (fState == eState_FirstName) || (fState == eState_NextName) )
+	{
+		VString name;
+		name.FromBlock( inBegin, length, VTC_UTF_8);
+		if ((fOptions & VJSONImporter::EJSI_QuotesMandatoryForString) != 0)
+			return _ThrowErrorInvalidToken( name, "\"");
+
+		fState = eState_Colon;
+		return fHandler->SetPropertyName( name);
+	}
+
+	if ( (fState != eState_Value) && (fState != eState_FirstValue) && (fState != eState_NextValue) )
+	{
+		VString found;
+		found.FromBlock( inBegin, length, VTC_UTF_8);
+		return _ThrowErrorInvalidToken( found, _GetExpectedString());
+	}
+
+	VError err;
+	if ( (length == 4) && (::memcmp( inBegin, "true", 4) == 0) )
+	{
+		err = fHandler->SetBool( true);
+	}
+	else if ( (length == 5) && (::memcmp( inBegin, "false", 5) == 0) )
+	{
+		err = fHandler->SetBool( false);
+	}
+	else if ( (length == 4) && (::memcmp( inBegin, "null", 4) == 0) )
+	{
+		err = fHandler->SetNull();
+	}
+	else if ( (*inBegin == '-') || ((*inBegin >= '0') && (*inBegin <= '9')) )
+	{
+		Real number;
+		if (_ParseNumber( inBegin, inEnd, number))
+		{
+			err = fHandler->SetNumber( number);
+		}
+		else
+		{
+			VString found;
+			found.FromBlock( inBegin, length, VTC_UTF_8);
+			return _ThrowErrorInvalidToken( found, "+- 0-9 eE");
+		}
+	}
+	else
+	{
+		VString string;
+		string.FromBlock( inBegin, length, VTC_UTF_8);
+		if ((fOptions & VJSONImporter::EJSI_QuotesMandatoryForString) != 0)
+			return _ThrowErrorInvalidToken( string, (fState == eState_FirstValue) ? sExpectedFirstValue : sExpectedValue);
+
+		err = fHandler->SetString( string);
+	}
+
+	return (err == VE_OK) ? _AfterValue() : err;
+}
+
+
+VError VJSONStreamParser::_Value( const VString& inString, bool inWithQuotes)
+{
+	if ( (fState != eState_Value) && (fState != eState_FirstValue) && (fState != eState_NextValue) )
+		return _ThrowErrorInvalidToken( CVSTR( "\""), _GetExpectedString());
+
+	VError err;
+
+	// dates are "!!ISODATE!!"
+	VIndex length = inString.GetLength();
+	const UniChar *p = inString.GetCPointer();
+	if ( ((fOptions & VJSONImporter::EJSI_AllowDates) != 0) && (length >= 4) && (p[0] == '!') && (p[1] == '!') && (p[length - 1] == '!') && (p[length - 2] == '!') )
+	{
+		VTime date;
+		VString s;
+		inString.GetSubString( 3, length - 4, s);
+		date.FromXMLString( s);
+		err = fHandler->SetDate( date);
+	}
+	else
+	{
+		err = fHandler->SetString( inString);
+	}
+
+	return (err == VE_OK) ? _AfterValue() : err;
+}
+
+
+VError VJSONStreamParser::_AfterValue()
+{
+	fState = fContainers.empty() ? eState_Done : eState_Separator;
+	return VE_OK;
+}
+
+
+VError VJSONStreamParser::_Structural( char inChar)
+{
+	bool isValue = (fState == eState_Value) || (fState == eState_FirstValue) || (fState == eState_NextValue);
+	char container = fContainers.empty() ? 0 : fContainers.back();
+	VError err = VE_OK;
+
+	switch( inChar)
+	{
+		case '{':
+		case '[':
+			if (!isValue)
+				return _ThrowErrorInvalidToken( VString( (UniChar) inChar), _GetExpectedString());
+
+			fContainers.push_back( inChar);
+			fState = (inChar == '{') ? eState_FirstName : eState_FirstValue;
+			return (inChar == '{') ? fHandler->BeginObject() : fHandler->BeginArray();
+
+		case '}':
+		case ']':
+			{
+				char opening = (inChar == '}') ? '{' : '[';
+				if ( (fState == eState_NextName) || (fState == eState_NextValue) )
+				{
+					if (container == opening)
+						return _ThrowErrorExtraComma( (inChar == '}') ? "}" : "]");	// just got a ,} or ,] sequence
+				}
+				else if ( (container == opening) && ((fState == eState_Separator) || (fState == ((inChar == '}') ? eState_FirstName : eState_FirstValue))) )
+				{
+					fContainers.pop_back();
+					err = (inChar == '}') ? fHandler->EndObject() : fHandler->EndArray();
+					return (err == VE_OK) ? _AfterValue() : err;
+				}
+				break;
+			}
+
+		case ',':
+			if (fState == eState_Separator)
+			{
+				fState = (container == '{') ? eState_NextName : eState_NextValue;
+				return VE_OK;
+			}
+			break;
+
+		case ':':
+			if (fState == eState_Colon)
+			{
+				fState = eState_Value;
+				return VE_OK;
+			}
+			break;
+	}
+
+	return _ThrowErrorInvalidToken( VString( (UniChar) inChar), _GetExpectedString());
+}
+
+
+const char* VJSONStreamParser::_GetExpectedString() const
+{
+	// same as VJSONImporter
+	switch( fState)
+	{
+		case eState_Value:
+		case eState_NextValue:	return sExpectedValue;
+		case eState_FirstValue:	return sExpectedFirstValue;
+		case eState_FirstName:	return "\" }";
+		case eState_NextName:	return "\"";
+		case eState_Colon:		return ":";
+		case eState_Separator:	return (fContainers.back() == '{') ? "} ," : "] ,";
+		default:				return "";
+	}
+}
+
+
+VError VJSONStreamParser::_ThrowErrorMalformed()
+{
+	VErrorBase* err = new VErrorBase( VE_MALFORMED_JSON_DESCRIPTION, 0);
+	if (err != NULL)
+	{
+		VString source( fSourceID);
+		if (!source.IsEmpty())
+		{
+			source += ',';
+			source += ' ';
+		}
+		err->GetBag()->SetString( "source", source);
+
+		err->GetBag()->SetLong( "line", fLine);
+		err->GetBag()->SetLong( "position", (sLONG) (fTokenOffset - fLineStartOffset) + 1);
+
+		VTask::GetCurrent()->PushError( err);
+	}
+	ReleaseRefCountable( &err);
+	return VE_MALFORMED_JSON_DESCRIPTION;
+}
+
+
+VError VJSONStreamParser::_ThrowErrorInvalidToken( const VString& inFoundToken, const char *inExpectedString)
+{
+	VErrorBase* err = new VErrorBase( inFoundToken.IsEmpty() ? (VError) VE_MALFORMED_JSON_EXPECTED_TOKEN : (VError) VE_MALFORMED_JSON_INVALID_TOKEN, 0);
+	if (err != NULL)
+	{
+		err->GetBag()->SetString( "found", inFoundToken);
+		err->GetBag()->SetString( "expected", inExpectedString);
+
+		VTask::GetCurrent()->PushError( err);
+	}
+	ReleaseRefCountable( &err);
+
+	// throw last the generic 550 error with line number and char pos
+	return _ThrowErrorMalformed();
+}
+
+
+VError VJSONStreamParser::_ThrowErrorUnterminated( const char *inUnterminatedString)
+{
+	VErrorBase* err = new VErrorBase( VE_MALFORMED_JSON_UNTERMINATED_TOKEN, 0);
+	if (err != NULL)
+	{
+		err->GetBag()->SetString( "token", inUnterminatedString);
+
+		VTask::GetCurrent()->PushError( err);
+	}
+	ReleaseRefCountable( &err);
+
+	return _ThrowErrorMalformed();
+}
+
+
+VError VJSONStreamParser::_ThrowErrorExtraComma( const char *inTerminatingToken)
+{
+	VErrorBase* err = new VErrorBase( VE_MALFORMED_JSON_EXTRA_COMMA, 0);
+	if (err != NULL)
+	{
+		err->GetBag()->SetString( "token", inTerminatingToken);
+
+		VTask::GetCurrent()->PushError( err);
+	}
+	ReleaseRefCountable( &err);
+
+	return _ThrowErrorMalformed();
+}
+
+
+//static
+VError VJSONStreamParser::ParseBuffer( const void *inData, VSize inSize, VJSONValue& outValue, VJSONImporter::EJSONImporterOptions inOptions)
+{
+	VJSONStreamBuilder builder;
+	VJSONStreamParser parser( &builder, inOptions);
+
+	// skip utf-8 bom
+	const uBYTE *data = (const uBYTE*) inData;
+	if ( (inSize >= 3) && (data[0] == 0xEF) && (data[1] == 0xBB) && (data[2] == 0xBF) )
+	{
+		data += 3;
+		inSize -= 3;
+	}
+
+	VError err = parser.Feed( data, inSize);
+	if (err == VE_OK)
+		err = parser.Finish();
+
+	if ( (err != VE_OK) && ((inOptions & VJSONImporter::EJSI_ReturnUndefinedWhenMalformed) != 0) )
+		outValue.SetUndefined();
+	else
+		outValue = builder.GetValue();
+
+	return err;
+}
+
+
+//static
+VError VJSONStreamParser::ParseStream( VStream *inStream, VJSONValue& outValue, VJSONImporter::EJSONImporterOptions inOptions, const VString *inSourceID, bool inIgnoreTrailingContent)
+{
+	VJSONStreamBuilder builder;
+	VJSONStreamParser parser( &builder, inOptions);
+	parser.SetIgnoreTrailingContent( inIgnoreTrailingContent);
+	if (inSourceID != NULL)
+		parser.SetSourceID( *inSourceID);
+
+	VError err = VE_OK;
+	std::vector<char> buffer( kSTREAM_CHUNK_SIZE);
+	bool first = true;
+	{
+		StErrorContextInstaller filter( VE_STREAM_EOF, VE_OK);
+
+		while (err == VE_OK)
+		{
+			VSize size = 0;
+			VError streamErr = inStream->GetData( &buffer.front(), buffer.size(), &size);
+			if ( (streamErr != VE_OK) && (streamErr != VE_STREAM_EOF) )
+			{
+				err = streamErr;
+				break;
+			}
+
+			VSize readSize = size;
+			const char *data = &buffer.front();
+			if (first)
+			{
+				// skip utf-8 bom
+				first = false;
+				if ( (size >= 3) && ((uBYTE) data[0] == 0xEF) && ((uBYTE) data[1] == 0xBB) && ((uBYTE) data[2] == 0xBF) )
+				{
+					data += 3;
+					size -= 3;
+				}
+			}
+
+			if (size > 0)
+				err = parser.Feed( data, size);
+
+			// a stream giving nothing without reporting its end is treated as ended, rather than read forever
+			if ( (streamErr == VE_STREAM_EOF) || (readSize == 0) || (inIgnoreTrailingContent && parser.IsDone()) )
+			{
+				inStream->ResetLastError();
+				break;
+			}
+		}
+	}
+
+	if (err == VE_OK)
+		err = parser.Finish();
+
+	if ( (err != VE_OK) && ((inOptions & VJSONImporter::EJSI_ReturnUndefinedWhenMalformed) != 0) )
+		outValue.SetUndefined();
+	else
+		outValue = builder.GetValue();
+
+	return err;
+}
+
+
+END_TOOLBOX_NAMESPACE
@@ -0,0 +1,198 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#ifndef __VJSONStreamParser__
+#define __VJSONStreamParser__
+
+#include "Kernel/Sources/VJSONTools.h"
+#include "Kernel/Sources/VJSONValue.h"
+
+BEGIN_TOOLBOX_NAMESPACE
+
+class VStream;
+class VTime;
+
+/*
+	@brief	Receives the events of a VJSONStreamParser, in document order.
+	Property names are given by SetPropertyName just before their value.
+	Returning an error stops the parsing, the error is returned by VJSONStreamParser::Feed().
+*/
+class XTOOLBOX_API IJSONStreamHandler
+{
+public:
+	virtual							~IJSONStreamHandler()	{}
+
+	virtual	VError					BeginObject() = 0;
+	virtual	VError					EndObject() = 0;
+	virtual	VError					BeginArray() = 0;
+	virtual	VError					EndArray() = 0;
+	virtual	VError					SetPropertyName( const VString& inName) = 0;
+	virtual	VError					SetString( const VString& inValue) = 0;
+	virtual	VError					SetNumber( Real inValue) = 0;
+	virtual	VError					SetBool( bool inValue) = 0;
+	virtual	VError					SetNull() = 0;
+
+			// only called with EJSI_AllowDates for strings like "!!ISODATE!!"
+	virtual	VError					SetDate( const VTime& inValue) = 0;
+};
+
+
+/*
+	@brief	IJSONStreamHandler building a VJSONValue tree, same as VJSONImporter::Parse() would.
+*/
+class XTOOLBOX_API VJSONStreamBuilder : public VObject, public IJSONStreamHandler
+{
+public:
+									VJSONStreamBuilder();
+	virtual							~VJSONStreamBuilder();
+
+			// the root value, complete once VJSONStreamParser::Finish() returned VE_OK
+			const VJSONValue&		GetValue() const		{ return fValue; }
+			void					Clear();
+
+	virtual	VError					BeginObject();
+	virtual	VError					EndObject();
+	virtual	VError					BeginArray();
+	virtual	VError					EndArray();
+	virtual	VError					SetPropertyName( const VString& inName);
+	virtual	VError					SetString( const VString& inValue);
+	virtual	VError					SetNumber( Real inValue);
+	virtual	VError					SetBool( bool inValue);
+	virtual	VError					SetNull();
+	virtual	VError					SetDate( const VTime& inValue);
+
+private:
+			void					_SetValue( const VJSONValue& inValue);
+
+			VJSONValue				fValue;
+			std::vector<VJSONValue>	fContainers;		// the open objects and arrays, innermost last
+			std::vector<VString>	fNames;				// name of the pending property for each open object
+			VJSONPropertyNameCache	fPropertyNames;
+};
+
+
+/*
+	@brief	JSON parser working on UTF-8 bytes, fed by chunks of any size.
+
+	The input doesn't need to be converted to a VString first, and a document doesn't need to be read at once:
+	a token cut between two chunks is kept until the next one.
+	Strings are scanned by blocks of 16 bytes when SSE2 is available.
+
+	Accepts the same syntax as VJSONImporter with the same options, and throws the same errors,
+	except that anything but white space following the top-level value is an error.
+	Error positions are given in bytes.
+
+	Example:
+		VJSONStreamBuilder builder;
+		VJSONStreamParser parser( &builder, VJSONImporter::EJSI_Strict);
+		while (...)
+			err = parser.Feed( buffer, size);
+		err = parser.Finish();
+		builder.GetValue() ...
+*/
+class XTOOLBOX_API VJSONStreamParser : public VObject
+{
+public:
+									VJSONStreamParser( IJSONStreamHandler *inHandler, VJSONImporter::EJSONImporterOptions inOptions = VJSONImporter::EJSI_Default);
+	virtual							~VJSONStreamParser();
+
+			// parses next chunk of the document.
+			// once an error has been returned, next calls do nothing and return the same error.
+			VError					Feed( const void *inData, VSize inSize);
+
+			// to be called at end of document. Throws an error if the document is not complete.
+			VError					Finish();
+
+			// prepares for a new document
+			void					Reset();
+
+			// if true, what follows the top-level value is not parsed (like VJSONImporter does). false by default.
+			void					SetIgnoreTrailingContent( bool inIgnore)	{ fIgnoreTrailingContent = inIgnore;}
+			bool					IsDone() const								{ return fState == eState_Done;}
+
+			void					SetSourceID( const VString& inSourceID)		{ fSourceID = inSourceID;}
+			const VString&			GetSourceID() const							{ return fSourceID;}
+
+			// parses a whole document and produces a value.
+	static	VError					ParseBuffer( const void *inData, VSize inSize, VJSONValue& outValue, VJSONImporter::EJSONImporterOptions inOptions = VJSONImporter::EJSI_Default);
+
+			// reads the stream by chunks until its end, or until the top-level value if inIgnoreTrailingContent is true.
+			// The stream must be opened for reading.
+	static	VError					ParseStream( VStream *inStream, VJSONValue& outValue, VJSONImporter::EJSONImporterOptions inOptions = VJSONImporter::EJSI_Default, const VString *inSourceID = NULL, bool inIgnoreTrailingContent = false);
+
+private:
+	enum {
+		kSTREAM_CHUNK_SIZE	= 256 * 1024
+	};
+
+	// what is expected next by the grammar
+	typedef enum {
+		eState_Value = 0,		// top-level value, or after ':'
+		eState_FirstValue,		// after '['
+		eState_NextValue,		// after ',' in an array
+		eState_FirstName,		// after '{'
+		eState_NextName,		// after ',' in an object
+		eState_Colon,
+		eState_Separator,		// after a value in an object or an array
+		eState_Done				// after the top-level value
+	} EState;
+
+	// token being read, possibly across chunks
+	typedef enum {
+		eToken_None = 0,
+		eToken_String,
+		eToken_Bare				// number, literal or unquoted string
+	} EToken;
+
+									VJSONStreamParser( const VJSONStreamParser&);	// forbidden
+			VJSONStreamParser&		operator=( const VJSONStreamParser&);			// forbidden
+
+			const char*				_ScanString( const char *inPos, const char *inEnd);
+			const char*				_ScanBare( const char *inPos, const char *inEnd);
+			VError					_EndString( const char *inBegin, const char *inEnd);
+			VError					_EndBare( const char *inBegin, const char *inEnd);
+			VError					_Structural( char inChar);
+			VError					_Value( const VString& inString, bool inWithQuotes);
+			VError					_AfterValue();
+			bool					_DecodeString( const char *inBegin, const char *inEnd, VString& outString);
+	static	bool					_ParseNumber( const char *inBegin, const char *inEnd, Real& outValue);
+			const char*				_GetExpectedString() const;
+
+			VError					_ThrowErrorMalformed();
+			VError					_ThrowErrorInvalidToken( const VString& inFoundToken, const char *inExpectedString);
+			VError					_ThrowErrorUnterminated( const char *inExpectedString);
+			VError					_ThrowErrorExtraComma( const char *inExpectedString);
+
+			IJSONStreamHandler*		fHandler;
+			VJSONImporter::EJSONImporterOptions	fOptions;
+			VError					fError;
+			EState					fState;
+			std::vector<char>		fContainers;		// '{' or '[' for each open container
+			EToken					fToken;
+			std::vector<char>		fPending;			// bytes of a token cut by the end of a chunk
+			std::vector<char>		fUnescaped;
+			bool					fPendingEscape;		// a string chunk ended with a backslash
+			bool					fStringHasEscape;
+			sLONG8					fOffset;			// of the current chunk in the document
+			sLONG8					fTokenOffset;		// of the current token in the document
+			sLONG8					fLineStartOffset;
+			sLONG					fLine;
+			bool					fIgnoreTrailingContent;
+			VString					fSourceID;
+};
+
+END_TOOLBOX_NAMESPACE
+
+#endif
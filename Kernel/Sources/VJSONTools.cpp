@@ -24,6 +24,9 @@
 #include "VError.h"
 #include "VValueBag.h"
 #include "VFile.h"
+#include "VFileStream.h"
+#include "VErrorContext.h"
+#include "VJSONStreamParser.h"
 #include "VUnicodeTableFull.h"
 
 BEGIN_TOOLBOX_NAMESPACE
@@ -44,6 +47,7 @@ VJSONImporter::VJSONImporter( const VString& inJSONString, EJSONImporterOptions
 , fStartToken( fString.GetCPointer())
 , fCurChar( fString.GetCPointer())
 , fRecursiveCallCount( 0)
+, fArena( NULL)
 {
 }
 
@@ -678,7 +682,7 @@ VError VJSONImporter::_ThrowErrorExtraComma( const char *inTerminatingToken) con
 VError VJSONImporter::_ParseObject( VJSONValue& outValue)
 {
 	VError err = VE_OK;
-	VJSONObject *object = new VJSONObject;
+	VJSONObject *object = new VJSONObject( fArena);
 	if (object == NULL)
 		err = VE_MEMORY_FULL;
 	
@@ -700,7 +704,7 @@ VError VJSONImporter::_ParseObject( VJSONValue& outValue)
 					err = Parse( value);
 					if (err == VE_OK)
 					{
-						object->SetProperty( name, value);
+						object->SetProperty( fPropertyNames.Get( name), value);
 
 						token = GetNextJSONToken( &err);
 						if (token == jsonEndObject)
@@ -806,9 +810,10 @@ VError VJSONImporter::_ParseArray( VJSONValue& outValue)
 /*
 	static
 */
-VError VJSONImporter::ParseString( const VString& inString, VJSONValue& outValue, EJSONImporterOptions inOptions)
+VError VJSONImporter::ParseString( const VString& inString, VJSONValue& outValue, EJSONImporterOptions inOptions, VArena *inArena)
 {
 	VJSONImporter importer( inString, inOptions);
+	importer.SetArena( inArena);
 	return importer.Parse( outValue);
 }
 
@@ -827,13 +832,39 @@ VError VJSONImporter::ParseFile( const VFile *inFile, VJSONValue& outValue, EJSO
 	VString sourceID;
 	inFile->GetPath( sourceID, FPS_POSIX);
 
-	VString source;
-	VError err = inFile->GetContentAsString( source, VTC_UTF_8);
+	// utf-8 files are parsed while being read, without converting them first
+	VFileStream stream( inFile);
+	VError err = stream.OpenReading();
 	if (err == VE_OK)
 	{
-		VJSONImporter importer( source, inOptions);
-		importer.SetSourceID( sourceID);
-		err = importer.Parse( outValue);
+		uBYTE bom[2] = { 0, 0 };
+		VSize size = 0;
+		{
+			StErrorContextInstaller filter( VE_STREAM_EOF, VE_OK);
+			stream.GetData( bom, sizeof( bom), &size);
+			stream.ResetLastError();
+		}
+
+		bool isUTF16 = (size == 2) && ( ((bom[0] == 0xFE) && (bom[1] == 0xFF)) || ((bom[0] == 0xFF) && (bom[1] == 0xFE)) );
+		if (!isUTF16)
+		{
+			err = stream.SetPos( 0);
+			if (err == VE_OK)
+				err = VJSONStreamParser::ParseStream( &stream, outValue, inOptions, &sourceID, true);	// content after the value is ignored, like ParseString() does
+		}
+		stream.CloseReading();
+
+		if (isUTF16)
+		{
+			VString source;
+			err = inFile->GetContentAsString( source, VTC_UTF_8);
+			if (err == VE_OK)
+			{
+				VJSONImporter importer( source, inOptions);
+				importer.SetSourceID( sourceID);
+				err = importer.Parse( outValue);
+			}
+		}
 	}
 
 	return err;
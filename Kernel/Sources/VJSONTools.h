@@ -18,12 +18,11 @@
 
 #include "Kernel/Sources/VString.h"
 #include "Kernel/Sources/VValueBag.h"
+#include "Kernel/Sources/VJSONValue.h"
 
 
 BEGIN_TOOLBOX_NAMESPACE
 
-class VJSONValue;
-
 /**@brief	VJSONImporter contains two kind of routines:
 				-> Low-level, to parse a JSON string as you want
 				-> High-level, to fill an object from the JSON string
@@ -83,7 +82,8 @@ public:
 			VError					Parse( VJSONValue& outValue);
 
 			// Parse some string and produces a value.
-	static	VError					ParseString( const VString& inString, VJSONValue& outValue, EJSONImporterOptions inOptions = EJSI_Default);
+			// If inArena is given, the properties of the objects are allocated in it: the value must be released before the arena is reset.
+	static	VError					ParseString( const VString& inString, VJSONValue& outValue, EJSONImporterOptions inOptions = EJSI_Default, VArena *inArena = NULL);
 
 			// Parse a file contents as string.
 			// default file encoding (if there's no bom) is utf-8
@@ -102,6 +102,9 @@ public:
 			
 			void					SetSourceID( const VString& inSourceID)		{ fSourceID = inSourceID;}
 			const VString&			GetSourceID() const							{ return fSourceID;}
+
+			// objects produced by Parse() allocate their properties in this arena
+			void					SetArena( VArena *inArena)					{ fArena = inArena;}
 	
 private:
 									VJSONImporter( const VJSONImporter&);	// forbidden
@@ -128,8 +131,10 @@ private:
 			const UniChar*			fStartToken;
 			
 			VString					fSourceID;	// for error reporting purpose. Might be an url or a file path of offending json.
+			VJSONPropertyNameCache	fPropertyNames;
 
 			uLONG					fRecursiveCallCount;//<<< right now (2009-05-29), only used by JSONObjectToBag
+			VArena*					fArena;
 	
 };
 
@@ -958,11 +958,27 @@ EJSONStatus IJSONObject::IJSON_Clone( const VJSONObject* /*inOwner*/, VJSONClone
 	return EJSON_unhandled;
 }
 
+
+void IJSONObject::IJSON_Materialize( VJSONObject* /*inOwner*/)
+{
+}
+
 //---------------------------------------------------
 
 
 VJSONObject::VJSONObject( IJSONObject *inImplementation)
-: fGraph( NULL)
+: fIndex( NULL)
+, fGraph( NULL)
+, fImpl( RetainRef( inImplementation))
+{
+	VInterlocked::Increment( &sCount);
+}
+
+
+VJSONObject::VJSONObject( VArena *inArena, IJSONObject *inImplementation)
+: fProperties( VArenaAllocator<PropertyType>( inArena))
+, fIndex( NULL)
+, fGraph( NULL)
 , fImpl( RetainRef( inImplementation))
 {
 	VInterlocked::Increment( &sCount);
@@ -971,6 +987,7 @@ VJSONObject::VJSONObject( IJSONObject *inImplementation)
 
 VJSONObject::~VJSONObject()
 {
+	_DeleteIndex();
 	ReleaseRef( &fGraph);
 	ReleaseRef( &fImpl);
 	VInterlocked::Decrement( &sCount);
@@ -1000,15 +1017,86 @@ VJSONValue VJSONObject::GetProperty( const VString& inName) const
 
 	if (status == EJSON_unhandled)
 	{
-		MapType::const_iterator i = fMap.find( inName);
-		if (i != fMap.end())
-			value = i->second.first;
+		size_t position = _Find( inName);
+		if (position < fProperties.size())
+			value = fProperties[position].second;
 	}
 	
 	return value;
 }
 
 
+size_t VJSONObject::_Find( const VString& inName) const
+{
+	if (fIndex != NULL)
+	{
+		IndexType::const_iterator i = fIndex->find( inName);
+		return (i != fIndex->end()) ? i->second : fProperties.size();
+	}
+
+	// names often share their buffer (see VJSONPropertyNameCache)
+	VIndex length = inName.GetLength();
+	const UniChar *p = inName.GetCPointer();
+	for( size_t i = 0 ; i < fProperties.size() ; ++i)
+	{
+		const VString& name = fProperties[i].first;
+		if ( (name.GetLength() == length) && ((name.GetCPointer() == p) || (::memcmp( name.GetCPointer(), p, length * sizeof( UniChar)) == 0)) )
+			return i;
+	}
+
+	return fProperties.size();
+}
+
+
+void VJSONObject::_Remove( size_t inPosition)
+{
+	if (fIndex != NULL)
+	{
+		fIndex->erase( fProperties[inPosition].first);
+
+		// decrement property positions above the deleted one
+		for( IndexType::iterator i = fIndex->begin() ; i != fIndex->end() ; ++i)
+		{
+			if (i->second > inPosition)
+				i->second -= 1;
+		}
+	}
+
+	fProperties.erase( fProperties.begin() + inPosition);
+
+	if (fProperties.size() <= kINDEX_THRESHOLD / 2)
+		_DeleteIndex();
+}
+
+
+void VJSONObject::_BuildIndex()
+{
+	// on failure, properties are still found without the index
+	IndexType *index = NULL;
+	try
+	{
+		index = new IndexType( fProperties.size() * 2, IndexAllocator( fProperties.get_allocator()));
+		for( size_t i = 0 ; i < fProperties.size() ; ++i)
+			index->insert( IndexType::value_type( fProperties[i].first, i));
+	}
+	catch(...)
+	{
+		delete index;
+		index = NULL;
+	}
+
+	_DeleteIndex();
+	fIndex = index;
+}
+
+
+void VJSONObject::_DeleteIndex()
+{
+	delete fIndex;
+	fIndex = NULL;
+}
+
+
 bool VJSONObject::SetProperty( const VString& inName, const VJSONValue& inValue)
 {
 	bool ok;
@@ -1025,14 +1113,37 @@ bool VJSONObject::SetProperty( const VString& inName, const VJSONValue& inValue)
 		try
 		{
 			ok = true;
+			size_t position = _Find( inName);
 			if (inValue.IsUndefined())
-				fMap.erase( inName);
+			{
+				if (position < fProperties.size())
+					_Remove( position);
+			}
 			else
 			{
-				std::pair<MapType::iterator,bool> i = fMap.insert( MapType::value_type( inName, std::pair<VJSONValue,size_t>(inValue,fMap.size())));
-				if (!i.second)
+				if (position < fProperties.size())
 				{
-					i.first->second.first = inValue;
+					fProperties[position].second = inValue;
+				}
+				else
+				{
+					fProperties.push_back( PropertyType( inName, inValue));
+					if (fIndex != NULL)
+					{
+						try
+						{
+							fIndex->insert( IndexType::value_type( inName, position));
+						}
+						catch(...)
+						{
+							fProperties.pop_back();
+							throw;
+						}
+					}
+					else if (fProperties.size() > kINDEX_THRESHOLD)
+					{
+						_BuildIndex();
+					}
 				}
 					
 				VJSONGraph::Connect( &fGraph, inValue);
@@ -1059,18 +1170,9 @@ void VJSONObject::RemoveProperty( const VString& inName)
 
 	if (status == EJSON_unhandled)
 	{
-		MapType::const_iterator i = fMap.find( inName);
-		if (i != fMap.end())
-		{
-			// decrement property indexes above the deleted one
-			size_t index = i->second.second;
-			for( MapType::iterator j = fMap.begin() ; j != fMap.end() ; ++j)
-			{
-				if (j->second.second > index)
-					j->second.second -= 1;
-			}
-			fMap.erase( i);
-		}
+		size_t position = _Find( inName);
+		if (position < fProperties.size())
+			_Remove( position);
 	}
 }
 
@@ -1082,13 +1184,14 @@ void VJSONObject::Clear()
 		bool ok = fImpl->IJSON_Clear( this);
 	}
 
-	fMap.clear();
+	fProperties.clear();
+	_DeleteIndex();
 }
 
 
 bool VJSONObject::IsEmpty() const
 {
-	bool isEmpty = fMap.empty();
+	bool isEmpty = fProperties.empty();
 	
 	if (isEmpty && (fImpl != NULL))
 	{
@@ -1122,16 +1225,17 @@ bool VJSONObject::DoStringify( VString& outString, VJSONWriter& inWriter, VError
 VError VJSONObject::MergeWith(const VJSONObject* inOther, bool inPrivilegesSourceOnConflict)
 {
 	VError err = VE_OK;
-	for (MapType::const_iterator cur = inOther->fMap.begin(), end = inOther->fMap.end(); (cur != end) && (err == VE_OK); ++cur)
+	// by position because inOther may be this
+	for (size_t i = 0 ; (i < inOther->_GetProperties().size()) && (err == VE_OK) ; ++i)
 	{
+		PropertyType property( inOther->fProperties[i]);
 		if (inPrivilegesSourceOnConflict)
 		{
-			MapType::const_iterator found = fMap.find( cur->first);
-			if (found == fMap.end())
-				SetProperty(cur->first, cur->second.first);
+			if (_Find( property.first) == fProperties.size())
+				SetProperty(property.first, property.second);
 		}
 		else
-			SetProperty(cur->first, cur->second.first);
+			SetProperty(property.first, property.second);
 	}
 	return err;
 }
@@ -1172,52 +1276,41 @@ VError VJSONObject::CloneProperties( VJSONCloner& inCloner, VJSONObject *inDesti
 	VError err = VE_OK;
 	if (inDestination != NULL)
 	{
-		MapType clonedMap( fMap);
+		// allocated like the destination properties, the vectors are swapped
+		const VectorOfProperty& properties = _GetProperties();
+		VectorOfProperty clonedProperties( properties.begin(), properties.end(), inDestination->fProperties.get_allocator());
 
-		for( MapType::iterator i = clonedMap.begin() ; (i != clonedMap.end()) && (err == VE_OK) ; ++i)
+		for( VectorOfProperty::iterator i = clonedProperties.begin() ; (i != clonedProperties.end()) && (err == VE_OK) ; ++i)
 		{
-			if (i->second.first.IsObject())
+			if (i->second.IsObject())
 			{
-				VJSONObject *theOriginalObject = RetainRefCountable( i->second.first.GetObject());
-				err = inCloner.CloneObject( theOriginalObject, i->second.first);
-				VJSONGraph::Connect( &inDestination->fGraph, i->second.first);
+				VJSONObject *theOriginalObject = RetainRefCountable( i->second.GetObject());
+				err = inCloner.CloneObject( theOriginalObject, i->second);
+				VJSONGraph::Connect( &inDestination->fGraph, i->second);
 				ReleaseRefCountable( &theOriginalObject);
 			}
-			else if (i->second.first.IsArray())
+			else if (i->second.IsArray())
 			{
-				VJSONArray *theOriginalArray = RetainRefCountable( i->second.first.GetArray());
-				err = theOriginalArray->Clone( i->second.first, inCloner);
-				VJSONGraph::Connect( &inDestination->fGraph, i->second.first);
+				VJSONArray *theOriginalArray = RetainRefCountable( i->second.GetArray());
+				err = theOriginalArray->Clone( i->second, inCloner);
+				VJSONGraph::Connect( &inDestination->fGraph, i->second);
 				ReleaseRefCountable( &theOriginalArray);
 			}
 		}
 		
 		if (err == VE_OK)
-			inDestination->fMap.swap( clonedMap);
+		{
+			inDestination->fProperties.swap( clonedProperties);
+			if (inDestination->fProperties.size() > kINDEX_THRESHOLD)
+				inDestination->_BuildIndex();
+			else
+				inDestination->_DeleteIndex();
+		}
 	}
 	return err;
 }
 
 
-//---------------------------------------------------
-
-
-VJSONPropertyConstOrderedIterator::VJSONPropertyConstOrderedIterator( const VJSONObject *inObject)
-{
-	fMappedValues.resize( inObject->fMap.size(), NULL);
-	
-	VectorOfMappedValueRef::iterator j = fMappedValues.begin();
-	for( VJSONObject::MapType::const_iterator i = inObject->fMap.begin() ; i != inObject->fMap.end() ; ++i)
-	{
-		xbox_assert( i->second.second >= 0 && i->second.second < fMappedValues.size());
-		fMappedValues[i->second.second] = &*i;
-	}
-	
-	fIterator = fMappedValues.begin();
-	fIterator_end = fMappedValues.end();
-}
-
-
 //---------------------------------------------------
 
 VJSONArray::VJSONArray()
@@ -1466,7 +1559,7 @@ VError VJSONWriter::StringifyObject( const VJSONObject *inObject, VString& outSt
 	
 	if (!inObject->DoStringify( outString, *this, &err))
 	{
-		if (inObject->fMap.empty())
+		if (inObject->_GetProperties().empty())
 		{
 			outString = "{}";
 		}
@@ -1475,7 +1568,7 @@ VError VJSONWriter::StringifyObject( const VJSONObject *inObject, VString& outSt
 			IncrementLevel();
 
 			VectorOfVString array;
-			array.resize( inObject->fMap.size());
+			array.resize( inObject->fProperties.size());
 
 			VectorOfVString::iterator j = array.begin();
 			for( VJSONPropertyConstOrderedIterator i( inObject) ; i.IsValid() && (err == VE_OK) ; ++i, ++j)
@@ -1864,7 +1957,7 @@ VError VJSONBinaryImporter::GetValue(VJSONValue& outVal)
 							fCurPtr += ((sLONG)len * 2);
 							VJSONValue val;
 							err = GetValue(val);
-							obj->SetProperty(name, val);
+							obj->SetProperty(fPropertyNames.Get(name), val);
 						}
 					} while (err == VE_OK && len != -1);
 					outVal.SetObject(obj);
@@ -18,6 +18,7 @@
 
 #include "Kernel/Sources/VString.h"
 #include "Kernel/Sources/VString_ExtendedSTL.h"
+#include "Kernel/Sources/VArena.h"
 
 BEGIN_TOOLBOX_NAMESPACE
 
@@ -252,6 +253,10 @@ public:
 
 	// Clone object. Should also clone the implementation
 	virtual	EJSONStatus			IJSON_Clone( const VJSONObject *inOwner, VJSONCloner& inCloner, VJSONValue& outValue, VError *outError) const;
+
+	// called before VJSONObject base properties are iterated.
+	// an implementation computing its properties on demand may set them now as base properties.
+	virtual	void				IJSON_Materialize( VJSONObject *inOwner);
 };
 
 
@@ -261,8 +266,11 @@ public:
 	key is a VString
 	value is a VJSONValue
 	
-	keys are unique and not ordered.
+	keys are unique and kept in declaration order.
 	Comparison for uniqueness test is based on utf-16 code point equality as in JavaScript.
+
+	Properties are stored in a vector and looked up linearly, which is the fastest for the usual small objects.
+	A hash index is added past kINDEX_THRESHOLD properties.
 	
 	A property cannot have JSON_undefined as value.
 	
@@ -283,6 +291,10 @@ public:
 			// construct an empty collection optionally bound to a virtual implementation.
 									VJSONObject( IJSONObject *inImplementation = NULL);
 
+			// construct an empty collection whose properties are allocated in inArena (see VJSONImporter::ParseString).
+			// the object must be released before the arena is reset.
+	explicit						VJSONObject( VArena *inArena, IJSONObject *inImplementation = NULL);
+
 			// overriden Release() method to handle cyclic dependencies
 	virtual	sLONG					Release( const char* inDebugInfo = 0) const;
 
@@ -392,14 +404,54 @@ protected:
 			void					Connect( VJSONGraph** inOtherGraph);
 
 private:
+	enum {
+		kINDEX_THRESHOLD = 8
+	};
+
+			typedef std::pair<VString,VJSONValue>											PropertyType;
+			typedef std::vector<PropertyType,VArenaAllocator<PropertyType> >				VectorOfProperty;
+			typedef VArenaAllocator<std::pair<const VString,size_t> >						IndexAllocator;
+			typedef unordered_map_VString<size_t,IndexAllocator>							IndexType;
+
+									VJSONObject( const VJSONObject&);				// forbidden
+			VJSONObject&			operator=( const VJSONObject&);					// forbidden
+
+			// returns the position of the property or fProperties.size() if not found
+			size_t					_Find( const VString& inName) const;
+			void					_Remove( size_t inPosition);
+			void					_BuildIndex();
+			void					_DeleteIndex();
+
+			// base properties, once the implementation has been given a chance to set them
+			const VectorOfProperty&	_GetProperties() const	{ if (fImpl != NULL) fImpl->IJSON_Materialize( const_cast<VJSONObject*>( this)); return fProperties;}
+			VectorOfProperty&		_GetProperties()		{ if (fImpl != NULL) fImpl->IJSON_Materialize( this); return fProperties;}
+
 	static	sLONG					sCount;
-			typedef unordered_map_VString<std::pair<VJSONValue,size_t> >	MapType;
-			MapType					fMap;
+			VectorOfProperty		fProperties;
+			IndexType*				fIndex;			// name to position, only for big objects
 	mutable	VJSONGraph*				fGraph;
 			IJSONObject*			fImpl;
 };
 
 
+/*
+	Keeps one copy of each property name.
+	The objects built from a same document get their names from it so that they share their buffers.
+*/
+class XTOOLBOX_API VJSONPropertyNameCache : public VObject
+{
+public:
+									VJSONPropertyNameCache()		{}
+
+			const VString&			Get( const VString& inName)		{ return fNames.insert( NameSet::value_type( inName, true)).first->first;}
+			void					Clear()							{ fNames.clear();}
+
+private:
+			typedef unordered_map_VString<bool>		NameSet;
+			NameSet					fNames;
+};
+
+
 /*
 	Iterators to iterates on a VJSONObject properties.
 	
@@ -414,14 +466,14 @@ private:
 	}
 	
 */
-// lexicographical order
+// properties declaration order (JavaScript natural order)
 class XTOOLBOX_API VJSONPropertyIterator : public XBOX::VObject
 {
 public:
-			VJSONPropertyIterator( VJSONObject *inObject):fIterator( inObject->fMap.begin()), fIterator_end( inObject->fMap.end()) {}
+			VJSONPropertyIterator( VJSONObject *inObject):fIterator( inObject->_GetProperties().begin()), fIterator_end( inObject->fProperties.end()) {}
 	
 			const VString&			GetName() const		{ return fIterator->first;}
-			VJSONValue&				GetValue() const	{ return fIterator->second.first;}
+			VJSONValue&				GetValue() const	{ return fIterator->second;}
 			
 			VJSONPropertyIterator&	operator++()		{ ++fIterator; return *this;}
 			
@@ -430,18 +482,18 @@ public:
 private:
 			VJSONPropertyIterator( const VJSONPropertyIterator&);				// forbidden
 			VJSONPropertyIterator&	operator=( const VJSONPropertyIterator&);	// forbidden
-			VJSONObject::MapType::iterator	fIterator;
-			VJSONObject::MapType::iterator	fIterator_end;
+			VJSONObject::VectorOfProperty::iterator	fIterator;
+			VJSONObject::VectorOfProperty::iterator	fIterator_end;
 };
 
 
 class XTOOLBOX_API VJSONPropertyConstIterator : public XBOX::VObject
 {
 public:
-			VJSONPropertyConstIterator( const VJSONObject *inObject):fIterator( inObject->fMap.begin()), fIterator_end( inObject->fMap.end()) {}
+			VJSONPropertyConstIterator( const VJSONObject *inObject):fIterator( inObject->_GetProperties().begin()), fIterator_end( inObject->fProperties.end()) {}
 
 			const VString&			GetName() const		{ return fIterator->first;}
-			const VJSONValue&		GetValue() const	{ return fIterator->second.first;}
+			const VJSONValue&		GetValue() const	{ return fIterator->second;}
 
 			VJSONPropertyConstIterator&	operator++()	{ ++fIterator; return *this;}
 
@@ -450,19 +502,20 @@ public:
 private:
 			VJSONPropertyConstIterator( const VJSONPropertyConstIterator&);				// forbidden
 			VJSONPropertyConstIterator&	operator=( const VJSONPropertyConstIterator&);	// forbidden
-			VJSONObject::MapType::const_iterator	fIterator;
-			VJSONObject::MapType::const_iterator	fIterator_end;
+			VJSONObject::VectorOfProperty::const_iterator	fIterator;
+			VJSONObject::VectorOfProperty::const_iterator	fIterator_end;
 };
 
 
-// ordered according to properties declaration order (JavaScript natural order)
+// ordered according to properties declaration order (JavaScript natural order).
+// all iterators now follow this order, this one is kept for compatibility.
 class XTOOLBOX_API VJSONPropertyConstOrderedIterator : public XBOX::VObject
 {
 public:
-			VJSONPropertyConstOrderedIterator( const VJSONObject *inObject);
+			VJSONPropertyConstOrderedIterator( const VJSONObject *inObject):fIterator( inObject->_GetProperties().begin()), fIterator_end( inObject->fProperties.end()) {}
 
-			const VString&			GetName() const		{ return (*fIterator)->first;}
-			const VJSONValue&		GetValue() const	{ return (*fIterator)->second.first;}
+			const VString&			GetName() const		{ return fIterator->first;}
+			const VJSONValue&		GetValue() const	{ return fIterator->second;}
 
 			VJSONPropertyConstOrderedIterator&	operator++()	{ ++fIterator; return *this;}
 
@@ -471,11 +524,9 @@ public:
 private:
 			VJSONPropertyConstOrderedIterator( const VJSONPropertyConstOrderedIterator&);				// forbidden
 			VJSONPropertyConstOrderedIterator&	operator=( const VJSONPropertyConstOrderedIterator&);	// forbidden
-			
-			typedef std::vector<const VJSONObject::MapType::value_type*>	VectorOfMappedValueRef;
-			VectorOfMappedValueRef					fMappedValues;
-			VectorOfMappedValueRef::const_iterator	fIterator;
-			VectorOfMappedValueRef::const_iterator	fIterator_end;
+
+			VJSONObject::VectorOfProperty::const_iterator	fIterator;
+			VJSONObject::VectorOfProperty::const_iterator	fIterator_end;
 };
 
 
@@ -654,6 +705,7 @@ class XTOOLBOX_API VJSONBinaryImporter : public VObject
 	private:
 		uBYTE* fCurPtr;
 		VSize fLen;
+		VJSONPropertyNameCache fPropertyNames;
 };
 
 
@@ -21,7 +21,6 @@
 
 
 
-/*
 static const char *GetMessageLevelName( EMessageLevel inLevel)
 {
 	switch( inLevel)
@@ -37,19 +36,152 @@ static const char *GetMessageLevelName( EMessageLevel inLevel)
 		default:				return "INFO";
 	}
 }
+
+
+
+/*
+	Single producer / single consumer ring of variable size records.
+	The producer is the owner task (or any thread holding fSharedRingLock for the shared ring), the consumer is whoever holds VLogger::fLock.
+	fHead and fTail are free running byte counters, only the owner of each one writes it.
+	A ring starts small and is replaced by a bigger one when it gets full (see VLogger::_GrowRing).
 */
+class VLogger::VLogRing : public VObject, public IRefCountable
+{
+public:
+
+	enum
+	{
+		kMIN_CAPACITY			= 4 * 1024,		// bytes, power of 2
+		kMAX_CAPACITY			= 64 * 1024,
+		kMAX_MESSAGE_LENGTH		= 8 * 1024		// UniChars, longer messages are stored out of line in a bag (see VLogger::_Push)
+	};
+
+	typedef struct Record
+	{
+		uLONG				fSize;		// whole record, 8 bytes aligned. 0 marks the unused end of the ring
+		sLONG				fLevel;
+		uLONG				fSourceID;	// 0 for bags
+		uLONG				fLength;	// UniChars following the record
+		uLONG8				fStamp;
+		const VValueBag*	fBag;		// retained bag from LogBag(), or NULL
+	} Record;
+
+	VLogRing( uLONG inCapacity) : fCapacity(inCapacity), fHead(0), fTail(0), fQueued(0), fDropped(0), fIsOrphan(0), fLastSourceID(0)
+	{
+		fBuffer = new char[fCapacity];
+	}
+
+	virtual ~VLogRing()
+	{
+		// release the bags that never reached the listeners
+		uLONG tail = (uLONG) fTail;
+		uLONG head = (uLONG) fHead;
+
+		while (tail != head)
+		{
+			uLONG offset = tail & (fCapacity - 1);
+			const Record *record = (const Record*) (fBuffer + offset);
+
+			if (record->fSize == 0)
+			{
+				tail += fCapacity - offset;
+			}
+			else
+			{
+				if (record->fBag != NULL)
+					record->fBag->Release();
+				tail += record->fSize;
+			}
+		}
+
+		delete [] fBuffer;
+	}
+
+	// returns false if the ring is full. outShouldWakeReader is set when the ring is more than half full.
+	bool Push( sLONG inLevel, uLONG8 inStamp, uLONG inSourceID, const VString *inMessage, const VValueBag *inBag, bool *outShouldWakeReader)
+	{
+		VIndex length = (inMessage != NULL) ? inMessage->GetLength() : 0;
+		xbox_assert( length <= kMAX_MESSAGE_LENGTH);
+		if (length > kMAX_MESSAGE_LENGTH)
+			length = kMAX_MESSAGE_LENGTH;
+
+		uLONG size = (uLONG) ((sizeof( Record) + length * sizeof( UniChar) + 7) & ~7);
+		uLONG head = (uLONG) fHead;
+		uLONG tail = (uLONG) VInterlocked::AtomicGet( &fTail);
+		uLONG offset = head & (fCapacity - 1);
+		uLONG contiguous = fCapacity - offset;
+		uLONG needed = (contiguous < size) ? contiguous + size : size;
+
+		if (fCapacity - (head - tail) < needed)
+		{
+			*outShouldWakeReader = true;
+			return false;
+		}
+
+		if (contiguous < size)
+		{
+			// not enough room before the end: mark it unused and restart at the beginning
+			((Record*) (fBuffer + offset))->fSize = 0;
+			head += contiguous;
+			offset = 0;
+		}
+
+		Record *record = (Record*) (fBuffer + offset);
+		record->fSize = size;
+		record->fLevel = inLevel;
+		record->fSourceID = inSourceID;
+		record->fLength = (uLONG) length;
+		record->fStamp = inStamp;
+		record->fBag = inBag;
+		if (length > 0)
+			::memcpy( record + 1, inMessage->GetCPointer(), length * sizeof( UniChar));
+
+		head += size;
+
+		// publish
+		VInterlocked::Exchange( &fHead, (sLONG) head);
+		VInterlocked::Increment( &fQueued);
+
+		*outShouldWakeReader = (head - tail) > fCapacity / 2;
+
+		return true;
+	}
+
+	char*		fBuffer;
+	uLONG		fCapacity;
+	sLONG		fHead;
+	char		fPadding[64];	// keep producer and consumer counters on different cache lines
+	sLONG		fTail;
+	sLONG		fQueued;
+	sLONG		fDropped;
+	sLONG		fIsOrphan;		// set when the owner task is dead: the ring is deleted once drained
+
+	// producer side cache of the last source id
+	VString		fLastSource;
+	uLONG		fLastSourceID;
+};
 
 
 
 VLogger::VLogger()// const VFolder& inLogFolder, const VString& inLogName)
-: fLogName("")//inLogName)
-, fIsStarted( false)
-, fMessagesLost(false)
+: fPolicy( eLogBackpressure_Drop)
+, fSpillDesc( NULL)
+, fSpilled( 0)
+, fLogged( 0)
+, fDroppedByDeadRings( 0)
+, fReaderWakeUp( 0, 1)
+, fRoomEvent( new VSyncEvent)
+, fBlockedProducers( 0)
+, fLogName("")//inLogName)
 , fFilter((1<<EML_Information) | (1<<EML_Warning) | (1<<EML_Error) | (1<<EML_Fatal) | (1<<EML_Debug) | (1<<EML_Assert) /*| (1<<EML_Trace) | (1<<EML_Dump)*/)
+, fIsStarted( false)
 , fLogReaderTask(NULL)
 {
-	fStartIndex = 0;
-	fEndIndex = 0;
+	fRingKey = VTask::CreateDataKey( &VLogger::_DisposeRing);
+
+	fSharedRing = new VLogRing( VLogRing::kMIN_CAPACITY);
+	fRings.push_back( RetainRefCountable( fSharedRing));
+
 	//inLogFolder.GetPath( fFolderPath);
 
 }
@@ -57,6 +189,9 @@ VLogger::VLogger()// const VFolder& inLogFolder, const VString& inLogName)
 
 VLogger::~VLogger()
 {
+	// live tasks keep a reference on their ring but won't find it anymore
+	VTask::DeleteDataKey( fRingKey);
+
 	fLock.Lock();
 	std::vector<ILogListener*>::iterator itListener = fLogListeners.begin();
 	while (itListener != fLogListeners.end())
@@ -64,8 +199,17 @@ VLogger::~VLogger()
 		(*itListener)->Release();
 		itListener++;
 	}
+
+	for( std::vector<VLogRing*>::iterator itRing = fRings.begin() ; itRing != fRings.end() ; ++itRing)
+		(*itRing)->Release();
+	fRings.clear();
 	fLock.Unlock();
 
+	ReleaseRefCountable( &fSharedRing);
+	ReleaseRefCountable( &fRoomEvent);
+
+	delete fSpillDesc;
+
 	xbox_assert( fLogReaderTask == NULL || fLogReaderTask->GetState() == TS_DEAD);
 	ReleaseRefCountable( &fLogReaderTask);
 }
@@ -96,19 +240,66 @@ void VLogger::Start()
 	}
 }
 
+
+static bool _CompareStamps( const std::pair<uLONG8, const VValueBag*>& inLeft, const std::pair<uLONG8, const VValueBag*>& inRight)
+{
+	return inLeft.first < inRight.first;
+}
+
+
 void VLogger::Flush()
 {
+	std::vector<StampedBag>			bags;
 	std::vector<const VValueBag*>	valuesVector;
 
 	fLock.Lock();
 
-	sLONG							nbRead = Read(valuesVector,true);
-	if (nbRead)
+	uLONG sourceID = 0;
+	VString source;
+	sLONG nbRings = 0;
+
+	std::vector<VLogRing*>::iterator itRing = fRings.begin();
+	while (itRing != fRings.end())
 	{
+		VLogRing *ring = *itRing;
+
+		// read the flag before draining so that the last records of a dead task are not lost
+		bool isOrphan = (VInterlocked::AtomicGet( &ring->fIsOrphan) != 0);
+
+		if (_Drain( ring, bags, sourceID, source) > 0)
+			++nbRings;
+
+		if (isOrphan)
+		{
+			VInterlocked::AtomicAdd( &fDroppedByDeadRings, VInterlocked::AtomicGet( &ring->fDropped));
+			ring->Release();
+			itRing = fRings.erase( itRing);
+		}
+		else
+		{
+			++itRing;
+		}
+	}
+
+	if (nbRings > 0)
+		_SignalRoom();
+
+	if (!bags.empty())
+	{
+		// each ring is ordered but rings interleave
+		if (nbRings > 1)
+			std::stable_sort( bags.begin(), bags.end(), _CompareStamps);
+
+		valuesVector.reserve( bags.size());
+		for( std::vector<StampedBag>::iterator itBag = bags.begin() ; itBag != bags.end() ; ++itBag)
+			valuesVector.push_back( itBag->second);
+
 		for( size_t idxListener = 0; idxListener < fLogListeners.size(); idxListener++ )
 		{
 			fLogListeners[idxListener]->Put(valuesVector);
 		}
+
+		VInterlocked::AtomicAdd( &fLogged, (sLONG) valuesVector.size());
 	}
 
 	fLock.Unlock();
@@ -119,6 +310,90 @@ void VLogger::Flush()
 	}
 }
 
+
+// milliseconds a blocked producer waits before checking that the reader is still running
+static const sLONG kBLOCKED_PRODUCER_TIMEOUT = 1000;
+
+
+void VLogger::_SignalRoom()
+{
+	// checked after the drain: a producer counted later retries its push after the drain and finds room
+	if (VInterlocked::AtomicGet( &fBlockedProducers) == 0)
+		return;
+
+	// the event stays signaled for the producers that took it, the next ones wait for the next drain
+	VSyncEvent *event = NULL;
+	{
+		StLocker<VCriticalSection> lock( &fRoomLock);
+		event = fRoomEvent;
+		fRoomEvent = new VSyncEvent;
+	}
+	event->Unlock();
+	event->Release();
+}
+
+
+sLONG VLogger::_Drain( VLogRing* inRing, std::vector<StampedBag>& ioBags, uLONG& ioSourceID, VString& ioSource)
+{
+	// fLock must be locked
+	sLONG nbRead = 0;
+	uLONG tail = (uLONG) inRing->fTail;
+	uLONG head = (uLONG) VInterlocked::AtomicGet( &inRing->fHead);
+
+	while (tail != head)
+	{
+		uLONG offset = tail & (inRing->fCapacity - 1);
+		const VLogRing::Record *record = (const VLogRing::Record*) (inRing->fBuffer + offset);
+
+		if (record->fSize == 0)
+		{
+			tail += inRing->fCapacity - offset;
+			continue;
+		}
+
+		if (record->fBag != NULL)
+		{
+			// the reference goes to the listeners
+			ioBags.push_back( StampedBag( record->fStamp, record->fBag));
+		}
+		else
+		{
+			if (record->fSourceID != ioSourceID)
+			{
+				StLocker<VCriticalSection> lock( &fSourcesLock);
+
+				ioSource = fSources[record->fSourceID - 1];
+				ioSourceID = record->fSourceID;
+			}
+
+			VString message;
+			message.FromUniString( (const UniChar*) (record + 1), (VIndex) record->fLength);
+
+			VValueBag *bag = new VValueBag;
+
+			ILoggerBagKeys::source.Set( bag, ioSource);
+			ILoggerBagKeys::level.Set( bag, (EMessageLevel) record->fLevel);
+			ILoggerBagKeys::message.Set( bag, message);
+			ILoggerBagKeys::timestamp.Set( bag, (sLONG8) record->fStamp);
+
+			ioBags.push_back( StampedBag( record->fStamp, bag));
+		}
+
+		tail += record->fSize;
+		++nbRead;
+	}
+
+	if (nbRead > 0)
+	{
+		// give the room back to the producer
+		VInterlocked::Exchange( &inRing->fTail, (sLONG) tail);
+		VInterlocked::AtomicAdd( &inRing->fQueued, -nbRead);
+	}
+
+	return nbRead;
+}
+
+
 sLONG VLogger::LogReaderTaskProc(XBOX::VTask* inTask)
 {
 	VLogger*						l_this = (VLogger*)inTask->GetKindData();
@@ -127,7 +402,8 @@ sLONG VLogger::LogReaderTaskProc(XBOX::VTask* inTask)
 	{
 		l_this->Flush();
 
-		VTask::Sleep(100);
+		// producers wake us up when a ring gets half full
+		l_this->fReaderWakeUp.Lock( 100);
 	}
 	return 0;
 }
@@ -185,71 +461,319 @@ bool VLogger::RemoveLogListener(ILogListener* inLogListener)
 }
 
 
-sLONG VLogger::Next(sLONG inIndex)
+//static
+void VLogger::_DisposeRing( void* inData)
 {
-	sLONG	nextIndex = inIndex + 1;
-	if (nextIndex >= K_NB_MAX_BAGS)
+	// called when the owner task dies or when the ring is replaced by a bigger one
+	VLogRing *ring = (VLogRing*) inData;
+	if (ring != NULL)
 	{
-		nextIndex = 0;
+		VInterlocked::Exchange( &ring->fIsOrphan, 1);
+		ring->Release();
 	}
-	return nextIndex;
 }
 
-void VLogger::LogBag( const VValueBag *inMessage)
+
+VLogger::VLogRing* VLogger::_GetCurrentRing()
 {
-	if ( ShouldLog(ILoggerBagKeys::level.Get(inMessage)) )
+	if (VTask::GetCurrent() == NULL)
+		return NULL;
+
+	VLogRing *ring = (VLogRing*) VTask::GetCurrentData( fRingKey);
+	if (ring == NULL)
 	{
-		fLock.Lock();
-		sLONG	nextIndex = Next(fEndIndex);
+		ring = new VLogRing( VLogRing::kMIN_CAPACITY);
 
-		if (nextIndex == fStartIndex)
 		{
-			fMessagesLost = true;
+			StLocker<VCriticalSection> lock( &fLock);
+			fRings.push_back( RetainRefCountable( ring));
 		}
-		else
+
+		// released by _DisposeRing()
+		VTask::SetCurrentData( fRingKey, ring);
+	}
+
+	return ring;
+}
+
+
+VLogger::VLogRing* VLogger::_GrowRing( VLogRing* inRing, bool inIsSharedRing)
+{
+	// the old ring can't be resized under the reader: it is drained and deleted by Flush() like the ring of a dead task
+	VLogRing *ring = new VLogRing( inRing->fCapacity * 2);
+
+	{
+		StLocker<VCriticalSection> lock( &fLock);
+		fRings.push_back( RetainRefCountable( ring));
+	}
+
+	// fSharedRingLock is held by the caller for the shared ring
+	if (inIsSharedRing)
+		fSharedRing = ring;
+	else
+		VTask::SetCurrentData( fRingKey, ring);
+
+	_DisposeRing( inRing);
+
+	return ring;
+}
+
+
+uLONG VLogger::_GetSourceID( VLogRing* inRing, const VString& inSource)
+{
+	if ( (inRing->fLastSourceID == 0) || !inRing->fLastSource.EqualToStringRaw( inSource))
+	{
+		StLocker<VCriticalSection> lock( &fSourcesLock);
+
+		std::map<VString, uLONG>::const_iterator i = fSourceIDs.find( inSource);
+		if (i == fSourceIDs.end())
 		{
-			inMessage->Retain();
-			fValues[fEndIndex] = inMessage;
-			fEndIndex = nextIndex;
+			fSources.push_back( inSource);
+			i = fSourceIDs.insert( std::pair<VString, uLONG>( inSource, (uLONG) fSources.size())).first;
 		}
 
-		fLock.Unlock();
+		inRing->fLastSource = inSource;
+		inRing->fLastSourceID = i->second;
+	}
+
+	return inRing->fLastSourceID;
+}
+
+
+void VLogger::_Push( EMessageLevel inLevel, const VString* inSource, const VString* inMessage, const VValueBag* inBag)
+{
+	// inBag has been retained by the caller
+	VTime now;
+	now.FromSystemTime();
+	uLONG8 stamp = now.GetStamp();
+
+	if ( (inBag == NULL) && (inMessage != NULL) && (inMessage->GetLength() > VLogRing::kMAX_MESSAGE_LENGTH) )
+	{
+		// too long for a record: the message is kept out of line in a bag, like the LogBag() ones
+		VValueBag *bag = new VValueBag;
+
+		ILoggerBagKeys::source.Set( bag, *inSource);
+		ILoggerBagKeys::level.Set( bag, inLevel);
+		ILoggerBagKeys::message.Set( bag, *inMessage);
+		ILoggerBagKeys::timestamp.Set( bag, (sLONG8) stamp);
+
+		inBag = bag;
+		inSource = NULL;
+		inMessage = NULL;
+	}
+
+	VLogRing *ring = _GetCurrentRing();
+	bool isSharedRing = (ring == NULL);
+	if (isSharedRing)
+	{
+		fSharedRingLock.Lock();
+		ring = fSharedRing;
+	}
+
+	uLONG sourceID = (inSource != NULL) ? _GetSourceID( ring, *inSource) : 0;
+	bool shouldWakeReader = false;
+	bool pushed = ring->Push( inLevel, stamp, sourceID, inMessage, inBag, &shouldWakeReader);
+
+	while (!pushed && (ring->fCapacity < VLogRing::kMAX_CAPACITY))
+	{
+		ring = _GrowRing( ring, isSharedRing);
+		sourceID = (inSource != NULL) ? _GetSourceID( ring, *inSource) : 0;
+		pushed = ring->Push( inLevel, stamp, sourceID, inMessage, inBag, &shouldWakeReader);
+	}
+
+	if (shouldWakeReader)
+		fReaderWakeUp.Unlock();
+
+	if (!pushed)
+	{
+		switch( fPolicy)
+		{
+			case eLogBackpressure_Block:
+				{
+					// the reader task can't wait for itself
+					VTask *readerTask = fLogReaderTask;
+					if ( (readerTask != NULL) && (VTask::GetCurrent() != readerTask) )
+					{
+						VInterlocked::Increment( &fBlockedProducers);
+						while (!pushed && fIsStarted && (readerTask->GetState() < TS_DYING))
+						{
+							VSyncEvent *event = NULL;
+							{
+								StLocker<VCriticalSection> lock( &fRoomLock);
+								event = RetainRefCountable( fRoomEvent);
+							}
+
+							// retried once the event is taken: a drain after this point signals it
+							fReaderWakeUp.Unlock();
+							pushed = ring->Push( inLevel, stamp, sourceID, inMessage, inBag, &shouldWakeReader);
+							if (!pushed)
+								event->Lock( kBLOCKED_PRODUCER_TIMEOUT);	// the reader may stop meanwhile
+							event->Release();
+						}
+						VInterlocked::Decrement( &fBlockedProducers);
+					}
+					break;
+				}
+
+			case eLogBackpressure_Spill:
+				{
+					if (inBag != NULL)
+					{
+						VString source, message;
+						ILoggerBagKeys::source.Get( inBag, source);
+						ILoggerBagKeys::message.Get( inBag, message);
+						pushed = _Spill( inLevel, stamp, source, message);
+					}
+					else
+					{
+						pushed = _Spill( inLevel, stamp, *inSource, *inMessage);
+					}
+
+					// the record went to the file
+					if (pushed && (inBag != NULL))
+						inBag->Release();
+					break;
+				}
+
+			default:
+				break;
+		}
+
+		if (!pushed)
+		{
+			VInterlocked::Increment( &ring->fDropped);
+			if (inBag != NULL)
+				inBag->Release();
+		}
+	}
+
+	if (isSharedRing)
+		fSharedRingLock.Unlock();
+}
+
+
+bool VLogger::_Spill( EMessageLevel inLevel, uLONG8 inStamp, const VString& inSource, const VString& inMessage)
+{
+	StLocker<VCriticalSection> lock( &fSpillLock);
+
+	if (fSpillDesc == NULL)
+		return false;
+
+	VTime time;
+	time.FromStamp( inStamp);
+
+	VString line;
+	time.GetXMLString( line, XSO_Default);
+	line.AppendCString( " [");
+	line.AppendString( inSource);
+	line.AppendCString( "] ");
+	line.AppendCString( GetMessageLevelName( inLevel));
+	line.AppendCString( " - ");
+	line.AppendString( inMessage);
+	line.AppendUniChar( '\n');
+
+	StStringConverter<char> buffer( line, VTC_UTF_8);
+
+	StErrorContextInstaller errorContext( false);
+	VError err = fSpillDesc->PutDataAtPos( buffer.GetCPointer(), buffer.GetSize());
+	if (err != VE_OK)
+		return false;
+
+	VInterlocked::Increment( &fSpilled);
+
+	return true;
+}
+
+
+VError VLogger::SetBackpressurePolicy( ELogBackpressurePolicy inPolicy, const VFilePath* inSpillFile)
+{
+	StLocker<VCriticalSection> lock( &fSpillLock);
+
+	VFileDesc *desc = NULL;
+	if (inPolicy == eLogBackpressure_Spill)
+	{
+		if ( (inSpillFile == NULL) || !inSpillFile->IsFile() )
+			return vThrowError( VE_INVALID_PARAMETER);
+
+		VFile file( *inSpillFile);
+		VError err = file.Open( FA_READ_WRITE, &desc, FO_CreateIfNotFound);
+		if (err == VE_OK)
+			err = desc->SetPos( desc->GetSize());
+		if (err != VE_OK)
+		{
+			delete desc;
+			return err;
+		}
+	}
+
+	delete fSpillDesc;
+	fSpillDesc = desc;
+	fPolicy = inPolicy;
+
+	return VE_OK;
+}
+
+
+void VLogger::GetStatistics( Statistics& outStatistics) const
+{
+	VLogger *self = const_cast<VLogger*>( this);
+
+	outStatistics.fQueued = 0;
+	outStatistics.fDropped = VInterlocked::AtomicGet( &self->fDroppedByDeadRings);
+	outStatistics.fLogged = VInterlocked::AtomicGet( &self->fLogged);
+	outStatistics.fSpilled = VInterlocked::AtomicGet( &self->fSpilled);
+
+	StLocker<VCriticalSection> lock( &fLock);
+
+	for( std::vector<VLogRing*>::const_iterator i = fRings.begin() ; i != fRings.end() ; ++i)
+	{
+		outStatistics.fQueued += VInterlocked::AtomicGet( &(*i)->fQueued);
+		outStatistics.fDropped += VInterlocked::AtomicGet( &(*i)->fDropped);
+	}
+
+	outStatistics.fRingCount = (sLONG) fRings.size();
+}
+
+
+void VLogger::LogBag( const VValueBag *inMessage)
+{
+	EMessageLevel level = ILoggerBagKeys::level.Get(inMessage);
+	if ( ShouldLog(level) )
+	{
+		// the ring keeps the bag until the reader task hands it to the listeners
+		inMessage->Retain();
+		_Push( level, NULL, NULL, inMessage);
 	}
 }
 
 
 void VLogger::LogMessage( ELog4jMessageLevel inLevel, const VString& inMessage, const VString& inSourceIdentifier)
 {
-	VValueBag* bag = new VValueBag;
+	if (!ShouldLog( inLevel))
+		return;
 
+	// the record only keeps a source id: the bag is built by the reader task
 	if (!inSourceIdentifier.IsEmpty())
 	{
-		ILoggerBagKeys::source.Set( bag, inSourceIdentifier);
+		_Push( inLevel, &inSourceIdentifier, &inMessage, NULL);
 	}
 	else
 	{
+		VString source;
 		bool sourceIdentifierSet = false;
 
 		const VValueBag* properties = VTask::GetCurrent()->RetainProperties();
 		if (properties != NULL)
 		{
-			VString source;
 			sourceIdentifierSet = properties->GetString( ILoggerBagKeys::source, source);
-			if (sourceIdentifierSet)
-				ILoggerBagKeys::source.Set( bag, source);
 		}
 		ReleaseRefCountable( &properties);
 
 		if (!sourceIdentifierSet)
-			ILoggerBagKeys::source.Set( bag, VProcess::Get()->GetLogSourceIdentifier());
-	}
+			source = VProcess::Get()->GetLogSourceIdentifier();
 
-	ILoggerBagKeys::level.Set( bag, inLevel);
-	ILoggerBagKeys::message.Set( bag, inMessage);
-
-	LogBag( bag);
-
-	ReleaseRefCountable(&bag);
+		_Push( inLevel, &source, &inMessage, NULL);
+	}
 }
 
 
@@ -290,40 +814,3 @@ bool VLogger::WithTag(uLONG inTag, bool inFlag)
 
 	return rv;
 }
-
-sLONG VLogger::Read(std::vector<const VValueBag*>& ioValuesVector,bool inAlreadyLocked )
-{
-	sLONG	nbRead = 0;
-	ioValuesVector.clear();
-	if (fStartIndex != fEndIndex)
-	{
-		if (!inAlreadyLocked)
-		{
-			fLock.Lock();
-		}
-		nbRead = fEndIndex - fStartIndex;
-		if (nbRead < 0)
-		{
-			nbRead += K_NB_MAX_BAGS;
-		}
-		/*if (inSize < nbRead)
-		{
-			nbRead = inSize;
-		}*/
-		sLONG curtIndex = fStartIndex;
-		for( sLONG idx = 0; idx < nbRead; idx++ )
-		{
-			ioValuesVector.push_back(fValues[curtIndex]);
-			fValues[curtIndex] = NULL;
-			curtIndex = Next(curtIndex);
-		}
-		fStartIndex = curtIndex;
-		if (!inAlreadyLocked)
-		{
-			fLock.Unlock();
-		}
-	}
-
-	return nbRead;
-}
-
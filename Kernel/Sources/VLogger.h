@@ -22,12 +22,15 @@
 #include "Kernel/Sources/VString.h"
 #include "Kernel/Sources/VTime.h"
 #include "Kernel/Sources/ILogger.h"
+#include "Kernel/Sources/VTask.h"
+#include "Kernel/Sources/VSyncObject.h"
 
 
 BEGIN_TOOLBOX_NAMESPACE
 
 
 class VFolder;
+class VFileDesc;
 
 
 
@@ -46,6 +49,20 @@ enum
 typedef EMessageLevel ELog4jMessageLevel;
 
 
+/** @brief	What a producer does when its ring is full at its maximum size (the reader task is late). */
+
+typedef enum ELogBackpressurePolicy
+{
+	eLogBackpressure_Drop	= 0,	// the record is lost and counted (default)
+	eLogBackpressure_Block,			// the producer waits for the reader task to make room
+	eLogBackpressure_Spill			// the record is appended to a spill file instead of going to the listeners
+} ELogBackpressurePolicy;
+
+
+
+/** @brief	Each producer task owns a lock-free ring of compact binary records (level, timestamp, source id, message).
+			Rings start at 4KB and double up to 64KB when a task logs faster than the reader drains.
+			The reader task drains all rings, builds the bags and hands them to the listeners in one batch. */
 
 class XTOOLBOX_API VLogger : public VObject, public ILogger
 {
@@ -53,6 +70,15 @@ public:
 
 	enum { kLoggerTaskKind = 'LOGG' };
 
+	typedef struct Statistics
+	{
+		sLONG	fQueued;		// records waiting in the rings
+		sLONG	fLogged;		// records handed to the listeners
+		sLONG	fDropped;		// records lost because a ring was full (or the spill file could not be written)
+		sLONG	fSpilled;		// records written to the spill file
+		sLONG	fRingCount;		// producer rings
+	} Statistics;
+
 			VLogger();// const VFolder& inLogFolder, const VString& inLogName);
 	virtual ~VLogger();
 
@@ -94,25 +120,57 @@ public:
 			bool					AddLogListener(ILogListener* inLogListener);
 			bool					RemoveLogListener(ILogListener* inLogListener);
 
+			// inSpillFile is only used (and mandatory) with eLogBackpressure_Spill. Spilled records are appended as text lines.
+			VError					SetBackpressurePolicy( ELogBackpressurePolicy inPolicy, const VFilePath* inSpillFile = NULL);
+			ELogBackpressurePolicy	GetBackpressurePolicy() const			{ return fPolicy;}
+
+			void					GetStatistics( Statistics& outStatistics) const;
+
 private:
+	class VLogRing;
+
 			bool					WithTag(uLONG inTag, bool inFlag);
 
-	#define K_NB_MAX_BAGS			(1000)
-			const VValueBag*		fValues[K_NB_MAX_BAGS];
-			sLONG					fStartIndex;	
-			sLONG					fEndIndex;
-	mutable	VCriticalSection		fLock;
-			bool					fMessagesLost;
+			VLogRing*				_GetCurrentRing();
+			VLogRing*				_GrowRing( VLogRing* inRing, bool inIsSharedRing);
+			uLONG					_GetSourceID( VLogRing* inRing, const VString& inSource);
+			void					_Push( EMessageLevel inLevel, const VString* inSource, const VString* inMessage, const VValueBag* inBag);
+			bool					_Spill( EMessageLevel inLevel, uLONG8 inStamp, const VString& inSource, const VString& inMessage);
+			void					_SignalRoom();
+
+			typedef std::pair<uLONG8, const VValueBag*>	StampedBag;
+
+			sLONG					_Drain( VLogRing* inRing, std::vector<StampedBag>& ioBags, uLONG& ioSourceID, VString& ioSource);
+
+	static	void					_DisposeRing( void* inData);
+
+	mutable	VCriticalSection		fLock;			// listeners and ring list, taken by the reader and when a task logs for the first time
+			std::vector<VLogRing*>	fRings;
+			VTaskDataKey			fRingKey;
+			VLogRing*				fSharedRing;	// for threads that are not VTasks
+			VCriticalSection		fSharedRingLock;
+
+	mutable	VCriticalSection		fSourcesLock;
+			std::map<VString, uLONG>	fSourceIDs;
+			std::vector<VString>	fSources;
+
+			ELogBackpressurePolicy	fPolicy;
+			VCriticalSection		fSpillLock;
+			VFileDesc*				fSpillDesc;
+			sLONG					fSpilled;
+			sLONG					fLogged;
+			sLONG					fDroppedByDeadRings;	// and by rings replaced by a bigger one
+
+			VSemaphore				fReaderWakeUp;
+			VCriticalSection		fRoomLock;
+			VSyncEvent*				fRoomEvent;			// signaled by the reader once rings are drained, then replaced
+			sLONG					fBlockedProducers;	// producers waiting on fRoomEvent (eLogBackpressure_Block)
 			VFilePath				fFolderPath;
 			VString					fLogName;
 			//VSplitableLogFile*		fOutput;
 			uLONG					fFilter;	// bitfield to know what we are supposed to log
 			bool					fIsStarted;	// to avoid an expensive lock on fLock just to know if we should log something
 
-			sLONG					Read(std::vector<const VValueBag*>& ioValuesVector, bool inAlreadyLocked = false);
-
-			sLONG					Next(sLONG inIndex);
-
 			std::vector<ILogListener*>		fLogListeners;
 	static	sLONG				LogReaderTaskProc(XBOX::VTask* inTask);
 		XBOX::VTask*			fLogReaderTask;
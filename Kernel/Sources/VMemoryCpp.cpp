@@ -263,6 +263,26 @@ void VMemStats::Dump()
 	DebugMsg(s);
 	DebugMsg(L"\n");
 
+	DebugMsg(L"Nb Thread Caches = ");
+	s.FromLong(fNbThreadCaches);
+	DebugMsg(s);
+	DebugMsg(L"\n");
+
+	DebugMsg(L"Thread Caches Hits = ");
+	s.FromLong8(fThreadCacheHits);
+	DebugMsg(s);
+	DebugMsg(L"\n");
+
+	DebugMsg(L"Thread Caches Misses = ");
+	s.FromLong8(fThreadCacheMisses);
+	DebugMsg(s);
+	DebugMsg(L"\n");
+
+	DebugMsg(L"Thread Caches Mem = ");
+	s.FromLong8(fThreadCacheBytes);
+	DebugMsg(s);
+	DebugMsg(L"\n");
+
 	DebugMsg(L"\n");
 	for_each(fObjectInfo.begin(), fObjectInfo.end(), DumpObjectInfo);
 
@@ -316,6 +336,11 @@ void VMemStats::Clear()
 	fBiggestBlock = 0;
 	fBiggestBlockFree = 0;
 	fNbObjects = 0;
+	fNbThreadCaches = 0;
+	fThreadCacheHits = 0;
+	fThreadCacheMisses = 0;
+	fThreadCacheBytes = 0;
+	fThreadCacheInfos.clear();
 }
 
 
@@ -422,12 +447,41 @@ void VCppMemMgr::_Init( EAllocatorKind inKind, bool inWithDebugInfo, bool inWith
 
 	fMaxVirtualAllocatedSize = (VSize) MaxLongInt;
 	fCurrentVirtualAllocatedSize = 0;
+
+	// the thread caches would hide the blocks from the debug checks
+	fFirstThreadCache = NULL;
+	fWithThreadCaches = !fUseStdLibMgr && !fWithDebugInfo && !fWithStrangeFill;
+
+	#if !WITH_NEW_XTOOLBOX_GETOPT
+	if (VProcess::GetCommandLineArgumentAsLong("-memThreadCaches", &val) && (val == 0))
+		fWithThreadCaches = false;
+	#endif
+
+	if (fWithThreadCaches)
+	{
+	#if VERSIONWIN
+		fThreadCacheSlot = ::FlsAlloc( _DisposeThreadCache);
+		fWithThreadCaches = (fThreadCacheSlot != FLS_OUT_OF_INDEXES);
+	#else
+		fWithThreadCaches = (::pthread_key_create( &fThreadCacheSlot, _DisposeThreadCache) == 0);
+	#endif
+	}
 }
 
 
 VCppMemMgr::~VCppMemMgr()
 {
 	CheckNow();
+	if (fWithThreadCaches)
+	{
+		// the caches of the threads still alive are abandoned with the pages
+		fWithThreadCaches = false;
+	#if VERSIONWIN
+		::FlsFree( fThreadCacheSlot);
+	#else
+		::pthread_key_delete( fThreadCacheSlot);
+	#endif
+	}
 	if (fUseStdLibMgr)
 	{
 		delete fStdMemMgr;
@@ -540,12 +594,97 @@ void VCppMemMgr::PurgeMem(sLONG whatBlock)
 }
 
 
+VMemThreadCache* VCppMemMgr::_GetThreadCache()
+{
+#if VERSIONWIN
+	VMemThreadCache* cache = (VMemThreadCache*) ::FlsGetValue( fThreadCacheSlot);
+#else
+	VMemThreadCache* cache = (VMemThreadCache*) ::pthread_getspecific( fThreadCacheSlot);
+#endif
+	if (cache == NULL)
+	{
+		VKernelTaskLock lock(&fMgrMutex);
+
+		void* mem = TryToMalloc( sizeof(VMemThreadCache), false, 'tcac', -1);
+		if (mem != NULL)
+		{
+			cache = new (mem) VMemThreadCache( this);
+		#if VERSIONWIN
+			bool ok = (::FlsSetValue( fThreadCacheSlot, cache) != FALSE);
+		#else
+			bool ok = (::pthread_setspecific( fThreadCacheSlot, cache) == 0);
+		#endif
+			if (ok)
+			{
+				cache->SetNext( fFirstThreadCache);
+				if (fFirstThreadCache != NULL)
+					fFirstThreadCache->SetPrevious( cache);
+				fFirstThreadCache = cache;
+			}
+			else
+			{
+				cache->~VMemThreadCache();
+				fMems[0]->Free( mem);
+				cache = NULL;
+			}
+		}
+	}
+	return cache;
+}
+
+
+//static
+#if VERSIONWIN
+void NTAPI VCppMemMgr::_DisposeThreadCache( void* inCache)
+#else
+void VCppMemMgr::_DisposeThreadCache( void* inCache)
+#endif
+{
+	// called at thread exit
+	VMemThreadCache* cache = (VMemThreadCache*) inCache;
+	if (cache != NULL)
+	{
+		VCppMemMgr* owner = cache->GetOwner();
+		VKernelTaskLock lock(&owner->fMgrMutex);
+
+		cache->Flush();
+
+		if (cache->GetPrevious() != NULL)
+			cache->GetPrevious()->SetNext( cache->GetNext());
+		else
+			owner->fFirstThreadCache = cache->GetNext();
+		if (cache->GetNext() != NULL)
+			cache->GetNext()->SetPrevious( cache->GetPrevious());
+
+		cache->~VMemThreadCache();
+		owner->fMems[0]->Free( cache);
+	}
+}
+
+
 void* VCppMemMgr::Malloc(VSize inNbBytes, bool inIsVObject, sLONG inTag, sLONG preferedBlock)
 {
-	void* result = NULL;
 	if (fUseStdLibMgr)
-		result = fStdMemMgr->Malloc(inNbBytes, false, inIsVObject, inTag);
-	else
+		return fStdMemMgr->Malloc(inNbBytes, false, inIsVObject, inTag);
+
+	if (fWithThreadCaches && preferedBlock < 0 && VMemThreadCache::IsCachedSize( inNbBytes))
+	{
+		VMemThreadCache* cache = _GetThreadCache();
+		if (cache != NULL)
+		{
+			void* result = cache->Malloc( inNbBytes, inIsVObject, inTag);
+			if (result != NULL)
+				return result;
+		}
+	}
+
+	return _SharedMalloc( inNbBytes, inIsVObject, inTag, preferedBlock);
+}
+
+
+void* VCppMemMgr::_SharedMalloc(VSize inNbBytes, bool inIsVObject, sLONG inTag, sLONG preferedBlock)
+{
+	void* result = NULL;
 	{
 		fMgrMutex.Lock();
 
@@ -905,6 +1044,28 @@ void VCppMemMgr::Free(void* ioPtr)
 	if (fUseStdLibMgr)
 		fStdMemMgr->Free(ioPtr);
 	else
+	{
+		VSize elemSize;
+		VMemThreadCache* cache;
+		if (ioPtr == NULL
+			|| !fWithThreadCaches
+			|| !VMemCppImpl::GetSmallBlockElemSize( ioPtr, &elemSize)
+			|| (cache = _GetThreadCache()) == NULL
+			|| !cache->Free( ioPtr, elemSize))
+		{
+			_SharedFree( ioPtr);
+		}
+	}
+#if VERSIONDEBUG_PROFILE
+	sLONG8 ticks2;
+	VSystem::GetProfilingCounter(ticks2);
+	VSystem::debug_AddToProfilerCount(0, ticks2-ticks);
+#endif
+}
+
+
+void VCppMemMgr::_SharedFree(void* ioPtr)
+{
 	{
 		VKernelTaskLock lock(&fMgrMutex);
 		Check();
@@ -933,11 +1094,6 @@ void VCppMemMgr::Free(void* ioPtr)
 			}
 		}
 	}
-#if VERSIONDEBUG_PROFILE
-	sLONG8 ticks2;
-	VSystem::GetProfilingCounter(ticks2);
-	VSystem::debug_AddToProfilerCount(0, ticks2-ticks);
-#endif
 }
 
 
@@ -1445,6 +1601,17 @@ void VCppMemMgr::GetStatistics(VMemStats& outStats, sLONG blockNumber)
 				(*cur)->GetStats(outStats, blocknum);
 			}
 		}
+
+		for (VMemThreadCache* cache = fFirstThreadCache; cache != NULL; cache = cache->GetNext())
+		{
+			VMemThreadCacheInfo info;
+			cache->GetInfo( info);
+			outStats.fThreadCacheInfos.push_back( info);
+			outStats.fNbThreadCaches++;
+			outStats.fThreadCacheHits += info.fHits;
+			outStats.fThreadCacheMisses += info.fMisses;
+			outStats.fThreadCacheBytes += info.fCachedBytes;
+		}
 	}
 }
 
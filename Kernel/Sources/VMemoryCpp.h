@@ -55,6 +55,7 @@ class XTOOLBOX_API VMemoryHog
 class IMemoryWalker;
 class VArrayLong;
 class VCppMemMgr;
+class VMemThreadCache;
 
 // Class definitions
 typedef VSize (*PurgeHandlerProc) (sLONG allocationBlockNumber, VSize inNeededBytes, bool withFlush);
@@ -112,12 +113,23 @@ struct MemImplBlockInfo
 	sWORD		fInnerUsedCount;	// page allocation used count. If this info is a boundary marker, fInnerUsedCount is the allocation block number.
 };
 
+// activity of one per thread small block cache (see VMemThreadCache)
+struct VMemThreadCacheInfo
+{
+	sLONG8		fHits;			// Malloc served from the cache
+	sLONG8		fMisses;		// Malloc that needed a refill from the shared pages
+	sLONG8		fFrees;			// Free kept in the cache
+	sLONG8		fReturns;		// blocks given back to the shared pages
+	VSize		fCachedBytes;	// bytes currently held by the cache
+};
+
 typedef XTOOLBOX_TEMPLATE_API std::map< const std::type_info* , VObjectInfo > VMapOfObjectInfo;
 typedef XTOOLBOX_TEMPLATE_API std::map< sLONG , VObjectInfo > VMapOfBlockInfo;
 typedef XTOOLBOX_TEMPLATE_API std::vector<VMemoryHog*> VStackOfMemHogs;
 typedef XTOOLBOX_TEMPLATE_API std::map< VSize , VMemBlockInfo > VMapOfMemBlockInfo;
 typedef XTOOLBOX_TEMPLATE_API std::vector<MemImplBlockInfo> VectorOfMemImplBlockInfo;
 typedef XTOOLBOX_TEMPLATE_API std::map<void*,const std::type_info*> VMapOfTypeInfoByVtbl;
+typedef XTOOLBOX_TEMPLATE_API std::vector<VMemThreadCacheInfo> VectorOfMemThreadCacheInfo;
 
 class VStream;
 
@@ -138,6 +150,10 @@ public:
 		fBiggestBlock = 0;
 		fBiggestBlockFree = 0;
 		fNbObjects = 0;
+		fNbThreadCaches = 0;
+		fThreadCacheHits = 0;
+		fThreadCacheMisses = 0;
+		fThreadCacheBytes = 0;
 	};
 
 	void Dump();
@@ -163,6 +179,13 @@ public:
 	VMapOfMemBlockInfo fOtherBlockInfo;
 	VectorOfMemImplBlockInfo	fMemImplBlockInfos;
 	VMapOfTypeInfoByVtbl	fTypeInfoByVtbl;
+
+	// per thread small block caches (xbox allocator only)
+	sLONG fNbThreadCaches;
+	sLONG8 fThreadCacheHits;
+	sLONG8 fThreadCacheMisses;
+	VSize fThreadCacheBytes;
+	VectorOfMemThreadCacheInfo fThreadCacheInfos;
 };
 
 
@@ -304,10 +327,22 @@ public:
 
 			void PurgeMem(sLONG whatBlock = -1);
 
+			bool	IsWithThreadCaches() const						{ return fWithThreadCaches; }
 
 private:
+	friend class VMemThreadCache;
+
 			void	_Init( EAllocatorKind inKind, bool inWithDebugInfo, bool inWithStrangeFill);
 			void*	TryToMalloc( VSize inNbBytes, bool inIsVObject, sLONG inTag, sLONG preferedBlock);
+			void*	_SharedMalloc( VSize inNbBytes, bool inIsVObject, sLONG inTag, sLONG preferedBlock);
+			void	_SharedFree( void* ioPtr);
+
+			VMemThreadCache*	_GetThreadCache();
+#if VERSIONWIN
+	static	void NTAPI	_DisposeThreadCache( void* inCache);
+#else
+	static	void	_DisposeThreadCache( void* inCache);
+#endif
 
 			//XMemCppImpl*					fMemMgr;
 			VKernelCriticalSection			fMgrMutex;
@@ -337,6 +372,15 @@ private:
 			sLONG							fWaitBeforeNewPtrStarter;
 			VStackOfMemHogs					fMemHogsStack;
 
+			// per thread small block caches, registered under fMgrMutex
+			bool							fWithThreadCaches;
+#if VERSIONWIN
+			DWORD							fThreadCacheSlot;
+#else
+			pthread_key_t					fThreadCacheSlot;
+#endif
+			VMemThreadCache*				fFirstThreadCache;
+
 	// Private allocation support
 			void	RegisterBlock( DebugBlockHeader* inAddr, VSize inUserSize, bool inIsVObject);
 			void	UnregisterBlock( DebugBlockHeader* inAddr);
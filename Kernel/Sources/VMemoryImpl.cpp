@@ -1126,6 +1126,37 @@ VSize VMemCppImpl::GetPtrSize( const void *inBlock)
 }
 
 
+//static
+bool VMemCppImpl::GetSmallBlockElemSize( const void *inBlock, VSize *outElemSize)
+{
+	VMemImplBlock *x = (VMemImplBlock*) ( ((char*)inBlock) - SizeHeader );
+	if (!x->IsASmallBlock())
+		return false;
+
+	VMemImplSmallBlock *xsmall = (VMemImplSmallBlock*) ( ((char*)inBlock) - VMemThreadImpl::SizeSmallHeader );
+	sLONG offset = xsmall->GetOffset();
+	offset = (-offset) & -2;
+	VPageAllocationImpl* page = (VPageAllocationImpl*) (((char*)xsmall)-offset);
+	*outElemSize = page->GetElemSize();
+	return true;
+}
+
+
+//static
+void VMemCppImpl::SetSmallBlockInfo( void *inBlock, Boolean isAnObject, sLONG inTag)
+{
+	// on remet le meme offset en changeant simplement le dernier bit
+	VMemImplSmallBlock *xsmall = (VMemImplSmallBlock*) ( ((char*)inBlock) - VMemThreadImpl::SizeSmallHeader );
+	sLONG offset = xsmall->GetOffset();
+	offset = (-offset) & -2;
+	sLONG plus = isAnObject ? 1 : 0;
+	xsmall->SetOffset(-(offset + plus));
+#if CPPMEM_CACHE_INFO
+	xsmall->SetTag(inTag);
+#endif
+}
+
+
 sLONG VMemCppImpl::GetAllocationBlockNumber(void *inBlock)
 {
 	assert(inBlock != NULL);
@@ -1602,3 +1633,130 @@ void VMemCppImpl::GetStats(VMemStats& stats, sWORD blocknumber)
 
 
 
+// ---------------------------------------------------------------------------
+
+
+VMemThreadCache::VMemThreadCache( VCppMemMgr *inOwner)
+: fOwner( inOwner)
+, fNext( NULL)
+, fPrevious( NULL)
+, fCachedBytes( 0)
+, fHits( 0)
+, fMisses( 0)
+, fFrees( 0)
+, fReturns( 0)
+{
+	for (sLONG i = 0; i < kClassCount; i++)
+	{
+		fFirst[i] = NULL;
+		fCount[i] = 0;
+	}
+}
+
+
+VMemThreadCache::~VMemThreadCache()
+{
+	xbox_assert(fCachedBytes == 0);
+}
+
+
+void* VMemThreadCache::Malloc( VSize inSize, Boolean isAnObject, sLONG inTag)
+{
+	sLONG sizeClass = (sLONG) ((inSize + VMemThreadImpl::SizeSmallHeader + kFirstStepAllocInc - 1) / kFirstStepAllocInc);
+	xbox_assert(sizeClass > 0 && sizeClass < kClassCount);
+
+	FreeBlock* block = fFirst[sizeClass];
+	if (block != NULL)
+	{
+		fFirst[sizeClass] = block->fNext;
+		fCount[sizeClass]--;
+		fCachedBytes -= sizeClass * kFirstStepAllocInc;
+		fHits++;
+		VMemCppImpl::SetSmallBlockInfo(block, isAnObject, inTag);
+		return block;
+	}
+
+	fMisses++;
+
+	// ask for the exact elem size of the class so that the whole batch comes from the same pages
+	VSize blockSize = sizeClass * kFirstStepAllocInc - VMemThreadImpl::SizeSmallHeader;
+	void* result;
+	{
+		VKernelTaskLock lock(&fOwner->fMgrMutex);
+
+		result = fOwner->TryToMalloc(blockSize, isAnObject, inTag, -1);
+		if (result != NULL)
+		{
+			for (sLONG i = 1; i < kRefillCount; i++)
+			{
+				FreeBlock* extra = (FreeBlock*) fOwner->TryToMalloc(blockSize, false, 0, -1);
+				if (extra == NULL)
+					break;
+				extra->fNext = fFirst[sizeClass];
+				fFirst[sizeClass] = extra;
+				fCount[sizeClass]++;
+				fCachedBytes += sizeClass * kFirstStepAllocInc;
+			}
+		}
+	}
+
+	return result;
+}
+
+
+bool VMemThreadCache::Free( void *inBlock, VSize inElemSize)
+{
+	if (inElemSize > kFirstStepAlloc || fCachedBytes + inElemSize > kMaxCachedBytes)
+		return false;
+
+	sLONG sizeClass = (sLONG) (inElemSize / kFirstStepAllocInc);
+
+	// fNext overwrites the vtable: the block must not be seen as a VObject by VPageAllocationImpl::GetStats
+	VMemCppImpl::SetSmallBlockInfo(inBlock, false, 0);
+
+	FreeBlock* block = (FreeBlock*) inBlock;
+	block->fNext = fFirst[sizeClass];
+	fFirst[sizeClass] = block;
+	fCount[sizeClass]++;
+	fCachedBytes += inElemSize;
+	fFrees++;
+
+	if (fCount[sizeClass] > kMaxBlocksPerClass)
+	{
+		VKernelTaskLock lock(&fOwner->fMgrMutex);
+		_GiveBack(sizeClass, kMaxBlocksPerClass / 2);
+	}
+
+	return true;
+}
+
+
+void VMemThreadCache::_GiveBack( sLONG inClass, sLONG inCount)
+{
+	for (sLONG i = 0; i < inCount && fFirst[inClass] != NULL; i++)
+	{
+		FreeBlock* block = fFirst[inClass];
+		fFirst[inClass] = block->fNext;
+		fCount[inClass]--;
+		fCachedBytes -= inClass * kFirstStepAllocInc;
+		fReturns++;
+		fOwner->fMems[0]->Free(block);
+	}
+}
+
+
+void VMemThreadCache::Flush()
+{
+	for (sLONG i = 0; i < kClassCount; i++)
+		_GiveBack(i, fCount[i]);
+}
+
+
+void VMemThreadCache::GetInfo( VMemThreadCacheInfo& outInfo) const
+{
+	outInfo.fHits = fHits;
+	outInfo.fMisses = fMisses;
+	outInfo.fFrees = fFrees;
+	outInfo.fReturns = fReturns;
+	outInfo.fCachedBytes = fCachedBytes;
+}
@@ -343,6 +343,12 @@ public:
 
 	sLONG GetAllocationBlockNumber(void *inBlock);
 
+	// returns false if inBlock is not a small block, else its element size including its header
+	static	bool	GetSmallBlockElemSize (const void *inBlock, VSize *outElemSize);
+	
+	// gives a small block taken back from a thread cache the flags of its new owner
+	static	void	SetSmallBlockInfo (void *inBlock, Boolean isAnObject, sLONG inTag);
+
 
 private:
 	//VKernelCriticalSection	fMutex;
@@ -367,6 +373,76 @@ private:
 #endif
 };
 
+
+
+/*
+	Per thread cache of free small blocks of the first step (elem size <= kFirstStepAlloc).
+
+	Malloc and Free of the owner VCppMemMgr are served from the cache of the calling thread without taking fMgrMutex.
+	On a miss the cache is refilled by batch under fMgrMutex, and a class holding too many blocks gives half of them
+	back to the shared pages in one go. A block freed by another thread than its allocator simply joins the cache of
+	the freeing thread.
+
+	The blocks stay accounted as used memory in the pages while cached.
+	The cache itself is allocated in the owner and is flushed and disposed when its thread dies.
+*/
+class VMemThreadCache
+{
+public:
+	enum {
+		kClassCount = kFirstStepAllocNbPages,		// one class per kFirstStepAllocInc
+		kRefillCount = 16,							// blocks fetched under lock on a miss
+		kMaxBlocksPerClass = 64,					// above, half the class is given back
+		kMaxCachedBytes = 256 * 1024				// above, Free goes directly to the shared pages
+	};
+
+								VMemThreadCache (VCppMemMgr *inOwner);
+								~VMemThreadCache ();
+
+	// returns true if a block of that size is handled by the caches
+	static	bool				IsCachedSize (VSize inSize)		{ return inSize + VMemThreadImpl::SizeSmallHeader <= kFirstStepAlloc; }
+
+	// returns NULL if the shared pages are full, caller should go through the regular path that may purge
+			void*				Malloc (VSize inSize, Boolean isAnObject, sLONG inTag);
+
+	// returns false if the block has not been kept
+			bool				Free (void *inBlock, VSize inElemSize);
+
+	// gives back all the cached blocks. fMgrMutex must be held.
+			void				Flush ();
+
+			void				GetInfo (VMemThreadCacheInfo& outInfo) const;
+
+			VCppMemMgr*			GetOwner () const				{ return fOwner; }
+
+			VMemThreadCache*	GetNext () const				{ return fNext; }
+			VMemThreadCache*	GetPrevious () const			{ return fPrevious; }
+			void				SetNext (VMemThreadCache* inNext)			{ fNext = inNext; }
+			void				SetPrevious (VMemThreadCache* inPrevious)	{ fPrevious = inPrevious; }
+
+private:
+	// the first bytes of a free cached block point to the next one
+	struct FreeBlock
+	{
+		FreeBlock*	fNext;
+	};
+
+			void				_GiveBack (sLONG inClass, sLONG inCount);
+
+	VCppMemMgr*			fOwner;
+	VMemThreadCache*	fNext;
+	VMemThreadCache*	fPrevious;
+	FreeBlock*			fFirst[kClassCount];
+	sLONG				fCount[kClassCount];
+	VSize				fCachedBytes;
+
+	// only written by the owning thread, read under fMgrMutex for statistics
+	sLONG8				fHits;
+	sLONG8				fMisses;
+	sLONG8				fFrees;
+	sLONG8				fReturns;
+};
+
 END_TOOLBOX_NAMESPACE
 
 #endif
@@ -28,6 +28,7 @@
 #include "ILogger.h"
 #include "VJSONValue.h"
 #include "VFileSystem.h"
+#include "VProfiler.h"
 #include <sys/types.h> // getpid
 #if !VERSIONWIN
 #include <unistd.h>
@@ -210,6 +211,8 @@ bool VProcess::_Init( VProcess::InitOptions inOptions)
 		ok = VDebugMgr::Get()->Init();
 	if (ok)
 		ok = VProgressManager::Init();
+	if (ok)
+		ok = VProfilerRegistry::Init();
 	if (ok)
 		ok = _Init_FileSystems();
 
@@ -265,6 +268,7 @@ void VProcess::_DeInit()
 	VFileKindManager::DeInit();
 	VFile::DeInit();
 	VProgressManager::Deinit();
+	VProfilerRegistry::DeInit();
 	XBOX::ReleaseRefCountable( &fIntlManager);
 
 	if (!fLogger.IsNull()) // ACI0086287 MoB: Crash with Python/ODBC
@@ -0,0 +1,316 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#include "VKernelPrecompiled.h"
+#include "VProfiler.h"
+#include "VTask.h"
+#include "VInterlocked.h"
+#include "VJSONValue.h"
+
+
+// same shard for all the records of a task
+static inline sLONG _GetShardIndex( sLONG inShardCount)
+{
+	return (sLONG) (((uLONG) VTask::GetCurrentID()) & (inShardCount - 1));
+}
+
+
+
+VProfilerCounter::VProfilerCounter()
+{
+	for (sLONG i = 0 ; i < kSHARD_COUNT ; ++i)
+		fShards[i].fValue = 0;
+}
+
+
+void VProfilerCounter::Add(sLONG8 inValue)
+{
+	VInterlocked::AtomicAdd(&fShards[_GetShardIndex(kSHARD_COUNT)].fValue, inValue);
+}
+
+
+sLONG8 VProfilerCounter::GetValue() const
+{
+	sLONG8 value = 0;
+
+	for (sLONG i = 0 ; i < kSHARD_COUNT ; ++i)
+		value += VInterlocked::AtomicAdd(const_cast<sLONG8*>(&fShards[i].fValue), 0);
+
+	return value;
+}
+
+
+void VProfilerCounter::Reset()
+{
+	for (sLONG i = 0 ; i < kSHARD_COUNT ; ++i)
+	{
+		sLONG8 value = VInterlocked::AtomicAdd(&fShards[i].fValue, 0);
+		VInterlocked::AtomicAdd(&fShards[i].fValue, -value);
+	}
+}
+
+
+
+VProfilerHistogram::VProfilerHistogram()
+{
+	::memset(fShards, 0, sizeof(fShards));
+}
+
+
+//static
+sLONG VProfilerHistogram::GetBucketIndex(sLONG8 inMicroseconds)
+{
+	if (inMicroseconds < kSUB_BUCKET_COUNT)
+		return (inMicroseconds < 0) ? 0 : (sLONG) inMicroseconds;
+
+	// position of the highest bit
+	uLONG8 value = (uLONG8) inMicroseconds;
+	sLONG exponent = 0;
+
+	if (value >= (XBOX_LONG8(1) << 32))	{ value >>= 32; exponent += 32; }
+	if (value >= (1 << 16))				{ value >>= 16; exponent += 16; }
+	if (value >= (1 << 8))				{ value >>= 8; exponent += 8; }
+	if (value >= (1 << 4))				{ value >>= 4; exponent += 4; }
+	if (value >= (1 << 2))				{ value >>= 2; exponent += 2; }
+	if (value >= (1 << 1))				{ exponent += 1; }
+
+	if (exponent > kMAX_EXPONENT)
+		return kBUCKET_COUNT - 1;
+
+	// the kSUB_BUCKET_BITS bits following the highest one select the sub-bucket
+	sLONG subBucket = (sLONG) (inMicroseconds >> (exponent - kSUB_BUCKET_BITS)) - kSUB_BUCKET_COUNT;
+
+	return kSUB_BUCKET_COUNT * (exponent - kSUB_BUCKET_BITS + 1) + subBucket;
+}
+
+
+//static
+sLONG8 VProfilerHistogram::GetBucketUpperBound(sLONG inIndex)
+{
+	if (inIndex < kSUB_BUCKET_COUNT)
+		return inIndex;
+
+	sLONG shift = inIndex / kSUB_BUCKET_COUNT - 1;
+	sLONG8 lowerBound = ((sLONG8) (kSUB_BUCKET_COUNT + inIndex % kSUB_BUCKET_COUNT)) << shift;
+
+	return lowerBound + (XBOX_LONG8(1) << shift) - 1;
+}
+
+
+void VProfilerHistogram::Record(sLONG8 inMicroseconds)
+{
+	Shard& shard = fShards[_GetShardIndex(kSHARD_COUNT)];
+
+	VInterlocked::Increment(&shard.fCounts[GetBucketIndex(inMicroseconds)]);
+	VInterlocked::AtomicAdd(&shard.fSum, inMicroseconds);
+
+	sLONG value = (inMicroseconds > kMAX_sLONG) ? kMAX_sLONG : (sLONG) inMicroseconds;
+	sLONG max = shard.fMax;
+	while (value > max)
+	{
+		sLONG previous = VInterlocked::CompareExchange(&shard.fMax, max, value);
+		if (previous == max)
+			break;
+		max = previous;
+	}
+}
+
+
+void VProfilerHistogram::GetSnapshot(Snapshot& outSnapshot) const
+{
+	std::vector<sLONG8> counts(kBUCKET_COUNT, 0);
+
+	outSnapshot.fCount = 0;
+	outSnapshot.fSum = 0;
+	outSnapshot.fMax = 0;
+
+	for (sLONG i = 0 ; i < kSHARD_COUNT ; ++i)
+	{
+		Shard& shard = const_cast<Shard&>(fShards[i]);
+
+		for (sLONG j = 0 ; j < kBUCKET_COUNT ; ++j)
+		{
+			sLONG count = VInterlocked::AtomicGet(&shard.fCounts[j]);
+			counts[j] += count;
+			outSnapshot.fCount += count;
+		}
+
+		outSnapshot.fSum += VInterlocked::AtomicAdd(&shard.fSum, 0);
+
+		sLONG max = VInterlocked::AtomicGet(&shard.fMax);
+		if (max > outSnapshot.fMax)
+			outSnapshot.fMax = max;
+	}
+
+	// percentiles are reported as the upper bound of their bucket
+	const Real percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	sLONG8* results[] = { &outSnapshot.fP50, &outSnapshot.fP90, &outSnapshot.fP99, &outSnapshot.fP999 };
+
+	sLONG8 cumulated = 0;
+	sLONG bucket = 0;
+	for (sLONG i = 0 ; i < 4 ; ++i)
+	{
+		sLONG8 rank = (sLONG8) (percentiles[i] * outSnapshot.fCount + 0.5);
+		if (rank < 1)
+			rank = 1;
+
+		if (outSnapshot.fCount == 0)
+		{
+			*results[i] = 0;
+			continue;
+		}
+
+		while (bucket < kBUCKET_COUNT - 1 && cumulated + counts[bucket] < rank)
+		{
+			cumulated += counts[bucket];
+			++bucket;
+		}
+
+		sLONG8 value = GetBucketUpperBound(bucket);
+		*results[i] = (value > outSnapshot.fMax) ? outSnapshot.fMax : value;
+	}
+}
+
+
+void VProfilerHistogram::Reset()
+{
+	for (sLONG i = 0 ; i < kSHARD_COUNT ; ++i)
+	{
+		Shard& shard = fShards[i];
+
+		for (sLONG j = 0 ; j < kBUCKET_COUNT ; ++j)
+			VInterlocked::Exchange(&shard.fCounts[j], 0);
+
+		sLONG8 sum = VInterlocked::AtomicAdd(&shard.fSum, 0);
+		VInterlocked::AtomicAdd(&shard.fSum, -sum);
+
+		VInterlocked::Exchange(&shard.fMax, 0);
+	}
+}
+
+
+
+VProfilerRegistry* VProfilerRegistry::sInstance = NULL;
+
+
+VProfilerRegistry::VProfilerRegistry()
+{
+}
+
+
+VProfilerRegistry::~VProfilerRegistry()
+{
+	for (std::map<VString, VProfilerCounter*>::iterator i = fCounters.begin() ; i != fCounters.end() ; ++i)
+		delete i->second;
+
+	for (std::map<VString, VProfilerHistogram*>::iterator i = fHistograms.begin() ; i != fHistograms.end() ; ++i)
+		delete i->second;
+}
+
+
+//static
+bool VProfilerRegistry::Init()
+{
+	if (sInstance == NULL)
+		sInstance = new VProfilerRegistry;
+
+	return sInstance != NULL;
+}
+
+
+//static
+void VProfilerRegistry::DeInit()
+{
+	delete sInstance;
+	sInstance = NULL;
+}
+
+
+//static
+VProfilerRegistry* VProfilerRegistry::Get()
+{
+	return sInstance;
+}
+
+
+VProfilerCounter* VProfilerRegistry::GetCounter(const VString& inName)
+{
+	StLocker<VCriticalSection> lock(&fMutex);
+
+	VProfilerCounter*& counter = fCounters[inName];
+	if (counter == NULL)
+		counter = new VProfilerCounter;
+
+	return counter;
+}
+
+
+VProfilerHistogram* VProfilerRegistry::GetHistogram(const VString& inName)
+{
+	StLocker<VCriticalSection> lock(&fMutex);
+
+	VProfilerHistogram*& histogram = fHistograms[inName];
+	if (histogram == NULL)
+		histogram = new VProfilerHistogram;
+
+	return histogram;
+}
+
+
+void VProfilerRegistry::Reset()
+{
+	StLocker<VCriticalSection> lock(&fMutex);
+
+	for (std::map<VString, VProfilerCounter*>::iterator i = fCounters.begin() ; i != fCounters.end() ; ++i)
+		i->second->Reset();
+
+	for (std::map<VString, VProfilerHistogram*>::iterator i = fHistograms.begin() ; i != fHistograms.end() ; ++i)
+		i->second->Reset();
+}
+
+
+void VProfilerRegistry::GetSnapshot(VJSONValue& outSnapshot) const
+{
+	VJSONValue counters(JSON_object);
+	VJSONValue histograms(JSON_object);
+
+	StLocker<VCriticalSection> lock(&fMutex);
+
+	for (std::map<VString, VProfilerCounter*>::const_iterator i = fCounters.begin() ; i != fCounters.end() ; ++i)
+		counters.SetProperty(i->first, VJSONValue((Real) i->second->GetValue()));
+
+	for (std::map<VString, VProfilerHistogram*>::const_iterator i = fHistograms.begin() ; i != fHistograms.end() ; ++i)
+	{
+		VProfilerHistogram::Snapshot snapshot;
+		i->second->GetSnapshot(snapshot);
+
+		VJSONValue histogram(JSON_object);
+
+		histogram.SetProperty(CVSTR("count"), VJSONValue((Real) snapshot.fCount));
+		histogram.SetProperty(CVSTR("sum"), VJSONValue((Real) snapshot.fSum));
+		histogram.SetProperty(CVSTR("mean"), VJSONValue((snapshot.fCount > 0) ? (Real) snapshot.fSum / snapshot.fCount : 0.0));
+		histogram.SetProperty(CVSTR("max"), VJSONValue((Real) snapshot.fMax));
+		histogram.SetProperty(CVSTR("p50"), VJSONValue((Real) snapshot.fP50));
+		histogram.SetProperty(CVSTR("p90"), VJSONValue((Real) snapshot.fP90));
+		histogram.SetProperty(CVSTR("p99"), VJSONValue((Real) snapshot.fP99));
+		histogram.SetProperty(CVSTR("p999"), VJSONValue((Real) snapshot.fP999));
+
+		histograms.SetProperty(i->first, histogram);
+	}
+
+	outSnapshot = VJSONValue(JSON_object);
+	outSnapshot.SetProperty(CVSTR("counters"), counters);
+	outSnapshot.SetProperty(CVSTR("histograms"), histograms);
+}
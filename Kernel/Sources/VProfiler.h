@@ -18,9 +18,13 @@
 
 #include "Kernel/Sources/VString.h"
 #include "Kernel/Sources/VAssert.h"
+#include "Kernel/Sources/VSyncObject.h"
 
 BEGIN_TOOLBOX_NAMESPACE
 
+class VJSONValue;
+class VProfilerHistogram;
+
 class XTOOLBOX_API VMicrosecondsCounter : public VObject
 {
 public:
@@ -64,6 +68,9 @@ public:
 	void	SetCounterName (const VString& inCounterName) { fCounterName = inCounterName; };
 	VString&	GetCounterName () { return fCounterName; };
 	
+	// each Stop() also records the duration in the histogram (see VProfilerRegistry)
+	void	SetHistogram (VProfilerHistogram* inHistogram) { fHistogram = inHistogram; };
+
 protected:
 #if VERSIONWIN
 	LARGE_INTEGER	fStartTime;
@@ -81,9 +88,157 @@ protected:
 	Real	fTotal;
 	Boolean	fDebugDumpOnDelete;
 	VString	fCounterName;
+	VProfilerHistogram*	fHistogram;
 	void _message(const VString& inCounterName);
 };
 
+
+/*
+	Counters and histograms shared by all tasks, to be read from a running server.
+
+	Increments never lock: values are split in kSHARD_COUNT cache line aligned shards and each task
+	always uses the same shard (from its task id). Readers sum the shards.
+*/
+
+class XTOOLBOX_API VProfilerCounter : public VObject
+{
+public:
+	enum { kSHARD_COUNT = 16 };
+
+			VProfilerCounter ();
+
+	void	Add (sLONG8 inValue);
+	void	Increment () { Add(1); };
+
+	sLONG8	GetValue () const;
+	void	Reset ();
+
+private:
+	typedef struct Shard
+	{
+		sLONG8	fValue;
+		char	fPadding[56];
+	} Shard;
+
+	Shard	fShards[kSHARD_COUNT];
+};
+
+
+/*
+	Latency histogram in microseconds with HDR like buckets: values below kSUB_BUCKET_COUNT have their own bucket,
+	then each power of 2 range is split in kSUB_BUCKET_COUNT linear buckets (about 6% relative error).
+	Values above 2^kMAX_EXPONENT microseconds (about 19 hours) go to the last bucket.
+*/
+
+class XTOOLBOX_API VProfilerHistogram : public VObject
+{
+public:
+	enum
+	{
+		kSHARD_COUNT		= 8,
+		kSUB_BUCKET_BITS	= 4,
+		kSUB_BUCKET_COUNT	= 1 << kSUB_BUCKET_BITS,
+		kMAX_EXPONENT		= 36,
+		kBUCKET_COUNT		= kSUB_BUCKET_COUNT * (kMAX_EXPONENT - kSUB_BUCKET_BITS + 2)
+	};
+
+	typedef struct Snapshot
+	{
+		sLONG8	fCount;
+		sLONG8	fSum;
+		sLONG8	fMax;
+		sLONG8	fP50;
+		sLONG8	fP90;
+		sLONG8	fP99;
+		sLONG8	fP999;
+	} Snapshot;
+
+			VProfilerHistogram ();
+
+	void	Record (sLONG8 inMicroseconds);
+
+	void	GetSnapshot (Snapshot& outSnapshot) const;
+	void	Reset ();
+
+	static	sLONG	GetBucketIndex (sLONG8 inMicroseconds);
+	static	sLONG8	GetBucketUpperBound (sLONG inIndex);
+
+private:
+	typedef struct Shard
+	{
+		sLONG8	fSum;
+		sLONG	fMax;	// microseconds, saturated
+		sLONG	fCounts[kBUCKET_COUNT];
+		char	fPadding[64];
+	} Shard;
+
+	Shard	fShards[kSHARD_COUNT];
+};
+
+
+/*
+	Named counters and histograms. They are created on first use and live until the process ends, so callers
+	may keep the returned pointers (typically in a static).
+
+	static VProfilerHistogram* sHistogram = VProfilerRegistry::Get()->GetHistogram( CVSTR( "ServerNet.read"));
+	{
+		StProfilerTimer timer( sHistogram);
+		...
+	}
+*/
+
+class XTOOLBOX_API VProfilerRegistry : public VObject
+{
+public:
+	static	bool					Init ();
+	static	void					DeInit ();
+	static	VProfilerRegistry*		Get ();
+
+	VProfilerCounter*				GetCounter (const VString& inName);
+	VProfilerHistogram*				GetHistogram (const VString& inName);
+
+	void							Reset ();
+
+	// { "counters": { name: value, ... }, "histograms": { name: { "count", "sum", "mean", "max", "p50", "p90", "p99", "p999" }, ... } }
+	// histogram values are in microseconds.
+	void							GetSnapshot (VJSONValue& outSnapshot) const;
+
+private:
+									VProfilerRegistry ();
+	virtual							~VProfilerRegistry ();
+
+	static	VProfilerRegistry*		sInstance;
+
+	mutable	VCriticalSection						fMutex;
+			std::map<VString, VProfilerCounter*>	fCounters;
+			std::map<VString, VProfilerHistogram*>	fHistograms;
+};
+
+
+/*
+	Records the time spent in its scope. Does nothing if the histogram is NULL.
+*/
+
+class XTOOLBOX_API StProfilerTimer
+{
+public:
+			StProfilerTimer (VProfilerHistogram* inHistogram) : fHistogram(inHistogram)
+			{
+				if (fHistogram != NULL)
+					fCounter.Start();
+			}
+
+			~StProfilerTimer ()
+			{
+				if (fHistogram != NULL)
+					fHistogram->Record(fCounter.Stop());
+			}
+
+private:
+	VProfilerHistogram*		fHistogram;
+	VMicrosecondsCounter	fCounter;
+};
+
 END_TOOLBOX_NAMESPACE
 
 #endif
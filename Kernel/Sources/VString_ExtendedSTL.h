@@ -241,15 +241,19 @@ namespace hash_VString
 	mymap	map;
 	map.insert( mymap::value_type( "hello", 1));
 */
-template<class Value>
-class unordered_map_VString : public NAMESPACE_TR1::unordered_map<XBOX::VString,Value,XBOX::hash_VString::hash, XBOX::hash_VString::equal_to>
+template<class Value, class Alloc = std::allocator<std::pair<const XBOX::VString, Value> > >
+class unordered_map_VString : public NAMESPACE_TR1::unordered_map<XBOX::VString,Value,XBOX::hash_VString::hash, XBOX::hash_VString::equal_to, Alloc>
 {
 public:
 	unordered_map_VString( size_t inBuckets = 10)
-		: NAMESPACE_TR1::unordered_map<VString,Value,hash_VString::hash, hash_VString::equal_to>( inBuckets, hash_VString::hash(), hash_VString::equal_to()) {}
+		: NAMESPACE_TR1::unordered_map<VString,Value,hash_VString::hash, hash_VString::equal_to, Alloc>( inBuckets, hash_VString::hash(), hash_VString::equal_to()) {}
+
+	// for stateful allocators like VArenaAllocator
+	unordered_map_VString( size_t inBuckets, const Alloc& inAllocator)
+		: NAMESPACE_TR1::unordered_map<VString,Value,hash_VString::hash, hash_VString::equal_to, Alloc>( inBuckets, hash_VString::hash(), hash_VString::equal_to(), inAllocator) {}
 
 	template <typename InputIterator>
-	unordered_map_VString( InputIterator begin, InputIterator end) : NAMESPACE_TR1::unordered_map<VString,Value,hash_VString::hash, hash_VString::equal_to>( begin, end) {}
+	unordered_map_VString( InputIterator begin, InputIterator end) : NAMESPACE_TR1::unordered_map<VString,Value,hash_VString::hash, hash_VString::equal_to, Alloc>( begin, end) {}
 };
 
 template<class Value>
@@ -23,6 +23,22 @@
 
 #include "VCharSetNames.h"
 
+// SSE2 is always there on x86_64, AVX2 is checked at runtime
+#if ARCH_386 && (ARCH_64 || defined(__SSE2__) || (COMPIL_VISUAL && defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+	#define WITH_SSE2_TRANSCODING	1
+	#include <emmintrin.h>
+	#if ARCH_64
+		#define WITH_AVX2_TRANSCODING	1
+		#include <immintrin.h>
+		#if COMPIL_VISUAL
+			#include <intrin.h>
+			#define AVX2_TARGET
+		#else
+			#define AVX2_TARGET		__attribute__((target("avx2")))
+		#endif
+	#endif
+#endif
+
 VTextConverters*		VTextConverters::sInstance = NULL;
 
 
@@ -661,6 +677,226 @@ bool VFromUnicodeConverter_Void::IsValid() const
 }
 
 
+// ---------------------------------------------------------------------------
+//  ASCII runs
+//
+//	Most of the text going through the UTF-8 converters is plain ASCII
+//	(HTTP headers, JSON, source code). The runs are copied by blocks,
+//	using SSE2 or AVX2 when available, and the converters fall back to
+//	one code point at a time on the first non ASCII char.
+//
+//	All the functions return the count of leading ASCII chars that have
+//	been copied. The destination of the narrowing ones may be NULL.
+// ---------------------------------------------------------------------------
+
+static VSize _WidenASCII_Scalar( const uBYTE *inSource, UniChar *outDest, VSize inCount)
+{
+	VSize i = 0;
+
+	for ( ; i + 8 <= inCount ; i += 8)
+	{
+		uLONG8 block;
+		::memcpy( &block, inSource + i, 8);
+		if ((block & XBOX_LONG8(0x8080808080808080)) != 0)
+			break;
+		for (VSize j = i ; j < i + 8 ; ++j)
+			outDest[j] = (UniChar) inSource[j];
+	}
+
+	for ( ; (i < inCount) && (inSource[i] < 0x80) ; ++i)
+		outDest[i] = (UniChar) inSource[i];
+
+	return i;
+}
+
+
+static VSize _NarrowASCII_Scalar( const UniChar *inSource, uBYTE *outDest, VSize inCount)
+{
+	VSize i = 0;
+
+	if (outDest == NULL)
+	{
+		while ( (i < inCount) && (inSource[i] < 0x80) )
+			++i;
+	}
+	else
+	{
+		for ( ; (i < inCount) && (inSource[i] < 0x80) ; ++i)
+			outDest[i] = (uBYTE) inSource[i];
+	}
+
+	return i;
+}
+
+
+#if WITH_SSE2_TRANSCODING
+
+static VSize _WidenASCII_SSE2( const uBYTE *inSource, UniChar *outDest, VSize inCount)
+{
+	VSize i = 0;
+	const __m128i zero = _mm_setzero_si128();
+
+	for ( ; i + 16 <= inCount ; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128( (const __m128i*) (inSource + i));
+		if (_mm_movemask_epi8( bytes) != 0)
+			break;
+		_mm_storeu_si128( (__m128i*) (outDest + i), _mm_unpacklo_epi8( bytes, zero));
+		_mm_storeu_si128( (__m128i*) (outDest + i + 8), _mm_unpackhi_epi8( bytes, zero));
+	}
+
+	return i + _WidenASCII_Scalar( inSource + i, outDest + i, inCount - i);
+}
+
+
+static VSize _NarrowASCII_SSE2( const UniChar *inSource, uBYTE *outDest, VSize inCount)
+{
+	VSize i = 0;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i nonASCII = _mm_set1_epi16( (short) 0xFF80);
+
+	for ( ; i + 8 <= inCount ; i += 8)
+	{
+		__m128i chars = _mm_loadu_si128( (const __m128i*) (inSource + i));
+		if (_mm_movemask_epi8( _mm_cmpeq_epi16( _mm_and_si128( chars, nonASCII), zero)) != 0xFFFF)
+			break;
+		if (outDest != NULL)
+			_mm_storel_epi64( (__m128i*) (outDest + i), _mm_packus_epi16( chars, chars));
+	}
+
+	return i + _NarrowASCII_Scalar( inSource + i, (outDest != NULL) ? outDest + i : NULL, inCount - i);
+}
+
+#endif
+
+
+#if WITH_AVX2_TRANSCODING
+
+AVX2_TARGET static VSize _WidenASCII_AVX2( const uBYTE *inSource, UniChar *outDest, VSize inCount)
+{
+	VSize i = 0;
+
+	for ( ; i + 32 <= inCount ; i += 32)
+	{
+		__m256i bytes = _mm256_loadu_si256( (const __m256i*) (inSource + i));
+		if (_mm256_movemask_epi8( bytes) != 0)
+			break;
+		_mm256_storeu_si256( (__m256i*) (outDest + i), _mm256_cvtepu8_epi16( _mm256_castsi256_si128( bytes)));
+		_mm256_storeu_si256( (__m256i*) (outDest + i + 16), _mm256_cvtepu8_epi16( _mm256_extracti128_si256( bytes, 1)));
+	}
+
+	return i + _WidenASCII_SSE2( inSource + i, outDest + i, inCount - i);
+}
+
+
+AVX2_TARGET static VSize _NarrowASCII_AVX2( const UniChar *inSource, uBYTE *outDest, VSize inCount)
+{
+	VSize i = 0;
+	const __m256i nonASCII = _mm256_set1_epi16( (short) 0xFF80);
+
+	for ( ; i + 16 <= inCount ; i += 16)
+	{
+		__m256i chars = _mm256_loadu_si256( (const __m256i*) (inSource + i));
+		if (!_mm256_testz_si256( chars, nonASCII))
+			break;
+		if (outDest != NULL)
+		{
+			// packus works per 128 bits lane, gather the low quadword of each lane
+			__m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi16( chars, chars), 0xD8);
+			_mm_storeu_si128( (__m128i*) (outDest + i), _mm256_castsi256_si128( packed));
+		}
+	}
+
+	return i + _NarrowASCII_SSE2( inSource + i, (outDest != NULL) ? outDest + i : NULL, inCount - i);
+}
+
+
+static bool _CPUHasAVX2()
+{
+#if COMPIL_VISUAL
+	int info[4];
+	__cpuid( info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// the OS must save the ymm registers
+	__cpuid( info, 1);
+	if ( ((info[2] & (1 << 27)) == 0) || ((_xgetbv( 0) & 6) != 6) )
+		return false;
+
+	__cpuidex( info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx2") != 0;
+#endif
+}
+
+#endif
+
+
+typedef VSize (*WidenASCIIProc)( const uBYTE *inSource, UniChar *outDest, VSize inCount);
+typedef VSize (*NarrowASCIIProc)( const UniChar *inSource, uBYTE *outDest, VSize inCount);
+
+static WidenASCIIProc	sWidenASCII = NULL;
+static NarrowASCIIProc	sNarrowASCII = NULL;
+
+
+static void _InitASCIIProcs()
+{
+	// called by VTextConverters constructor, before any thread may need them
+	WidenASCIIProc widen = _WidenASCII_Scalar;
+	NarrowASCIIProc narrow = _NarrowASCII_Scalar;
+
+#if WITH_SSE2_TRANSCODING
+	widen = _WidenASCII_SSE2;
+	narrow = _NarrowASCII_SSE2;
+#endif
+
+#if WITH_AVX2_TRANSCODING
+	if (_CPUHasAVX2())
+	{
+		widen = _WidenASCII_AVX2;
+		narrow = _NarrowASCII_AVX2;
+	}
+#endif
+
+	sNarrowASCII = narrow;
+	sWidenASCII = widen;
+}
+
+
+static inline VSize _WidenASCII( const uBYTE *inSource, UniChar *outDest, VSize inCount)
+{
+	if (sWidenASCII == NULL)
+		_InitASCIIProcs();
+	return sWidenASCII( inSource, outDest, inCount);
+}
+
+
+template <class T>
+static inline VSize _NarrowASCII( const T *inSource, uBYTE *outDest, VSize inCount)
+{
+	// wchar_t may be 32 bits wide
+	VSize i = 0;
+	for ( ; (i < inCount) && (static_cast<uLONG>( inSource[i]) < 0x80) ; ++i)
+	{
+		if (outDest != NULL)
+			outDest[i] = (uBYTE) inSource[i];
+	}
+	return i;
+}
+
+
+template <>
+inline VSize _NarrowASCII<UniChar>( const UniChar *inSource, uBYTE *outDest, VSize inCount)
+{
+	if (sNarrowASCII == NULL)
+		_InitASCIIProcs();
+	return sNarrowASCII( inSource, outDest, inCount);
+}
+
+
 // ---------------------------------------------------------------------------
 //  XMLUTF8Transcoder: Implementation of the transcoder API
 //	From Xerces
@@ -691,56 +927,82 @@ bool VToUnicodeConverter_UTF8::Convert(const void* inSource, VSize inSourceBytes
 		// Special-case ASCII, which is a leading byte value of <= 127
 		if (firstByte <= 127)
 		{
-			*outPtr++ = UniChar(firstByte);
-			srcPtr++;
+			VSize count = Min( (VSize) (srcEnd - srcPtr), (VSize) (outEnd - outPtr));
+			VSize copied = _WidenASCII( srcPtr, outPtr, count);
+			srcPtr += copied;
+			outPtr += copied;
 			continue;
 		}
 
-		// See how many trailing src bytes this sequence is going to require
+		// See how many trailing src bytes this sequence is going to require.
+		// A trailing byte cannot start a sequence, C0 and C1 only start overlong sequences,
+		// and F5 to FF would encode code points above 0x10FFFF.
 		const unsigned int trailingBytes = sUTFBytes[firstByte];
+		if ( (trailingBytes == 0) || (firstByte < 0xC2) || (firstByte > 0xF4) )
+		{
+			*outPtr++ = 0xFFFD;
+			++srcPtr;
+			continue;
+		}
 
+		// The second byte range also excludes overlong forms, surrogates and code points above 0x10FFFF,
+		// so that any sequence whose trailing bytes are in range is valid.
+		uBYTE secondMin = 0x80;
+		uBYTE secondMax = 0xBF;
+		switch(firstByte)
+		{
+			case 0xE0 : secondMin = 0xA0; break;
+			case 0xED : secondMax = 0x9F; break;
+			case 0xF0 : secondMin = 0x90; break;
+			case 0xF4 : secondMax = 0x8F; break;
+		}
+
+		// An invalid sequence is replaced by one U+FFFD per maximal subpart (the lead byte and the
+		// trailing bytes that were in range), and the conversion goes on with the byte that broke it.
 		//
-		//  If there are not enough source bytes to do this one, then we
-		//  are done. Note that we done >= here because we are implicitly
-		//  counting the 1 byte we get no matter what.
-		//
-		//  If we break out here, then there is nothing to undo since we
-		//  haven't updated any pointers yet.
-		//
-		if (srcPtr + trailingBytes >= srcEnd)
-			break;
+		// If the buffer ends before the sequence does, then we are done and the sequence is left
+		// for next time. Nothing to undo since we haven't updated any pointers yet.
+		unsigned int validBytes = 1;
+		while (validBytes <= trailingBytes)
+		{
+			if (srcPtr + validBytes >= srcEnd)
+				break;
+			const uBYTE trailingByte = srcPtr[validBytes];
+			if ( (validBytes == 1) ? ((trailingByte < secondMin) || (trailingByte > secondMax)) : ((trailingByte & 0xC0) != 0x80) )
+				break;
+			++validBytes;
+		}
+
+		if (validBytes <= trailingBytes)
+		{
+			if (srcPtr + validBytes >= srcEnd)
+				break;
+
+			*outPtr++ = 0xFFFD;
+			srcPtr += validBytes;
+			continue;
+		}
 
 		// Looks ok, so lets build up the value
 		uLONG tmpVal = 0;
 		switch(trailingBytes)
 		{
-			case 5 : tmpVal += *srcPtr++; tmpVal <<= 6;
-			case 4 : tmpVal += *srcPtr++; tmpVal <<= 6;
-			case 3 : tmpVal += *srcPtr++; tmpVal <<= 6;
-			case 2 : tmpVal += *srcPtr++; tmpVal <<= 6;
-			case 1 : tmpVal += *srcPtr++; tmpVal <<= 6;
-			case 0 : tmpVal += *srcPtr++;
+			case 3 : tmpVal += srcPtr[trailingBytes - 3]; tmpVal <<= 6;
+			case 2 : tmpVal += srcPtr[trailingBytes - 2]; tmpVal <<= 6;
+			case 1 : tmpVal += srcPtr[trailingBytes - 1]; tmpVal <<= 6;
+					 tmpVal += srcPtr[trailingBytes];
 					 break;
-
-			default :
-				isOK = false;
-				goto failure;
 		}
 		tmpVal -= sUTFOffsets[trailingBytes];
 
 		//
 		//  If it will fit into a single char, then put it in. Otherwise
-		//  encode it as a surrogate pair. If its not valid, use the
-		//  replacement char.
+		//  encode it as a surrogate pair.
 		//
 		if (!(tmpVal & 0xFFFF0000))
 		{
 			*outPtr++ = UniChar(tmpVal);
-		}
-		else if (tmpVal > 0x10FFFF)
-		{
-			isOK = false;
-			goto failure;
+			srcPtr += trailingBytes + 1;
 		}
 		else
 		{
@@ -754,6 +1016,8 @@ bool VToUnicodeConverter_UTF8::Convert(const void* inSource, VSize inSourceBytes
 			if (outPtr + 1 >= outEnd)
 				break;
 
+			srcPtr += trailingBytes + 1;
+
 			// Store the leading surrogate char
 			tmpVal -= 0x10000;
 			*outPtr++ = UniChar((tmpVal >> 10) + 0xD800);
@@ -767,7 +1031,6 @@ bool VToUnicodeConverter_UTF8::Convert(const void* inSource, VSize inSourceBytes
 		}
 	}
 
-failure:
 	// Update the bytes eaten
 	*outBytesConsumed = srcPtr - (uBYTE *) inSource;
 
@@ -796,6 +1059,18 @@ static bool _Convert(const T* inSource, VIndex inSourceChars, VIndex *outCharsCo
 
     while (srcPtr < srcEnd)
     {
+		// copy the ASCII runs by blocks
+		if (static_cast<uLONG>( *srcPtr) < 0x80)
+		{
+			VSize count = Min( (VSize) (srcEnd - srcPtr), (VSize) (outEnd - outPtr));
+			if (count == 0)
+				break;
+			VSize copied = _NarrowASCII( srcPtr, (inBuffer != NULL) ? outPtr : NULL, count);
+			srcPtr += copied;
+			outPtr += copied;
+			continue;
+		}
+
         //
         //  Tentatively get the next char out. We have to get it into a
         //  32 bit value, because it could be a surrogate pair.
@@ -812,11 +1087,24 @@ static bool _Convert(const T* inSource, VIndex inSourceChars, VIndex *outCharsCo
             if (srcPtr + 1 >= srcEnd)
                 break;
 
-            // Create the composite surrogate pair
-            curVal = ((curVal - 0xD800) << 10) + ((*(srcPtr + 1) - 0xDC00) + 0x10000);
-
-            // And indicate that we ate another one
-            srcUsed++;
+            uLONG nextVal = static_cast<uLONG>( *(srcPtr + 1));
+            if ((nextVal >= 0xDC00) && (nextVal <= 0xDFFF))
+            {
+                // Create the composite surrogate pair
+                curVal = ((curVal - 0xD800) << 10) + ((nextVal - 0xDC00) + 0x10000);
+
+                // And indicate that we ate another one
+                srcUsed++;
+            }
+            else
+            {
+                // unpaired surrogate: would produce invalid UTF-8
+                curVal = 0xFFFD;
+            }
+        }
+        else if ((curVal >= 0xDC00) && (curVal <= 0xDFFF))
+        {
+            curVal = 0xFFFD;
         }
 
         // Figure out how many bytes we need
@@ -927,6 +1215,8 @@ VTextConverters *VTextConverters::Get()
 
 VTextConverters::VTextConverters()
 {
+	_InitASCIIProcs();
+
 	fFromUniConverter = XIntlMgrImpl::NewFromUnicodeConverter( VTC_SystemCharset);
 	fToUniConverter = XIntlMgrImpl::NewToUnicodeConverter( VTC_SystemCharset);
 
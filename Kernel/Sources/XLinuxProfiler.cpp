@@ -26,6 +26,7 @@
 
 
 VProfilingCounter::VProfilingCounter(const VString* inCounterName, Boolean inStartNow, Boolean inDebugDumpOnDelete)
+: fHistogram(NULL)
 {
 	fFrequency = 1000000L;
 	fDebugDumpOnDelete = inDebugDumpOnDelete;
@@ -83,6 +84,9 @@ void VProfilingCounter::Stop(Boolean inDebugDump)
 	fTotal += duration;
 	fNbVal++;
 	
+	if (fHistogram != NULL)
+		fHistogram->Record((sLONG8) duration);
+	
 	if (inDebugDump)
 		DumpDuration();
 }
@@ -18,6 +18,7 @@
 
 
 VProfilingCounter::VProfilingCounter(const VString* inCounterName, Boolean inStartNow, Boolean inDebugDumpOnDelete)
+: fHistogram(NULL)
 {
 	fFrequency = 1000000L;
 	fDebugDumpOnDelete = inDebugDumpOnDelete;
@@ -63,6 +64,9 @@ void VProfilingCounter::Stop(Boolean inDebugDump)
 	fTotal += duration;
 	fNbVal++;
 	
+	if (fHistogram != NULL)
+		fHistogram->Record((sLONG8) duration);
+	
 	if (inDebugDump)
 		DumpDuration();
 }
@@ -50,6 +50,8 @@
 #include "Kernel/Sources/VPictureHelper.h"
 #include "Kernel/Sources/VJSONTools.h"
 #include "Kernel/Sources/VJSONValue.h"
+#include "Kernel/Sources/VJSONStreamParser.h"
+#include "Kernel/Sources/VJSONBlob.h"
 #include "Kernel/Sources/VLogger.h"
 #include "Kernel/Sources/VLog4jMsgFile.h"
 #include "Kernel/Sources/VTextStyle.h"
@@ -85,6 +87,7 @@
 #include "Kernel/Sources/VDebugBlockInfo.h"
 #include "Kernel/Sources/VLeaks.h"
 #include "Kernel/Sources/VMemoryCpp.h"
+#include "Kernel/Sources/VArena.h"
 #include "Kernel/Sources/VMemorySlot.h"
 #include "Kernel/Sources/VStackCrawl.h"
 #include "Kernel/Sources/VMemoryWalker.h"
@@ -29,6 +29,13 @@
 	#include <functional>
 #endif
 
+#if VERSION_LINUX
+	#include <sys/epoll.h>
+	#include <sys/eventfd.h>
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
 
 BEGIN_TOOLBOX_NAMESPACE
 
@@ -36,10 +43,57 @@ BEGIN_TOOLBOX_NAMESPACE
 using namespace ServerNetTools;
 
 
-VTCPSelectIOPool::VTCPSelectIOPool ( ) :
+// Pin calling thread to a processor, handlers call it at start of DoRun(). Return false if not supported.
+
+static bool _PinCurrentThread (sLONG inCPUIndex)
+{
+#if VERSION_LINUX
+	if (inCPUIndex < 0 || inCPUIndex >= CPU_SETSIZE)
+
+		return false;
+
+	cpu_set_t	cpuSet;
+
+	CPU_ZERO(&cpuSet);
+	CPU_SET(inCPUIndex, &cpuSet);
+
+	return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+	return false;
+#endif
+}
+
+// Recompute callbacks per second when a second or more has elapsed since last computation.
+
+static void _UpdateCallbackRate (sLONG8 inCallbackCount, sLONG8& ioRateStartCount, uLONG& ioRateStartTime, Real& ioCallbacksPerSecond)
+{
+	uLONG	currentTime	= VSystem::GetCurrentTime();
+	uLONG	elapsed		= currentTime - ioRateStartTime;
+
+	if (elapsed >= 1000) {
+
+		ioCallbacksPerSecond = (Real) (inCallbackCount - ioRateStartCount) * 1000.0 / (Real) elapsed;
+		ioRateStartCount = inCallbackCount;
+		ioRateStartTime = currentTime;
+
+	}
+}
+
+
+VTCPSelectIOPool::VTCPSelectIOPool (sLONG inBackend) :
 fHandlerList ( )
 {
-	
+	xbox_assert(inBackend == eBACKEND_SELECT || inBackend == eBACKEND_EPOLL);
+
+#if VERSION_LINUX
+	fBackend = inBackend;
+#else
+	fBackend = eBACKEND_SELECT;
+#endif
+
+	fShardCount = 0;
+	fShardPolicy = ePOLICY_LEAST_LOADED;
+	fPinToCPU = false;
 }
 
 VTCPSelectIOPool::~VTCPSelectIOPool ( )
@@ -47,6 +101,34 @@ VTCPSelectIOPool::~VTCPSelectIOPool ( )
 	Close ( );
 }
 
+VError VTCPSelectIOPool::SetSharding (sLONG inShardCount, sLONG inPolicy, bool inPinToCPU)
+{
+	xbox_assert(inShardCount >= 0);
+	xbox_assert(inPolicy == ePOLICY_LEAST_LOADED || inPolicy == ePOLICY_HASH);
+
+	if ( !fHandlersLock. Lock ( ) )
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	VError	vError	= VE_OK;
+
+	if (!fHandlerList.empty())
+
+		vError = VE_SRVR_INVALID_INTERNAL_STATE;
+
+	else {
+
+		fShardCount = inShardCount > 0 ? inShardCount : VSystem::GetNumberOfProcessors();
+		fShardPolicy = inPolicy;
+		fPinToCPU = inPinToCPU;
+
+	}
+
+	if ( !fHandlersLock. Unlock ( ) && vError == VE_OK )
+		vError = VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	return vError;
+}
+
 CTCPSelectIOHandler* VTCPSelectIOPool::AddSocketForReading ( VEndPoint* inEndPoint, VError& outError )
 {
 	return _AddSocket(inEndPoint, NULL, NULL, outError);
@@ -80,8 +162,31 @@ CTCPSelectIOHandler	*VTCPSelectIOPool::_AddSocket (VEndPoint *inEndPoint, void *
 	}
 	
 	CTCPSelectIOHandler*							sioHandler = 0;
-	std::list<CTCPSelectIOHandler*>::iterator		iterHandler = fHandlerList. begin ( );
-	while ( iterHandler != fHandlerList. end ( ) )
+
+	if ( fShardCount > 0 )
+	{
+		// Try the shard given by policy first. If it refuses the socket (full select() set), fall back 
+		// to the first handler that accepts it.
+
+		CTCPSelectIOHandler*		shard = _SelectShard ( vtcpEndPoint-> GetRawSocket ( ) );
+
+		if (inCallback == NULL) {
+
+			if (shard->AddSocketForReading(vtcpEndPoint->GetRawSocket(), sslDelegate) == VE_OK)
+
+				sioHandler = shard;
+
+		} else {
+
+			if (shard->AddSocketForWatching(vtcpEndPoint->GetRawSocket(), inEndPoint, inData, inCallback) == VE_OK)
+
+				sioHandler = shard;
+
+		}
+	}
+
+	std::vector<CTCPSelectIOHandler*>::iterator		iterHandler = fHandlerList. begin ( );
+	while ( sioHandler == 0 && iterHandler != fHandlerList. end ( ) )
 	{
 		if (*iterHandler) { 
 			
@@ -111,8 +216,7 @@ CTCPSelectIOHandler	*VTCPSelectIOPool::_AddSocket (VEndPoint *inEndPoint, void *
 	
 	if ( !sioHandler )
 	{
-		VTCPSelectIOHandler*		vioh = new VTCPSelectIOHandler ( );
-		vioh-> Run ( );
+		CTCPSelectIOHandler*		vioh = _NewHandler ( );
 		
 		if (inCallback == NULL)
 			
@@ -133,12 +237,100 @@ CTCPSelectIOHandler	*VTCPSelectIOPool::_AddSocket (VEndPoint *inEndPoint, void *
 	return sioHandler;
 }
 
+CTCPSelectIOHandler *VTCPSelectIOPool::_NewHandler (sLONG inCPUIndex)
+{
+#if VERSION_LINUX
+	if (fBackend == eBACKEND_EPOLL) {
+
+		VTCPEPollIOHandler	*epollHandler	= new VTCPEPollIOHandler();
+
+		if (epollHandler->IsValid()) {
+
+			epollHandler->SetCPUAffinity(inCPUIndex);
+			epollHandler->Run();
+			return epollHandler;
+
+		}
+
+		// Can't create epoll instance (out of file descriptors?), use select() for this handler.
+
+		epollHandler->Release();
+
+	}
+#endif
+
+	VTCPSelectIOHandler		*selectHandler	= new VTCPSelectIOHandler();
+
+	selectHandler->SetCPUAffinity(inCPUIndex);
+	selectHandler->Run();
+
+	return selectHandler;
+}
+
+CTCPSelectIOHandler *VTCPSelectIOPool::_SelectShard (Socket inRawSocket)
+{
+	xbox_assert(fShardCount > 0);
+
+	// Shards are created together, on first socket.
+
+	if (fHandlerList.empty()) {
+
+		sLONG	cpuCount	= VSystem::GetNumberOfProcessors();
+
+		for (sLONG i = 0; i < fShardCount; i++)
+
+			fHandlerList.push_back(_NewHandler(fPinToCPU && cpuCount > 0 ? i % cpuCount : -1));
+
+	}
+
+	if (fShardPolicy == ePOLICY_HASH)
+
+		return fHandlerList[(uLONG) inRawSocket % (uLONG) fShardCount];
+
+	CTCPSelectIOHandler		*leastLoaded	= NULL;
+	sLONG					minSocketCount	= 0;
+
+	for (sLONG i = 0; i < fShardCount; i++) {
+
+		VTCPSelectIOStatistics	statistics;
+
+		fHandlerList[i]->GetStatistics(statistics);
+		if (leastLoaded == NULL || statistics.fSocketCount < minSocketCount) {
+
+			leastLoaded = fHandlerList[i];
+			minSocketCount = statistics.fSocketCount;
+
+		}
+
+	}
+
+	return leastLoaded;
+}
+
+VError VTCPSelectIOPool::GetStatistics (std::vector<VTCPSelectIOStatistics>& outStatistics)
+{
+	outStatistics.clear();
+
+	if ( !fHandlersLock. Lock ( ) )
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	outStatistics.resize(fHandlerList.size());
+	for (size_t i = 0; i < fHandlerList.size(); i++)
+
+		fHandlerList[i]->GetStatistics(outStatistics[i]);
+
+	if ( !fHandlersLock. Unlock ( ) )
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	return VE_OK;
+}
+
 VError VTCPSelectIOPool::Close ( )
 {
 	if ( !fHandlersLock. Lock ( ) )
 		return VE_SRVR_FAILED_TO_SYNC_LOCK;
 	
-	std::list<CTCPSelectIOHandler*>::iterator		iterHandler = fHandlerList. begin ( );
+	std::vector<CTCPSelectIOHandler*>::iterator		iterHandler = fHandlerList. begin ( );
 	while ( iterHandler != fHandlerList. end ( ) )
 	{
 		if ( *iterHandler )
@@ -232,11 +424,14 @@ bool VTCPSelectReadAction::NotifyActionComplete ( )
 
 void VTCPSelectReadAction::DoAction (fd_set* fdSockets)
 {
-	int	nRawSocket	= GetRawSocket();
+	if (FD_ISSET(GetRawSocket(), fdSockets))
 
-	if (!FD_ISSET(nRawSocket, fdSockets))
+		DoReadyAction();
+}
 
-		return;
+void VTCPSelectReadAction::DoReadyAction ()
+{
+	int	nRawSocket	= GetRawSocket();
 
 	if (IsProcessed())
 
@@ -293,10 +488,13 @@ void VTCPSelectReadAction::DoAction (fd_set* fdSockets)
 
 void VTCPSelectReadAction::HandleError (fd_set* fdSockets)
 {
-	int	nRawSocket = GetRawSocket ( );
+	if (FD_ISSET ( GetRawSocket ( ), fdSockets ))
+		HandleReadyError ( );
+}
 
-	if (!FD_ISSET ( nRawSocket, fdSockets ))
-		return;
+void VTCPSelectReadAction::HandleReadyError ()
+{
+	int	nRawSocket = GetRawSocket ( );
 
 	if (IsProcessed())
 	
@@ -344,26 +542,28 @@ void VTCPSelectWatchAction::DoAction (fd_set* fdSockets)
 {
 	xbox_assert(GetType() == VTCPSelectAction::eTYPE_WATCH);
 
-	if (!FD_ISSET(GetRawSocket(), fdSockets))
+	if (FD_ISSET(GetRawSocket(), fdSockets))
 
-		return;
-		
-	else {		
-	
-		if (!TriggerReadCallback(0))
+		DoReadyAction();
+}
 
-			SetLastError(VE_SRVR_READ_FAILED);	// May be not a failed read, but this will prevent select() to check this socket.
+void VTCPSelectWatchAction::DoReadyAction ()
+{
+	if (!TriggerReadCallback(0))
 
-	}
+		SetLastError(VE_SRVR_READ_FAILED);	// May be not a failed read, but this will prevent select() to check this socket.
 }
 
 void VTCPSelectWatchAction::HandleError (fd_set* fdSockets)
 {
-	int	nRawSocket = GetRawSocket();
+	if (FD_ISSET(GetRawSocket(), fdSockets))
 
-	if (!FD_ISSET(nRawSocket, fdSockets))
+		HandleReadyError();
+}
 
-		return;
+void VTCPSelectWatchAction::HandleReadyError ()
+{
+	int	nRawSocket = GetRawSocket();
 
 	int				nError = 0;
 #if VERSIONWIN
@@ -393,6 +593,11 @@ VTCPSelectIOHandler::VTCPSelectIOHandler ( ) :
 {
 	SetName ( "ServerNet select I/O handler" );
 	fReadCount = 0;
+
+	fCPUIndex = -1;
+	fCallbackCount = fRateStartCount = 0;
+	fRateStartTime = VSystem::GetCurrentTime ( );
+	fCallbacksPerSecond = 0.0;
 }
 
 VTCPSelectIOHandler::~VTCPSelectIOHandler ( )
@@ -410,6 +615,39 @@ void VTCPSelectIOHandler::Stop ( )
 	Kill ( );
 }
 
+void VTCPSelectIOHandler::SetCPUAffinity (sLONG inCPUIndex)
+{
+	fCPUIndex = inCPUIndex;
+}
+
+void VTCPSelectIOHandler::GetStatistics (VTCPSelectIOStatistics& outStatistics)
+{
+	::memset(&outStatistics, 0, sizeof(outStatistics));
+
+	if ( !fReadSockLock. Lock ( ) )
+		return;
+
+	// Copy the list, IsProcessed() takes a lock and yields, don't hold the handler meanwhile.
+
+	std::list<VRefPtr<VTCPSelectAction> >				readSockList ( fReadSockList );
+	std::list<VRefPtr<VTCPSelectAction> >::iterator		iterAction;
+
+	outStatistics.fCallbackCount = fCallbackCount;
+	outStatistics.fCallbacksPerSecond = fCallbacksPerSecond;
+	outStatistics.fCPUIndex = fCPUIndex;
+
+	fReadSockLock. Unlock ( );
+
+	for (iterAction = readSockList.begin(); iterAction != readSockList.end(); ++iterAction) {
+
+		outStatistics.fSocketCount++;
+		if ((*iterAction)->GetType() == VTCPSelectAction::eTYPE_READ && !((VTCPSelectReadAction *) (*iterAction).Get())->IsProcessed())
+
+			outStatistics.fQueueDepth++;
+
+	}
+}
+
 void VTCPSelectIOHandler::AddToFDSet ( VTCPSelectAction* vtcpSelectAction, fd_set* fdSockets )
 {
 	if ( vtcpSelectAction-> GetLastError ( ) != VE_OK )
@@ -435,6 +673,10 @@ Boolean VTCPSelectIOHandler::DoRun ( )
 {	
 	int							nSocketsReadyForRead;
 	struct timeval				tvTimeout;
+
+	if ( !_PinCurrentThread ( fCPUIndex ) )
+		fCPUIndex = -1;
+
 	while ( GetState ( ) != TS_DYING && GetState ( ) != TS_DEAD )
 	{
 		StDropErrorContext errCtx;
@@ -446,6 +688,8 @@ Boolean VTCPSelectIOHandler::DoRun ( )
 
 		if ( !fReadSockLock. Lock ( ) )
 			break;
+
+		_UpdateCallbackRate ( fCallbackCount, fRateStartCount, fRateStartTime, fCallbacksPerSecond );
 		std::for_each (
 					fReadSockList. begin ( ), fReadSockList. end ( ),
 					std::bind2nd ( std::ptr_fun( AddToFDSet ), &fReadSockSet ) );
@@ -519,9 +763,11 @@ Boolean VTCPSelectIOHandler::DoRun ( )
 				XBOX::DebugMsg ( vstrMsg );
 			}*/
 
-			std::for_each (
-						fReadSockList. begin ( ), fReadSockList. end ( ),
-						std::bind2nd ( std::ptr_fun( HandleRead ), &fReadSockSet ) );
+			for ( std::list<XBOX::VRefPtr<VTCPSelectAction> >::iterator i = fReadSockList. begin ( ) ; i != fReadSockList. end ( ) ; ++i )
+			{
+				if ( HandleRead ( *i, &fReadSockSet ) )
+					fCallbackCount++;
+			}
 		}
 
 		if ( !fReadSockLock. Unlock ( ) )
@@ -721,9 +967,17 @@ VError VTCPSelectIOHandler::Read ( Socket inRawSocket, char* inBuffer, uLONG* nB
 	return vError;
 }
 
-void VTCPSelectIOHandler::HandleRead ( VTCPSelectAction* vtcpSelectAction, fd_set* fdSockets )
+bool VTCPSelectIOHandler::HandleRead ( VTCPSelectAction* vtcpSelectAction, fd_set* fdSockets )
 {
+	if ( !FD_ISSET ( vtcpSelectAction-> GetRawSocket ( ), fdSockets ) )
+		return false;
+
+	// Signaled read socket may have no Read() waiting anymore.
+	if ( vtcpSelectAction-> GetType ( ) == VTCPSelectAction::eTYPE_READ && ( ( VTCPSelectReadAction* ) vtcpSelectAction )-> IsProcessed ( ) )
+		return false;
+
 	vtcpSelectAction->DoAction(fdSockets);
+	return true;
 }
 
 void VTCPSelectIOHandler::HandleError ( VTCPSelectAction* vtcpSelectAction, fd_set* fdSockets )
@@ -760,4 +1014,584 @@ sLONG VTCPSelectIOHandler::GetActiveReadCount ( )
 	return nResult;
 }
 
+#if VERSION_LINUX
+
+VTCPEPollIOHandler::VTCPEPollIOHandler ( ) :
+									VTask ( NULL, 0, XBOX::eTaskStylePreemptive, NULL ),
+									fLock ( )
+{
+	SetName ( "ServerNet epoll I/O handler" );
+
+	fCPUIndex = -1;
+	fCallbackCount = fRateStartCount = 0;
+	fRateStartTime = VSystem::GetCurrentTime();
+	fCallbacksPerSecond = 0.0;
+
+	fEPollFD = ::epoll_create1(EPOLL_CLOEXEC);
+	fWakeUpFD = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (fEPollFD != -1 && fWakeUpFD != -1) {
+
+		struct epoll_event	event;
+
+		::memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = fWakeUpFD;
+
+		if (::epoll_ctl(fEPollFD, EPOLL_CTL_ADD, fWakeUpFD, &event) < 0) {
+
+			::close(fWakeUpFD);
+			fWakeUpFD = -1;
+
+		}
+
+	}
+}
+
+VTCPEPollIOHandler::~VTCPEPollIOHandler ( )
+{
+	if (fLock.Lock()) {
+
+		fReadyWatches.clear();
+		fArmedReads.clear();
+		fDirectReads.clear();
+		fActions.clear();
+
+		fLock.Unlock();
+
+	}
+
+	if (fWakeUpFD != -1)
+
+		::close(fWakeUpFD);
+
+	if (fEPollFD != -1)
+
+		::close(fEPollFD);
+}
+
+void VTCPEPollIOHandler::Stop ( )
+{
+	Kill();
+	_WakeUp();
+}
+
+void VTCPEPollIOHandler::SetCPUAffinity (sLONG inCPUIndex)
+{
+	fCPUIndex = inCPUIndex;
+}
+
+void VTCPEPollIOHandler::GetStatistics (VTCPSelectIOStatistics& outStatistics)
+{
+	::memset(&outStatistics, 0, sizeof(outStatistics));
+
+	if (!fLock.Lock())
+
+		return;
+
+	outStatistics.fSocketCount = (sLONG) fActions.size();
+	outStatistics.fQueueDepth = (sLONG) (fArmedReads.size() + fReadyWatches.size());
+	outStatistics.fCallbackCount = fCallbackCount;
+	outStatistics.fCallbacksPerSecond = fCallbacksPerSecond;
+	outStatistics.fCPUIndex = fCPUIndex;
+
+	fLock.Unlock();
+}
+
+VError VTCPEPollIOHandler::AddSocketForReading ( Socket inRawSocket, VSslDelegate* inSSLDelegate )
+{
+	xbox_assert(inRawSocket != -1);
+
+	VTCPSelectAction	*vtcpAction	= new VTCPSelectReadAction(inRawSocket, 0, 0, inSSLDelegate);
+	VError				vError		= _AddAction(vtcpAction);
+
+	ReleaseRefCountable(&vtcpAction);
+
+	return vError;
+}
+
+VError VTCPEPollIOHandler::RemoveSocketForReading ( Socket inRawSocket )
+{
+	return _RemoveAction(inRawSocket, VTCPSelectAction::eTYPE_READ);
+}
+
+VError VTCPEPollIOHandler::AddSocketForWatching (Socket inRawSocket, VEndPoint *inEndPoint, void *inData, CTCPSelectIOHandler::ReadCallback *inCallback)
+{
+	xbox_assert(inRawSocket != -1);
+
+	VTCPSelectAction	*vtcpAction	= new VTCPSelectWatchAction(inRawSocket, inEndPoint, inData, inCallback);
+	VError				vError		= _AddAction(vtcpAction);
+
+	ReleaseRefCountable(&vtcpAction);
+
+	return vError;
+}
+
+VError VTCPEPollIOHandler::RemoveSocketForWatching (Socket inRawSocket)
+{
+	return _RemoveAction(inRawSocket, VTCPSelectAction::eTYPE_WATCH);
+}
+
+VError VTCPEPollIOHandler::Read ( Socket inRawSocket, char* inBuffer, uLONG* nBufferLength, sLONG& outError, sLONG& outSystemError, uLONG inTimeOutMillis )
+{
+	xbox_assert(inRawSocket != -1);
+
+	if (!fLock.Lock())
+
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	VError							vError	= VE_OK;
+	VRefPtr<VTCPSelectReadAction>	vtcpSelectReadAction;
+	MapOfActions::iterator			iterAction;
+
+	iterAction = fActions.find(inRawSocket);
+	if (iterAction == fActions.end() || iterAction->second->GetType() != VTCPSelectAction::eTYPE_READ)
+
+		vError = VE_SRVR_SOCKET_IS_NOT_READING;
+
+	else {
+
+		vtcpSelectReadAction = (VTCPSelectReadAction *) iterAction->second.Get();
+		vtcpSelectReadAction->SetBuffer(inBuffer);
+		vtcpSelectReadAction->SetFullBufferSize(nBufferLength);
+		vtcpSelectReadAction->SetProcessed(false);
+		vtcpSelectReadAction->SetTimeOut(inTimeOutMillis);
+
+		// Readiness is edge-triggered: data received before this call has already been reported, so the
+		// socket is checked and read here, outside of the lock. Meanwhile the handler task only flags events.
+
+		fDirectReads[inRawSocket] = false;
+
+	}
+
+	if (!fLock.Unlock())
+
+		vError = VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	if (vError != VE_OK)
+
+		return vError;
+
+	bool	isArmed	= false;
+
+	while (!isArmed) {
+
+		bool	hasRead	= false;
+
+		if (vtcpSelectReadAction->GetLastError() == VE_OK
+		&& _HasPendingInput(inRawSocket, vtcpSelectReadAction->GetSSLDelegate())) {
+
+			vtcpSelectReadAction->DoReadyAction();
+			hasRead = true;
+
+		}
+
+		if (!fLock.Lock())
+
+			return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+		if (hasRead)
+
+			fCallbackCount++;
+
+		MapOfDirectReads::iterator	iterDirect	= fDirectReads.find(inRawSocket);
+
+		if (iterDirect != fDirectReads.end() && iterDirect->second && !vtcpSelectReadAction->IsProcessed())
+
+			iterDirect->second = false;		// Signaled while being checked, check again.
+
+		else {
+
+			if (iterDirect != fDirectReads.end())
+
+				fDirectReads.erase(iterDirect);
+
+			if (!vtcpSelectReadAction->IsProcessed() && _IsRegistered(vtcpSelectReadAction.Get()))
+
+				fArmedReads.push_back(vtcpSelectReadAction.Get());
+
+			isArmed = true;
+
+		}
+
+		if (!fLock.Unlock())
+
+			return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	}
+
+	if (!vtcpSelectReadAction->WaitForAction())
+
+		vError = VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	vError = vtcpSelectReadAction->GetLastError();
+	if (vError != VE_OK) {
+
+		outError = vtcpSelectReadAction->GetLastSocketError();
+		outSystemError = vtcpSelectReadAction->GetLastSystemSocketError();
+
+	}
+
+	return vError;
+}
+
+Boolean VTCPEPollIOHandler::DoRun ( )
+{
+	struct epoll_event	events[kMAX_EVENTS_PER_WAIT];
+
+	if (!_PinCurrentThread(fCPUIndex))
+
+		fCPUIndex = -1;
+
+	while (GetState() != TS_DYING && GetState() != TS_DEAD) {
+
+		StDropErrorContext	errCtx;
+
+		if (!fLock.Lock())
+
+			break;
+
+		_UpdateCallbackRate(fCallbackCount, fRateStartCount, fRateStartTime, fCallbacksPerSecond);
+
+		// Don't wait if there are watched sockets left with data.
+
+		int	timeOut	= fReadyWatches.empty() ? kWAIT_TIMEOUT : 0;
+
+		if (!fLock.Unlock())
+
+			break;
+
+		int	nbEvents	= ::epoll_wait(fEPollFD, events, kMAX_EVENTS_PER_WAIT, timeOut);
+
+		if (nbEvents < 0) {
+
+			xbox_assert(errno == EINTR);
+			nbEvents = 0;
+
+		}
+
+		if (!fLock.Lock())
+
+			break;
+
+		for (int i = 0; i < nbEvents; i++) {
+
+			if (events[i].data.fd == fWakeUpFD) {
+
+				uint64_t	counter;
+
+				while (::read(fWakeUpFD, &counter, sizeof(counter)) > 0)
+
+					;
+
+			} else {
+
+				MapOfActions::iterator	iterAction	= fActions.find(events[i].data.fd);
+
+				if (iterAction != fActions.end()) {
+
+					// Keep a reference, callback may remove its own socket.
+
+					VRefPtr<VTCPSelectAction>	vtcpAction(iterAction->second);
+
+					_HandleEvent(vtcpAction.Get(), events[i].events);
+
+				}
+
+			}
+
+		}
+
+		_ProcessReadyWatches();
+		_ProcessArmedReads();
+
+		if (!fLock.Unlock())
+
+			break;
+
+	}
+
+	return true;
+}
+
+VError VTCPEPollIOHandler::_AddAction (VTCPSelectAction *inAction)
+{
+	xbox_assert(inAction != NULL);
+
+	if (!fLock.Lock())
+
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	VError	vError		= VE_OK;
+	Socket	rawSocket	= inAction->GetRawSocket();
+
+	if (fActions.find(rawSocket) != fActions.end())
+
+		vError = inAction->GetType() == VTCPSelectAction::eTYPE_READ ? VE_SRVR_SOCKET_ALREADY_READING : VE_SRVR_SOCKET_ALREADY_WATCHING;
+
+	else {
+
+		struct epoll_event	event;
+
+		::memset(&event, 0, sizeof(event));
+
+		// Read actions are edge-triggered as they may have no Read() waiting. Watched sockets are
+		// level-triggered, so data left by a callback is signaled again.
+
+		event.events = EPOLLIN | EPOLLRDHUP;
+		if (inAction->GetType() == VTCPSelectAction::eTYPE_READ)
+
+			event.events |= EPOLLET;
+
+		event.data.fd = rawSocket;
+
+		if (::epoll_ctl(fEPollFD, EPOLL_CTL_ADD, rawSocket, &event) < 0)
+
+			vError = errno == ENOSPC || errno == ENOMEM ? VE_SRVR_TOO_MANY_SOCKETS_FOR_SELECT_IO : VE_SRVR_INVALID_PARAMETER;
+
+		else
+
+			fActions[rawSocket] = inAction;
+
+	}
+
+	if (!fLock.Unlock() && vError == VE_OK)
+
+		vError = VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	return vError;
+}
+
+VError VTCPEPollIOHandler::_RemoveAction (Socket inRawSocket, sLONG inType)
+{
+	if (!fLock.Lock())
+
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	VError					vError		= VE_OK;
+	MapOfActions::iterator	iterAction	= fActions.find(inRawSocket);
+
+	if (iterAction != fActions.end()) {
+
+		xbox_assert(iterAction->second->GetType() == inType);
+
+		// Socket may be removed for reading by another thread via ForceClose call.
+		// In this case I need to notify original reader that the read is over.
+
+		if (iterAction->second->GetType() == VTCPSelectAction::eTYPE_READ)
+
+			((VTCPSelectReadAction *) iterAction->second.Get())->NotifyActionComplete();
+
+		// Will fail if socket has already been closed, it is then already out of the epoll set.
+
+		struct epoll_event	event;
+
+		::memset(&event, 0, sizeof(event));
+		::epoll_ctl(fEPollFD, EPOLL_CTL_DEL, inRawSocket, &event);
+
+		// Ready and armed lists still reference the action, they are checked with _IsRegistered().
+
+		fActions.erase(iterAction);
+
+	} else
+
+		vError = VE_SRVR_SOCKET_IS_NOT_READING;
+
+	if (!fLock.Unlock())
+
+		vError = VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	return vError;
+}
+
+bool VTCPEPollIOHandler::_IsRegistered (VTCPSelectAction *inAction)
+{
+	MapOfActions::iterator	iterAction	= fActions.find(inAction->GetRawSocket());
+
+	return iterAction != fActions.end() && iterAction->second.Get() == inAction;
+}
+
+void VTCPEPollIOHandler::_WakeUp ( )
+{
+	if (fWakeUpFD != -1) {
+
+		uint64_t	one	= 1;
+
+		// Can only fail if counter overflows, handler is then already being woken up.
+
+		if (::write(fWakeUpFD, &one, sizeof(one)) < 0)
+
+			xbox_assert(errno == EAGAIN);
+
+	}
+}
+
+void VTCPEPollIOHandler::_HandleEvent (VTCPSelectAction *inAction, uint32_t inEvents)
+{
+	if (inAction->GetType() == VTCPSelectAction::eTYPE_READ) {
+
+		VTCPSelectReadAction		*readAction	= (VTCPSelectReadAction *) inAction;
+		MapOfDirectReads::iterator	iterDirect	= fDirectReads.find(inAction->GetRawSocket());
+
+		// Being read by its Read() caller, which will check the socket again.
+
+		if (iterDirect != fDirectReads.end()) {
+
+			iterDirect->second = true;
+			return;
+
+		}
+
+		// If no Read() is waiting, data will be found by next Read() call.
+
+		if (readAction->IsProcessed())
+
+			return;
+
+		if (inEvents & EPOLLERR)
+
+			readAction->HandleReadyError();
+
+		if (!readAction->IsProcessed())
+
+			readAction->DoReadyAction();
+
+		fCallbackCount++;
+
+	} else {
+
+		VTCPSelectWatchAction	*watchAction	= (VTCPSelectWatchAction *) inAction;
+
+		if (watchAction->GetLastError() == VE_OK && (inEvents & EPOLLERR))
+
+			watchAction->HandleReadyError();
+
+		if (watchAction->GetLastError() == VE_OK)
+
+			_TriggerWatch(watchAction);
+
+		else
+
+			_DisarmWatch(watchAction);
+
+	}
+}
+
+void VTCPEPollIOHandler::_TriggerWatch (VTCPSelectWatchAction *inAction)
+{
+	inAction->DoReadyAction();
+	fCallbackCount++;
+
+	// Data left on the socket is signaled again, but data already decrypted by the SSL delegate is not.
+
+	if (inAction->GetLastError() != VE_OK)
+
+		_DisarmWatch(inAction);
+
+	else if (_IsRegistered(inAction) && _HasBufferedInput(inAction))
+
+		fReadyWatches.push_back(inAction);
+}
+
+void VTCPEPollIOHandler::_DisarmWatch (VTCPSelectWatchAction *inAction)
+{
+	// Failed socket would be signaled forever, take it out of the epoll set until it is removed.
+
+	if (_IsRegistered(inAction)) {
+
+		struct epoll_event	event;
+
+		::memset(&event, 0, sizeof(event));
+		::epoll_ctl(fEPollFD, EPOLL_CTL_DEL, inAction->GetRawSocket(), &event);
+
+	}
+}
+
+void VTCPEPollIOHandler::_ProcessReadyWatches ( )
+{
+	if (fReadyWatches.empty())
+
+		return;
+
+	ListOfActions	readyWatches;
+
+	readyWatches.swap(fReadyWatches);
+	for (ListOfActions::iterator i = readyWatches.begin(); i != readyWatches.end(); ++i) {
+
+		VTCPSelectWatchAction	*watchAction	= (VTCPSelectWatchAction *) (*i).Get();
+
+		// Buffered data may already have been consumed by a callback for the same socket.
+
+		if (watchAction->GetLastError() == VE_OK && _IsRegistered(watchAction) && _HasBufferedInput(watchAction))
+
+			_TriggerWatch(watchAction);
+
+	}
+}
+
+void VTCPEPollIOHandler::_ProcessArmedReads ( )
+{
+	ListOfActions::iterator	i	= fArmedReads.begin();
+
+	while (i != fArmedReads.end()) {
+
+		VTCPSelectReadAction	*readAction	= (VTCPSelectReadAction *) (*i).Get();
+
+		if (!_IsRegistered(readAction) || readAction->IsProcessed()) {
+
+			i = fArmedReads.erase(i);
+			continue;
+
+		}
+
+		if (readAction->GetLastError() != VE_OK) {
+
+			// A previous read failed, don't let the reader wait forever.
+
+			readAction->NotifyActionComplete();
+			i = fArmedReads.erase(i);
+
+		} else if (readAction->TimeOutExpired()) {
+
+			readAction->SetLastError(VE_SRVR_READ_TIMED_OUT);
+			readAction->NotifyActionComplete();
+			i = fArmedReads.erase(i);
+
+		} else
+
+			++i;
+
+	}
+}
+
+bool VTCPEPollIOHandler::_HasBufferedInput (VTCPSelectWatchAction *inAction)
+{
+	VTCPEndPoint	*endPoint	= dynamic_cast<VTCPEndPoint *>(inAction->GetEndPoint());
+
+	return endPoint != NULL && endPoint->GetSSLDelegate() != NULL && endPoint->GetSSLDelegate()->GetBufferedDataLen() > 0;
+}
+
+bool VTCPEPollIOHandler::_HasPendingInput (Socket inRawSocket, VSslDelegate *inSSLDelegate)
+{
+	if (inSSLDelegate != NULL && inSSLDelegate->GetBufferedDataLen() > 0)
+
+		return true;
+
+	char	c;
+	ssize_t	nResult;
+
+	do {
+
+		nResult = ::recv(inRawSocket, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+	} while (nResult < 0 && errno == EINTR);
+
+	// End of stream and socket errors are reported by the read itself.
+
+	return nResult >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+#endif	// VERSION_LINUX
+
+
 END_TOOLBOX_NAMESPACE
@@ -26,6 +26,18 @@ BEGIN_TOOLBOX_NAMESPACE
 class VSslDelegate;
 
 
+// Counters of a select I/O handler (a "shard" of a VTCPSelectIOPool), see VTCPSelectIOPool::GetStatistics().
+
+struct VTCPSelectIOStatistics
+{
+	sLONG		fSocketCount;			// Sockets registered for reading or watching.
+	sLONG		fQueueDepth;			// Pending work: Read() calls waiting for data and ready sockets waiting for dispatch.
+	sLONG8		fCallbackCount;			// Total of reads completed and callbacks triggered.
+	Real		fCallbacksPerSecond;	// Rate of the above, updated every second.
+	sLONG		fCPUIndex;				// Processor the handler is pinned to, -1 if not pinned.
+};
+
+
 class XTOOLBOX_API CTCPSelectIOHandler
 {
 	public :
@@ -57,25 +69,70 @@ class XTOOLBOX_API CTCPSelectIOHandler
 	virtual VError	RemoveSocketForWatching (Socket inRawSocket) = 0;
 	
 	virtual void Stop ( ) = 0;
+
+	// Pin handler to a processor, must be called before handler is run. Ignored if not supported by platform.
+
+	virtual void	SetCPUAffinity (sLONG inCPUIndex) = 0;
+
+	virtual void	GetStatistics (VTCPSelectIOStatistics& outStatistics) = 0;
 };
 
 
 class XTOOLBOX_API VTCPSelectIOPool : public IRefCountable
 {
 	public :
+
+	// Readiness backend used by the handlers of the pool, chosen at creation.
+
+	enum {
+
+		eBACKEND_SELECT,		// Portable select() loop, at most FD_SETSIZE sockets per handler, O(n) per wakeup.
+		eBACKEND_EPOLL,			// Edge-triggered epoll, no socket limit and O(ready) dispatch (Linux only, select() elsewhere).
+
+		eBACKEND_DEFAULT	= eBACKEND_SELECT
+
+	};
+
+	// How sockets are assigned to handlers when pool is sharded.
+
+	enum {
+
+		ePOLICY_LEAST_LOADED,	// Handler with the fewest sockets.
+		ePOLICY_HASH			// Handler given by the socket descriptor, always the same for a given socket.
+
+	};
 	
-	VTCPSelectIOPool ( );
+	VTCPSelectIOPool (sLONG inBackend = eBACKEND_DEFAULT);
 	virtual ~VTCPSelectIOPool ( );
+
+	// Run a fixed set of handlers (one per processor if inShardCount is zero) and spread sockets among them,
+	// instead of filling handlers one after the other. Must be called before any socket is added.
+	// If inPinToCPU is true, each handler is pinned to a processor (round robin).
+
+	VError SetSharding (sLONG inShardCount, sLONG inPolicy = ePOLICY_LEAST_LOADED, bool inPinToCPU = true);
 	
 	CTCPSelectIOHandler* AddSocketForReading ( VEndPoint* inEndPoint, VError& outError );
 	CTCPSelectIOHandler* AddSocketForWatching (VEndPoint* inEndPoint, void *inData, CTCPSelectIOHandler::ReadCallback *inCallback, VError& outError);
+
+	// Counters of each handler (shard), in creation order.
+
+	VError GetStatistics (std::vector<VTCPSelectIOStatistics>& outStatistics);
 	
 	VError Close ( );
+
+	sLONG GetBackend ( )	{ return fBackend; }
 	
 private:
 	
-	std::list<CTCPSelectIOHandler*>			fHandlerList;
+	std::vector<CTCPSelectIOHandler*>		fHandlerList;
 	VCriticalSection						fHandlersLock;
+	sLONG									fBackend;
+	sLONG									fShardCount;	// Zero if pool isn't sharded.
+	sLONG									fShardPolicy;
+	bool									fPinToCPU;
+
+	CTCPSelectIOHandler	*_NewHandler (sLONG inCPUIndex = -1);
+	CTCPSelectIOHandler	*_SelectShard (Socket inRawSocket);
 	
 	// Set a "watch" if inCallback is not NULL, otherwise read socket.
 	
@@ -116,6 +173,11 @@ virtual	sLONG		GetType () = 0;
 virtual void		DoAction (fd_set* fdSockets) = 0;
 virtual void		HandleError (fd_set* fdSockets) = 0;
 
+		// Same as above, but socket is already known to be ready (readiness reported by epoll).
+
+virtual void		DoReadyAction () = 0;
+virtual void		HandleReadyError () = 0;
+
 	protected:
 
 					VTCPSelectAction (Socket inSocket);
@@ -154,9 +216,14 @@ virtual sLONG	GetType ()									{	return VTCPSelectAction::eTYPE_READ;	}
 		bool	WaitForAction ();
 		bool	NotifyActionComplete ();
 
+		VSslDelegate	*GetSSLDelegate ()					{	return fSslDelegate;	}
+
 virtual void	DoAction (fd_set* fdSockets);
 virtual void	HandleError (fd_set* fdSockets);
 
+virtual void	DoReadyAction ();
+virtual void	HandleReadyError ();
+
 	protected:
 
 virtual			~VTCPSelectReadAction()	{}
@@ -185,9 +252,14 @@ virtual sLONG	GetType ()					{	return VTCPSelectAction::eTYPE_WATCH;	}
 
 		bool	TriggerReadCallback (sLONG inErrorCode);
 
+		VEndPoint	*GetEndPoint ()		{	return fEndPoint;	}
+
 virtual void	DoAction (fd_set* fdSockets);
 virtual void	HandleError (fd_set* fdSockets);
 
+virtual void	DoReadyAction ();
+virtual void	HandleReadyError ();
+
 	protected:
 
 virtual			~VTCPSelectWatchAction ()	{}
@@ -216,6 +288,9 @@ class XTOOLBOX_API VTCPSelectIOHandler : public CTCPSelectIOHandler, public VTas
 
 		virtual void	Stop ( );
 
+		virtual void	SetCPUAffinity (sLONG inCPUIndex);
+		virtual void	GetStatistics (VTCPSelectIOStatistics& outStatistics);
+
 		static sLONG	GetLastSocketError ( );
 
 	protected :
@@ -230,14 +305,107 @@ class XTOOLBOX_API VTCPSelectIOHandler : public CTCPSelectIOHandler, public VTas
 		fd_set											fReadSockSet;
 		sLONG8											fReadCount;
 
+		sLONG											fCPUIndex;
+		sLONG8											fCallbackCount;
+		sLONG8											fRateStartCount;
+		uLONG											fRateStartTime;
+		Real											fCallbacksPerSecond;
+
 		static void AddToFDSet ( VTCPSelectAction* vtcpSelectAction, fd_set* fdSockets );
-		static void HandleRead ( VTCPSelectAction* vtcpSelectAction, fd_set* fdSockets );
+		static bool HandleRead ( VTCPSelectAction* vtcpSelectAction, fd_set* fdSockets );
 		static void HandleError ( VTCPSelectAction* vtcpSelectAction, fd_set* fdSockets );
 
 		sLONG GetActiveReadCount ( );
 };
 
 
+#if VERSION_LINUX
+
+// Edge-triggered epoll implementation of CTCPSelectIOHandler.
+//
+// Sockets are registered once with the kernel, so there is no FD_SETSIZE limit and a wakeup only costs the
+// number of ready sockets. Edge-triggered readiness is reported once per arrival of data: callbacks only do
+// one read, so sockets with data left after their callback are kept in a ready list and dispatched again on
+// next loop (with a zero wait), which preserves the level-triggered contract of the select() handler.
+
+class XTOOLBOX_API VTCPEPollIOHandler : public CTCPSelectIOHandler, public VTask
+{
+	public :
+
+						VTCPEPollIOHandler ( );
+		virtual			~VTCPEPollIOHandler ( );
+
+		// Return false if epoll instance couldn't be created, the handler is then unusable.
+
+		bool			IsValid ( )		{	return fEPollFD != -1 && fWakeUpFD != -1;	}
+
+		virtual VError	AddSocketForReading ( Socket inRawSocket, VSslDelegate* inSSLDelegate=NULL );
+		virtual VError	Read ( Socket inRawSocket, char* inBuffer, uLONG* nBufferLength, sLONG& outError, sLONG& outSystemError, uLONG inTimeOutMillis = 0 );
+		virtual VError	RemoveSocketForReading ( Socket inRawSocket );
+
+		virtual VError	AddSocketForWatching (Socket inRawSocket, VEndPoint *inEndPoint, void *inData, CTCPSelectIOHandler::ReadCallback *inCallback);
+		virtual VError	RemoveSocketForWatching (Socket inRawSocket);
+
+		virtual void	Stop ( );
+
+		virtual void	SetCPUAffinity (sLONG inCPUIndex);
+		virtual void	GetStatistics (VTCPSelectIOStatistics& outStatistics);
+
+	protected :
+
+		 virtual Boolean DoRun ( );
+
+	private :
+
+		typedef std::map<Socket, XBOX::VRefPtr<VTCPSelectAction> >	MapOfActions;
+		typedef std::list<XBOX::VRefPtr<VTCPSelectAction> >			ListOfActions;
+		typedef std::map<Socket, bool>								MapOfDirectReads;
+
+		enum {
+
+			kMAX_EVENTS_PER_WAIT	= 256,
+			kWAIT_TIMEOUT			= 100		// Milliseconds, also granularity of Read() timeouts.
+
+		};
+
+		int												fEPollFD;
+		int												fWakeUpFD;		// eventfd used to interrupt epoll_wait().
+
+		MapOfActions									fActions;
+		ListOfActions									fArmedReads;	// Read actions with a Read() call waiting.
+		ListOfActions									fReadyWatches;	// Watched sockets with SSL data left after their callback.
+		MapOfDirectReads								fDirectReads;	// Sockets read by their Read() caller, flagged if signaled meanwhile.
+		VCriticalSection								fLock;
+
+		sLONG											fCPUIndex;
+		sLONG8											fCallbackCount;
+		sLONG8											fRateStartCount;
+		uLONG											fRateStartTime;
+		Real											fCallbacksPerSecond;
+
+		VError			_AddAction (VTCPSelectAction *inAction);
+		VError			_RemoveAction (Socket inRawSocket, sLONG inType);
+		bool			_IsRegistered (VTCPSelectAction *inAction);
+
+		void			_WakeUp ( );
+		void			_HandleEvent (VTCPSelectAction *inAction, uint32_t inEvents);
+		void			_TriggerWatch (VTCPSelectWatchAction *inAction);
+		void			_DisarmWatch (VTCPSelectWatchAction *inAction);
+		void			_ProcessReadyWatches ( );
+		void			_ProcessArmedReads ( );
+
+		// Return true if the SSL delegate of watched socket holds decrypted data.
+
+		static bool		_HasBufferedInput (VTCPSelectWatchAction *inAction);
+
+		// Return true if a read on socket won't block (data, end of stream, or error pending).
+
+		static bool		_HasPendingInput (Socket inRawSocket, VSslDelegate *inSSLDelegate);
+};
+
+#endif	// VERSION_LINUX
+
+
 END_TOOLBOX_NAMESPACE
 
 
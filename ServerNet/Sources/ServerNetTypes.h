@@ -54,7 +54,7 @@ HTTP_Method;
 
 const sLONG kAUTO_YIELD_TIMEOUT=50; //WaitFor will call Yield every 50 ms
 
-#define WITH_SHARED_WORKERS 0
+#define WITH_SHARED_WORKERS 1
 
 
 enum
@@ -70,6 +70,23 @@ enum
 	kWorkerPool_SpareTaskKind = 'WKPS'
 };
 
+// Counters of a listener, see VSockListener::GetStatistics().
+struct VSockListenerStatistics
+{
+	sLONG8	fAcceptCount;			// Connections accepted.
+	sLONG8	fWakeUpCount;			// Times listening sockets were found ready.
+	sLONG	fMaxBatchSize;			// Most connections accepted from a socket in a single wake up.
+	sLONG8	fBacklogFullCount;		// Times a listening socket was found with a full backlog, connections may have been refused (Linux only).
+	Real	fAcceptsPerSecond;		// Updated every second.
+};
+
+// A buffer of a scatter/gather write, see VTCPEndPoint::WriteExactlyV().
+struct VWriteBuffer
+{
+	const void*	fData;
+	uLONG		fLength;
+};
+
 // classic functor for quick deletion of containers objects (m.c)
 template<class T> struct del_fun_t 
 {
@@ -30,16 +30,135 @@ using namespace ServerNetTools;
 VTCPSessionManager						VTCPSessionManager::sInstance;
 uLONG									VTCPSessionManager::sWorkerSleepDuration = 10000; // 10 seconds
 VSyncEvent								VTCPSessionManager::sSyncEventForSleep;
-std::vector<VTCPEndPoint*>				VTCPSessionManager::sEndPointsIdle;
-std::vector<VTCPEndPoint*>				VTCPSessionManager::sEndPointsPostponed;
+sLONG									VTCPSessionManager::sNextWakeUp = 0;
+std::map<VTCPEndPoint*, VTCPSessionManager::SessionTimer*>		VTCPSessionManager::sEndPointTimers;
+VTCPSessionTimerWheel					VTCPSessionManager::sEndPointWheel;
 VCriticalSection						VTCPSessionManager::sEndPoints;
 std::vector<VTCPServerSession*>			VTCPSessionManager::sServerSessions;
 VCriticalSection						VTCPSessionManager::sServerSessionsMutex;
-std::map<sLONG, std::pair< VTCPEndPoint*, VTCPServerSession* > >		VTCPSessionManager::sMapKeepAliveSessions;
+std::map<sLONG, VTCPSessionManager::SessionTimer*>		VTCPSessionManager::sMapKeepAliveSessions;
+VTCPSessionTimerWheel					VTCPSessionManager::sKeepAliveWheel;
 VCriticalSection						VTCPSessionManager::sKeepAliveSessionsMutex;
 uLONG									VTCPSessionManager::sKeepAliveTimeOut = 10000;
 
 
+VTCPSessionTimerWheel::VTCPSessionTimerWheel ( )
+{
+	::memset ( fSlots, 0, sizeof ( fSlots ) );
+	fCurrentTick = 0;
+	fTime = 0;
+	fLastSystemTime = VSystem::GetCurrentTime ( );
+	fTimerCount = 0;
+	fExpirationCount = 0;
+}
+
+void VTCPSessionTimerWheel::InitTimer ( Timer& outTimer )
+{
+	outTimer. fNext = 0;
+	outTimer. fPrevious = 0;
+	outTimer. fTick = 0;
+	outTimer. fRounds = 0;
+	outTimer. fIsScheduled = false;
+}
+
+sLONG8 VTCPSessionTimerWheel::_GetTime ( )
+{
+	/* VSystem::GetCurrentTime ( ) wraps around after 49 days, only its differences are used. */
+	uLONG				nSystemTime = VSystem::GetCurrentTime ( );
+	fTime += ( uLONG ) ( nSystemTime - fLastSystemTime );
+	fLastSystemTime = nSystemTime;
+
+	return fTime;
+}
+
+void VTCPSessionTimerWheel::_Unlink ( Timer* inTimer )
+{
+	if ( inTimer-> fPrevious != 0 )
+		inTimer-> fPrevious-> fNext = inTimer-> fNext;
+	else
+		fSlots [ inTimer-> fTick & ( kSLOT_COUNT - 1 ) ] = inTimer-> fNext;
+
+	if ( inTimer-> fNext != 0 )
+		inTimer-> fNext-> fPrevious = inTimer-> fPrevious;
+
+	inTimer-> fNext = 0;
+	inTimer-> fPrevious = 0;
+	inTimer-> fIsScheduled = false;
+	fTimerCount--;
+}
+
+void VTCPSessionTimerWheel::Schedule ( Timer* inTimer, uLONG inDelay )
+{
+	if ( inTimer-> fIsScheduled )
+		_Unlink ( inTimer );
+
+	/* Rounded up: a timer never expires early. */
+	sLONG8				nTick = ( _GetTime ( ) + inDelay + kTICK - 1 ) / kTICK;
+	if ( nTick < fCurrentTick )
+		nTick = fCurrentTick;
+
+	inTimer-> fTick = nTick;
+	inTimer-> fRounds = ( uLONG ) ( ( nTick - fCurrentTick ) / kSLOT_COUNT );
+	inTimer-> fIsScheduled = true;
+
+	Timer**				pSlot = fSlots + ( nTick & ( kSLOT_COUNT - 1 ) );
+	inTimer-> fPrevious = 0;
+	inTimer-> fNext = *pSlot;
+	if ( *pSlot != 0 )
+		( *pSlot )-> fPrevious = inTimer;
+	*pSlot = inTimer;
+
+	fTimerCount++;
+}
+
+void VTCPSessionTimerWheel::Cancel ( Timer* inTimer )
+{
+	if ( inTimer-> fIsScheduled )
+		_Unlink ( inTimer );
+}
+
+void VTCPSessionTimerWheel::Advance ( std::vector<Timer*>& ioExpired )
+{
+	sLONG8				nNowTick = _GetTime ( ) / kTICK;
+	while ( fCurrentTick <= nNowTick )
+	{
+		Timer*			vTimer = fSlots [ fCurrentTick & ( kSLOT_COUNT - 1 ) ];
+		while ( vTimer != 0 )
+		{
+			Timer*		vNext = vTimer-> fNext;
+			if ( vTimer-> fRounds == 0 )
+			{
+				_Unlink ( vTimer );
+				ioExpired. push_back ( vTimer );
+				fExpirationCount++;
+			}
+			else
+				vTimer-> fRounds--;
+
+			vTimer = vNext;
+		}
+
+		fCurrentTick++;
+	}
+}
+
+uLONG VTCPSessionTimerWheel::GetDelayToNextTimer ( uLONG inMaxDelay )
+{
+	if ( fTimerCount == 0 )
+		return inMaxDelay;
+
+	sLONG8				nNow = _GetTime ( );
+	sLONG8				nMaxTick = ( nNow + inMaxDelay ) / kTICK;
+	for ( sLONG8 nTick = fCurrentTick; nTick <= nMaxTick && nTick < fCurrentTick + kSLOT_COUNT; nTick++ )
+	{
+		if ( fSlots [ nTick & ( kSLOT_COUNT - 1 ) ] != 0 )
+			return ( nTick * kTICK <= nNow ) ? 0 : ( uLONG ) ( nTick * kTICK - nNow );
+	}
+
+	return inMaxDelay;
+}
+
+
 VTCPSessionManager::VTCPSessionManager ( )
 {
 	fWorkerTask = 0;
@@ -83,36 +202,78 @@ sLONG VTCPSessionManager::Run ( VTask* vTask )
 	if ( !vTask )
 		return 0;
 	
-	VError											vError = VE_OK;
-	
-	std::vector<VTCPEndPoint*>::iterator			iterEndPoints;
-	VTCPEndPoint*									vtcpEndPoint = 0;
-	std::vector<VTCPServerSession*>::iterator		iterServerSessions;
-	VTCPServerSession*								vtcpServerSession = 0;
-	std::map<sLONG, std::pair< VTCPEndPoint*, VTCPServerSession* > >::iterator		iterKeepAlive;
-	std::map<sLONG, std::pair< VTCPEndPoint*, VTCPServerSession* > >::iterator		iterKeepAliveTemp;
+	uLONG											nLastServerSessionsCheck = VSystem::GetCurrentTime ( );
 	while ( vTask-> GetState ( ) != TS_DYING && vTask-> GetState ( ) != TS_DEAD )
 	{
 		VTask::FlushErrors ( );
 		
-		sSyncEventForSleep. Lock ( sWorkerSleepDuration );
+		/* Reset before computing the delay: a timer scheduled after that wakes the worker up. While the delay is
+		computed, the wake up is published as far away as possible, so that a timer scheduled after its wheel was
+		looked at, but before the actual wake up is published, still signals the worker. */
 		sSyncEventForSleep. Reset ( );
+
+		uLONG					nNow = VSystem::GetCurrentTime ( );
+		VInterlocked::Exchange ( &sNextWakeUp, ( sLONG ) ( nNow + kFAR_WAKE_UP ) );
+
+		uLONG					nDelay = sWorkerSleepDuration - ( nNow - nLastServerSessionsCheck );
+		if ( nNow - nLastServerSessionsCheck >= sWorkerSleepDuration )
+			nDelay = 0;
+
+		if ( sEndPoints. Lock ( ) )
+		{
+			nDelay = sEndPointWheel. GetDelayToNextTimer ( nDelay );
+			sEndPoints. Unlock ( );
+		}
+		if ( sKeepAliveSessionsMutex. Lock ( ) )
+		{
+			nDelay = sKeepAliveWheel. GetDelayToNextTimer ( nDelay );
+			sKeepAliveSessionsMutex. Unlock ( );
+		}
+
+		VInterlocked::Exchange ( &sNextWakeUp, ( sLONG ) ( nNow + nDelay ) );
+		if ( nDelay > 0 )
+			sSyncEventForSleep. Lock ( nDelay );
 		
 		if ( vTask-> GetState ( ) == TS_DYING || vTask-> GetState ( ) == TS_DEAD )
 			break;
 		
-		if ( !sEndPoints. Lock ( ) )
+		HandleEndPointTimers ( );
+		HandleKeepAliveTimers ( );
+
+		nNow = VSystem::GetCurrentTime ( );
+		if ( nNow - nLastServerSessionsCheck >= sWorkerSleepDuration )
 		{
-			xbox_assert ( false );
-			
-			continue;
+			nLastServerSessionsCheck = nNow;
+			HandleServerSessions ( );
 		}
+	} // end of while ( vTask-> GetState ( ) != TS_DYING && vTask-> GetState ( ) != TS_DEAD )
+	
+	return 0;
+}
+
+void VTCPSessionManager::HandleEndPointTimers ( )
+{
+	if ( !sEndPoints. Lock ( ) )
+	{
+		xbox_assert ( false );
 		
-		/* Look at idling end points */
-		iterEndPoints = sEndPointsIdle. begin ( );
-		while ( iterEndPoints != sEndPointsIdle. end ( ) )
+		return;
+	}
+	
+	std::vector<VTCPSessionTimerWheel::Timer*>		vctrExpired;
+	sEndPointWheel. Advance ( vctrExpired );
+
+	VError											vError = VE_OK;
+	std::vector<VTCPSessionTimerWheel::Timer*>::iterator		iterTimers = vctrExpired. begin ( );
+	while ( iterTimers != vctrExpired. end ( ) )
+	{
+		SessionTimer*			vTimer = static_cast<SessionTimer*> ( *iterTimers );
+		VTCPEndPoint*			vtcpEndPoint = vTimer-> fEndPoint;
+		iterTimers++;
+
+		if ( vTimer-> fKind == kTIMER_IDLE )
 		{
-			vtcpEndPoint = *iterEndPoints;
+			/* Look at an idling end point */
 			vError = HandleForIdleTimeOut ( vtcpEndPoint );
 			xbox_assert ( vError == VE_OK );
 			
@@ -120,119 +281,172 @@ sLONG VTCPSessionManager::Run ( VTask* vTask )
 			{
 				if ( vtcpEndPoint-> IsPostponed ( ) )
 				{
-					//iterEndPoints = std::find ( sEndPointsIdle. begin ( ), sEndPointsIdle. end ( ), vtcpEndPoint );
-					iterEndPoints = sEndPointsIdle. erase ( iterEndPoints );
-					sEndPointsPostponed. push_back ( vtcpEndPoint );
+					vTimer-> fKind = kTIMER_POSTPONED;
+					SchedulePostponed ( vTimer );
 
 					DebugMessage ( CVSTR ( "Moved from idle to postponed collection" ), vtcpEndPoint );
 				}
 				else
-					iterEndPoints++;
+					ScheduleIdle ( vTimer );
 			}
 			else //if ( vError == VE_SRVR_CONNECTION_BROKEN || vError == VE_SRVR_READ_TIMED_OUT )
 			{
 				DebugMessage ( CVSTR ( "Failed to handle idle timeout" ), vtcpEndPoint, vError );
 
-				iterEndPoints = sEndPointsIdle. erase ( iterEndPoints );
+				sEndPointTimers. erase ( vtcpEndPoint );
+				delete vTimer;
 			}
 		}
-		
-		/* Look at postponed end points */
-		bool					bIsTimedOut = false;
-		iterEndPoints = sEndPointsPostponed. begin ( );
-		while ( iterEndPoints != sEndPointsPostponed. end ( ) )
+		else
 		{
-			vtcpEndPoint = *iterEndPoints;
+			/* Look at a postponed end point */
+			bool				bIsTimedOut = false;
 			vError = HandleForPostponedTimeOut ( vtcpEndPoint, bIsTimedOut );
 			xbox_assert ( vError == VE_OK );
 
 			if ( vError != VE_OK )
 				DebugMessage ( CVSTR ( "Failed to handle postponed timeout" ), vtcpEndPoint, vError );
 			
+			/* A timed out end point stays postponed until it's removed: it's checked again at the recheck delay. */
 			if ( vError == VE_OK && bIsTimedOut )
-			{
-				iterEndPoints++;//iterEndPoints = sEndPointsPostponed. erase ( iterEndPoints );
 				DebugMessage ( CVSTR ( "Postponed expired" ), vtcpEndPoint, vError );
-			}
-			else
-				iterEndPoints++;
-		}
-		
-		if ( !sEndPoints. Unlock ( ) )
-		{
-			xbox_assert ( false );
-			
-			break;
-		}
-		
-		/* Look at postponed server sessions */
-		if ( !sServerSessionsMutex. Lock ( ) )
-		{
-			xbox_assert ( false );
-			
-			continue;
+
+			SchedulePostponed ( vTimer );
 		}
+	}
+	
+	if ( !sEndPoints. Unlock ( ) )
+		xbox_assert ( false );
+}
+
+void VTCPSessionManager::HandleKeepAliveTimers ( )
+{
+	if ( !sKeepAliveSessionsMutex. Lock ( ) )
+	{
+		xbox_assert ( false );
 		
-		iterServerSessions = sServerSessions. begin ( );
-		while ( iterServerSessions != sServerSessions. end ( ) )
+		return;
+	}
+	
+	std::vector<VTCPSessionTimerWheel::Timer*>		vctrExpired;
+	sKeepAliveWheel. Advance ( vctrExpired );
+
+	std::vector<VTCPSessionTimerWheel::Timer*>::iterator		iterTimers = vctrExpired. begin ( );
+	while ( iterTimers != vctrExpired. end ( ) )
+	{
+		SessionTimer*			vTimer = static_cast<SessionTimer*> ( *iterTimers );
+		VTCPServerSession*		vtcpServerSession = vTimer-> fServerSession;
+		iterTimers++;
+
+		uLONG					nNow = VSystem::GetCurrentTime ( );
+		uLONG					nElapsed = nNow - vtcpServerSession-> GetLastKeepAlive ( );
+		if ( nElapsed > vtcpServerSession-> GetKeepAliveInterval ( ) )
 		{
-			vtcpServerSession = *iterServerSessions;
-			if ( vtcpServerSession-> IsTimedOut ( ) )
+			VError				vError = HandleForKeepAlive ( vTimer-> fEndPoint, vtcpServerSession );
+			xbox_assert ( vError == VE_OK );
+			if ( vError == VE_SRVR_CONNECTION_BROKEN )
 			{
-				iterServerSessions = sServerSessions. erase ( iterServerSessions );
+				sMapKeepAliveSessions. erase ( vTimer-> fEndPoint-> GetSimpleID ( ) );
 				vtcpServerSession-> Release ( );
-				vtcpServerSession = 0;
+				delete vTimer;
+				
+				continue;
 			}
-			else
-				iterServerSessions++;
-		}
-		
-		if ( !sServerSessionsMutex. Unlock ( ) )
-		{
-			xbox_assert ( false );
-			
-			break;
-		}
-		
-		/* Look at the keep-alive server sessions */
-		if ( !sKeepAliveSessionsMutex. Lock ( ) )
-		{
-			xbox_assert ( false );
-			
-			continue;
-		}
-		
-		uLONG				nNow = VSystem::GetCurrentTime ( );
-		iterKeepAlive = sMapKeepAliveSessions. begin ( );
-		while ( iterKeepAlive != sMapKeepAliveSessions. end ( ) )
-		{
-			vtcpServerSession = ( *iterKeepAlive ). second. second;
-			vtcpEndPoint = ( *iterKeepAlive ). second. first;
-			if ( vtcpServerSession != 0 && nNow - vtcpServerSession-> GetLastKeepAlive ( ) > vtcpServerSession-> GetKeepAliveInterval ( ) )
-			{
-				vError = HandleForKeepAlive ( vtcpEndPoint, vtcpServerSession );
-				xbox_assert ( vError == VE_OK );
-				if ( vError == VE_SRVR_CONNECTION_BROKEN )
-				{
-					iterKeepAliveTemp = iterKeepAlive;
-					iterKeepAlive++;
-					sMapKeepAliveSessions. erase ( iterKeepAliveTemp );
-					
-					continue;
-				}
-			}
-			iterKeepAlive++;
+
+			vtcpServerSession-> SetLastKeepAlive ( nNow );
+			nElapsed = 0;
 		}
+
+		ScheduleTimer ( sKeepAliveWheel, vTimer, vtcpServerSession-> GetKeepAliveInterval ( ) - nElapsed + 1 );
+	}
+	
+	if ( !sKeepAliveSessionsMutex. Unlock ( ) )
+		xbox_assert ( false );
+}
+
+void VTCPSessionManager::HandleServerSessions ( )
+{
+	/* Look at postponed server sessions */
+	if ( !sServerSessionsMutex. Lock ( ) )
+	{
+		xbox_assert ( false );
 		
-		if ( !sKeepAliveSessionsMutex. Unlock ( ) )
+		return;
+	}
+	
+	VTCPServerSession*								vtcpServerSession = 0;
+	std::vector<VTCPServerSession*>::iterator		iterServerSessions = sServerSessions. begin ( );
+	while ( iterServerSessions != sServerSessions. end ( ) )
+	{
+		vtcpServerSession = *iterServerSessions;
+		if ( vtcpServerSession-> IsTimedOut ( ) )
 		{
-			xbox_assert ( false );
-			
-			break;
+			iterServerSessions = sServerSessions. erase ( iterServerSessions );
+			vtcpServerSession-> Release ( );
+			vtcpServerSession = 0;
 		}
-	} // end of while ( vTask-> GetState ( ) != TS_DYING && vTask-> GetState ( ) != TS_DEAD )
+		else
+			iterServerSessions++;
+	}
 	
-	return 0;
+	if ( !sServerSessionsMutex. Unlock ( ) )
+		xbox_assert ( false );
+}
+
+uLONG VTCPSessionManager::GetRecheckDelay ( uLONG inTimeout )
+{
+	return ( inTimeout == 0 || inTimeout > sWorkerSleepDuration ) ? sWorkerSleepDuration : inTimeout;
+}
+
+void VTCPSessionManager::ScheduleIdle ( SessionTimer* inTimer )
+{
+	/* The idle start moves each time the end point is used: the timer is only a lower bound, the end point
+	is checked again when it fires. An end point in use, or already timed out but not postponed, is checked again later. */
+	uLONG					nDelay = inTimer-> fEndPoint-> GetIdleTimeLeft ( );
+	if ( nDelay == 0 )
+		nDelay = GetRecheckDelay ( inTimer-> fEndPoint-> GetIdleTimeout ( ) );
+
+	ScheduleTimer ( sEndPointWheel, inTimer, nDelay );
+}
+
+void VTCPSessionManager::SchedulePostponed ( SessionTimer* inTimer )
+{
+	uLONG					nDelay = inTimer-> fEndPoint-> GetPostponeTimeLeft ( );
+	if ( nDelay == 0 )
+		nDelay = GetRecheckDelay ( inTimer-> fEndPoint-> GetPostponeTimeout ( ) );
+
+	ScheduleTimer ( sEndPointWheel, inTimer, nDelay );
+}
+
+void VTCPSessionManager::ScheduleTimer ( VTCPSessionTimerWheel& inWheel, SessionTimer* inTimer, uLONG inDelay )
+{
+	inWheel. Schedule ( inTimer, inDelay );
+
+	/* Wake the worker up if it sleeps beyond the new deadline. */
+	uLONG					nDeadline = VSystem::GetCurrentTime ( ) + inDelay;
+	if ( ( sLONG ) ( nDeadline - ( uLONG ) VInterlocked::AtomicGet ( &sNextWakeUp ) ) < 0 )
+		sSyncEventForSleep. Unlock ( );
+}
+
+VError VTCPSessionManager::GetTimerStatistics ( TimerStatistics& outStatistics )
+{
+	if ( !sEndPoints. Lock ( ) )
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	outStatistics. fEndPointTimers = sEndPointWheel. GetTimerCount ( );
+	outStatistics. fExpirations = sEndPointWheel. GetExpirationCount ( );
+
+	sEndPoints. Unlock ( );
+
+	if ( !sKeepAliveSessionsMutex. Lock ( ) )
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	outStatistics. fKeepAliveTimers = sKeepAliveWheel. GetTimerCount ( );
+	outStatistics. fExpirations += sKeepAliveWheel. GetExpirationCount ( );
+
+	sKeepAliveSessionsMutex. Unlock ( );
+
+	return VE_OK;
 }
 
 void VTCPSessionManager::Start ( )
@@ -275,7 +489,16 @@ VError VTCPSessionManager::Add ( VTCPEndPoint* inEndPoint )
 	if ( !sEndPoints. Lock ( ) )
 		return VE_SRVR_FAILED_TO_SYNC_LOCK;
 	
-	sEndPointsIdle. push_back ( inEndPoint );
+	SessionTimer*&				vTimer = sEndPointTimers [ inEndPoint ];
+	if ( vTimer == 0 )
+	{
+		vTimer = new SessionTimer ( );
+		VTCPSessionTimerWheel::InitTimer ( *vTimer );
+		vTimer-> fEndPoint = inEndPoint;
+		vTimer-> fServerSession = 0;
+	}
+	vTimer-> fKind = kTIMER_IDLE;
+	ScheduleIdle ( vTimer );
 	
 	VError		vError = VE_OK;
 	if ( !sEndPoints. Unlock ( ) )
@@ -294,14 +517,12 @@ VError VTCPSessionManager::Remove ( VTCPEndPoint* inEndPoint )
 	if ( !sEndPoints. Lock ( ) )
 		return VE_SRVR_FAILED_TO_SYNC_LOCK;
 	
-	std::vector<VTCPEndPoint*>::iterator		iter = std::find ( sEndPointsIdle. begin ( ), sEndPointsIdle. end ( ), inEndPoint );
-	if ( iter != sEndPointsIdle. end ( ) )
-		sEndPointsIdle. erase ( iter );
-	else
+	std::map<VTCPEndPoint*, SessionTimer*>::iterator		iter = sEndPointTimers. find ( inEndPoint );
+	if ( iter != sEndPointTimers. end ( ) )
 	{
-		iter = std::find ( sEndPointsPostponed. begin ( ), sEndPointsPostponed. end ( ), inEndPoint );
-		if ( iter != sEndPointsPostponed. end ( ) )
-			sEndPointsPostponed. erase ( iter );
+		sEndPointWheel. Cancel ( iter-> second );
+		delete iter-> second;
+		sEndPointTimers. erase ( iter );
 	}
 	
 	VError		vError = VE_OK;
@@ -317,11 +538,8 @@ bool VTCPSessionManager::IsPostponed ( VTCPEndPoint* inEndPoint )
 	
 	bool				bResult = false;
 	sEndPoints. Lock ( );
-	std::vector<VTCPEndPoint*>::iterator		iter = std::find (
-																  sEndPointsPostponed. begin ( ),
-																  sEndPointsPostponed. end ( ),
-																  inEndPoint );
-	bResult = ( iter != sEndPointsPostponed. end ( ) );
+	std::map<VTCPEndPoint*, SessionTimer*>::iterator		iter = sEndPointTimers. find ( inEndPoint );
+	bResult = ( iter != sEndPointTimers. end ( ) && iter-> second-> fKind == kTIMER_POSTPONED );
 	sEndPoints. Unlock ( );
 	
 	return bResult;
@@ -336,16 +554,18 @@ VError VTCPSessionManager::Restore ( VTCPEndPoint* inEndPoint )
 	if ( !sEndPoints. Lock ( ) )
 		return VE_SRVR_FAILED_TO_SYNC_LOCK;
 	
-	std::vector<VTCPEndPoint*>::iterator		iter = std::find (
-																  sEndPointsPostponed. begin ( ),
-																  sEndPointsPostponed. end ( ),
-																  inEndPoint );
-	xbox_assert ( iter != sEndPointsPostponed. end ( ) );
+	SessionTimer*&				vTimer = sEndPointTimers [ inEndPoint ];
+	xbox_assert ( vTimer != 0 && vTimer-> fKind == kTIMER_POSTPONED );
 	
-	if ( iter != sEndPointsPostponed. end ( ) )
-		sEndPointsPostponed. erase ( iter );
-	
-	sEndPointsIdle. push_back ( inEndPoint );
+	if ( vTimer == 0 )
+	{
+		vTimer = new SessionTimer ( );
+		VTCPSessionTimerWheel::InitTimer ( *vTimer );
+		vTimer-> fEndPoint = inEndPoint;
+		vTimer-> fServerSession = 0;
+	}
+	vTimer-> fKind = kTIMER_IDLE;
+	ScheduleIdle ( vTimer );
 	
 	if ( !sEndPoints. Unlock ( ) )
 	{
@@ -591,12 +811,19 @@ VError VTCPSessionManager::AddForKeepAlive ( VTCPEndPoint* inEndPoint, VTCPServe
 		return VE_SRVR_FAILED_TO_SYNC_LOCK;
 	
 	VError														vError = VE_OK;
-	std::map<sLONG, std::pair< VTCPEndPoint*, VTCPServerSession* > >::iterator				iter = sMapKeepAliveSessions. find ( inEndPoint-> GetSimpleID ( ) );
+	std::map<sLONG, SessionTimer*>::iterator					iter = sMapKeepAliveSessions. find ( inEndPoint-> GetSimpleID ( ) );
 	if ( iter == sMapKeepAliveSessions. end ( ) )
 	{
 		inSession-> Retain ( );
 		inSession-> SetLastKeepAlive ( VSystem::GetCurrentTime ( ) );
-		sMapKeepAliveSessions [ inEndPoint-> GetSimpleID ( ) ] = std::pair< VTCPEndPoint*, VTCPServerSession* > ( inEndPoint, inSession );
+
+		SessionTimer*				vTimer = new SessionTimer ( );
+		VTCPSessionTimerWheel::InitTimer ( *vTimer );
+		vTimer-> fKind = kTIMER_KEEP_ALIVE;
+		vTimer-> fEndPoint = inEndPoint;
+		vTimer-> fServerSession = inSession;
+		sMapKeepAliveSessions [ inEndPoint-> GetSimpleID ( ) ] = vTimer;
+		ScheduleTimer ( sKeepAliveWheel, vTimer, inSession-> GetKeepAliveInterval ( ) + 1 );
 		
 		if ( fWorkerTask == 0 )
 			Start ( );
@@ -617,16 +844,17 @@ VError VTCPSessionManager::RemoveFromKeepAlive ( VTCPEndPoint const & inEndPoint
 		return VE_SRVR_FAILED_TO_SYNC_LOCK;
 	
 	VError														vError = VE_OK;
-	VTCPServerSession*											tcpServerSession = 0;
-	std::map<sLONG, std::pair< VTCPEndPoint*, VTCPServerSession* > >::iterator				iter = sMapKeepAliveSessions. find ( inEndPoint. GetSimpleID ( ) );
+	std::map<sLONG, SessionTimer*>::iterator					iter = sMapKeepAliveSessions. find ( inEndPoint. GetSimpleID ( ) );
 	if ( iter == sMapKeepAliveSessions. end ( ) )
 		vError = ThrowNetError ( VE_SRVR_SESSION_NOT_FOUND );
 	else
 	{
-		tcpServerSession = ( ( *iter ). second ). second;
+		SessionTimer*				vTimer = iter-> second;
 		sMapKeepAliveSessions. erase ( iter );
-		xbox_assert ( tcpServerSession != 0 );
-		tcpServerSession-> Release ( );
+		sKeepAliveWheel. Cancel ( vTimer );
+		xbox_assert ( vTimer-> fServerSession != 0 );
+		vTimer-> fServerSession-> Release ( );
+		delete vTimer;
 	}
 	
 	if ( !sKeepAliveSessionsMutex. Unlock ( ) )
@@ -637,7 +865,6 @@ VError VTCPSessionManager::RemoveFromKeepAlive ( VTCPEndPoint const & inEndPoint
 }
 
 
-
 VTCPServerSession::VTCPServerSession ( )
 {
 	fUuidClient. FromVUUID ( VUUID::sNullUUID );
@@ -78,6 +78,68 @@ class XTOOLBOX_API VTCPServerSession : public VObject, public IRefCountable
 };
 
 
+/* Hashed timing wheel (Varghese & Lauck): a timer is linked in the slot of its deadline tick, modulo the number of
+slots, with the number of wheel revolutions left before it's due. Scheduling, cancelling and expiring a timer take
+constant time, and advancing the wheel only visits the slots of the elapsed ticks.
+The wheel counts time from its own clock, that doesn't wrap. It is not synchronized. */
+class XTOOLBOX_API VTCPSessionTimerWheel : public VObject
+{
+	public :
+
+	enum
+	{
+		kTICK = 100,				/* Milliseconds. */
+		kSLOT_COUNT = 1024			/* Must be a power of 2. A revolution is about 100 seconds. */
+	};
+
+	/* To be embedded in the caller's timers. */
+	typedef struct Timer
+	{
+		Timer*					fNext;
+		Timer*					fPrevious;
+		sLONG8					fTick;
+		uLONG					fRounds;
+		bool					fIsScheduled;
+	} Timer;
+
+	VTCPSessionTimerWheel ( );
+	virtual ~VTCPSessionTimerWheel ( ) { ; }
+
+	static void InitTimer ( Timer& outTimer );
+
+	/* Schedules inTimer to expire in inDelay milliseconds, rescheduling it if it already is. */
+	void Schedule ( Timer* inTimer, uLONG inDelay );
+	void Cancel ( Timer* inTimer );
+
+	/* Unschedules the timers that are due and appends them to ioExpired. */
+	void Advance ( std::vector<Timer*>& ioExpired );
+
+	/* Milliseconds before next slot holding a timer, at most inMaxDelay. */
+	uLONG GetDelayToNextTimer ( uLONG inMaxDelay );
+
+	sLONG GetTimerCount ( ) const { return fTimerCount; }
+	sLONG8 GetExpirationCount ( ) const { return fExpirationCount; }
+
+	private :
+
+	VTCPSessionTimerWheel ( const VTCPSessionTimerWheel& );				/* forbidden */
+	VTCPSessionTimerWheel& operator= ( const VTCPSessionTimerWheel& );	/* forbidden */
+
+	sLONG8 _GetTime ( );
+	void _Unlink ( Timer* inTimer );
+
+	Timer*						fSlots [ kSLOT_COUNT ];
+	sLONG8						fCurrentTick;		/* Next tick to visit. */
+	sLONG8						fTime;				/* Milliseconds since creation. */
+	uLONG						fLastSystemTime;
+	sLONG						fTimerCount;
+	sLONG8						fExpirationCount;
+};
+
+
+/* Idle and postponed end points, and keep-alive sessions, are scheduled in timing wheels when they are added or
+restored, so that the manager only looks at the ones whose deadline is reached. Server sessions are still scanned
+every sWorkerSleepDuration. */
 class XTOOLBOX_API VTCPSessionManager : public VObject
 {
 	public :
@@ -99,20 +161,57 @@ class XTOOLBOX_API VTCPSessionManager : public VObject
 	VError AddForKeepAlive ( VTCPEndPoint* inEndPoint, VTCPServerSession* inSession );
 	VError RemoveFromKeepAlive ( VTCPEndPoint const & inEndPoint );
 	
+	typedef struct TimerStatistics
+	{
+		sLONG					fEndPointTimers;		/* Idle and postponed end points. */
+		sLONG					fKeepAliveTimers;
+		sLONG8					fExpirations;
+	} TimerStatistics;
+
+	VError GetTimerStatistics ( TimerStatistics& outStatistics );
+	
 	static void DebugMessage ( XBOX::VString const & inMessage, VTCPEndPoint* inEndPoint, XBOX::VError inError = XBOX::VE_OK );
 	
 private:
 	
+	enum
+	{
+		kTIMER_IDLE = 0,
+		kTIMER_POSTPONED,
+		kTIMER_KEEP_ALIVE
+	};
+
+	enum
+	{
+		kFAR_WAKE_UP = 0x7FFFFFFF		/* Milliseconds from now, published in sNextWakeUp while the delay is computed. */
+	};
+
+	typedef struct SessionTimer : public VTCPSessionTimerWheel::Timer
+	{
+		sLONG					fKind;
+		VTCPEndPoint*			fEndPoint;
+		VTCPServerSession*		fServerSession;		/* Keep-alive only, retained. */
+	} SessionTimer;
+
 	VTCPSessionManager ( );
 	
 	void Start ( );
 	VError ReleaseAllServerSessions ( );
 	
 	static sLONG Run ( VTask* vTask );
+	static void HandleEndPointTimers ( );
+	static void HandleKeepAliveTimers ( );
+	static void HandleServerSessions ( );
 	static VError HandleForIdleTimeOut ( VTCPEndPoint* vtcpEndPoint );
 	static VError HandleForPostponedTimeOut ( VTCPEndPoint* vtcpEndPoint, bool& outTimedOut );
 	static VError HandleForKeepAlive ( VTCPEndPoint* vtcpEndPoint, VTCPServerSession* vtcpServerSession );
 
+	/* Delay before checking again an end point that has no timeout or could not be checked. */
+	static uLONG GetRecheckDelay ( uLONG inTimeout );
+	static void ScheduleIdle ( SessionTimer* inTimer );
+	static void SchedulePostponed ( SessionTimer* inTimer );
+	static void ScheduleTimer ( VTCPSessionTimerWheel& inWheel, SessionTimer* inTimer, uLONG inDelay );
+
 	static VTCPSessionManager					sInstance;
 	
 	/*
@@ -120,20 +219,22 @@ private:
 	 static VMutex								fPostponedSessionsLock;
 	 */
 	
-	/* End points that are potential candicates to be postponed if timeout for idling is reached. */
-	static std::vector<VTCPEndPoint*>			sEndPointsIdle;
-	static std::vector<VTCPEndPoint*>			sEndPointsPostponed;
+	/* End points that are potential candicates to be postponed if timeout for idling is reached, and postponed ones. */
+	static std::map<VTCPEndPoint*, SessionTimer*>	sEndPointTimers;
+	static VTCPSessionTimerWheel				sEndPointWheel;
 	static VCriticalSection						sEndPoints;
 	
 	static std::vector<VTCPServerSession*>		sServerSessions;
 	static VCriticalSection						sServerSessionsMutex;
 	
-	static std::map<sLONG, std::pair< VTCPEndPoint*, VTCPServerSession* > >		sMapKeepAliveSessions;
+	static std::map<sLONG, SessionTimer*>		sMapKeepAliveSessions;
+	static VTCPSessionTimerWheel				sKeepAliveWheel;
 	static VCriticalSection						sKeepAliveSessionsMutex;
 	
 	VCriticalSection							fWorkerMutex;
 	VTask*										fWorkerTask;
 	static VSyncEvent							sSyncEventForSleep;
+	static sLONG								sNextWakeUp; // VSystem::GetCurrentTime ( ) at which the worker plans to wake up
 	static uLONG								sWorkerSleepDuration; // Milliseconds
 	static uLONG								sKeepAliveTimeOut;
 	/*
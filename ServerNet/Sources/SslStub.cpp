@@ -349,3 +349,26 @@ int SNET_STDCALL SSLSTUB::SSL_connect(SSL *ssl)
 {
 	return ::SSL_connect(ssl);
 }
+
+
+// Used for client session resumption (VHTTPConnectionPool).
+
+SSL_SESSION* SNET_STDCALL SSLSTUB::SSL_get1_session(SSL* ssl)
+{
+	return ::SSL_get1_session(ssl);
+}
+
+int SNET_STDCALL SSLSTUB::SSL_set_session(SSL* ssl, SSL_SESSION* session)
+{
+	return ::SSL_set_session(ssl, session);
+}
+
+void SNET_STDCALL SSLSTUB::SSL_SESSION_free(SSL_SESSION* session)
+{
+	::SSL_SESSION_free(session);
+}
+
+long SNET_STDCALL SSLSTUB::SSL_session_reused_4D(SSL* ssl)
+{
+	return SSL_session_reused(ssl);
+}
@@ -146,6 +146,12 @@ namespace snet_ssl_stub
 
 	// Used by VSslDelegate::HandShake() (SSJS socket implementation).
 	int						SNET_STDCALL	SSL_connect						(SSL *ssl);
+
+	// Used for client session resumption (VHTTPConnectionPool).
+	SSL_SESSION*			SNET_STDCALL	SSL_get1_session				(SSL* ssl);
+	int						SNET_STDCALL	SSL_set_session					(SSL* ssl, SSL_SESSION* session);
+	void					SNET_STDCALL	SSL_SESSION_free				(SSL_SESSION* session);
+	long					SNET_STDCALL	SSL_session_reused_4D			(SSL* ssl);
 }
 
 
@@ -26,6 +26,7 @@
 #include "VTCPEndPoint.h"
 
 #include "VProxyManager.h"
+#include "VHTTPClient.h"
 
 #if VERSIONMAC || VERSION_LINUX
 	#include <netdb.h>
@@ -71,6 +72,11 @@ VServerNetManager::~VServerNetManager()
 {
 	VErrorBase::UnregisterLocalizer(kSERVER_NET_SIGNATURE);
 
+	//Pooled connections may hold SSL sessions.
+	VHTTPConnectionPool::DeInit();
+
+	VDnsResolver::DeInit();
+
 	VError verr=SslFramework::DeInit();
 	xbox_assert(verr==VE_OK);
 }
@@ -235,6 +241,10 @@ void VServerNetManager::Init(ICriticalError* inCriticalError, IpPolicy inIpPolic
 		xbox_assert(verr==VE_OK);
 
 		VProxyManager::Init();
+
+		VHTTPConnectionPool::Init();
+
+		VDnsResolver::Init();
 	}
 }
 
@@ -22,66 +22,172 @@
 BEGIN_TOOLBOX_NAMESPACE
 
 
-VConnectionHandlerQueue::VConnectionHandlerQueue ( ) :
-m_qConnectionHandlers ( )
+VConnectionHandlerQueue::VConnectionHandlerQueue ( sLONG inCapacity ) :
+m_vsemWakeUp ( 0, 0x7FFFFFFF )
 {
-	m_vcsQueueProtector = new VCriticalSection ( );
+	uLONG				nCapacity = 2;
+	while ( nCapacity < ( uLONG ) inCapacity && nCapacity < 0x40000000 )
+		nCapacity <<= 1;
+
+	m_arrSlots = new Slot [ nCapacity ];
+	m_nMask = nCapacity - 1;
+	for ( uLONG i = 0; i < nCapacity; i++ )
+	{
+		m_arrSlots [ i ]. fSequence = ( sLONG ) i;
+		m_arrSlots [ i ]. fHandler = NULL;
+	}
+
+	m_nPushPosition = 0;
+	m_nPopPosition = 0;
+	m_nWaiters = 0;
 }
 
 VConnectionHandlerQueue::~VConnectionHandlerQueue ( )
 {
-	if ( m_vcsQueueProtector )
-		delete m_vcsQueueProtector;
+	delete [ ] m_arrSlots;
 }
 
 VError VConnectionHandlerQueue::Push ( VConnectionHandler* inConnectionHandler )
 {
-	if ( !m_vcsQueueProtector-> Lock ( ) )
-		return VE_SRVR_FAILED_TO_SYNC_LOCK;
-	
-	m_qConnectionHandlers. push ( inConnectionHandler );
-	
-	m_vcsQueueProtector-> Unlock ( );
-	
+	Slot*				vSlot = NULL;
+	sLONG				nPosition = VInterlocked::AtomicGet ( &m_nPushPosition );
+	while ( true )
+	{
+		vSlot = m_arrSlots + ( ( uLONG ) nPosition & m_nMask );
+
+		/* Positions wrap around, only differences are meaningful. */
+		sLONG			nDiff = ( sLONG ) ( ( uLONG ) VInterlocked::AtomicGet ( &vSlot-> fSequence ) - ( uLONG ) nPosition );
+		if ( nDiff == 0 )
+		{
+			sLONG		nSeen = VInterlocked::CompareExchange ( &m_nPushPosition, nPosition, ( sLONG ) ( ( uLONG ) nPosition + 1 ) );
+			if ( nSeen == nPosition )
+				break;
+
+			nPosition = nSeen;
+		}
+		else if ( nDiff < 0 )
+		{
+			/* The slot still holds the handler pushed one round ago. */
+			return VE_SRVR_RESOURCE_TEMPORARILY_UNAVAILABLE;
+		}
+		else
+			nPosition = VInterlocked::AtomicGet ( &m_nPushPosition );
+	}
+
+	vSlot-> fHandler = inConnectionHandler;
+
+	/* Full barrier: the handler is visible before the slot is marked as ready, and the waiter
+	count is read after, so that a consumer about to sleep either sees the handler or is signaled. */
+	VInterlocked::Exchange ( &vSlot-> fSequence, ( sLONG ) ( ( uLONG ) nPosition + 1 ) );
+
+	WakeUpWaiter ( );
+
 	return VE_OK;
 }
 
+VConnectionHandler* VConnectionHandlerQueue::_TryPop ( )
+{
+	Slot*				vSlot = NULL;
+	sLONG				nPosition = VInterlocked::AtomicGet ( &m_nPopPosition );
+	while ( true )
+	{
+		vSlot = m_arrSlots + ( ( uLONG ) nPosition & m_nMask );
+
+		sLONG			nDiff = ( sLONG ) ( ( uLONG ) VInterlocked::AtomicGet ( &vSlot-> fSequence ) - ( ( uLONG ) nPosition + 1 ) );
+		if ( nDiff == 0 )
+		{
+			sLONG		nSeen = VInterlocked::CompareExchange ( &m_nPopPosition, nPosition, ( sLONG ) ( ( uLONG ) nPosition + 1 ) );
+			if ( nSeen == nPosition )
+				break;
+
+			nPosition = nSeen;
+		}
+		else if ( nDiff < 0 )
+			return NULL;
+		else
+			nPosition = VInterlocked::AtomicGet ( &m_nPopPosition );
+	}
+
+	VConnectionHandler*	vcHandler = vSlot-> fHandler;
+	vSlot-> fHandler = NULL;
+
+	/* Ready to be written again one round later. */
+	VInterlocked::Exchange ( &vSlot-> fSequence, ( sLONG ) ( ( uLONG ) nPosition + m_nMask + 1 ) );
+
+	return vcHandler;
+}
+
 VConnectionHandler* VConnectionHandlerQueue::Pop ( VError* ioError )
 {
-	if ( !m_vcsQueueProtector-> Lock ( ) )
+	*ioError = VE_OK;
+
+	return _TryPop ( );
+}
+
+VConnectionHandler* VConnectionHandlerQueue::Pop ( VError* ioError, sLONG inTimeoutMilliseconds )
+{
+	*ioError = VE_OK;
+
+	VConnectionHandler*	vcHandler = _TryPop ( );
+	if ( vcHandler || inTimeoutMilliseconds <= 0 )
+		return vcHandler;
+
+	/* Register before checking again: a producer pushing after this check will see the waiter. */
+	VInterlocked::Increment ( &m_nWaiters );
+
+	vcHandler = _TryPop ( );
+	if ( !vcHandler )
 	{
-		*ioError = VE_SRVR_FAILED_TO_SYNC_LOCK;
-		
-		return NULL;
+		if ( m_vsemWakeUp. Lock ( inTimeoutMilliseconds ) )
+			return _TryPop ( );
 	}
-	
-	VConnectionHandler*			vcHandler = NULL;
-	if ( m_qConnectionHandlers. size ( ) > 0 )
+
+	/* Not woken up: unregister, unless a producer did it already, in which case its signal is left
+	in the semaphore and will only cause a spurious wake up. */
+	sLONG				nWaiters = VInterlocked::AtomicGet ( &m_nWaiters );
+	while ( nWaiters > 0 )
 	{
-		vcHandler = m_qConnectionHandlers. front ( );
-		m_qConnectionHandlers. pop ( );
+		sLONG			nSeen = VInterlocked::CompareExchange ( &m_nWaiters, nWaiters, nWaiters - 1 );
+		if ( nSeen == nWaiters )
+			break;
+
+		nWaiters = nSeen;
 	}
-	
-	*ioError = VE_OK;
-	
-	m_vcsQueueProtector-> Unlock ( );
-	
-	return vcHandler;
+
+	return vcHandler ? vcHandler : _TryPop ( );
+}
+
+bool VConnectionHandlerQueue::WakeUpWaiter ( )
+{
+	sLONG				nWaiters = VInterlocked::AtomicGet ( &m_nWaiters );
+	while ( nWaiters > 0 )
+	{
+		sLONG			nSeen = VInterlocked::CompareExchange ( &m_nWaiters, nWaiters, nWaiters - 1 );
+		if ( nSeen == nWaiters )
+		{
+			m_vsemWakeUp. Unlock ( );
+
+			return true;
+		}
+
+		nWaiters = nSeen;
+	}
+
+	return false;
+}
+
+void VConnectionHandlerQueue::WakeUpAllWaiters ( )
+{
+	sLONG				nWaiters = VInterlocked::Exchange ( &m_nWaiters, 0 );
+	while ( nWaiters-- > 0 )
+		m_vsemWakeUp. Unlock ( );
 }
 
 void VConnectionHandlerQueue::ReleaseAll ( )
 {
-	m_vcsQueueProtector-> Lock ( );
-	
 	VConnectionHandler*			vcHandler = NULL;
-	while ( m_qConnectionHandlers. size ( ) > 0 )
-	{
-		vcHandler = m_qConnectionHandlers. front ( );
-		m_qConnectionHandlers. pop ( );
+	while ( ( vcHandler = _TryPop ( ) ) != NULL )
 		vcHandler-> Release ( );
-	}
-	
-	m_vcsQueueProtector-> Unlock ( );
 }
 
 
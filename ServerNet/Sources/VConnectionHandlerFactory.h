@@ -75,23 +75,69 @@ public :
 };
 
 
-/* A synchronized queue of connection handlers. */
+/* A synchronized queue of connection handlers.
+
+Bounded multi-producer multi-consumer queue without lock: every slot carries a sequence number telling whether
+it's ready to be written or read at a given position, so that producers and consumers only compete, with a
+compare-and-swap, on the position they move.
+
+Consumers may wait for a handler. Waiting uses an event count: a consumer registers as waiter, checks the queue
+again and then sleeps on a semaphore that producers signal only when somebody is registered. Nothing is locked
+when nobody waits. */
 class XTOOLBOX_API VConnectionHandlerQueue : public VObject
 {
 public :
 	
-	VConnectionHandlerQueue ( );
+	enum { kDEFAULT_CAPACITY = 4096 };
+
+	/* inCapacity is rounded up to a power of 2. */
+	VConnectionHandlerQueue ( sLONG inCapacity = kDEFAULT_CAPACITY );
 	~VConnectionHandlerQueue ( );
 	
+	/* Returns VE_SRVR_RESOURCE_TEMPORARILY_UNAVAILABLE if the queue is full: the caller keeps the handler. */
 	VError Push ( VConnectionHandler* inConnectionHandler );
+
+	/* Returns NULL if the queue is empty. */
 	VConnectionHandler* Pop ( VError* ioError );
+
+	/* Waits at most inTimeoutMilliseconds for a handler. May return NULL earlier if WakeUpWaiter()
+	or WakeUpAllWaiters() is called or if another consumer took the handler: callers loop. */
+	VConnectionHandler* Pop ( VError* ioError, sLONG inTimeoutMilliseconds );
+
+	/* Wakes up a consumer waiting in Pop ( ). Returns false if nobody waits. */
+	bool WakeUpWaiter ( );
+	void WakeUpAllWaiters ( );
+
+	sLONG GetWaiterCount ( ) { return VInterlocked::AtomicGet ( &m_nWaiters ); }
+
 	void ReleaseAll ( );
 
 	
 private :
 	
-	VCriticalSection*						m_vcsQueueProtector;
-	std::queue<VConnectionHandler*>			m_qConnectionHandlers;
+	typedef struct Slot
+	{
+		sLONG								fSequence;
+		VConnectionHandler*					fHandler;
+	} Slot;
+
+	VConnectionHandlerQueue ( const VConnectionHandlerQueue& );				/* forbidden */
+	VConnectionHandlerQueue& operator= ( const VConnectionHandlerQueue& );	/* forbidden */
+
+	VConnectionHandler* _TryPop ( );
+
+	Slot*									m_arrSlots;
+	uLONG									m_nMask;
+
+	/* Written by different threads, keep them on different cache lines. */
+	char									m_Padding1 [ 64 ];
+	sLONG									m_nPushPosition;
+	char									m_Padding2 [ 60 ];
+	sLONG									m_nPopPosition;
+	char									m_Padding3 [ 60 ];
+
+	sLONG									m_nWaiters;
+	VSemaphore								m_vsemWakeUp;
 };
 
 
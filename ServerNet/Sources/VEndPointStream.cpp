@@ -78,6 +78,40 @@ XBOX::VError VEndPointStream::DoPutData (const void *inBuffer, VSize inNbBytes)
 		return XBOX::VE_OK;	
 }
 
+XBOX::VError VEndPointStream::PutDataV (const VWriteBuffer *inBuffers, uLONG inCount)
+{
+	xbox_assert(fEndPoint != NULL);
+
+	if (fError != XBOX::VE_OK)
+
+		return fError;
+
+	if (!fIsWriting)
+
+		return fError = XBOX::vThrowError(XBOX::VE_STREAM_CANNOT_WRITE);
+
+	sLONG8	totalBytes;
+
+	totalBytes = 0;
+	for (uLONG i = 0; i < inCount; i++)
+
+		totalBytes += inBuffers[i].fLength;
+
+	if (totalBytes) {
+
+		fError = fEndPoint->WriteExactlyV(inBuffers, inCount, fTimeOut);
+		if (fError == XBOX::VE_OK) {
+
+			fTotalBytes += totalBytes;
+			fPosition += totalBytes;
+
+		}
+
+	}
+
+	return fError;
+}
+
 XBOX::VError VEndPointStream::DoGetData (void *inBuffer, VSize *ioCount)
 {
 	xbox_assert(fEndPoint != NULL);
@@ -31,6 +31,10 @@ public:
 
 	void					SetTimeOut (sLONG inTimeOut);
 
+	// Write several buffers at once, using VTCPEndPoint::WriteExactlyV(). Same semantics as PutData().
+
+	XBOX::VError			PutDataV (const VWriteBuffer *inBuffers, uLONG inCount);
+
 protected:
 
 	// VTCPEndPoint opening or closing is not to be handled by VEndPointStream.
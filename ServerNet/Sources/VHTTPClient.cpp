@@ -44,6 +44,7 @@ typedef unsigned char HASHHEX[HASHHEXLEN+1];
 const sLONG DEFAULT_HTTP_CONNECTION_TIMEOUT					= 120;		/*  2 mins in seconds */
 const sLONG	DEFAULT_HTTP_READ_WRITE_TIMEOUT					= 3600;		/* 60 mins in seconds */
 const sLONG DEFAULT_HTTP_MAX_REDIRECTIONS					= 2;
+const sLONG DEFAULT_HTTP_MAX_PIPELINED_REQUESTS				= 8;
 const sLONG DEFAULT_HTTP_PORT								= 80;
 const sLONG DEFAULT_HTTPS_PORT								= 443;
 
@@ -313,6 +314,28 @@ void _GetMethodName (HTTP_Method inMethod, XBOX::VString& outMethodName)
 }
 
 
+/*
+ *	Requests that may be sent again after connection was lost (RFC 7230 6.3.1): server gives the same result
+ *	whether it processed them once or twice.
+ */
+static
+bool _IsIdempotentMethod (HTTP_Method inMethod)
+{
+	switch (inMethod)
+	{
+	case HTTP_GET:
+	case HTTP_HEAD:
+	case HTTP_PUT:
+	case HTTP_DELETE:
+	case HTTP_OPTIONS:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+
 static
 XBOX::VSize _GetChunkSize (char *inDataPtr)
 {
@@ -537,141 +560,174 @@ const VError	VE_SRVR_ZIP_DECOMPRESSION_FAILED		= MAKE_VERROR (kSERVER_NET_SIGNAT
 const VError	VE_SRVR_ZIP_NON_COMPRESSED_INPUT_DATA	= MAKE_VERROR (kSERVER_NET_SIGNATURE, 502);
 
 
-static inline
-VError _ExpandMemoryBlock (void *inCompressedBlock, sLONG8 inBlockSize, XBOX::VStream& outExpandedStream)
+/*
+ *	Inflates a gzip or deflate encoded body piece by piece, as it is received.
+ *	Data is checked for the gzip or zlib header: as long as nothing could be inflated, received data is kept
+ *	and if it turns out not to be compressed (some servers lie on Content-Encoding), it is passed as is.
+ */
+BEGIN_TOOLBOX_NAMESPACE
+
+class VHTTPBodyInflater : public XBOX::VObject
+{
+public:
+							VHTTPBodyInflater ();
+	virtual					~VHTTPBodyInflater ();
+
+	XBOX::VError			Init ();
+
+	/*
+	 *	Inflated data is passed to inOutputCallBack, which may be called several times.
+	 */
+	XBOX::VError			Put (const void *inData, XBOX::VSize inDataSize, HTTPResponseBodyCallBack inOutputCallBack, void *inOutputPrivateData);
+	XBOX::VError			Finish (HTTPResponseBodyCallBack inOutputCallBack, void *inOutputPrivateData);
+
+private:
+	XBOX::VError			_PassRawData (HTTPResponseBodyCallBack inOutputCallBack, void *inOutputPrivateData);
+
+	z_stream				fStream;
+	bool					fIsInitialized;
+	Bytef *					fBuffer;
+	bool					fHasInflatedData;
+	bool					fIsRaw;				// Data isn't compressed after all, pass it as is.
+	bool					fIsStreamEnded;
+	XBOX::VMemoryBuffer<>	fRawData;			// Received data, until something is inflated.
+};
+
+END_TOOLBOX_NAMESPACE
+
+
+VHTTPBodyInflater::VHTTPBodyInflater ()
+: fIsInitialized (false)
+, fBuffer (NULL)
+, fHasInflatedData (false)
+, fIsRaw (false)
+, fIsStreamEnded (false)
+, fRawData()
+{
+	memset (&fStream, 0, sizeof (z_stream));
+}
+
+
+VHTTPBodyInflater::~VHTTPBodyInflater ()
+{
+	if (fIsInitialized)
+		inflateEnd (&fStream);
+
+	if (NULL != fBuffer)
+		free (fBuffer);
+}
+
+
+XBOX::VError VHTTPBodyInflater::Init ()
+{
+	fBuffer = (Bytef *) malloc (HTTP_CLIENT_BUFFER_SIZE);
+	if (NULL == fBuffer)
+		return XBOX::vThrowError (XBOX::VE_MEMORY_FULL);
+
+	fStream.zalloc = Z_NULL;
+	fStream.zfree = Z_NULL;
+	fStream.opaque = Z_NULL;
+
+	/*
+	 *	JQ 05/02/2009: we need to add 32 to default windowBits in order to enable gzip (+zlib) inflating
+	 *				  (with 15 inflate can inflate only zlib stream)
+	 */
+	if (Z_OK != inflateInit2 (&fStream, 15 + 32))
+		return XBOX::vThrowError (VE_SRVR_ZIP_DECOMPRESSION_FAILED);
+
+	fIsInitialized = true;
+
+	return XBOX::VE_OK;
+}
+
+
+XBOX::VError VHTTPBodyInflater::Put (const void *inData, XBOX::VSize inDataSize, HTTPResponseBodyCallBack inOutputCallBack, void *inOutputPrivateData)
 {
-	if ((inCompressedBlock == NULL) || (inBlockSize < 0))
-		return vThrowError (VE_INVALID_PARAMETER);
+	if (fIsRaw)
+		return inOutputCallBack (inOutputPrivateData, inData, inDataSize);
 
-	if (!outExpandedStream.IsWriting())
-		return vThrowError (VE_STREAM_NOT_OPENED);
+	/*
+	 *	DH 22-Feb-2013 Data following the end of the compressed stream is ignored.
+	 */
+	if (fIsStreamEnded || (0 == inDataSize))
+		return XBOX::VE_OK;
 
-	VError errorToReturn = VE_OK;
+	if (!fHasInflatedData && !fRawData.PutDataAmortized (fRawData.GetDataSize(), inData, inDataSize))
+		return XBOX::vThrowError (XBOX::VE_MEMORY_FULL);
 
-	if (errorToReturn == VE_OK)
+	XBOX::VError	error = XBOX::VE_OK;
+	int				zError = Z_OK;
+
+	fStream.next_in = (Bytef *) inData;
+	fStream.avail_in = (uInt) inDataSize;
+
+	/*
+	 *	Loop until input is consumed and output buffer is not full (nothing is left pending in zlib).
+	 */
+	do
 	{
-		sLONG8 bufferMaxSize = 1000000;
+		fStream.next_out = fBuffer;
+		fStream.avail_out = HTTP_CLIENT_BUFFER_SIZE;
 
-		/*
-		 *	the decompression will be done by steps if needed, decompressing data until the expanded buffer becomes full each time.
-		 */
-		sLONG8 expandedBufferLength = bufferMaxSize;
-		Bytef * expandedBuffer = (Bytef *) malloc(expandedBufferLength  * sizeof(Bytef));
-		if (expandedBuffer == NULL)
-			errorToReturn = vThrowError (VE_MEMORY_FULL);
+		zError = inflate (&fStream, Z_SYNC_FLUSH);
 
-		if (errorToReturn == VE_OK)
+		if ((Z_OK == zError) || (Z_STREAM_END == zError) || (Z_BUF_ERROR == zError))
 		{
-			/*
-			 *	initialization of zlib structure. For info:
-			 *	- next_in/out =  adress of inCompressedBlock/expandedBuffer
-			 *	- avail_in = number of bytes available in the inCompressedBlock
-			 *	- avail_out = remaining free space in the expandedBuffer
-			 *	- total_in = total size of data already expanded
-			 *	- total_out = total size of expanded data
-			 */
-			z_stream zlib_compressedStream;
-			memset(&zlib_compressedStream,0,sizeof(z_stream));
-			
-			zlib_compressedStream.next_in = (Bytef *)inCompressedBlock;
-			zlib_compressedStream.avail_in = inBlockSize;
-			zlib_compressedStream.total_in = 0;
-			zlib_compressedStream.next_out = expandedBuffer;
-			zlib_compressedStream.avail_out = (uInt)expandedBufferLength;
-			zlib_compressedStream.zalloc = Z_NULL;
-			zlib_compressedStream.zfree = Z_NULL;
-			zlib_compressedStream.opaque = Z_NULL;
-			
-			/*
-			 *	initializing decompression
-			 *	JQ 05/02/2009: we need to add 32 to default windowBits
-			 *					in order to enable gzip (+zlib) inflating
-			 *				  (with 15 inflate can inflate only zlib stream)
-			 *				  (SVG component need gzip inflating in order to inflate svgz files
-			 *				   which are gzip compressed)
-			 */
-			int decompressionError = inflateInit2 (&zlib_compressedStream, 15+32);
-			
-			if (decompressionError == Z_OK)
+			XBOX::VSize	inflatedSize = HTTP_CLIENT_BUFFER_SIZE - fStream.avail_out;
+
+			if (inflatedSize > 0)
 			{
-				do
+				if (!fHasInflatedData)
 				{
-					decompressionError = inflate (&zlib_compressedStream, Z_SYNC_FLUSH);
-					
-					/*
-					 *	the remaining size of data to expand must always be ranging between 0 and blockSize.
-					 */
-					xbox_assert (zlib_compressedStream.total_in >= 0);
-					xbox_assert (zlib_compressedStream.total_in <= inBlockSize);
-
-					/*
-					 *	the remaining free space in the expandedBuffer must always be ranging between 0 and expandedBufferLength.
-					 */
-					xbox_assert (zlib_compressedStream.avail_out >= 0);
-					xbox_assert (zlib_compressedStream.avail_out <= expandedBufferLength);
-
-					switch (decompressionError)
-					{
-						case Z_OK:
-						case Z_STREAM_END: 	
-							/*	if there is some expanded data in the expanded buffer, they must be written in the expandedStream. */
-							if ((expandedBufferLength - zlib_compressedStream.avail_out) > 0)
-							{
-								errorToReturn = outExpandedStream.PutData (expandedBuffer, (expandedBufferLength - zlib_compressedStream.avail_out));
-								if (errorToReturn != VE_OK)
-								{
-									errorToReturn = vThrowError (VE_STREAM_CANNOT_WRITE);
-									break;
-								}
-								/* we update next_out and avail_out with the recent emptied buffer. */
-								zlib_compressedStream.next_out = expandedBuffer;
-								zlib_compressedStream.avail_out = (uInt)expandedBufferLength;
-							} 
-							break;
-
-							// error cases
-						case Z_DATA_ERROR:
-							errorToReturn = vThrowError (VE_SRVR_ZIP_NON_COMPRESSED_INPUT_DATA);
-							break;
-							
-						case Z_VERSION_ERROR:
-							errorToReturn = vThrowError (VE_SRVR_ZIP_BAD_VERSION);
-							break;
-							
-						case Z_BUF_ERROR:	
-						case Z_NEED_DICT:
-						case Z_STREAM_ERROR:
-						case Z_MEM_ERROR:
-							errorToReturn = vThrowError (VE_SRVR_ZIP_DECOMPRESSION_FAILED);
-							break;	
-					}
-					
+					fHasInflatedData = true;
+					fRawData.Clear();
 				}
-				/*
-				 *	we stop looping if there are no more data to expand, or if an error occured in decompression
-				 */
-				while ((errorToReturn == VE_OK) && (decompressionError != Z_STREAM_END));
-				/*
-				 *	DH 22-Feb-2013 In case the blob is corrupted we have to stop on Z_STREAM_END even if blockSize>zlib_compressedStream.total_in 
-				 *	otherwise we loop indefinitely (see http://www.zlib.net/zlib_how.html for usage example)
-				 */
 
-				inflateEnd (&zlib_compressedStream);	// YT 13-Mar-2009 - ACI0060740
-			}
-			/*
-			 *	if the initilization of decompression failed.
-			 */
-			else
-			{
-				errorToReturn = vThrowError (VE_SRVR_ZIP_DECOMPRESSION_FAILED);
+				error = inOutputCallBack (inOutputPrivateData, fBuffer, inflatedSize);
 			}
-		}
 
-		if (expandedBuffer != NULL)
-			free (expandedBuffer);
+			if (Z_STREAM_END == zError)
+				fIsStreamEnded = true;
+			else if (Z_BUF_ERROR == zError)
+				break;	// No progress possible: more input is needed.
+		}
+		else if (!fHasInflatedData)
+		{
+			return _PassRawData (inOutputCallBack, inOutputPrivateData);
+		}
+		else
+		{
+			error = XBOX::vThrowError ((Z_VERSION_ERROR == zError) ? VE_SRVR_ZIP_BAD_VERSION : VE_SRVR_ZIP_DECOMPRESSION_FAILED);
+		}
 	}
-	
-	return errorToReturn;
+	while ((XBOX::VE_OK == error) && !fIsStreamEnded && ((fStream.avail_in > 0) || (0 == fStream.avail_out)));
+
+	return error;
+}
+
+
+XBOX::VError VHTTPBodyInflater::Finish (HTTPResponseBodyCallBack inOutputCallBack, void *inOutputPrivateData)
+{
+	/*
+	 *	Body too short to be compressed data.
+	 */
+	if (!fIsRaw && !fHasInflatedData && (fRawData.GetDataSize() > 0))
+		return _PassRawData (inOutputCallBack, inOutputPrivateData);
+
+	return XBOX::VE_OK;
+}
+
+
+XBOX::VError VHTTPBodyInflater::_PassRawData (HTTPResponseBodyCallBack inOutputCallBack, void *inOutputPrivateData)
+{
+	XBOX::VError	error = XBOX::VE_OK;
+
+	fIsRaw = true;
+	if (fRawData.GetDataSize() > 0)
+		error = inOutputCallBack (inOutputPrivateData, fRawData.GetDataPtr(), fRawData.GetDataSize());
+	fRawData.Clear();
+
+	return error;
 }
 
 
@@ -746,6 +802,408 @@ void VAuthInfos::Clear()
 //--------------------------------------------------------------------------------------------------
 
 
+VHTTPConnectionPool *			VHTTPConnectionPool::sInstance = NULL;
+
+
+VHTTPConnectionPool::VHTTPConnectionPool()
+: fMaxConnectionsPerHost (DEFAULT_MAX_CONNECTIONS_PER_HOST)
+, fIdleTimeout (DEFAULT_IDLE_TIMEOUT)
+, fPurgeTask (NULL)
+{
+	::memset (&fStatistics, 0, sizeof (fStatistics));
+}
+
+
+VHTTPConnectionPool::~VHTTPConnectionPool()
+{
+	Purge (false);
+
+	for (MapOfHostEntry::iterator it = fHosts.begin(); it != fHosts.end(); ++it)
+		XBOX::VSslDelegate::ReleaseSession (&it->second.fSslSession);
+}
+
+
+/* static */
+void VHTTPConnectionPool::Init()
+{
+	if (NULL == sInstance)
+	{
+		sInstance = new VHTTPConnectionPool();
+		sInstance->_StartPurgeTask();
+	}
+}
+
+
+/* static */
+void VHTTPConnectionPool::DeInit()
+{
+	// A purge task stuck in closing connections still uses the pool: it is leaked rather than freed under its feet.
+	if ((NULL != sInstance) && sInstance->_StopPurgeTask())
+		delete sInstance;
+
+	sInstance = NULL;
+}
+
+
+/* static */
+VHTTPConnectionPool *VHTTPConnectionPool::Get()
+{
+	return sInstance;
+}
+
+
+/* static */
+void VHTTPConnectionPool::_MakeKey (const XBOX::VString& inDNSNameOrIP, sLONG inPort, bool inUseSSL, XBOX::VString& outKey)
+{
+	outKey.FromString (inDNSNameOrIP);
+	outKey.ToLowerCase();
+	outKey.AppendUniChar (CHAR_COLON);
+	outKey.AppendLong (inPort);
+	if (inUseSSL)
+		outKey.AppendCString ("/ssl");
+}
+
+
+void VHTTPConnectionPool::_CollectExpired (uLONG inNow, std::vector<XBOX::VTCPEndPoint *>& outEndPoints)
+{
+	// fMutex must be locked.
+	uLONG idleTimeoutMS = (uLONG) fIdleTimeout * 1000;
+
+	for (MapOfHostEntry::iterator it = fHosts.begin(); it != fHosts.end(); ++it)
+	{
+		std::vector<IdleConnection>& idle = it->second.fIdle;
+
+		for (std::vector<IdleConnection>::iterator itIdle = idle.begin(); itIdle != idle.end();)
+		{
+			if ((inNow - itIdle->fIdleSince) >= idleTimeoutMS)
+			{
+				outEndPoints.push_back (itIdle->fEndPoint);
+				itIdle = idle.erase (itIdle);
+				--it->second.fPooledCount;
+				++fStatistics.fEvictions;
+			}
+			else
+			{
+				++itIdle;
+			}
+		}
+	}
+
+	// Forget hosts with no connection left, and no SSL session recently used.
+	for (MapOfHostEntry::iterator it = fHosts.begin(); it != fHosts.end();)
+	{
+		HostEntry& entry = it->second;
+
+		if (entry.fIdle.empty() && (0 == entry.fPooledCount) && ((NULL == entry.fSslSession) || ((inNow - entry.fLastUsed) >= idleTimeoutMS)))
+		{
+			XBOX::VSslDelegate::ReleaseSession (&entry.fSslSession);
+			fHosts.erase (it++);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+
+/* static */
+void VHTTPConnectionPool::_CloseEndPoints (std::vector<XBOX::VTCPEndPoint *>& ioEndPoints)
+{
+	// Closing may block a little (SSL shutdown): never done while fMutex is locked.
+	for (std::vector<XBOX::VTCPEndPoint *>::iterator it = ioEndPoints.begin(); it != ioEndPoints.end(); ++it)
+	{
+		(*it)->Close();
+		XBOX::ReleaseRefCountable (&(*it));
+	}
+
+	ioEndPoints.clear();
+}
+
+
+void VHTTPConnectionPool::_StartPurgeTask ()
+{
+	fPurgeTask = new XBOX::VTask (this, 0, XBOX::eTaskStylePreemptive, _PurgeTaskRun);
+
+	if (NULL != fPurgeTask)
+	{
+		fPurgeTask->SetName (CVSTR ("HTTP Connection Pool Purge"));
+		fPurgeTask->SetKindData ((sLONG_PTR) this);
+		fPurgeTask->Run();
+	}
+}
+
+
+bool VHTTPConnectionPool::_StopPurgeTask ()
+{
+	if (NULL == fPurgeTask)
+		return true;
+
+	fPurgeTask->Kill();
+	fPurgeEvent.Unlock();
+
+	if (!fPurgeTask->WaitForDeath (5000))
+		return false;
+
+	XBOX::ReleaseRefCountable (&fPurgeTask);
+
+	return true;
+}
+
+
+/* static */
+sLONG VHTTPConnectionPool::_PurgeTaskRun (XBOX::VTask *inTask)
+{
+	VHTTPConnectionPool *pool = reinterpret_cast<VHTTPConnectionPool *>(inTask->GetKindData());
+
+	// Expired connections are otherwise only closed when pool is used.
+	while (!inTask->IsDying())
+	{
+		pool->fPurgeEvent.Lock (PURGE_INTERVAL);
+
+		if (!inTask->IsDying())
+			pool->Purge (true);
+	}
+
+	return 0;
+}
+
+
+XBOX::VTCPEndPoint *VHTTPConnectionPool::RetainConnection (const XBOX::VString& inDNSNameOrIP, sLONG inPort, bool inUseSSL, sLONG inConnectionTimeoutMS, bool *outIsPooled, bool *outIsReused, XBOX::VError& outError)
+{
+	XBOX::VString							key;
+	XBOX::VTCPEndPoint *					endPoint = NULL;
+	void *									sslSession = NULL;
+	bool									isPooled = false;
+	std::vector<XBOX::VTCPEndPoint *>		expired;
+
+	outError = XBOX::VE_OK;
+	_MakeKey (inDNSNameOrIP, inPort, inUseSSL, key);
+
+	{
+		XBOX::StLocker<XBOX::VCriticalSection>	lock (&fMutex);
+
+		_CollectExpired (XBOX::VSystem::GetCurrentTime(), expired);
+
+		HostEntry& entry = fHosts[key];	// Value initialized if new.
+
+		entry.fLastUsed = XBOX::VSystem::GetCurrentTime();
+
+		if (!entry.fIdle.empty())
+		{
+			// Most recently used first: it is the least likely to have been closed by server.
+			endPoint = entry.fIdle.back().fEndPoint;
+			entry.fIdle.pop_back();
+			isPooled = true;
+			++fStatistics.fHits;
+		}
+		else
+		{
+			isPooled = (entry.fPooledCount < fMaxConnectionsPerHost);
+			if (isPooled)
+				++entry.fPooledCount;
+			++fStatistics.fMisses;
+
+			if (inUseSSL && (NULL != entry.fSslSession))
+			{
+				// Take a reference for use outside of lock.
+				sslSession = entry.fSslSession;
+				entry.fSslSession = NULL;
+			}
+		}
+	}
+
+	_CloseEndPoints (expired);
+
+	if (NULL != endPoint)
+	{
+		if (NULL != outIsPooled)
+			*outIsPooled = true;
+		if (NULL != outIsReused)
+			*outIsReused = true;
+
+		return endPoint;
+	}
+
+	endPoint = XBOX::VTCPEndPointFactory::CreateClientConnection (inDNSNameOrIP, inPort, inUseSSL, true, inConnectionTimeoutMS, NULL, outError);
+	if (XBOX::VE_OK != outError)
+		XBOX::ReleaseRefCountable (&endPoint);
+
+	if ((NULL != endPoint) && (NULL != sslSession) && (NULL != endPoint->GetSSLDelegate()))
+	{
+		// Handshake occurs at first write: offer the previous session to the server.
+		XBOX::StErrorContextInstaller	errorContext (false);
+
+		endPoint->GetSSLDelegate()->SetSession (sslSession);
+	}
+
+	{
+		XBOX::StLocker<XBOX::VCriticalSection>	lock (&fMutex);
+
+		HostEntry& entry = fHosts[key];	// May have been dropped meanwhile if not pooled.
+
+		entry.fLastUsed = XBOX::VSystem::GetCurrentTime();
+
+		if ((NULL == endPoint) && isPooled)
+		{
+			--entry.fPooledCount;
+			isPooled = false;
+		}
+
+		// Give session back, unless a newer one has been saved meanwhile.
+		if ((NULL != sslSession) && (NULL == entry.fSslSession))
+		{
+			entry.fSslSession = sslSession;
+			sslSession = NULL;
+		}
+	}
+
+	XBOX::VSslDelegate::ReleaseSession (&sslSession);
+
+	if (NULL != outIsPooled)
+		*outIsPooled = isPooled;
+	if (NULL != outIsReused)
+		*outIsReused = false;
+
+	return endPoint;
+}
+
+
+void VHTTPConnectionPool::ReleaseConnection (XBOX::VTCPEndPoint *inEndPoint, const XBOX::VString& inDNSNameOrIP, sLONG inPort, bool inUseSSL, bool inIsReusable)
+{
+	XBOX::VString						key;
+	void *								sslSession = NULL;
+	std::vector<XBOX::VTCPEndPoint *>	toClose;
+
+	_MakeKey (inDNSNameOrIP, inPort, inUseSSL, key);
+
+	if (NULL == inEndPoint)
+	{
+		// Connection has been stolen, just forget about it.
+		XBOX::StLocker<XBOX::VCriticalSection>	lock (&fMutex);
+
+		--fHosts[key].fPooledCount;
+		++fStatistics.fDiscards;
+
+		return;
+	}
+
+	if (inIsReusable && inUseSSL && (NULL != inEndPoint->GetSSLDelegate()))
+		sslSession = inEndPoint->GetSSLDelegate()->RetainSession();
+
+	{
+		XBOX::StLocker<XBOX::VCriticalSection>	lock (&fMutex);
+
+		uLONG		now = XBOX::VSystem::GetCurrentTime();
+		HostEntry&	entry = fHosts[key];
+
+		entry.fLastUsed = now;
+
+		if (NULL != sslSession)
+			std::swap (sslSession, entry.fSslSession);
+
+		if (inIsReusable && (fIdleTimeout > 0))
+		{
+			IdleConnection	idle;
+
+			idle.fEndPoint = inEndPoint;
+			idle.fIdleSince = now;
+			entry.fIdle.push_back (idle);
+		}
+		else
+		{
+			toClose.push_back (inEndPoint);
+			--entry.fPooledCount;
+			++fStatistics.fDiscards;
+		}
+
+		xbox_assert(entry.fPooledCount >= 0);
+
+		_CollectExpired (now, toClose);
+	}
+
+	XBOX::VSslDelegate::ReleaseSession (&sslSession);
+	_CloseEndPoints (toClose);
+}
+
+
+void VHTTPConnectionPool::NotifySessionResumption ()
+{
+	XBOX::StLocker<XBOX::VCriticalSection>	lock (&fMutex);
+
+	++fStatistics.fSessionResumptions;
+}
+
+
+void VHTTPConnectionPool::Purge (bool inExpiredOnly)
+{
+	std::vector<XBOX::VTCPEndPoint *>	toClose;
+
+	{
+		XBOX::StLocker<XBOX::VCriticalSection>	lock (&fMutex);
+
+		if (inExpiredOnly)
+		{
+			_CollectExpired (XBOX::VSystem::GetCurrentTime(), toClose);
+		}
+		else
+		{
+			for (MapOfHostEntry::iterator it = fHosts.begin(); it != fHosts.end(); ++it)
+			{
+				for (std::vector<IdleConnection>::iterator itIdle = it->second.fIdle.begin(); itIdle != it->second.fIdle.end(); ++itIdle)
+				{
+					toClose.push_back (itIdle->fEndPoint);
+					--it->second.fPooledCount;
+					++fStatistics.fEvictions;
+				}
+
+				it->second.fIdle.clear();
+			}
+		}
+	}
+
+	_CloseEndPoints (toClose);
+}
+
+
+void VHTTPConnectionPool::SetMaxConnectionsPerHost (sLONG inValue)
+{
+	XBOX::StLocker<XBOX::VCriticalSection>	lock (&fMutex);
+
+	fMaxConnectionsPerHost = (inValue > 0) ? inValue : 0;
+}
+
+
+void VHTTPConnectionPool::SetIdleTimeout (sLONG inValue)
+{
+	{
+		XBOX::StLocker<XBOX::VCriticalSection>	lock (&fMutex);
+
+		fIdleTimeout = (inValue > 0) ? inValue : 0;
+	}
+
+	Purge (true);
+}
+
+
+void VHTTPConnectionPool::GetStatistics (Statistics& outStatistics) const
+{
+	XBOX::StLocker<XBOX::VCriticalSection>	lock (&fMutex);
+
+	outStatistics = fStatistics;
+	outStatistics.fIdleCount = outStatistics.fActiveCount = 0;
+
+	for (MapOfHostEntry::const_iterator it = fHosts.begin(); it != fHosts.end(); ++it)
+	{
+		outStatistics.fIdleCount += (sLONG) it->second.fIdle.size();
+		outStatistics.fActiveCount += it->second.fPooledCount - (sLONG) it->second.fIdle.size();
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------
+
+
 VAuthInfos						VHTTPClient::fSavedHTTPAuthenticationInfos;
 VAuthInfos						VHTTPClient::fSavedProxyAuthenticationInfos;
 XBOX::VString					VHTTPClient::fUserAgent;
@@ -760,6 +1218,10 @@ VHTTPClient::VHTTPClient()
 , fResponseHeaderBuffer()
 , fLeftOver()
 , fResponseBody()
+, fResponseBodyStream (NULL)
+, fResponseBodyCallBackPtr (NULL)
+, fResponseBodyCallBackPrivateData (NULL)
+, fIsResponseBodyStreamed (false)
 , fProgressionCallBackPtr (NULL)
 , fProgressionCallBackPrivateData (NULL)
 , fAuthenticationDialogCallBackPtr (NULL)
@@ -774,6 +1236,9 @@ VHTTPClient::VHTTPClient()
 , fPort (DEFAULT_HTTP_PORT)
 , fUseProxy (false)
 , fNTLMAuthenticationInProgress (false)
+, fBodyInflater (NULL)
+, fPipelinedRequests()
+, fMaxPipelinedRequests (DEFAULT_HTTP_MAX_PIPELINED_REQUESTS)
 , fHTTPAuthenticationInfos ()
 , fProxyAuthenticationInfos ()
 , fResetAuthenticationInfos (false)
@@ -788,6 +1253,12 @@ VHTTPClient::VHTTPClient()
 , fContentType()
 , fTCPEndPoint (NULL)
 , fNumberOfRequests (0)
+, fUseConnectionPool (true)
+, fIsPooledConnection (false)
+, fIsReusedConnection (false)
+, fIsConnectionReusable (false)
+, fPooledPort (0)
+, fPooledUseSSL (false)
 , fUseHTTPCompression (false)
 , fFollowRedirect (true)
 , fMaxRedirections (DEFAULT_HTTP_MAX_REDIRECTIONS)
@@ -808,6 +1279,10 @@ VHTTPClient::VHTTPClient (const XBOX::VURL& inURL, const XBOX::VString& inConten
 , fResponseHeaderBuffer()
 , fLeftOver()
 , fResponseBody()
+, fResponseBodyStream (NULL)
+, fResponseBodyCallBackPtr (NULL)
+, fResponseBodyCallBackPrivateData (NULL)
+, fIsResponseBodyStreamed (false)
 , fProgressionCallBackPtr (NULL)
 , fProgressionCallBackPrivateData (NULL)
 , fAuthenticationDialogCallBackPtr (NULL)
@@ -822,6 +1297,9 @@ VHTTPClient::VHTTPClient (const XBOX::VURL& inURL, const XBOX::VString& inConten
 , fPort (DEFAULT_HTTP_PORT)
 , fUseProxy (false)
 , fNTLMAuthenticationInProgress (false)
+, fBodyInflater (NULL)
+, fPipelinedRequests()
+, fMaxPipelinedRequests (DEFAULT_HTTP_MAX_PIPELINED_REQUESTS)
 , fHTTPAuthenticationInfos ()
 , fProxyAuthenticationInfos ()
 , fResetAuthenticationInfos (false)
@@ -836,6 +1314,12 @@ VHTTPClient::VHTTPClient (const XBOX::VURL& inURL, const XBOX::VString& inConten
 , fContentType()
 , fTCPEndPoint (NULL)
 , fNumberOfRequests (0)
+, fUseConnectionPool (true)
+, fIsPooledConnection (false)
+, fIsReusedConnection (false)
+, fIsConnectionReusable (false)
+, fPooledPort (0)
+, fPooledUseSSL (false)
 , fUseHTTPCompression (false)
 , fFollowRedirect (true)
 , fMaxRedirections (DEFAULT_HTTP_MAX_REDIRECTIONS)
@@ -924,6 +1408,11 @@ VHTTPClient::~VHTTPClient()
 	fResponseBody.Clear();
 	fLeftOver.Clear();
 
+	delete fBodyInflater;
+	fBodyInflater = NULL;
+
+	ClearPipelinedRequests();
+
 	CloseConnection();
 
 #if WITH_HTTP_CLIENT_DEBUG_LOG
@@ -990,16 +1479,36 @@ void VHTTPClient::ClearSavedAuthenticationInfos()
 }
 
 
-XBOX::VError VHTTPClient::_OpenConnection (const XBOX::VString& inDNSNameOrIP, const sLONG inPort, bool inUseSSL, XBOX::VTCPSelectIOPool *inSelectIOPool)
+XBOX::VError VHTTPClient::_OpenConnection (const XBOX::VString& inDNSNameOrIP, const sLONG inPort, bool inUseSSL, XBOX::VTCPSelectIOPool *inSelectIOPool, bool inMayUsePool)
 {
 	XBOX::VError error = XBOX::VE_OK;
 
 	if (NULL == fTCPEndPoint)
 	{
-		sLONG			connectionTimeoutMS = XBOX::Abs(fConnectionTimeout) * 1000;
-		XBOX::VError	connectionError = XBOX::VE_OK;
+		sLONG					connectionTimeoutMS = XBOX::Abs(fConnectionTimeout) * 1000;
+		XBOX::VError			connectionError = XBOX::VE_OK;
+		VHTTPConnectionPool *	pool = VHTTPConnectionPool::Get();
+
+		fIsPooledConnection = fIsReusedConnection = fIsConnectionReusable = false;
+
+		/*
+		 *	Keep-Alive connections are shared process wide, unless socket is to be stolen (WebSockets) or used with SelectIO
+		 */
+		if (inMayUsePool && fUseConnectionPool && fKeepAlive && !fUpgradeRequest && (NULL == inSelectIOPool) && (NULL != pool))
+		{
+			fTCPEndPoint = pool->RetainConnection (inDNSNameOrIP, inPort, inUseSSL, connectionTimeoutMS, &fIsPooledConnection, &fIsReusedConnection, connectionError);
+			if (fIsPooledConnection)
+			{
+				fPooledDNSNameOrIP.FromString (inDNSNameOrIP);
+				fPooledPort = inPort;
+				fPooledUseSSL = inUseSSL;
+			}
+		}
+		else
+		{
+			fTCPEndPoint = XBOX::VTCPEndPointFactory::CreateClientConnection(inDNSNameOrIP, inPort, inUseSSL, true, connectionTimeoutMS, inSelectIOPool, connectionError);
+		}
 
-		fTCPEndPoint = XBOX::VTCPEndPointFactory::CreateClientConnection(inDNSNameOrIP, inPort, inUseSSL, true, connectionTimeoutMS, inSelectIOPool, connectionError);
 		if (XBOX::VE_OK != connectionError)
 		{
 			error = XBOX::vThrowError(connectionError);
@@ -1113,7 +1622,7 @@ XBOX::VError VHTTPClient::OpenConnection (XBOX::VTCPSelectIOPool *inSelectIOPool
 		/*
 		 *	Open Connection according fUseSSL flag except for SSL connection through proxy (always in HTTP)
 		 */
-		error = _OpenConnection (dnsNameOrIP, port, bSendConnectToProxy ? false : fUseSSL, inSelectIOPool);
+		error = _OpenConnection (dnsNameOrIP, port, bSendConnectToProxy ? false : fUseSSL, inSelectIOPool, !bSendConnectToProxy);
 
 		if (XBOX::VE_OK == error)
 		{
@@ -1188,8 +1697,25 @@ XBOX::VError VHTTPClient::CloseConnection()
 
 	if (NULL != fTCPEndPoint)
 	{
-		error = fTCPEndPoint->Close();
-		XBOX::ReleaseRefCountable (&fTCPEndPoint);
+		VHTTPConnectionPool *pool = VHTTPConnectionPool::Get();
+
+		if (fIsPooledConnection && (NULL != pool))
+		{
+			// Handshake is over: a new connection may have resumed the session offered by pool.
+			if (!fIsReusedConnection && fPooledUseSSL && (NULL != fTCPEndPoint->GetSSLDelegate()) && fTCPEndPoint->GetSSLDelegate()->IsSessionReused())
+				pool->NotifySessionResumption();
+
+			// Pool takes ownership (idle connection or closed).
+			pool->ReleaseConnection (fTCPEndPoint, fPooledDNSNameOrIP, fPooledPort, fPooledUseSSL, fIsConnectionReusable);
+			fTCPEndPoint = NULL;
+		}
+		else
+		{
+			error = fTCPEndPoint->Close();
+			XBOX::ReleaseRefCountable (&fTCPEndPoint);
+		}
+
+		fIsPooledConnection = fIsReusedConnection = fIsConnectionReusable = false;
 	}
 
 	return error;
@@ -1201,6 +1727,13 @@ XBOX::VTCPEndPoint *VHTTPClient::StealEndPoint ()
 
 	if ((endPoint = fTCPEndPoint) != NULL)
 	{
+		VHTTPConnectionPool *pool = VHTTPConnectionPool::Get();
+
+		// A stolen connection never goes back to pool.
+		if (fIsPooledConnection && (NULL != pool))
+			pool->ReleaseConnection (NULL, fPooledDNSNameOrIP, fPooledPort, fPooledUseSSL, false);
+
+		fIsPooledConnection = fIsReusedConnection = fIsConnectionReusable = false;
 		fTCPEndPoint = NULL;
 	}
 
@@ -1222,10 +1755,39 @@ XBOX::VError VHTTPClient::SendRequest (HTTP_Method inMethod)
 
 XBOX::VError VHTTPClient::ReadResponseHeader ()
 {	
+	StartReadingResponseHeader();
+
+	return _ReadResponseHeaderFromSocket();
+}
+
+XBOX::VError VHTTPClient::_ReadPipelinedResponseHeader ()
+{
+	/*
+	 *	Data read after previous response is the beginning of this one.
+	 */
+	XBOX::VMemoryBuffer<>	pendingData;
+	XBOX::VError			error = XBOX::VE_OK;
+	bool					isComplete = false;
+
+	pendingData.SetDataPtr(fLeftOver.GetDataPtr(), fLeftOver.GetDataSize(), fLeftOver.GetAllocatedSize());
+	fLeftOver.ForgetData();
+
+	StartReadingResponseHeader();
+
+	if (pendingData.GetDataSize() > 0)
+		error = ContinueReadingResponseHeader((const char *) pendingData.GetDataPtr(), pendingData.GetDataSize(), &isComplete);
+
+	if ((XBOX::VE_OK == error) && !isComplete)
+		error = _ReadResponseHeaderFromSocket();
+
+	return error;
+}
+
+XBOX::VError VHTTPClient::_ReadResponseHeaderFromSocket ()
+{
 	XBOX::VError	error;
 	sLONG			tryCount;
 
-	StartReadingResponseHeader();
 	tryCount = 0;
 	for ( ; ; ) {
 
@@ -2228,10 +2790,29 @@ sLONG VHTTPClient::_ExtractHTTPStatusCode() const
 }
 
 
-void VHTTPClient::_SetBodyReply (char *inBody, XBOX::VSize inBodySize)
+bool VHTTPClient::_IsResponseHandledBySend()
+{
+	if (fUseAuthentication && ((401 == fStatusCode) || (407 == fStatusCode)))
+		return true;
+
+	if (fFollowRedirect && ((301 == fStatusCode) || (302 == fStatusCode) || (303 == fStatusCode) || (307 == fStatusCode)))
+		return fResponseHeader.IsHeaderSet (CONST_STRING_LOCATION);
+
+	return false;
+}
+
+
+XBOX::VError VHTTPClient::_StartResponseBody (bool inMayStream)
 {
 	fResponseBody.Clear();
-	fResponseBody.SetDataPtr (inBody, inBodySize, inBodySize);
+
+	delete fBodyInflater;
+	fBodyInflater = NULL;
+
+	fIsResponseBodyStreamed = inMayStream && ((NULL != fResponseBodyStream) || (NULL != fResponseBodyCallBackPtr)) && !_IsResponseHandledBySend();
+
+	if (fIsResponseBodyStreamed && (NULL != fResponseBodyStream) && !fResponseBodyStream->IsWriting())
+		return XBOX::vThrowError (XBOX::VE_STREAM_NOT_OPENED);
 
 	// Decompress body data (when applicable)
 	XBOX::VString	valueString;
@@ -2240,38 +2821,77 @@ void VHTTPClient::_SetBodyReply (char *inBody, XBOX::VSize inBodySize)
 		((EqualASCIIString (valueString, CONST_STRING_DEFLATE)) || 
 		(EqualASCIIString (valueString, CONST_STRING_GZIP))))
 	{
-		XBOX::VPtrStream	stream;
-		XBOX::VError		error;
+		fBodyInflater = new VHTTPBodyInflater();
+		if (NULL == fBodyInflater)
+			return XBOX::vThrowError (XBOX::VE_MEMORY_FULL);
 
-		stream.OpenWriting();
-		error = _ExpandMemoryBlock(fResponseBody.GetDataPtr(), fResponseBody.GetDataSize(), stream);
-		stream.CloseWriting(true);
+		XBOX::VError	error = fBodyInflater->Init();
 
-		if (error == VE_OK)
+		if (XBOX::VE_OK != error)
 		{
-			char *		dataPtr = (char *)malloc(stream.GetSize());
-			XBOX::VSize	dataSize = stream.GetSize();
+			/*
+			 *	Body will be kept compressed
+			 */
+			delete fBodyInflater;
+			fBodyInflater = NULL;
+
+			if (fIsResponseBodyStreamed)
+				return error;
+		}
+	}
+
+	return XBOX::VE_OK;
+}
+
+
+XBOX::VError VHTTPClient::_PutResponseBodyData (const void *inData, XBOX::VSize inDataSize)
+{
+	if (NULL != fBodyInflater)
+		return fBodyInflater->Put (inData, inDataSize, _WriteResponseBodyDataCallBack, this);
+	else
+		return _WriteResponseBodyData (inData, inDataSize);
+}
+
+
+XBOX::VError VHTTPClient::_EndResponseBody()
+{
+	XBOX::VError	error = XBOX::VE_OK;
+
+	if (NULL != fBodyInflater)
+	{
+		error = fBodyInflater->Finish (_WriteResponseBodyDataCallBack, this);
+
+		delete fBodyInflater;
+		fBodyInflater = NULL;
+	}
+
+	return error;
+}
+
+
+XBOX::VError VHTTPClient::_WriteResponseBodyData (const void *inData, XBOX::VSize inDataSize)
+{
+	if (!fIsResponseBodyStreamed)
+	{
+		if (!fResponseBody.PutDataAmortized (fResponseBody.GetDataSize(), inData, inDataSize))
+			return XBOX::vThrowError (XBOX::VE_MEMORY_FULL);
+
+		return XBOX::VE_OK;
+	}
+	else if (NULL != fResponseBodyStream)
+	{
+		return fResponseBodyStream->PutData (inData, inDataSize);
+	}
+	else
+	{
+		return fResponseBodyCallBackPtr (fResponseBodyCallBackPrivateData, inData, inDataSize);
+	}
+}
 
-			if (dataPtr != NULL)
-			{
-				stream.OpenReading();
-				error = stream.GetData(dataPtr, dataSize);
-				stream.CloseReading();
 
-				// Replace compressed body content by the new expanded one
-				if (error == VE_OK)
-				{
-					fResponseBody.Clear();
-					fResponseBody.SetDataPtr(dataPtr, dataSize, dataSize);
-				}
-				else
-				{
-					free(dataPtr);
-					dataPtr = NULL;
-				}
-			}
-		}
-	}
+XBOX::VError VHTTPClient::_WriteResponseBodyDataCallBack (void *ioPrivateData, const void *inData, XBOX::VSize inDataSize)
+{
+	return ((VHTTPClient *) ioPrivateData)->_WriteResponseBodyData (inData, inDataSize);
 }
 
 
@@ -2469,12 +3089,13 @@ bool VHTTPClient::AddNtlmAuthorizationHeader (const XBOX::VString& inAuthorizati
 }
 
 
-XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
+XBOX::VError VHTTPClient::_SendRequestAndReadResponseHeader()
 {
 	XBOX::VError			error = XBOX::VE_OK;
-	bool					isHeaderOK = false;
 	sLONG					progressionPercentage = 15;
 
+	fIsConnectionReusable = false;
+
 	if (NULL != fProgressionCallBackPtr)
 		fProgressionCallBackPtr(fProgressionCallBackPrivateData, PROGSTATUS_STARTING, 0);
 
@@ -2507,16 +3128,27 @@ XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
 	_LogData((char *)RESPONSE_MARKER_STRING, strlen(RESPONSE_MARKER_STRING));
 #endif
 
+	if (XBOX::VE_OK == error)
+		error = ReadResponseHeader ();
+
+	return error;
+}
+
+
+XBOX::VError VHTTPClient::_ReceiveResponseBody (bool inMayStream, bool& outIsBodyDelimited)
+{
+	bool			isBodyDelimited = true;
+	XBOX::VError	error = _StartResponseBody (inMayStream);
+
 	if (XBOX::VE_OK == error)
 	{
-		XBOX::VSize	bufferSize = HTTP_CLIENT_BUFFER_SIZE;
-		char *		buffer = (char *) malloc (HTTP_CLIENT_BUFFER_SIZE);
-		bool		previousLineEndedWithCRLF = false;
+		XBOX::VSize		bufferSize = HTTP_CLIENT_BUFFER_SIZE;
+		char *			buffer = (char *) malloc (HTTP_CLIENT_BUFFER_SIZE);
+		XBOX::VError	bodyError = XBOX::VE_OK;	// Error from body decoding or from body stream / call back.
 
 		if (NULL == buffer)
 			error = XBOX::vThrowError (XBOX::VE_MEMORY_FULL);
 
-		error = ReadResponseHeader ();
 		if (XBOX::VE_OK == error)
 		{
 			if (HTTP_HEAD != fRequestMethod)	// YT 19-Sep-2011 - ACI0073045 - Do not try to read message body with HEAD request
@@ -2535,47 +3167,32 @@ XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
 					// cool, there is a Content-Length
 					if (curr_body_len > 0)	// if 0, do nothing
 					{
-						XBOX::VMemoryBuffer<>	memoryBuffer;
 						XBOX::VSize				chunkSize = 0;
-                        
-                        //jmo - Correction partielle pour le pb du keep-alive qui ne rend pas la main :
-                        //      S'il reste des données dans leftOver (cad si on a lu plus que les headers
-                        //      en première lecture), on place les données non lues au début de memoryBuffer,
-                        //      comme si elles venaient tout juste d'être lues (et on ajuste curr_body_len).
-                        if(fLeftOver.GetDataSize()>0)
-                        {
-                            memoryBuffer.PutDataAmortized(0, fLeftOver.GetDataPtr(), fLeftOver.GetDataSize());
-                            fLeftOver.Clear();
-                            curr_body_len-=memoryBuffer.GetDataSize();
-                        }
-                        
-                        while ((XBOX::VE_OK == error) && (curr_body_len > 0))
+
+						/*
+						 *	Never read past the body: with pipelined requests, next response follows.
+						 *	Data already received with header (fLeftOver) is read first by _ReadFromSocket().
+						 */
+						while ((XBOX::VE_OK == error) && (XBOX::VE_OK == bodyError) && (curr_body_len > 0))
 						{
-							chunkSize = HTTP_CLIENT_BUFFER_SIZE;
-							error = _ReadFromSocket(buffer, HTTP_CLIENT_BUFFER_SIZE, chunkSize);
+							chunkSize = (XBOX::VSize) XBOX::Min<sLONG8>(curr_body_len, HTTP_CLIENT_BUFFER_SIZE);
+							error = _ReadFromSocket(buffer, chunkSize, chunkSize);
 
 							if ((XBOX::VE_OK == error) && (chunkSize > 0))
 							{
-								memoryBuffer.PutDataAmortized(memoryBuffer.GetDataSize(), (const void *)buffer, chunkSize);
+								bodyError = _PutResponseBodyData((const void *)buffer, chunkSize);
 								curr_body_len -= chunkSize;
 							}
 
 							XBOX::VTask::Yield();
 						}
 
-						if (NULL != memoryBuffer.GetDataPtr())
-						{
-							_SetBodyReply((char *)memoryBuffer.GetDataPtr(), memoryBuffer.GetDataSize());
-							memoryBuffer.ForgetData();
-						}
-
+						isBodyDelimited = (XBOX::VE_OK == error) && (XBOX::VE_OK == bodyError) && (0 == curr_body_len);
 						error = XBOX::VE_OK;
 					}
 				}
 				else
 				{
-					XBOX::VMemoryBuffer<> memoryBuffer;
-
 					if (isChunked)
 					{
 						/*
@@ -2583,7 +3200,7 @@ XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
 						 *	(that way we really are HTTP/1.1 compliant)
 						 */
 						bool stopReading = false;
-						while ((XBOX::VE_OK == error) && (bufferSize > 0) && !stopReading)
+						while ((XBOX::VE_OK == error) && (XBOX::VE_OK == bodyError) && (bufferSize > 0) && !stopReading)
 						{
 							// first, we need to read the length of the next chunk												
 							bufferSize = 0;	// ReadLine b/c chunk length ends with CRLF
@@ -2599,40 +3216,47 @@ XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
 								XBOX::VSize chunkSize = _GetChunkSize(buffer);
 								if (chunkSize)
 								{
-									bufferSize = chunkSize;	// check size <32k
-									if (bufferSize <= HTTP_CLIENT_BUFFER_SIZE)
+									/*
+									 *	Read chunk by pieces of at most HTTP_CLIENT_BUFFER_SIZE bytes, whatever its size
+									 */
+									XBOX::VSize	chunkLeft = chunkSize;
+
+									while ((XBOX::VE_OK == error) && (XBOX::VE_OK == bodyError) && (chunkLeft > 0))
 									{
-										// optim: we can use buffer b/c it's big enough
+										bufferSize = XBOX::Min<XBOX::VSize>(chunkLeft, HTTP_CLIENT_BUFFER_SIZE);
 										error = _ReadExactlyFromSocket(buffer, HTTP_CLIENT_BUFFER_SIZE, bufferSize);
 
 										if ((XBOX::VE_OK == error) && (bufferSize > 0))
 										{
-											memoryBuffer.PutDataAmortized (memoryBuffer.GetDataSize(), (const void *)buffer, bufferSize);
+											bodyError = _PutResponseBodyData ((const void *)buffer, bufferSize);
+											chunkLeft -= bufferSize;
 										}
-									}
-									else
-									{
-										// DAMNED ! this is a big boy. Deal with it.
-										char *temp_buffer2 = (char *)malloc (bufferSize);
-										if (temp_buffer2)
+										else if (XBOX::VE_OK == error)
 										{
-											error = _ReadExactlyFromSocket(temp_buffer2, bufferSize, bufferSize);
-
-											if ((XBOX::VE_OK == error) && (bufferSize > 0))
-											{
-												memoryBuffer.PutDataAmortized (memoryBuffer.GetDataSize(), (const void *)temp_buffer2, bufferSize);
-											}
-											free (temp_buffer2);
+											error = XBOX::VE_SRVR_NOTHING_TO_READ;
 										}
+
+										XBOX::VTask::Yield();
 									}
 
-									// Sanity check
-									xbox_assert(bufferSize == chunkSize);
+									bufferSize = chunkSize - chunkLeft;
 								}
 								else
 									stopReading = true;
 							}
 						}
+
+						/*
+						 *	Consume the CRLF ending the last chunk (no trailer expected), so that connection can be reused
+						 */
+						isBodyDelimited = false;
+						if ((XBOX::VE_OK == error) && (XBOX::VE_OK == bodyError) && stopReading)
+						{
+							bufferSize = 0;
+							error = _ReadFromSocket (buffer, HTTP_CLIENT_BUFFER_SIZE, bufferSize);
+
+							isBodyDelimited = (XBOX::VE_OK == error) && (bufferSize == 2) && (buffer[0] == '\r') && (buffer[1] == '\n');
+						}
 					}
 					else
 					{
@@ -2640,6 +3264,7 @@ XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
 						 *	Some servers do that :-(
 						 *	Just read until there is nothing left...
 						 */
+						isBodyDelimited = false;
 						if (XBOX::VE_OK == error)
 						{
 							do
@@ -2649,24 +3274,23 @@ XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
 
 								if ((XBOX::VE_OK == error) && (bufferSize > 0))
 								{
-									memoryBuffer.PutDataAmortized (memoryBuffer.GetDataSize(), (const void *)buffer, bufferSize);
+									bodyError = _PutResponseBodyData ((const void *)buffer, bufferSize);
 								}
 
 								XBOX::VTask::Yield();
 							}
-							while ((XBOX::VE_OK == error) && (bufferSize > 0));
+							while ((XBOX::VE_OK == error) && (XBOX::VE_OK == bodyError) && (bufferSize > 0));
 						}
 					}
 
-					if (NULL != memoryBuffer.GetDataPtr())
-					{
-						_SetBodyReply((char *)memoryBuffer.GetDataPtr(), memoryBuffer.GetDataSize());
-						memoryBuffer.ForgetData();
-					}
-
 					error = XBOX::VE_OK;
 				}
 			}
+
+			if (XBOX::VE_OK == bodyError)
+				bodyError = _EndResponseBody();
+			else
+				_EndResponseBody();
 		}
 
 		if (NULL != buffer)
@@ -2674,7 +3298,51 @@ XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
 			free (buffer);
 			buffer = NULL;
 		}
+
+		/*
+		 *	A truncated or badly compressed body is kept as is when buffered (as before),
+		 *	but caller must know when streamed data is incomplete
+		 */
+		if ((XBOX::VE_OK != bodyError) && fIsResponseBodyStreamed)
+		{
+			CloseConnection();
+			error = bodyError;
+		}
+	}
+
+	outIsBodyDelimited = isBodyDelimited;
+
+	return error;
+}
+
+
+XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
+{
+	XBOX::VError			error = XBOX::VE_OK;
+	bool					isBodyDelimited = true;	// Connection can be reused only if we know where response ends.
+
+	{
+		XBOX::StErrorContextInstaller	errorContext (true);
+
+		error = _SendRequestAndReadResponseHeader();
+
+		/*
+		 *	An idle connection from pool may have been closed by server meanwhile: nothing is received.
+		 *	Retry once on a new connection, for idempotent methods only.
+		 */
+		if ((XBOX::VE_OK != error) && fIsReusedConnection && (0 == fResponseHeaderBuffer.GetDataSize()) && _IsIdempotentMethod (fRequestMethod))
+		{
+			errorContext.Flush();
+			CloseConnection();
+			fNumberOfRequests = 0;
+
+			error = _SendRequestAndReadResponseHeader();
+		}
 	}
+
+	if (XBOX::VE_OK == error)
+		error = _ReceiveResponseBody (true, isBodyDelimited);
+
 	/*
 	 *	J.F. Do not close the stream if an error has been raised
 	 *	(The comm has already been closed)
@@ -2692,6 +3360,11 @@ XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
 			connectionCloseByServer = (FindASCIIString (connectionValue, "keep-alive") == 0);
 		}
 
+		/*
+		 *	Connection can go back to pool only if nothing is left to read from it
+		 */
+		fIsConnectionReusable = fKeepAlive && !connectionCloseByServer && isBodyDelimited && (0 == fLeftOver.GetDataSize());
+
 		if (!fKeepAlive || connectionCloseByServer)
 		{
 			CloseConnection();
@@ -2711,6 +3384,303 @@ XBOX::VError VHTTPClient::_SendRequestAndReceiveResponse()
 }
 
 
+VHTTPPipelinedRequest::VHTTPPipelinedRequest (HTTP_Method inMethod, const XBOX::VString& inFolder, const XBOX::VString& inQuery)
+: fMethod (inMethod)
+, fFolder (inFolder)
+, fQuery (inQuery)
+, fRequestHeader()
+, fRequestBody()
+, fError (XBOX::VE_OK)
+, fStatusCode (0)
+, fResponseHeader()
+, fResponseBody()
+, fSendCount (0)
+, fSendTime (0)
+, fResponseHeaderTime (0)
+, fResponseTime (0)
+{
+	// Folder is relative to the root, as in fFolder
+	if (!fFolder.IsEmpty() && (CHAR_SOLIDUS == fFolder.GetUniChar (1)))
+		fFolder.Remove (1, 1);
+}
+
+
+VHTTPPipelinedRequest::~VHTTPPipelinedRequest()
+{
+	fRequestBody.Clear();
+	fResponseBody.Clear();
+}
+
+
+bool VHTTPPipelinedRequest::SetRequestBody (const void *inDataPtr, XBOX::VSize inDataSize)
+{
+	fRequestBody.Clear();
+
+	return fRequestBody.PutData (0, inDataPtr, inDataSize);
+}
+
+
+void VHTTPPipelinedRequest::_ClearResponse()
+{
+	fError = XBOX::VE_OK;
+	fStatusCode = 0;
+	fResponseHeader.Clear();
+	fResponseBody.Clear();
+	fSendCount = 0;
+	fSendTime = fResponseHeaderTime = fResponseTime = 0;
+}
+
+
+VHTTPPipelinedRequest *VHTTPClient::AddPipelinedRequest (HTTP_Method inMethod, const XBOX::VString& inFolder, const XBOX::VString& inQuery)
+{
+	VHTTPPipelinedRequest *request = new VHTTPPipelinedRequest (inMethod, inFolder, inQuery);
+
+	if (NULL != request)
+		fPipelinedRequests.push_back (request);
+
+	return request;
+}
+
+
+void VHTTPClient::ClearPipelinedRequests()
+{
+	for (std::vector<VHTTPPipelinedRequest *>::iterator it = fPipelinedRequests.begin(); it != fPipelinedRequests.end(); ++it)
+		delete *it;
+
+	fPipelinedRequests.clear();
+}
+
+
+XBOX::VError VHTTPClient::SendPipelinedRequests()
+{
+	XBOX::VError	error = XBOX::VE_OK;
+	sLONG			count = (sLONG) fPipelinedRequests.size();
+	sLONG			index = 0;
+
+	for (sLONG i = 0; i < count; ++i)
+		fPipelinedRequests[i]->_ClearResponse();
+
+	/*
+	 *	Save client own request (restored when done), its body must not be sent with pipelined requests
+	 */
+	VHTTPHeader				clientHeader (fHeader);
+	XBOX::VString			clientFolder (fFolder);
+	XBOX::VString			clientQuery (fQuery);
+	HTTP_Method				clientMethod = fRequestMethod;
+	bool					clientKeepAlive = fKeepAlive;
+	XBOX::VMemoryBuffer<>	clientBody;
+
+	clientBody.SetDataPtr (fRequestBody.GetDataPtr(), fRequestBody.GetDataSize(), fRequestBody.GetAllocatedSize());
+	fRequestBody.ForgetData();
+
+	fResponseHeaderBuffer.Clear();
+	fKeepAlive = true;	// Pipelining needs a persistent connection
+
+	while ((XBOX::VE_OK == error) && (index < count))
+	{
+		/*
+		 *	Pipeline following idempotent requests, any other request is sent alone
+		 */
+		sLONG	end = index + 1;
+
+		if (_IsIdempotentMethod (fPipelinedRequests[index]->fMethod))
+		{
+			while ((end < count) && (end - index < fMaxPipelinedRequests) && _IsIdempotentMethod (fPipelinedRequests[end]->fMethod))
+				++end;
+		}
+
+		sLONG	answeredCount = 0;
+		bool	wasReusedConnection = false;
+
+		{
+			XBOX::StErrorContextInstaller	errorContext (true);
+
+			error = _SendPipelinedRequests (index, end, answeredCount, wasReusedConnection);
+
+			/*
+			 *	Server closed connection before answering all requests: requests left are sent again on a new connection.
+			 *	When nothing was answered, an idle connection from pool may have been closed by server meanwhile: retry once.
+			 *	Idempotent methods only (see _SendRequestAndReceiveResponse()), other requests fail with their error.
+			 */
+			if (XBOX::VE_OK != error)
+			{
+				VHTTPPipelinedRequest *request = fPipelinedRequests[index + answeredCount];
+
+				if (_IsIdempotentMethod (request->fMethod) && ((answeredCount > 0) || (wasReusedConnection && (request->fSendCount < 2))))
+				{
+					errorContext.Flush();
+					error = XBOX::VE_OK;
+				}
+				else
+				{
+					request->fError = error;
+				}
+			}
+		}
+
+		index += answeredCount;
+	}
+
+	/*
+	 *	Requests left without response after an error
+	 */
+	for (sLONG i = index + 1; i < count; ++i)
+		fPipelinedRequests[i]->fError = VE_SRVR_CONNECTION_FAILED;
+
+	fHeader = clientHeader;
+	fFolder.FromString (clientFolder);
+	fQuery.FromString (clientQuery);
+	fRequestMethod = clientMethod;
+	fKeepAlive = clientKeepAlive;
+
+	fRequestBody.SetDataPtr (clientBody.GetDataPtr(), clientBody.GetDataSize(), clientBody.GetAllocatedSize());
+	clientBody.ForgetData();
+
+	if (!fKeepAlive)
+		CloseConnection();
+
+	return error;
+}
+
+
+XBOX::VError VHTTPClient::_AppendPipelinedRequest (VHTTPPipelinedRequest& inRequest, const VHTTPHeader& inClientHeader, XBOX::VMemoryBuffer<>& ioRequests)
+{
+	std::vector<std::pair<XBOX::VString, XBOX::VString> >	headers;
+	XBOX::VString											requestString;
+
+	fHeader = inClientHeader;
+	fHeader.RemoveHeader (HEADER_CONTENT_LENGTH);	// Left by a previous request
+	inRequest.fRequestHeader.GetHeadersList (headers);
+	for (std::vector<std::pair<XBOX::VString, XBOX::VString> >::const_iterator it = headers.begin(); it != headers.end(); ++it)
+		fHeader.SetHeaderValue (it->first, it->second, true);
+
+	fFolder.FromString (inRequest.fFolder);
+	fQuery.FromString (inRequest.fQuery);
+
+	_GenerateRequest (inRequest.fMethod);
+
+	// fRequestBody is empty: set Content-Length of this request body
+	if (inRequest.fRequestBody.GetDataSize() > 0)
+		fHeader.SetContentLength (inRequest.fRequestBody.GetDataSize());
+
+	_GetRequestHeaderString (requestString);
+
+	XBOX::StStringConverter<char> converter (requestString, XBOX::VTC_UTF_8);
+
+	if (!ioRequests.PutDataAmortized (ioRequests.GetDataSize(), converter.GetCPointer(), converter.GetSize()))
+		return XBOX::vThrowError (XBOX::VE_MEMORY_FULL);
+
+	if ((inRequest.fRequestBody.GetDataSize() > 0) && !ioRequests.PutDataAmortized (ioRequests.GetDataSize(), inRequest.fRequestBody.GetDataPtr(), inRequest.fRequestBody.GetDataSize()))
+		return XBOX::vThrowError (XBOX::VE_MEMORY_FULL);
+
+	return XBOX::VE_OK;
+}
+
+
+XBOX::VError VHTTPClient::_SendPipelinedRequests (sLONG inFirst, sLONG inEnd, sLONG& outAnsweredCount, bool& outWasReusedConnection)
+{
+	XBOX::VError			error = XBOX::VE_OK;
+	XBOX::VMemoryBuffer<>	requests;
+	VHTTPHeader				clientHeader (fHeader);
+
+	outAnsweredCount = 0;
+	fIsConnectionReusable = false;
+
+	error = OpenConnection (NULL);
+	outWasReusedConnection = fIsReusedConnection;
+
+	/*
+	 *	Write all requests at once
+	 */
+	for (sLONG i = inFirst; (XBOX::VE_OK == error) && (i < inEnd); ++i)
+		error = _AppendPipelinedRequest (*fPipelinedRequests[i], clientHeader, requests);
+
+	fHeader = clientHeader;
+
+#if WITH_HTTP_CLIENT_DEBUG_LOG
+	_LogData((char *)REQUEST_MARKER_STRING, strlen(REQUEST_MARKER_STRING));
+#endif
+
+	if (XBOX::VE_OK == error)
+	{
+		uLONG	sendTime = XBOX::VSystem::GetCurrentTime();
+
+		for (sLONG i = inFirst; i < inEnd; ++i)
+		{
+			fPipelinedRequests[i]->fSendTime = sendTime;
+			++fPipelinedRequests[i]->fSendCount;
+		}
+
+		error = _WriteToSocket (requests.GetDataPtr(), requests.GetDataSize());
+	}
+
+	requests.Clear();
+
+#if WITH_HTTP_CLIENT_DEBUG_LOG
+	_LogData((char *)RESPONSE_MARKER_STRING, strlen(RESPONSE_MARKER_STRING));
+#endif
+
+	/*
+	 *	Read responses in order, as long as server keeps connection alive
+	 */
+	bool	isConnectionAlive = (XBOX::VE_OK == error);
+
+	for (sLONG i = inFirst; isConnectionAlive && (i < inEnd); ++i)
+	{
+		VHTTPPipelinedRequest&	request = *fPipelinedRequests[i];
+		bool					isBodyDelimited = false;
+
+		fRequestMethod = request.fMethod;	// No body to read for HEAD
+
+		error = (i == inFirst) ? ReadResponseHeader() : _ReadPipelinedResponseHeader();
+		if (XBOX::VE_OK != error)
+			break;
+
+		request.fResponseHeaderTime = XBOX::VSystem::GetCurrentTime() - request.fSendTime;
+
+		error = _ReceiveResponseBody (false, isBodyDelimited);
+		if (XBOX::VE_OK != error)
+			break;
+
+		request.fResponseTime = XBOX::VSystem::GetCurrentTime() - request.fSendTime;
+		request.fStatusCode = fStatusCode;
+		request.fResponseHeader = fResponseHeader;
+		request.fResponseBody.SetDataPtr (fResponseBody.GetDataPtr(), fResponseBody.GetDataSize(), fResponseBody.GetAllocatedSize());
+		fResponseBody.ForgetData();
+
+		++outAnsweredCount;
+		++fNumberOfRequests;
+
+		XBOX::VString connectionValue;
+		if (fResponseHeader.GetHeaderValue (CONST_STRING_CONNECTION, connectionValue) && (FindASCIIString (connectionValue, "keep-alive") == 0))
+			isConnectionAlive = false;	// Connection closed by server
+		else
+			isConnectionAlive = isBodyDelimited;
+	}
+
+	/*
+	 *	Connection can go back to pool only if all requests were answered and nothing is left to read from it
+	 */
+	if ((XBOX::VE_OK == error) && isConnectionAlive && (outAnsweredCount == inEnd - inFirst))
+	{
+		fIsConnectionReusable = (0 == fLeftOver.GetDataSize());
+	}
+	else
+	{
+		CloseConnection();
+		fNumberOfRequests = 0;
+	}
+
+	/*
+	 *	Requests left unanswered: server closed connection
+	 */
+	if ((XBOX::VE_OK == error) && (outAnsweredCount < inEnd - inFirst))
+		error = VE_SRVR_CONNECTION_BROKEN;
+
+	return error;
+}
+
+
 XBOX::VError VHTTPClient::_SendCONNECTToProxy()
 {
 	if ((!fUseProxy) || (!fUseSSL))
@@ -2740,11 +3710,25 @@ XBOX::VError VHTTPClient::_SendCONNECTToProxy()
 XBOX::VError VHTTPClient::_SendRequestHeader()
 {
 	XBOX::VString	requestString;
+
+	_GetRequestHeaderString (requestString);
+
+	// Write Header
+	XBOX::StStringConverter<char> converter (requestString, XBOX::VTC_UTF_8);
+
+	return _WriteToSocket ((void *)converter.GetCPointer(), (uLONG)converter.GetSize());
+}
+
+
+void VHTTPClient::_GetRequestHeaderString (XBOX::VString& outRequestString)
+{
 	XBOX::VString	headerString;
 
+	outRequestString.Clear();
+
 	fHeader.ToString (headerString);
-	_GetMethodName (fRequestMethod, requestString);
-	requestString.AppendUniChar (CHAR_SPACE);
+	_GetMethodName (fRequestMethod, outRequestString);
+	outRequestString.AppendUniChar (CHAR_SPACE);
 
 	if (!fProxy.IsEmpty() && !XBOX::VProxyManager::ByPassProxyOnLocalhost (fDomain) && !fUseSSL)
 	{
@@ -2752,34 +3736,29 @@ XBOX::VError VHTTPClient::_SendRequestHeader()
 		 *	if there is an HTTP proxy, then we need to use an absolute URI for non SSL requests
 		 */
 		
-		requestString.AppendCString ("http://");
-		requestString.AppendString (fDomain);
-		requestString.AppendUniChar (CHAR_COLON);
-		requestString.AppendLong (fPort);
+		outRequestString.AppendCString ("http://");
+		outRequestString.AppendString (fDomain);
+		outRequestString.AppendUniChar (CHAR_COLON);
+		outRequestString.AppendLong (fPort);
 		
 	}
 
-	requestString.AppendUniChar (CHAR_SOLIDUS);
+	outRequestString.AppendUniChar (CHAR_SOLIDUS);
 
 	if (!fFolder.IsEmpty())
-		requestString.AppendString (fFolder);
+		outRequestString.AppendString (fFolder);
 
 	if (!fQuery.IsEmpty())
-		requestString.AppendUniChar (CHAR_QUESTION_MARK).AppendString (fQuery);
+		outRequestString.AppendUniChar (CHAR_QUESTION_MARK).AppendString (fQuery);
 
-	requestString.AppendUniChar (CHAR_SPACE);
-	requestString.AppendCString ("HTTP/1.1\r\n");	//Trick to avoid chunked transfer-encoding in http 1.1
+	outRequestString.AppendUniChar (CHAR_SPACE);
+	outRequestString.AppendCString ("HTTP/1.1\r\n");	//Trick to avoid chunked transfer-encoding in http 1.1
 
 	// Write the whole headers
-	requestString.AppendString (headerString);
+	outRequestString.AppendString (headerString);
 
 	// Terminate request with a final <CRLF>
-	requestString.AppendCString ("\r\n");
-
-	// Write Header
-	XBOX::StStringConverter<char> converter (requestString, XBOX::VTC_UTF_8);
-
-	return _WriteToSocket ((void *)converter.GetCPointer(), (uLONG)converter.GetSize());
+	outRequestString.AppendCString ("\r\n");
 }
 
 
@@ -65,8 +65,164 @@ private:
 };
 
 
+/*
+ *	Process wide pool of keep-alive connections, used by VHTTPClient when keep-alive is on.
+ *	Connections are keyed by host, port and SSL. Idle connections are closed after the idle timeout, by a
+ *	background task if the pool is not used meanwhile.
+ *	At most "max connections per host" are pooled for a given key; connections opened beyond that
+ *	limit are not pooled (closed when released). SSL sessions are kept per key for resumption.
+ */
+class XTOOLBOX_API VHTTPConnectionPool : public XBOX::VObject
+{
+public:
+	typedef struct
+	{
+		uLONG8								fHits;				// Idle connection reused.
+		uLONG8								fMisses;			// New connection opened.
+		uLONG8								fEvictions;			// Idle connection closed (timeout or pool cleared).
+		uLONG8								fDiscards;			// Connection released as not reusable, or not pooled.
+		uLONG8								fSessionResumptions;// SSL session resumed by server for a new pooled connection.
+		sLONG								fIdleCount;
+		sLONG								fActiveCount;
+	} Statistics;
+
+	enum
+	{
+		DEFAULT_MAX_CONNECTIONS_PER_HOST	= 8,
+		DEFAULT_IDLE_TIMEOUT				= 30,	// In seconds.
+		PURGE_INTERVAL						= 5000,	// In milliseconds.
+	};
+
+	static void								Init();
+	static void								DeInit();
+
+	// Returns NULL if ServerNet is not initialized (no pooling).
+	static VHTTPConnectionPool *			Get();
+
+	/*
+	 *	Retain an idle connection, or open a new one. *outIsPooled tells if connection must be given back with
+	 *	ReleaseConnection() (else just close it), *outIsReused tells if it was idle in pool.
+	 */
+	XBOX::VTCPEndPoint *					RetainConnection (const XBOX::VString& inDNSNameOrIP, sLONG inPort, bool inUseSSL, sLONG inConnectionTimeoutMS, bool *outIsPooled, bool *outIsReused, XBOX::VError& outError);
+	// Pool takes ownership of inEndPoint. Pass NULL for a connection that has been stolen (it is just forgotten).
+	void									ReleaseConnection (XBOX::VTCPEndPoint *inEndPoint, const XBOX::VString& inDNSNameOrIP, sLONG inPort, bool inUseSSL, bool inIsReusable);
+	// Tell that server resumed the SSL session offered for a new connection (known once handshake is over).
+	void									NotifySessionResumption ();
+
+	// Close idle connections (all of them, or only the expired ones).
+	void									Purge (bool inExpiredOnly = true);
+
+	void									SetMaxConnectionsPerHost (sLONG inValue);
+	sLONG									GetMaxConnectionsPerHost () const { return fMaxConnectionsPerHost; }
+	void									SetIdleTimeout (sLONG inValue);	// In seconds.
+	sLONG									GetIdleTimeout () const { return fIdleTimeout; }
+
+	void									GetStatistics (Statistics& outStatistics) const;
+
+private:
+	typedef struct
+	{
+		XBOX::VTCPEndPoint *				fEndPoint;
+		uLONG								fIdleSince;
+	} IdleConnection;
+
+	typedef struct
+	{
+		std::vector<IdleConnection>			fIdle;
+		sLONG								fPooledCount;		// Idle and in use.
+		void *								fSslSession;
+		uLONG								fLastUsed;			// Entry is dropped once unused for the idle timeout.
+	} HostEntry;
+
+	typedef std::map<XBOX::VString, HostEntry>	MapOfHostEntry;
+
+											VHTTPConnectionPool ();
+	virtual									~VHTTPConnectionPool ();
+
+	static void								_MakeKey (const XBOX::VString& inDNSNameOrIP, sLONG inPort, bool inUseSSL, XBOX::VString& outKey);
+	void									_CollectExpired (uLONG inNow, std::vector<XBOX::VTCPEndPoint *>& outEndPoints);
+	static void								_CloseEndPoints (std::vector<XBOX::VTCPEndPoint *>& ioEndPoints);
+
+	void									_StartPurgeTask ();
+	bool									_StopPurgeTask ();
+	static sLONG							_PurgeTaskRun (XBOX::VTask *inTask);
+
+	static VHTTPConnectionPool *			sInstance;
+
+	mutable XBOX::VCriticalSection			fMutex;
+	MapOfHostEntry							fHosts;
+	sLONG									fMaxConnectionsPerHost;
+	sLONG									fIdleTimeout;
+	Statistics								fStatistics;
+	XBOX::VTask *							fPurgeTask;
+	XBOX::VSyncEvent						fPurgeEvent;		// Signaled to wake purge task up when stopping.
+};
+
+
 typedef void (* HTTPRequestProgressionCallBack) (void *ioPrivateData, sLONG inMessage, sLONG inProgressionPercentage);
 typedef void (* HTTPRequestAuthenticationDialogCallBack) (VAuthInfos& ioAuthenticationInfos, void *inPrivateData);
+typedef XBOX::VError (* HTTPResponseBodyCallBack) (void *ioPrivateData, const void *inData, XBOX::VSize inDataSize);
+
+
+class VHTTPBodyInflater;
+
+
+/*
+ *	Request of a pipelined batch (see VHTTPClient::AddPipelinedRequest()), and its response once the batch is sent.
+ *	Owned by the VHTTPClient.
+ */
+class XTOOLBOX_API VHTTPPipelinedRequest : public XBOX::VObject
+{
+public:
+	/*
+	 *	Request: folder & query as in the URL, headers are added to (or replace) the client ones.
+	 */
+	HTTP_Method								GetMethod() const { return fMethod; }
+	const XBOX::VString&					GetFolder() const { return fFolder; }
+	const XBOX::VString&					GetQuery() const { return fQuery; }
+	VHTTPHeader&							GetRequestHTTPHeaders() { return fRequestHeader; }
+	bool									SetRequestBody (const void *inDataPtr, XBOX::VSize inDataSize);
+
+	/*
+	 *	Response
+	 */
+	XBOX::VError							GetError() const { return fError; }					// VE_OK when a response was received.
+	sLONG									GetHTTPStatusCode() const { return fStatusCode; }
+	const VHTTPHeader&						GetResponseHeaders() const { return fResponseHeader; }
+	const XBOX::VMemoryBuffer<>&			GetResponseBody() const { return fResponseBody; }
+	sLONG									GetSendCount() const { return fSendCount; }			// More than 1 if sent again after server closed connection.
+
+	/*
+	 *	Timing (in milliseconds) since request was written on connection
+	 */
+	uLONG									GetResponseHeaderTime() const { return fResponseHeaderTime; }
+	uLONG									GetResponseTime() const { return fResponseTime; }
+
+private:
+	friend class VHTTPClient;
+
+											VHTTPPipelinedRequest (HTTP_Method inMethod, const XBOX::VString& inFolder, const XBOX::VString& inQuery);
+	virtual									~VHTTPPipelinedRequest();
+											VHTTPPipelinedRequest (const VHTTPPipelinedRequest&);				// forbidden
+	VHTTPPipelinedRequest&					operator= (const VHTTPPipelinedRequest&);							// forbidden
+
+	void									_ClearResponse();
+
+	HTTP_Method								fMethod;
+	XBOX::VString							fFolder;
+	XBOX::VString							fQuery;
+	VHTTPHeader								fRequestHeader;
+	XBOX::VMemoryBuffer<>					fRequestBody;
+
+	XBOX::VError							fError;
+	sLONG									fStatusCode;
+	VHTTPHeader								fResponseHeader;
+	XBOX::VMemoryBuffer<>					fResponseBody;
+	sLONG									fSendCount;
+	uLONG									fSendTime;
+	uLONG									fResponseHeaderTime;
+	uLONG									fResponseTime;
+};
 
 
 class XTOOLBOX_API VHTTPClient : public XBOX::VObject
@@ -116,11 +272,42 @@ public:
 	 */
 	void									GetResponseBodyString (XBOX::VString& outBodyString);
 
+	/*
+	 *	Response body streaming:
+	 *	When a stream or a call back is set, body is passed on as it is received (dechunked and inflated) instead of
+	 *	being buffered, and GetResponseBody() stays empty. Stream must be opened for writing and is not owned.
+	 *	Returning an error from call back stops reading (and connection is closed).
+	 *	Responses Send() handles by itself (authentication challenges & redirections it follows) are still buffered.
+	 */
+	void									SetResponseBodyStream (XBOX::VStream *inStream) { fResponseBodyStream = inStream; }
+	XBOX::VStream *							GetResponseBodyStream() const { return fResponseBodyStream; }
+	void									SetResponseBodyCallBack (HTTPResponseBodyCallBack inCallBackPtr, void *inPrivateData) { fResponseBodyCallBackPtr = inCallBackPtr; fResponseBodyCallBackPrivateData = inPrivateData; }
+	bool									IsResponseBodyStreamed() const { return fIsResponseBodyStreamed; }		// Last response body was streamed
+
 	/*
 	 *	Prepare Request, Open Connection, Send Request and Close Connection
 	 */
 	XBOX::VError							Send (HTTP_Method inMethod);
 
+	/*
+	 *	HTTP/1.1 Pipelining:
+	 *	Requests added are sent to the client server (domain, port & proxy as set by Init()) by SendPipelinedRequests(),
+	 *	several at a time on one keep-alive connection, without waiting for each response. Responses are read in order
+	 *	and kept in each request (never streamed, no authentication nor redirection handling).
+	 *	Only idempotent requests (GET, HEAD, PUT, DELETE & OPTIONS) are pipelined, any other one is sent alone.
+	 *	When server closes connection before answering all requests, the idempotent ones left are sent again on a new
+	 *	connection. A non-idempotent request is never sent again: it fails with its error.
+	 *	SendPipelinedRequests() returns the error of the first request that could not be answered, if any.
+	 */
+	VHTTPPipelinedRequest *					AddPipelinedRequest (HTTP_Method inMethod, const XBOX::VString& inFolder, const XBOX::VString& inQuery = XBOX::VString());
+	sLONG									GetPipelinedRequestCount() const { return (sLONG) fPipelinedRequests.size(); }
+	VHTTPPipelinedRequest *					GetPipelinedRequest (sLONG inIndex) const { return fPipelinedRequests[inIndex]; }
+	void									ClearPipelinedRequests();
+	XBOX::VError							SendPipelinedRequests();
+
+	void									SetMaxPipelinedRequests (sLONG inValue) { fMaxPipelinedRequests = inValue; }	// Requests in flight on connection
+	sLONG									GetMaxPipelinedRequests() const { return fMaxPipelinedRequests; }
+
 	/*
 	 *	For WebSockets
 	 */
@@ -167,6 +354,8 @@ public:
 	bool									GetUseHTTPCompression() const { return fUseHTTPCompression; }
 	void									SetKeepAlive (bool inValue) { fKeepAlive = inValue; }
 	bool									GetKeepAlive() const { return fKeepAlive; }
+	void									SetUseConnectionPool (bool inValue) { fUseConnectionPool = inValue; }	// Default is true (only used with keep-alive).
+	bool									GetUseConnectionPool() const { return fUseConnectionPool; }
 
 	/*
 	 *	Connection Timeout (in seconds)
@@ -228,8 +417,15 @@ public:
 
 private:
 	XBOX::VError							_SendRequestAndReceiveResponse();
+	XBOX::VError							_SendRequestAndReadResponseHeader();
 	XBOX::VError							_SendCONNECTToProxy();
 	XBOX::VError							_SendRequestHeader();
+	void									_GetRequestHeaderString (XBOX::VString& outRequestString);
+	XBOX::VError							_ReadResponseHeaderFromSocket();
+	XBOX::VError							_ReadPipelinedResponseHeader();
+	XBOX::VError							_ReceiveResponseBody (bool inMayStream, bool& outIsBodyDelimited);
+	XBOX::VError							_AppendPipelinedRequest (VHTTPPipelinedRequest& inRequest, const VHTTPHeader& inClientHeader, XBOX::VMemoryBuffer<>& ioRequests);
+	XBOX::VError							_SendPipelinedRequests (sLONG inFirst, sLONG inEnd, sLONG& outAnsweredCount, bool& outWasReusedConnection);
 	bool									_ParseURL (const XBOX::VURL& inURL);
 	XBOX::VError							_GenerateRequest (HTTP_Method inMethod);
 	bool									_ExtractAuthenticationInfos (XBOX::VString& outRealm, VAuthInfos::AuthMethod& outProxyAuthenticationMethod);
@@ -237,12 +433,17 @@ private:
 	void									_InitCustomHeaders();
 	void									_ComputeDomain (XBOX::VString& outDomain, bool useProxy);
 	sLONG									_ExtractHTTPStatusCode() const;
-	void									_SetBodyReply (char *inBody, XBOX::VSize inBodySize);
+	bool									_IsResponseHandledBySend();
+	XBOX::VError							_StartResponseBody (bool inMayStream);
+	XBOX::VError							_PutResponseBodyData (const void *inData, XBOX::VSize inDataSize);
+	XBOX::VError							_EndResponseBody();
+	XBOX::VError							_WriteResponseBodyData (const void *inData, XBOX::VSize inDataSize);
+	static XBOX::VError						_WriteResponseBodyDataCallBack (void *ioPrivateData, const void *inData, XBOX::VSize inDataSize);
 	void									_ReinitHTTP (bool reinitHeader = true, bool reinitReplyHeader = true, bool reinitBufferPool = true);
 	bool									_IsChunkedResponse();
 	bool									_SetHostHeader();
 
-	XBOX::VError							_OpenConnection (const XBOX::VString& inDNSNameOrIP, const sLONG inPort, bool inUseSSL, XBOX::VTCPSelectIOPool *inSelectIOPool);
+	XBOX::VError							_OpenConnection (const XBOX::VString& inDNSNameOrIP, const sLONG inPort, bool inUseSSL, XBOX::VTCPSelectIOPool *inSelectIOPool, bool inMayUsePool);
 	bool									_ConnectionOpened();
 	XBOX::VError							_PromoteToSSL();
 	XBOX::VError							_WriteToSocket (void *inBuffer, XBOX::VSize inBufferSize);
@@ -291,6 +492,21 @@ private:
 	XBOX::VMemoryBuffer<>					fResponseBody;
 	sLONG									fStatusCode;
 	XBOX::VMemoryBuffer<>					fLeftOver;
+
+	/*
+	 *	Response body streaming
+	 */
+	XBOX::VStream *							fResponseBodyStream;
+	HTTPResponseBodyCallBack				fResponseBodyCallBackPtr;
+	void *									fResponseBodyCallBackPrivateData;
+	bool									fIsResponseBodyStreamed;
+	VHTTPBodyInflater *						fBodyInflater;			// Not NULL while reading a gzip or deflate encoded body.
+
+	/*
+	 *	Pipelining
+	 */
+	std::vector<VHTTPPipelinedRequest *>	fPipelinedRequests;
+	sLONG									fMaxPipelinedRequests;
 	
 	/*
 	 *	HTTP & Proxy Authentication
@@ -329,6 +545,17 @@ private:
 	XBOX::VString							fLastAddressUsed;
 	bool									fUpgradeRequest;		// If it is a upgrade request, this will override fKeepAlive.
 
+	/*
+	 *	Connection Pool
+	 */
+	bool									fUseConnectionPool;
+	bool									fIsPooledConnection;	// fTCPEndPoint must be given back to VHTTPConnectionPool.
+	bool									fIsReusedConnection;	// fTCPEndPoint was idle in pool (may have been closed by server).
+	bool									fIsConnectionReusable;	// Last response was fully read and server keeps connection alive.
+	XBOX::VString							fPooledDNSNameOrIP;
+	sLONG									fPooledPort;
+	bool									fPooledUseSSL;
+
 	/*
 	 *	Content-Encoding
 	 */
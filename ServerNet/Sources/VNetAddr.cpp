@@ -377,9 +377,20 @@ VError VNetAddressList::FromLocalInterfaces()
 
 VError VNetAddressList::FromDnsQuery(const VString& inDnsName, PortNumber inPort)
 {
-	XAddrDnsQuery query(this);
-	
-	VError verr=query.FillAddrList(inDnsName, inPort);
+	VDnsResolver* resolver=VDnsResolver::Get();
+
+	VError verr=VE_OK;
+
+	if(resolver!=NULL)
+	{
+		verr=resolver->Resolve(inDnsName, inPort, this);
+	}
+	else
+	{
+		XAddrDnsQuery query(this);
+
+		verr=query.FillAddrList(inDnsName, inPort);
+	}
 	
 #if VERSIONDEBUG
 	VNetAddressList::const_iterator cit;
@@ -455,4 +466,494 @@ void VNetAddressList::PushXNetAddr(const XNetAddr& inNetAddr)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// VDnsResolveMessage
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VDnsResolveMessage::VDnsResolveMessage() : fPort(kBAD_PORT), fError(VE_OK)
+{
+	//Nothing to do
+}
+
+
+//virtual
+VDnsResolveMessage::~VDnsResolveMessage()
+{
+	//Nothing to do
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// VDnsResolver
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//A lookup in progress ; sync callers wait on fDone, async callers are in fWaiters.
+class VDnsResolver::VPendingQuery : public VObject, public IRefCountable
+{
+public :
+
+	VPendingQuery(const VString& inKey, const VString& inDnsName, PortNumber inPort) :
+		fKey(inKey), fDnsName(inDnsName), fPort(inPort), fError(VE_OK) {}
+
+	VString fKey;
+	VString fDnsName;
+	PortNumber fPort;
+
+	VNetAddressList fList;
+	VError fError;
+
+	VSyncEvent fDone;
+
+	std::vector<std::pair<VDnsResolveMessage*, IMessageable*> > fWaiters;
+};
+
+
+VDnsResolver* VDnsResolver::sInstance=NULL;
+
+
+VDnsResolver::VDnsResolver() :
+	fQueueSemaphore(0, kMAX_sLONG), fPositiveTTL(kDEFAULT_POSITIVE_TTL*1000), fNegativeTTL(kDEFAULT_NEGATIVE_TTL*1000),
+	fQueryProc(_DefaultQuery)
+{
+	::memset(&fStatistics, 0, sizeof(fStatistics));
+}
+
+
+//virtual
+VDnsResolver::~VDnsResolver()
+{
+	//DeInit() only deletes a resolver whose workers are dead and with no query in progress.
+	xbox_assert(fWorkers.empty() && fQueue.empty() && fPending.empty());
+}
+
+
+bool VDnsResolver::_Stop()
+{
+	std::vector<VTask*>::iterator it;
+
+	for(it=fWorkers.begin() ; it!=fWorkers.end() ; ++it)
+		(*it)->Kill();
+
+	for(it=fWorkers.begin() ; it!=fWorkers.end() ; ++it)
+		fQueueSemaphore.Unlock();
+
+	std::vector<VTask*> aliveWorkers;
+
+	for(it=fWorkers.begin() ; it!=fWorkers.end() ; ++it)
+	{
+		if((*it)->WaitForDeath(5000))
+			ReleaseRefCountable(&(*it));
+		else
+			aliveWorkers.push_back(*it);
+	}
+
+	fWorkers.swap(aliveWorkers);
+
+	//Queries still queued are never run : they complete with an error, so that sync callers waiting for them wake up.
+	std::deque<VPendingQuery*> queue;
+	bool isIdle=false;
+
+	{
+		StLocker<VCriticalSection> lock(&fMutex);
+
+		queue.swap(fQueue);
+
+		for(std::deque<VPendingQuery*>::iterator itQueue=queue.begin() ; itQueue!=queue.end() ; ++itQueue)
+		{
+			std::map<VString, VPendingQuery*>::iterator itPending=fPending.find((*itQueue)->fKey);
+
+			if(itPending!=fPending.end() && itPending->second==*itQueue)
+			{
+				fPending.erase(itPending);
+				(*itQueue)->Release();
+			}
+		}
+
+		isIdle=fWorkers.empty() && fPending.empty();
+	}
+
+	while(!queue.empty())
+	{
+		VPendingQuery* pending=queue.front();
+
+		queue.pop_front();
+
+		pending->fError=VE_SRVR_RESOURCE_TEMPORARILY_UNAVAILABLE;
+		pending->fDone.Unlock();
+
+		for(size_t i=0 ; i<pending->fWaiters.size() ; i++)
+		{
+			VDnsResolveMessage* msg=pending->fWaiters[i].first;
+
+			msg->fError=pending->fError;
+			msg->PostTo(pending->fWaiters[i].second);
+
+			ReleaseRefCountable(&msg);
+		}
+
+		pending->fWaiters.clear();
+
+		ReleaseRefCountable(&pending);
+	}
+
+	return isIdle;
+}
+
+
+//static
+void VDnsResolver::Init()
+{
+	if(sInstance==NULL)
+		sInstance=new VDnsResolver();
+}
+
+
+//static
+void VDnsResolver::DeInit()
+{
+	//A worker stuck in a query, or a query run by a caller, still uses the resolver : it is leaked rather than freed under their feet.
+	if(sInstance!=NULL && sInstance->_Stop())
+		delete sInstance;
+
+	sInstance=NULL;
+}
+
+
+//static
+VDnsResolver* VDnsResolver::Get()
+{
+	return sInstance;
+}
+
+
+//static
+void VDnsResolver::_MakeKey(const VString& inDnsName, PortNumber inPort, VString& outKey)
+{
+	outKey.FromString(inDnsName);
+	outKey.ToLowerCase();
+	outKey.AppendUniChar(CHAR_COLON);
+	outKey.AppendLong(inPort);
+}
+
+
+//static
+VError VDnsResolver::_DefaultQuery(const VString& inDnsName, PortNumber inPort, VNetAddressList* outList)
+{
+	XAddrDnsQuery query(outList);
+
+	return query.FillAddrList(inDnsName, inPort);
+}
+
+
+bool VDnsResolver::_LookUp(const VString& inKey, VNetAddressList* outList, VError* outError)
+{
+	//fMutex must be locked.
+
+	std::map<VString, CacheEntry>::iterator it=fCache.find(inKey);
+
+	if(it==fCache.end())
+		return false;
+
+	uLONG age=VSystem::GetCurrentTime()-it->second.fResolvedAt;
+
+	if(age>=(uLONG)it->second.fTTL)
+	{
+		fCache.erase(it);
+		return false;
+	}
+
+	if(outList!=NULL)
+		outList->fAddrList.insert(outList->fAddrList.end(), it->second.fList.fAddrList.begin(), it->second.fList.fAddrList.end());
+
+	*outError=it->second.fError;
+
+	if(it->second.fError==VE_OK)
+		fStatistics.fHits++;
+	else
+		fStatistics.fNegativeHits++;
+
+	return true;
+}
+
+
+VDnsResolver::VPendingQuery* VDnsResolver::_RetainPending(const VString& inKey, const VString& inDnsName, PortNumber inPort, bool* outIsNew)
+{
+	//fMutex must be locked.
+
+	std::map<VString, VPendingQuery*>::iterator it=fPending.find(inKey);
+
+	if(it!=fPending.end())
+	{
+		fStatistics.fCoalesced++;
+
+		*outIsNew=false;
+
+		return RetainRefCountable(it->second);
+	}
+
+	fStatistics.fMisses++;
+
+	VPendingQuery* pending=new VPendingQuery(inKey, inDnsName, inPort);
+
+	fPending[inKey]=RetainRefCountable(pending);	//Released by _Query()
+
+	*outIsNew=true;
+
+	return pending;
+}
+
+
+void VDnsResolver::_Query(VPendingQuery* inPending)
+{
+	QueryProc queryProc=NULL;
+
+	{
+		StLocker<VCriticalSection> lock(&fMutex);
+
+		queryProc=fQueryProc;
+	}
+
+	{
+		StErrorContextInstaller errorContext(false);
+
+		inPending->fError=queryProc(inPending->fDnsName, inPending->fPort, &inPending->fList);
+	}
+
+	std::vector<std::pair<VDnsResolveMessage*, IMessageable*> > waiters;
+
+	{
+		StLocker<VCriticalSection> lock(&fMutex);
+
+		sLONG ttl=(inPending->fError==VE_OK) ? fPositiveTTL : fNegativeTTL;
+
+		if(ttl>0)
+		{
+			if(fCache.size()>=kMAX_CACHE_ENTRIES)
+				fCache.clear();
+
+			CacheEntry& entry=fCache[inPending->fKey];
+
+			entry.fList=inPending->fList;
+			entry.fError=inPending->fError;
+			entry.fResolvedAt=VSystem::GetCurrentTime();
+			entry.fTTL=ttl;
+		}
+
+		std::map<VString, VPendingQuery*>::iterator it=fPending.find(inPending->fKey);
+
+		if(it!=fPending.end() && it->second==inPending)
+		{
+			fPending.erase(it);
+			inPending->Release();
+		}
+
+		waiters.swap(inPending->fWaiters);
+	}
+
+	inPending->fDone.Unlock();
+
+	for(size_t i=0 ; i<waiters.size() ; i++)
+	{
+		VDnsResolveMessage* msg=waiters[i].first;
+
+		msg->fError=inPending->fError;
+		msg->fAddressList.fAddrList.insert(msg->fAddressList.fAddrList.end(), inPending->fList.fAddrList.begin(), inPending->fList.fAddrList.end());
+
+		msg->PostTo(waiters[i].second);
+
+		ReleaseRefCountable(&msg);
+	}
+}
+
+
+void VDnsResolver::_StartWorkers()
+{
+	//fMutex must be locked.
+
+	while(fWorkers.size()<kWORKER_COUNT)
+	{
+		VTask* worker=new VTask(this, 0, eTaskStylePreemptive, _WorkerRun);
+
+		if(worker==NULL)
+			break;
+
+		worker->SetName(CVSTR("ServerNet DNS resolver"));
+		worker->SetKindData((sLONG_PTR) this);
+		worker->Run();
+
+		fWorkers.push_back(worker);
+	}
+}
+
+
+//static
+sLONG VDnsResolver::_WorkerRun(VTask* inTask)
+{
+	VDnsResolver* resolver=reinterpret_cast<VDnsResolver*>(inTask->GetKindData());
+
+	while(!inTask->IsDying())
+	{
+		resolver->fQueueSemaphore.Lock();
+
+		VPendingQuery* pending=NULL;
+
+		{
+			StLocker<VCriticalSection> lock(&resolver->fMutex);
+
+			if(!resolver->fQueue.empty())
+			{
+				pending=resolver->fQueue.front();
+				resolver->fQueue.pop_front();
+			}
+		}
+
+		if(pending!=NULL)
+		{
+			resolver->_Query(pending);
+
+			ReleaseRefCountable(&pending);
+		}
+	}
+
+	return 0;
+}
+
+
+VError VDnsResolver::Resolve(const VString& inDnsName, PortNumber inPort, VNetAddressList* outList)
+{
+	if(outList==NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+	VString key;
+
+	_MakeKey(inDnsName, inPort, key);
+
+	VPendingQuery* pending=NULL;
+
+	bool isNew=false;
+
+	{
+		StLocker<VCriticalSection> lock(&fMutex);
+
+		VError verr=VE_OK;
+
+		if(_LookUp(key, outList, &verr))
+			return (verr==VE_OK) ? VE_OK : vThrowError(verr);
+
+		pending=_RetainPending(key, inDnsName, inPort, &isNew);
+	}
+
+	//First caller does the query in its own task, others wait for it.
+	if(isNew)
+		_Query(pending);
+	else
+		pending->fDone.Lock();
+
+	outList->fAddrList.insert(outList->fAddrList.end(), pending->fList.fAddrList.begin(), pending->fList.fAddrList.end());
+
+	VError verr=pending->fError;
+
+	ReleaseRefCountable(&pending);
+
+	return (verr==VE_OK) ? VE_OK : vThrowError(verr);
+}
+
+
+VError VDnsResolver::ResolveAsync(const VString& inDnsName, PortNumber inPort, VDnsResolveMessage* inMessage, IMessageable* inTarget)
+{
+	if(inMessage==NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+	IMessageable* target=(inTarget!=NULL) ? inTarget : VTask::GetCurrent();
+
+	inMessage->fDnsName.FromString(inDnsName);
+	inMessage->fPort=inPort;
+	inMessage->fError=VE_OK;
+
+	VString key;
+
+	_MakeKey(inDnsName, inPort, key);
+
+	{
+		StLocker<VCriticalSection> lock(&fMutex);
+
+		VError verr=VE_OK;
+
+		if(!_LookUp(key, &inMessage->fAddressList, &verr))
+		{
+			bool isNew=false;
+
+			VPendingQuery* pending=_RetainPending(key, inDnsName, inPort, &isNew);
+
+			pending->fWaiters.push_back(std::make_pair(RetainRefCountable(inMessage), target));
+
+			if(isNew)
+			{
+				fQueue.push_back(pending);	//Released by worker
+				fQueueSemaphore.Unlock();
+
+				_StartWorkers();
+			}
+			else
+			{
+				ReleaseRefCountable(&pending);
+			}
+
+			return VE_OK;
+		}
+
+		inMessage->fError=verr;
+	}
+
+	//Cache hit : Post right now.
+	inMessage->PostTo(target);
+
+	return VE_OK;
+}
+
+
+void VDnsResolver::Flush()
+{
+	StLocker<VCriticalSection> lock(&fMutex);
+
+	fCache.clear();
+}
+
+
+void VDnsResolver::SetTTL(sLONG inPositiveTTL, sLONG inNegativeTTL)
+{
+	StLocker<VCriticalSection> lock(&fMutex);
+
+	fPositiveTTL=(inPositiveTTL>0) ? inPositiveTTL*1000 : 0;
+	fNegativeTTL=(inNegativeTTL>0) ? inNegativeTTL*1000 : 0;
+
+	fCache.clear();
+}
+
+
+void VDnsResolver::SetQueryProc(QueryProc inQueryProc)
+{
+	StLocker<VCriticalSection> lock(&fMutex);
+
+	fQueryProc=(inQueryProc!=NULL) ? inQueryProc : _DefaultQuery;
+
+	fCache.clear();
+}
+
+
+void VDnsResolver::GetStatistics(Statistics& outStatistics) const
+{
+	StLocker<VCriticalSection> lock(&fMutex);
+
+	outStatistics=fStatistics;
+
+	outStatistics.fEntryCount=static_cast<sLONG>(fCache.size());
+	outStatistics.fPendingCount=static_cast<sLONG>(fPending.size());
+}
+
+
 END_TOOLBOX_NAMESPACE
@@ -19,6 +19,8 @@
 #include <stdexcept>
 #include <iterator>
 #include <list>
+#include <map>
+#include <deque>
 
 
 #include "ServerNetTypes.h"
@@ -113,6 +115,7 @@ public :
 
 	VError FromLocalInterfaces();
 	
+	//Uses VDnsResolver (cached) if available.
 	VError FromDnsQuery(const VString& inDnsName, PortNumber inPort);
 	
 	class XTOOLBOX_API const_iterator : public std::iterator<std::forward_iterator_tag, VNetAddress>
@@ -145,6 +148,8 @@ private :
 	
 	DECLARE_XNETADDR_FRIENDSHIP //jmo - Pas de friend sur un typedef ? C'est NUL !
 
+	friend class VDnsResolver;
+
 	void PushXNetAddr(const XNetAddr& inNetAddr);
 	
 	std::list<VNetAddress> fAddrList;
@@ -152,6 +157,121 @@ private :
 };
 
 
+//Posted to the calling task by VDnsResolver::ResolveAsync() when resolution is over.
+//Default DoExecute() calls target DoMessage() ; override it to handle the result.
+class XTOOLBOX_API VDnsResolveMessage : public VMessage
+{
+public :
+
+	VDnsResolveMessage();
+
+	const VString& GetDnsName() const		{ return fDnsName; }
+	PortNumber GetPort() const				{ return fPort; }
+	VError GetError() const					{ return fError; }
+	VNetAddressList& GetAddressList()		{ return fAddressList; }
+
+protected :
+
+	virtual ~VDnsResolveMessage();
+
+private :
+
+	friend class VDnsResolver;
+
+	VString fDnsName;
+	PortNumber fPort;
+	VError fError;
+	VNetAddressList fAddressList;
+};
+
+
+//Process wide DNS resolver : Results (failures included) are cached for a fixed TTL and concurrent
+//lookups of the same name are coalesced. getaddrinfo() does not give record TTLs, hence fixed ones.
+class XTOOLBOX_API VDnsResolver : public VObject
+{
+public :
+
+	//Query procedure ; XAddrDnsQuery (getaddrinfo()) by default. Can be replaced by a stub (tests).
+	typedef VError (*QueryProc)(const VString& inDnsName, PortNumber inPort, VNetAddressList* outList);
+
+	enum
+	{
+		kDEFAULT_POSITIVE_TTL=60,	//seconds
+		kDEFAULT_NEGATIVE_TTL=5,	//seconds
+		kWORKER_COUNT=2,
+		kMAX_CACHE_ENTRIES=1024
+	};
+
+	typedef struct
+	{
+		uLONG8 fHits;
+		uLONG8 fNegativeHits;
+		uLONG8 fMisses;
+		uLONG8 fCoalesced;
+		sLONG fEntryCount;
+		sLONG fPendingCount;
+	} Statistics;
+
+	static void Init();
+	static void DeInit();
+
+	//NULL if ServerNet is not initialized.
+	static VDnsResolver* Get();
+
+	//Blocking resolve ; addresses are appended to outList.
+	VError Resolve(const VString& inDnsName, PortNumber inPort, VNetAddressList* outList);
+
+	//Non blocking resolve : inMessage is filled and posted to inTarget (current task if NULL) when done.
+	//It may be posted before ResolveAsync() returns (cache hit).
+	VError ResolveAsync(const VString& inDnsName, PortNumber inPort, VDnsResolveMessage* inMessage, IMessageable* inTarget=NULL);
+
+	void Flush();
+
+	void SetTTL(sLONG inPositiveTTL, sLONG inNegativeTTL);	//seconds ; 0 disables caching
+	void SetQueryProc(QueryProc inQueryProc);				//NULL restores default
+
+	void GetStatistics(Statistics& outStatistics) const;
+
+private :
+
+	class VPendingQuery;
+
+	typedef struct
+	{
+		VNetAddressList fList;
+		VError fError;
+		uLONG fResolvedAt;
+		sLONG fTTL;				//milliseconds
+	} CacheEntry;
+
+	VDnsResolver();
+	virtual ~VDnsResolver();
+
+	static void _MakeKey(const VString& inDnsName, PortNumber inPort, VString& outKey);
+	static VError _DefaultQuery(const VString& inDnsName, PortNumber inPort, VNetAddressList* outList);
+	static sLONG _WorkerRun(VTask* inTask);
+
+	bool _LookUp(const VString& inKey, VNetAddressList* outList, VError* outError);
+	VPendingQuery* _RetainPending(const VString& inKey, const VString& inDnsName, PortNumber inPort, bool* outIsNew);
+	void _Query(VPendingQuery* inPending);
+	void _StartWorkers();
+	bool _Stop();	//true if no worker is alive nor any query in progress
+
+	static VDnsResolver* sInstance;
+
+	mutable VCriticalSection fMutex;
+	std::map<VString, CacheEntry> fCache;
+	std::map<VString, VPendingQuery*> fPending;
+	std::deque<VPendingQuery*> fQueue;
+	VSemaphore fQueueSemaphore;
+	std::vector<VTask*> fWorkers;
+	sLONG fPositiveTTL;
+	sLONG fNegativeTTL;
+	QueryProc fQueryProc;
+	Statistics fStatistics;
+};
+
+
 END_TOOLBOX_NAMESPACE
 
 
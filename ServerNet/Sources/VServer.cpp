@@ -150,6 +150,56 @@ VError VServer::Stop ( )
 }
 
 
+// Additional task accepting connections for a VTCPConnectionListener, on its own SO_REUSEPORT sockets.
+
+class VTCPConnectionAcceptor : public VTask
+{
+	public :
+
+	VTCPConnectionAcceptor ( VTCPConnectionListener* inListener, VSockListener* inSockListener ) :
+	VTask ( NULL, 0, XBOX::eTaskStylePreemptive, NULL )
+	{
+		fListener = inListener;
+		fSockListener = inSockListener;
+
+		SetName ( "TCP connection acceptor" );
+		SetKind ( kServerNetListenerTaskKind );
+	}
+
+	virtual ~VTCPConnectionAcceptor ( )
+	{
+		if ( fSockListener )
+		{
+			fSockListener-> StopListeningAndClearPorts ( );
+			delete fSockListener;
+		}
+	}
+
+	VSockListener* GetSockListener ( ) { return fSockListener; }
+
+	protected :
+
+	virtual Boolean DoRun ( )
+	{
+		while ( GetState ( ) != TS_DYING && GetState ( ) != TS_DEAD )
+		{
+			StDropErrorContext errCtx;
+
+			XTCPSock* xsock = fSockListener-> GetNewConnectedSocket ( 100 /*ms*/ );
+			if ( xsock )
+				fListener-> _HandleNewConnection ( xsock );
+		}
+
+		return false;
+	}
+
+	private :
+
+	VTCPConnectionListener*		fListener;
+	VSockListener*				fSockListener;
+};
+
+
 VTCPConnectionListener::VTCPConnectionListener ( IRequestLogger* inRequestLogger ) :
 VTask ( NULL, 0, XBOX::eTaskStylePreemptive, NULL ),
 fFactories ( ),
@@ -160,6 +210,7 @@ fKeyPath ( )
 	fSockListener = NULL;
 	fWorkerPool = NULL;
 	fSelectIOPool = NULL;
+	fAcceptorCount = 1;
 
 	fCertificate.Clear();
 	fKey.Clear();
@@ -199,34 +250,95 @@ void VTCPConnectionListener::SetSSLKeyAndCertificate ( VString const & inCertifi
 	fKey = inKey;
 }
 
-VError VTCPConnectionListener::StartListening ( )
+VError VTCPConnectionListener::SetAcceptorCount ( sLONG inCount )
 {
-	StTmpErrorContext errCtx;
-	
-	if ((fSockListener = new VSockListener(fRequestLogger)) == NULL) 
+	xbox_assert ( fSockListener == NULL );
+
+	if ( inCount < 1 )
+		return VE_INVALID_PARAMETER;
 
-		return VE_MEMORY_FULL;
+#if VERSION_LINUX
+	fAcceptorCount = inCount;
+#else
+	fAcceptorCount = 1;
+#endif
 
-	VError	vError = VE_OK;
+	return VE_OK;
+}
+
+VError VTCPConnectionListener::GetStatistics ( VSockListenerStatistics& outStatistics )
+{
+	::memset ( &outStatistics, 0, sizeof ( outStatistics ) );
+
+	if ( !fAcceptorsLock. Lock ( ) )
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	std::vector<VSockListener*>		sockListeners;
+
+	if ( fSockListener )
+		sockListeners. push_back ( fSockListener );
+
+	std::vector<VTCPConnectionAcceptor*>::iterator		iterAcceptor = fAcceptors. begin ( );
+	while ( iterAcceptor != fAcceptors. end ( ) )
+	{
+		sockListeners. push_back ( ( *iterAcceptor )-> GetSockListener ( ) );
+		iterAcceptor++;
+	}
+
+	std::vector<VSockListener*>::iterator		iterListener = sockListeners. begin ( );
+	while ( iterListener != sockListeners. end ( ) )
+	{
+		VSockListenerStatistics		statistics;
+
+		( *iterListener )-> GetStatistics ( statistics );
+
+		outStatistics. fAcceptCount += statistics. fAcceptCount;
+		outStatistics. fWakeUpCount += statistics. fWakeUpCount;
+		outStatistics. fBacklogFullCount += statistics. fBacklogFullCount;
+		outStatistics. fAcceptsPerSecond += statistics. fAcceptsPerSecond;
+		if ( statistics. fMaxBatchSize > outStatistics. fMaxBatchSize )
+			outStatistics. fMaxBatchSize = statistics. fMaxBatchSize;
+
+		iterListener++;
+	}
+
+	fAcceptorsLock. Unlock ( );
+
+	return VE_OK;
+}
+
+VSockListener* VTCPConnectionListener::_NewSockListener ( bool inReusePort, VError& outError )
+{
+	VSockListener*		sockListener = new VSockListener ( fRequestLogger );
+
+	if ( sockListener == NULL )
+	{
+		outError = VE_MEMORY_FULL;
+
+		return NULL;
+	}
+
+	outError = VE_OK;
 
 	if (!fCertificatePath.IsEmpty() && !fKeyPath.IsEmpty())
 	{
-		fSockListener-> SetCertificatePaths (fCertificatePath, fKeyPath);
+		sockListener-> SetCertificatePaths (fCertificatePath, fKeyPath);
 
 	} else if (!fCertificate.IsEmpty() && !fKey.IsEmpty()) {
 
-		vError = fSockListener-> SetKeyAndCertificate(fKey, fCertificate);
+		outError = sockListener-> SetKeyAndCertificate(fKey, fCertificate);
 
 	}
 	
-	if (vError != VE_OK) {
+	if (outError != VE_OK) {
 
-		delete fSockListener;
-		fSockListener = NULL;
-		return vError;
+		delete sockListener;
+		return NULL;
 
 	}
 
+	sockListener-> SetReusePort ( inReusePort );
+
 	VTCPConnectionHandlerFactory*								vtcpCHFactory = NULL;
 	std::vector<PortNumber>											vctrPorts;
 	std::vector<PortNumber>::iterator								iterPorts;
@@ -234,26 +346,52 @@ VError VTCPConnectionListener::StartListening ( )
 	while ( iterFactories != fFactories. end ( ) )
 	{
 		vtcpCHFactory = *iterFactories;
-		vError = vtcpCHFactory-> GetPorts ( vctrPorts );
-		if ( vError != VE_OK )
+		outError = vtcpCHFactory-> GetPorts ( vctrPorts );
+		if ( outError != VE_OK )
 			break;
 		iterPorts = vctrPorts. begin ( );
 		while ( iterPorts != vctrPorts. end ( ) )
 		{
-			fSockListener-> AddListeningPort ( vtcpCHFactory-> GetIP ( ), *iterPorts, vtcpCHFactory-> IsSSL ( ) );
+			sockListener-> AddListeningPort ( vtcpCHFactory-> GetIP ( ), *iterPorts, vtcpCHFactory-> IsSSL ( ) );
 			iterPorts++;
 		}
 		vctrPorts. clear ( );
 		
 		iterFactories++;
 	}
-	
-	if ( vError == VE_OK )
+
+	if ( outError == VE_OK && !sockListener-> StartListening ( ) )
+		outError = ThrowNetError ( VE_SRVR_FAILED_TO_START_LISTENER );
+
+	if ( outError != VE_OK )
 	{
-		if ( fSockListener-> StartListening ( ) )
-			Run ( );
-		else
-			vError = ThrowNetError ( VE_SRVR_FAILED_TO_START_LISTENER );
+		sockListener-> StopListeningAndClearPorts ( );
+		delete sockListener;
+		sockListener = NULL;
+	}
+
+	return sockListener;
+}
+
+VError VTCPConnectionListener::StartListening ( )
+{
+	StTmpErrorContext errCtx;
+
+	VError	vError = VE_OK;
+	bool	reusePort = fAcceptorCount > 1;
+
+	fSockListener = _NewSockListener ( reusePort, vError );
+
+	for ( sLONG i = 1; vError == VE_OK && i < fAcceptorCount; i++ )
+	{
+		VSockListener*		sockListener = _NewSockListener ( reusePort, vError );
+
+		if ( sockListener )
+		{
+			fAcceptorsLock. Lock ( );
+			fAcceptors. push_back ( new VTCPConnectionAcceptor ( this, sockListener ) );
+			fAcceptorsLock. Unlock ( );
+		}
 	}
 	
 	if ( vError != VE_OK )
@@ -262,6 +400,15 @@ VError VTCPConnectionListener::StartListening ( )
 	}
 	else
 	{
+		Run ( );
+
+		std::vector<VTCPConnectionAcceptor*>::iterator		iterAcceptor = fAcceptors. begin ( );
+		while ( iterAcceptor != fAcceptors. end ( ) )
+		{
+			( *iterAcceptor )-> Run ( );
+			iterAcceptor++;
+		}
+
 		errCtx.Flush();
 	}
 	
@@ -282,12 +429,29 @@ VError VTCPConnectionListener::StopListening ( )
 
 void VTCPConnectionListener::DeInit ( )
 {
+	// Additional accepting tasks use factories and pools, stop them first. Lock also protects listeners
+	// against GetStatistics().
+
+	fAcceptorsLock. Lock ( );
+
+	std::vector<VTCPConnectionAcceptor*>::iterator		iterAcceptor = fAcceptors. begin ( );
+	while ( iterAcceptor != fAcceptors. end ( ) )
+	{
+		( *iterAcceptor )-> Kill ( );
+		( *iterAcceptor )-> WaitForDeath ( 5000 );
+		( *iterAcceptor )-> Release ( );
+		iterAcceptor++;
+	}
+	fAcceptors. clear ( );
+
 	if ( fSockListener )
 	{
 		fSockListener-> StopListeningAndClearPorts();
 		delete fSockListener;
 		fSockListener = NULL;
 	}
+
+	fAcceptorsLock. Unlock ( );
 	
 	std::vector<VTCPConnectionHandlerFactory*>::iterator		iter = fFactories. begin ( );
 	while ( iter != fFactories. end ( ) )
@@ -315,14 +479,10 @@ void VTCPConnectionListener::DeInit ( )
 
 Boolean VTCPConnectionListener::DoRun ( )
 {
-	VError							vError = VE_OK;
-	
 	if ( fRequestLogger != 0 )
 		fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::Enter", 1 );
 	
 	uLONG							nIdlePeriod = VSystem::GetCurrentTime ( );
-	std::vector<PortNumber>				vctrPorts;
-	std::vector<PortNumber>::iterator	iterPort;
 	while ( GetState ( ) != TS_DYING && GetState ( ) != TS_DEAD && fSockListener )
 	{
 		StDropErrorContext errCtx;
@@ -330,70 +490,7 @@ Boolean VTCPConnectionListener::DoRun ( )
 		XTCPSock* xsock = fSockListener-> GetNewConnectedSocket(100 /*ms*/);
 		if ( xsock )
 		{
-			if ( fRequestLogger != 0 )
-				fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::NewConnectionAccepted", VSystem::GetCurrentTime ( ) );
-			
-			VTCPEndPoint*		vtcpEndPoint = new VTCPEndPoint ( xsock, fSelectIOPool );
-#if EXCHANGE_ENDPOINT_ID
-			static sLONG		nIDGenerator = 0;
-			nIDGenerator++;
-			vError = vtcpEndPoint-> WriteExactly ( &nIDGenerator, sizeof ( sLONG ), 60 * 1000 );
-			vtcpEndPoint-> SetID ( nIDGenerator );
-			xbox_assert ( vError == VE_OK );
-#endif
-			
-			/* PLAN: Need to locate an appropriate factory, create new handler,
-			 give it the end point and then transfer handler to the thread pool
-			 for execution. */
-			
-			VTCPConnectionHandlerFactory*								vtcpCHFactory = NULL;
-			std::vector<VTCPConnectionHandlerFactory*>::iterator		iter = fFactories. begin ( );
-			while ( iter != fFactories. end ( ) )
-			{
-				vtcpCHFactory = *iter;
-				vctrPorts. clear ( );
-				vtcpCHFactory-> GetPorts ( vctrPorts );
-				iterPort = std::find ( vctrPorts. begin ( ), vctrPorts. end ( ), xsock-> GetPort ( ) );
-				if ( iterPort != vctrPorts. end ( ) )
-					break;
-				
-				vtcpCHFactory = NULL;
-				iter++;
-			}
-			if ( !vtcpCHFactory )
-			{
-				if ( fRequestLogger != 0 )
-					fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::ERROR::CONNECTION FACTORY NOT FOUND", VSystem::GetCurrentTime ( ) );
-
-				vtcpEndPoint-> Close ( );
-				vtcpEndPoint-> Release ( );
-				
-				continue;
-			}
-			
-			VConnectionHandler*						vcHandler = vtcpCHFactory-> CreateConnectionHandler ( vError );
-			if ( vcHandler == 0 )
-			{
-				if ( fRequestLogger != 0 )
-					fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::ERROR::FAILED TO CREATE CONNECTION HANDLER", VSystem::GetCurrentTime ( ) );
-
-				vtcpEndPoint-> Close ( );
-				vtcpEndPoint-> Release ( );
-				
-				continue;
-			}
-			
-			vcHandler-> _ResetRedistributionCount ( );
-			
-			vcHandler-> SetEndPoint ( vtcpEndPoint );
-			ReleaseRefCountable ( &vtcpEndPoint );
-			
-			/* Transfer vcHandler to the thread pool for execution. */
-			if ( fWorkerPool )
-				fWorkerPool-> AddConnectionHandler ( vcHandler );
-			
-			if ( fRequestLogger != 0 )
-				fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::New connection is being handled", VSystem::GetCurrentTime ( ) );
+			_HandleNewConnection ( xsock );
 		}
 		else
 		{
@@ -412,6 +509,86 @@ Boolean VTCPConnectionListener::DoRun ( )
 	return false;
 }
 
+void VTCPConnectionListener::_HandleNewConnection ( XTCPSock* xsock )
+{
+	VError							vError = VE_OK;
+	std::vector<PortNumber>				vctrPorts;
+	std::vector<PortNumber>::iterator	iterPort;
+
+	if ( fRequestLogger != 0 )
+		fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::NewConnectionAccepted", VSystem::GetCurrentTime ( ) );
+	
+	VTCPEndPoint*		vtcpEndPoint = new VTCPEndPoint ( xsock, fSelectIOPool );
+#if EXCHANGE_ENDPOINT_ID
+	static sLONG		nIDGenerator = 0;
+	nIDGenerator++;
+	vError = vtcpEndPoint-> WriteExactly ( &nIDGenerator, sizeof ( sLONG ), 60 * 1000 );
+	vtcpEndPoint-> SetID ( nIDGenerator );
+	xbox_assert ( vError == VE_OK );
+#endif
+	
+	/* PLAN: Need to locate an appropriate factory, create new handler,
+	 give it the end point and then transfer handler to the thread pool
+	 for execution. */
+	
+	VTCPConnectionHandlerFactory*								vtcpCHFactory = NULL;
+	std::vector<VTCPConnectionHandlerFactory*>::iterator		iter = fFactories. begin ( );
+	while ( iter != fFactories. end ( ) )
+	{
+		vtcpCHFactory = *iter;
+		vctrPorts. clear ( );
+		vtcpCHFactory-> GetPorts ( vctrPorts );
+		iterPort = std::find ( vctrPorts. begin ( ), vctrPorts. end ( ), xsock-> GetPort ( ) );
+		if ( iterPort != vctrPorts. end ( ) )
+			break;
+		
+		vtcpCHFactory = NULL;
+		iter++;
+	}
+	if ( !vtcpCHFactory )
+	{
+		if ( fRequestLogger != 0 )
+			fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::ERROR::CONNECTION FACTORY NOT FOUND", VSystem::GetCurrentTime ( ) );
+
+		vtcpEndPoint-> Close ( );
+		vtcpEndPoint-> Release ( );
+		
+		return;
+	}
+	
+	VConnectionHandler*						vcHandler = vtcpCHFactory-> CreateConnectionHandler ( vError );
+	if ( vcHandler == 0 )
+	{
+		if ( fRequestLogger != 0 )
+			fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::ERROR::FAILED TO CREATE CONNECTION HANDLER", VSystem::GetCurrentTime ( ) );
+
+		vtcpEndPoint-> Close ( );
+		vtcpEndPoint-> Release ( );
+		
+		return;
+	}
+	
+	vcHandler-> _ResetRedistributionCount ( );
+	
+	vcHandler-> SetEndPoint ( vtcpEndPoint );
+	ReleaseRefCountable ( &vtcpEndPoint );
+	
+	/* Transfer vcHandler to the thread pool for execution. */
+	if ( fWorkerPool && fWorkerPool-> AddConnectionHandler ( vcHandler ) != VE_OK )
+	{
+		/* The pool queue is full: drop the connection rather than keeping the listener waiting. */
+		if ( fRequestLogger != 0 )
+			fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::ERROR::FAILED TO QUEUE CONNECTION HANDLER", VSystem::GetCurrentTime ( ) );
+
+		vcHandler-> Release ( );
+
+		return;
+	}
+	
+	if ( fRequestLogger != 0 )
+		fRequestLogger-> Log ( 'SRNT', 0, "SERVER_NET::VTCPConnectionListener::DoRun()::New connection is being handled", VSystem::GetCurrentTime ( ) );
+}
+
 VError VTCPConnectionListener::AddConnectionHandlerFactory ( VConnectionHandlerFactory* inFactory )
 {
 	VTCPConnectionHandlerFactory*			vtcpCHFactory = dynamic_cast<VTCPConnectionHandlerFactory*>( inFactory );
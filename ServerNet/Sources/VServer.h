@@ -50,6 +50,7 @@ class XTOOLBOX_API VServer : public VObject, public IRefCountable
 
 
 class VWorkerPool;
+class VTCPConnectionAcceptor;
 
 class XTOOLBOX_API VTCPConnectionListener : public IConnectionListener, public VTask
 {
@@ -71,12 +72,30 @@ class XTOOLBOX_API VTCPConnectionListener : public IConnectionListener, public V
 	
 	virtual void SetSSLCertificatePaths (const VFilePath& inCertificatePath, const VFilePath& inKeyPath);
 	virtual void SetSSLKeyAndCertificate ( VString const & inCertificate, VString const &inKey);
+
+	// Number of tasks accepting connections, one by default. With more, each task has its own SO_REUSEPORT 
+	// listening sockets on the same ports and the kernel spreads incoming connections among them (Linux only,
+	// ignored elsewhere). Must be called before StartListening().
+
+	virtual VError SetAcceptorCount ( sLONG inCount );
+
+	// Counters summed over all accepting tasks.
+
+	virtual VError GetStatistics ( VSockListenerStatistics& outStatistics );
 	
 	protected :
+
+	friend class VTCPConnectionAcceptor;
 	
 	virtual Boolean DoRun ( );
 	
 	virtual void DeInit ( );
+
+	VSockListener* _NewSockListener ( bool inReusePort, VError& outError );
+
+	// Find factory for socket's port and give a new connection handler to the worker pool, called by all accepting tasks.
+
+	void _HandleNewConnection ( XTCPSock* inSock );
 	
 	IRequestLogger*										fRequestLogger;
 	std::vector<VTCPConnectionHandlerFactory*>			fFactories;
@@ -87,6 +106,9 @@ class XTOOLBOX_API VTCPConnectionListener : public IConnectionListener, public V
 	VFilePath											fKeyPath;
 	VString												fCertificate;
 	VString												fKey;
+	sLONG												fAcceptorCount;
+	std::vector<VTCPConnectionAcceptor*>				fAcceptors;			// Additional accepting tasks.
+	VCriticalSection									fAcceptorsLock;
 };
 
 
@@ -124,6 +124,8 @@ const VError	VE_SRVR_WEBSOCKET_CONNECTION_FAILED				= MAKE_VERROR(kSERVER_NET_SI
 const VError	VE_SRVR_WEBSOCKET_INVALID_SERVER_RESPONSE		= MAKE_VERROR(kSERVER_NET_SIGNATURE, 413);	// Server HTTP response from opening handshake is not valid according to spec.
 const VError	VE_SRVR_WEBSOCKET_WRONG_ACCEPTANCE_KEY			= MAKE_VERROR(kSERVER_NET_SIGNATURE, 414);	// Server returned a wrong acceptance key.
 const VError	VE_SRVR_WEBSOCKET_INVALID_CLIENT_REQUEST		= MAKE_VERROR(kSERVER_NET_SIGNATURE, 415);	// Server received an invalid HTTP request (start of opening handshake).
+const VError	VE_SRVR_WEBSOCKET_COMPRESSION_ERROR			= MAKE_VERROR(kSERVER_NET_SIGNATURE, 416);	// permessage-deflate extension failed to compress or decompress a message.
+const VError	VE_SRVR_WEBSOCKET_MESSAGE_TOO_BIG				= MAKE_VERROR(kSERVER_NET_SIGNATURE, 417);	// Decompressed message exceeds the configured maximum size.
 
 class SNETGenericError : public VErrorBase
 {
@@ -0,0 +1,284 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#include "VServerNetPrecompiled.h"
+
+#include "VSharedWorkers.h"
+
+#include "VWorkerPool.h"
+
+#include "Tools.h"
+
+
+BEGIN_TOOLBOX_NAMESPACE
+
+
+using namespace ServerNetTools;
+
+
+#if WITH_SHARED_WORKERS
+
+
+VConnectionHandlerStealQueue::VConnectionHandlerStealQueue ( )
+{
+	m_nTop = 0;
+	m_nBottom = 0;
+	::memset ( ( void* ) m_arrSlots, 0, sizeof ( m_arrSlots ) );
+}
+
+VConnectionHandlerStealQueue::~VConnectionHandlerStealQueue ( )
+{
+	;
+}
+
+bool VConnectionHandlerStealQueue::Push ( VConnectionHandler* inConnectionHandler )
+{
+	/* Only the owner writes m_nBottom. */
+	sLONG				nBottom = m_nBottom;
+	sLONG				nTop = VInterlocked::AtomicGet ( &m_nTop );
+	if ( ( uLONG ) nBottom - ( uLONG ) nTop >= kCAPACITY )
+		return false;
+
+	m_arrSlots [ ( uLONG ) nBottom & ( kCAPACITY - 1 ) ] = inConnectionHandler;
+
+	/* Full barrier: the slot is visible before the new bottom. */
+	VInterlocked::Exchange ( &m_nBottom, ( sLONG ) ( ( uLONG ) nBottom + 1 ) );
+
+	return true;
+}
+
+VConnectionHandler* VConnectionHandlerStealQueue::Steal ( )
+{
+	while ( true )
+	{
+		sLONG				nTop = VInterlocked::AtomicGet ( &m_nTop );
+		sLONG				nBottom = VInterlocked::AtomicGet ( &m_nBottom );
+		if ( ( sLONG ) ( ( uLONG ) nBottom - ( uLONG ) nTop ) <= 0 )
+			return NULL;
+
+		/* The slot cannot be overwritten before m_nTop moves past it, in which case the CAS fails. */
+		VConnectionHandler*	vcHandler = m_arrSlots [ ( uLONG ) nTop & ( kCAPACITY - 1 ) ];
+		if ( VInterlocked::CompareExchange ( &m_nTop, nTop, ( sLONG ) ( ( uLONG ) nTop + 1 ) ) == nTop )
+			return vcHandler;
+	}
+}
+
+sLONG VConnectionHandlerStealQueue::GetCount ( ) const
+{
+	sLONG				nTop = VInterlocked::AtomicGet ( const_cast<sLONG*> ( &m_nTop ) );
+	sLONG				nBottom = VInterlocked::AtomicGet ( const_cast<sLONG*> ( &m_nBottom ) );
+	sLONG				nCount = ( sLONG ) ( ( uLONG ) nBottom - ( uLONG ) nTop );
+
+	return ( nCount > 0 ) ? nCount : 0;
+}
+
+
+VSharedWorker::VSharedWorker ( VWorkerPool& inParentWorkerPool ) :
+VTask ( NULL, 0, XBOX::eTaskStylePreemptive, NULL ),
+m_vParentWorkerPool ( inParentWorkerPool ),
+m_vQueue ( ),
+m_vcsCurrentLock ( )
+{
+	m_CurrentConnectionHandler = NULL;
+	m_nRunsNotDone = 0;
+	m_nStealSeed = ( uLONG ) ( sLONG_PTR ) this ^ VSystem::GetCurrentTime ( );
+	if ( m_nStealSeed == 0 )
+		m_nStealSeed = 1;
+	::memset ( &m_Statistics, 0, sizeof ( m_Statistics ) );
+	m_nProfilingFrequency = VSystem::GetProfilingFrequency ( );
+	if ( m_nProfilingFrequency <= 0 )
+		m_nProfilingFrequency = 1;
+}
+
+VSharedWorker::~VSharedWorker ( )
+{
+	ReleaseAllConnectionHandlers ( );
+}
+
+VError VSharedWorker::StopConnectionHandlers ( int inType )
+{
+	VError				vError = VE_OK;
+
+	if ( !m_vcsCurrentLock. Lock ( ) )
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+
+	if ( m_CurrentConnectionHandler && m_CurrentConnectionHandler-> GetType ( ) == inType )
+		vError = m_CurrentConnectionHandler-> Stop ( );
+
+	m_vcsCurrentLock. Unlock ( );
+
+	/* Only the owner pushes to its queue: the queued handlers are taken out, stopped if they match, and given
+	back through the pool queue, where this worker takes them again once its queue is empty. Handlers pushed
+	back meanwhile are left, the count bounds the loop. */
+	std::vector<VConnectionHandler*>	vctrQueued;
+	sLONG								nCount = m_vQueue. GetCount ( );
+	VConnectionHandler*					vcHandler = NULL;
+	while ( nCount-- > 0 && ( vcHandler = m_vQueue. Steal ( ) ) != NULL )
+	{
+		if ( vcHandler-> GetType ( ) == inType )
+		{
+			VError						vStopError = vcHandler-> Stop ( );
+			if ( vError == VE_OK )
+				vError = vStopError;
+		}
+		vctrQueued. push_back ( vcHandler );
+	}
+	m_vParentWorkerPool. RequeueSharedConnectionHandlers ( vctrQueued );
+
+	return vError;
+}
+
+void VSharedWorker::GetStatistics ( Statistics& outStatistics ) const
+{
+	outStatistics = m_Statistics;
+	outStatistics. fQueueLength = m_vQueue. GetCount ( );
+}
+
+Boolean VSharedWorker::DoRun ( )
+{
+	VConnectionHandler*				vcHandler = NULL;
+	while ( GetState ( ) != TS_DYING && GetState ( ) != TS_DEAD )
+	{
+		if ( !vcHandler )
+			vcHandler = TakeConnectionHandler ( );
+		if ( !vcHandler )
+			vcHandler = Park ( kPARK_TIMEOUT );
+
+		if ( vcHandler )
+		{
+			bool					bPause = RunConnectionHandler ( vcHandler );
+
+			/* A new handler ends the pause. */
+			if ( bPause && !vcHandler )
+				vcHandler = Park ( kROUND_PAUSE );
+		}
+	}
+
+	if ( vcHandler )
+		vcHandler-> Release ( );
+	ReleaseAllConnectionHandlers ( );
+
+	return false;
+}
+
+VConnectionHandler* VSharedWorker::TakeConnectionHandler ( )
+{
+	/* Own handlers first, in turn. */
+	VConnectionHandler*			vcHandler = m_vQueue. Steal ( );
+	if ( vcHandler )
+		return vcHandler;
+
+	vcHandler = m_vParentWorkerPool. PopSharedConnectionHandler ( );
+	if ( vcHandler )
+		return vcHandler;
+
+	/* xorshift, to spread the thieves over the victims */
+	m_nStealSeed ^= m_nStealSeed << 13;
+	m_nStealSeed ^= m_nStealSeed >> 17;
+	m_nStealSeed ^= m_nStealSeed << 5;
+
+	vcHandler = m_vParentWorkerPool. StealSharedConnectionHandler ( this, m_nStealSeed );
+	if ( vcHandler )
+		m_Statistics. fSteals++;
+
+	return vcHandler;
+}
+
+bool VSharedWorker::RunConnectionHandler ( VConnectionHandler*& ioConnectionHandler )
+{
+	VConnectionHandler*							vcHandler = ioConnectionHandler;
+	ioConnectionHandler = NULL;
+
+	m_vcsCurrentLock. Lock ( );
+	m_CurrentConnectionHandler = vcHandler;
+	m_vcsCurrentLock. Unlock ( );
+
+	sLONG8										nStart;
+	VSystem::GetProfilingCounter ( nStart );
+
+	VError										vError = VE_OK;
+	VConnectionHandler::E_WORK_STATUS			wStatus;
+	{
+		StDropErrorContext						errCtx;
+		wStatus = vcHandler-> Handle ( vError );
+	}
+
+	sLONG8										nEnd;
+	VSystem::GetProfilingCounter ( nEnd );
+	sLONG8										nRunTime = ( ( nEnd - nStart ) * 1000000 ) / m_nProfilingFrequency;
+
+	m_vcsCurrentLock. Lock ( );
+	m_CurrentConnectionHandler = NULL;
+	m_vcsCurrentLock. Unlock ( );
+
+	m_Statistics. fRuns++;
+	m_Statistics. fRunTime += nRunTime;
+	if ( nRunTime > m_Statistics. fMaxRunTime )
+		m_Statistics. fMaxRunTime = nRunTime;
+
+	if ( wStatus == VConnectionHandler::eWS_DONE )
+	{
+		m_Statistics. fCompleted++;
+		m_nRunsNotDone = 0;
+		vcHandler-> Release ( );
+
+		return false;
+	}
+
+	if ( !m_vQueue. Push ( vcHandler ) )
+	{
+		/* Full: let another worker have it, or keep it if the pool queue is full too. */
+		if ( m_vParentWorkerPool. PushSharedConnectionHandler ( vcHandler ) != VE_OK )
+			ioConnectionHandler = vcHandler;
+	}
+	else if ( m_vQueue. GetCount ( ) > 1 )
+	{
+		/* Handlers are waiting behind this one: an idle worker may take some. */
+		m_vParentWorkerPool. WakeUpSharedWorker ( );
+	}
+
+	/* Every handler of the queue ran without being done: they are probably waiting for I/O. */
+	if ( ++m_nRunsNotDone > m_vQueue. GetCount ( ) )
+	{
+		m_nRunsNotDone = 0;
+
+		return true;
+	}
+
+	return false;
+}
+
+VConnectionHandler* VSharedWorker::Park ( sLONG inTimeout )
+{
+	if ( GetState ( ) == TS_DYING || GetState ( ) == TS_DEAD )
+		return NULL;
+
+	m_Statistics. fParks++;
+
+	return m_vParentWorkerPool. WaitForSharedConnectionHandler ( inTimeout );
+}
+
+void VSharedWorker::ReleaseAllConnectionHandlers ( )
+{
+	VConnectionHandler*			vcHandler = NULL;
+	while ( ( vcHandler = m_vQueue. Steal ( ) ) != NULL )
+		vcHandler-> Release ( );
+}
+
+
+#endif	// WITH_SHARED_WORKERS
+
+
+END_TOOLBOX_NAMESPACE
@@ -0,0 +1,127 @@
+/*
+* This file is part of Wakanda software, licensed by 4D under
+*  (i) the GNU General Public License version 3 (GNU GPL v3), or
+*  (ii) the Affero General Public License version 3 (AGPL v3) or
+*  (iii) a commercial license.
+* This file remains the exclusive property of 4D and/or its licensors
+* and is protected by national and international legislations.
+* In any event, Licensee's compliance with the terms and conditions
+* of the applicable license constitutes a prerequisite to any use of this file.
+* Except as otherwise expressly stated in the applicable license,
+* such license does not include any other license or rights on this file,
+* 4D's and/or its licensors' trademarks and/or other proprietary rights.
+* Consequently, no title, copyright or other proprietary rights
+* other than those specified in the applicable license is granted.
+*/
+#include "ServerNetTypes.h"
+
+#include "VConnectionHandlerFactory.h"
+
+
+#ifndef SNET_SHARED_WORKERS
+#define SNET_SHARED_WORKERS
+
+
+BEGIN_TOOLBOX_NAMESPACE
+
+
+/** @brief	Bounded work-stealing queue of connection handlers (a Chase-Lev deque without its LIFO end).
+			Only the owner worker pushes, at the bottom. The owner and the other workers take from the top with
+			a compare-and-swap: the owner runs its handlers round-robin and idle workers steal the oldest ones.
+			Indexes wrap around, only their difference matters. */
+class XTOOLBOX_API VConnectionHandlerStealQueue : public VObject
+{
+	public :
+
+	enum { kCAPACITY = 1024 };	/* Must be a power of 2. */
+
+	VConnectionHandlerStealQueue ( );
+	virtual ~VConnectionHandlerStealQueue ( );
+
+	/* Owner only. Returns false if the queue is full. */
+	bool Push ( VConnectionHandler* inConnectionHandler );
+
+	/* Any thread. Returns NULL if the queue is empty. */
+	VConnectionHandler* Steal ( );
+
+	sLONG GetCount ( ) const;
+
+	private :
+
+	VConnectionHandlerStealQueue ( const VConnectionHandlerStealQueue& );				/* forbidden */
+	VConnectionHandlerStealQueue& operator= ( const VConnectionHandlerStealQueue& );	/* forbidden */
+
+	/* Top and bottom are written by different threads, keep them on different cache lines. */
+	sLONG										m_nTop;
+	char										m_Padding1 [ 60 ];
+	sLONG										m_nBottom;
+	char										m_Padding2 [ 60 ];
+	VConnectionHandler* volatile				m_arrSlots [ kCAPACITY ];
+};
+
+
+/** @brief	Worker running connection handlers that can share a task (see VConnectionHandler::CanShareWorker()).
+			Handlers not done are pushed back to the worker queue and run again in turn. When its queue is empty,
+			a worker takes new handlers from the pool queue, then steals from the other workers and finally parks
+			on the pool queue until a handler is pushed or the pool wakes it up. */
+class XTOOLBOX_API VSharedWorker : public VTask
+{
+	public :
+
+	/* Counters are updated by the worker only and read without synchronization: they are approximate. */
+	typedef struct Statistics
+	{
+		sLONG									fQueueLength;
+		sLONG8									fRuns;				/* Calls to VConnectionHandler::Handle(). */
+		sLONG8									fCompleted;			/* Handlers that returned eWS_DONE. */
+		sLONG8									fSteals;			/* Handlers taken from other workers. */
+		sLONG8									fParks;
+		sLONG8									fRunTime;			/* Microseconds spent in Handle(). */
+		sLONG8									fMaxRunTime;		/* Microseconds. */
+	} Statistics;
+
+	VSharedWorker ( VWorkerPool& inParentWorkerPool );
+	virtual ~VSharedWorker ( );
+
+	/* Stops the handler being run and the queued ones that are of type inType. */
+	VError StopConnectionHandlers ( int inType );
+
+	/* Called by other workers. */
+	VConnectionHandler* StealConnectionHandler ( ) { return m_vQueue. Steal ( ); }
+
+	void GetStatistics ( Statistics& outStatistics ) const;
+
+	protected :
+
+	enum
+	{
+		kPARK_TIMEOUT = 1000,		/* Milliseconds, in case a wake up is missed. */
+		kROUND_PAUSE = 10			/* Milliseconds, after a round where no handler was done. */
+	};
+
+	virtual Boolean DoRun ( );
+
+	VConnectionHandler* TakeConnectionHandler ( );
+	/* Returns true if the worker should pause before next run. ioConnectionHandler is set to NULL unless
+	it could not be queued again, in which case it should be run again right away. */
+	bool RunConnectionHandler ( VConnectionHandler*& ioConnectionHandler );
+	VConnectionHandler* Park ( sLONG inTimeout );
+	void ReleaseAllConnectionHandlers ( );
+
+	VWorkerPool&								m_vParentWorkerPool;
+	VConnectionHandlerStealQueue				m_vQueue;
+
+	VCriticalSection							m_vcsCurrentLock;
+	VConnectionHandler*							m_CurrentConnectionHandler;
+
+	sLONG										m_nRunsNotDone;		/* Consecutive runs that returned eWS_NOT_DONE. */
+	uLONG										m_nStealSeed;
+	Statistics									m_Statistics;
+	sLONG8										m_nProfilingFrequency;
+};
+
+
+END_TOOLBOX_NAMESPACE
+
+
+#endif
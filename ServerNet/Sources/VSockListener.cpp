@@ -48,11 +48,11 @@ public:
 	
 	XTCPSock* GetSock()						{ return fSock; }
 	
-	VError Publish()
+	VError Publish(bool inReusePort=false)
 	{
 		StTmpErrorContext errCtx;
 
-		XTCPSock* sock=XTCPSock::NewServerListeningSock(fAddr, fBoundSock, fReuseAddress);
+		XTCPSock* sock=XTCPSock::NewServerListeningSock(fAddr, fBoundSock, fReuseAddress, inReusePort);
 
 		SetSock(sock);
 		
@@ -78,7 +78,7 @@ private:
 
 
 VSockListener::VSockListener(IRequestLogger* inRequestLogger) :
-fRequestLogger(inRequestLogger), fListenStarted(false), fKeyCertChain(NULL)
+fRequestLogger(inRequestLogger), fListenStarted(false), fReusePort(false), fKeyCertChain(NULL)
 {}
 
 
@@ -365,7 +365,7 @@ bool VSockListener::StartListening()
 		std::vector<XSBind*>::iterator		iterBind = fPlainListens. begin ( );
 		while ( iterBind != fPlainListens. end ( ) )
 		{
-			if ( !( l_res = ( ( *iterBind )-> Publish ( ) == VE_OK ) ) )
+			if ( !( l_res = ( ( *iterBind )-> Publish ( fReusePort ) == VE_OK ) ) )
 				break;
 			
 			fAcceptIterator.AddServiceSocket((*iterBind)->GetSock());
@@ -377,7 +377,7 @@ bool VSockListener::StartListening()
 			iterBind = fSslListens. begin ( );
 			while ( iterBind != fSslListens. end ( ) )
 			{
-				VError verr=(*iterBind)->Publish();
+				VError verr=(*iterBind)->Publish(fReusePort);
 				
 				if(verr!=VE_OK)
 				{
@@ -470,4 +470,10 @@ void VSockListener::ReleaseConnection(XTCPSock *iConnection)
 }
 
 
+void VSockListener::GetStatistics (VSockListenerStatistics& outStatistics)
+{
+	fAcceptIterator.GetStatistics(&outStatistics);
+}
+
+
 END_TOOLBOX_NAMESPACE
@@ -55,10 +55,16 @@ public:
 	
 	void setAcceptTimeout(uLONG inMsTimeout);
 	bool SetBlocking (bool isBlocking = false);
+
+	// Listen with SO_REUSEPORT, so several listeners can be bound to the same ports (kernel spreads connections
+	// among them). Must be called before StartListening(). Only effective where SO_REUSEPORT is supported.
+	void SetReusePort (bool inReusePort)		{ fReusePort = inReusePort; }
 	
 	XTCPSock* GetNewConnectedSocket(sLONG inMsTimeout);
 	
 	void ReleaseConnection(XTCPSock* in);
+
+	void GetStatistics (VSockListenerStatistics& outStatistics);
 	
 private:
 	
@@ -72,6 +78,7 @@ private:
 	std::vector<XSBind*> fSslListens;
 	XTCPAcceptIterator fAcceptIterator;
 	bool fListenStarted;
+	bool fReusePort;
 	VKeyCertChain* fKeyCertChain;
 };
 
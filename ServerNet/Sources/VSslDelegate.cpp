@@ -1386,6 +1386,52 @@ VSslDelegate* VSslDelegate::NewServerDelegate(Socket inRawSocket, VKeyCertChain*
 }
 
 
+void* VSslDelegate::RetainSession()
+{
+	if(fConnection==NULL || fIOState==kNeedHandshake)
+		return NULL;
+
+	return SSLSTUB::SSL_get1_session(fConnection->GetConnection());
+}
+
+
+VError VSslDelegate::SetSession(void* inSession)
+{
+	if(fConnection==NULL || inSession==NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+	xbox_assert(fIOState==kNeedHandshake);
+
+	int res=SSLSTUB::SSL_set_session(fConnection->GetConnection(), reinterpret_cast<SSL_SESSION*>(inSession));
+
+	if(res!=1)
+		return vThrowThreadErrorStack(VE_SSL_NEW_CONTEXT_FAILED);
+
+	return VE_OK;
+}
+
+
+bool VSslDelegate::IsSessionReused()
+{
+	if(fConnection==NULL || fIOState==kNeedHandshake)
+		return false;
+
+	return SSLSTUB::SSL_session_reused_4D(fConnection->GetConnection())!=0;
+}
+
+
+//static
+void VSslDelegate::ReleaseSession(void** ioSession)
+{
+	if(ioSession==NULL || *ioSession==NULL)
+		return;
+
+	SSLSTUB::SSL_SESSION_free(reinterpret_cast<SSL_SESSION*>(*ioSession));
+
+	*ioSession=NULL;
+}
+
+
 //Verrue pour débuter le dialogue 4D client/serveur avec SelectIO
 void VSslDelegate::DummyWriteToTriggerHandshake()
 {
@@ -1576,6 +1622,58 @@ VError VSslDelegate::Write(const void* inBuff, uLONG* ioLen)
 }
 
 
+VError VSslDelegate::WriteV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen)
+{
+	// - inBuffers and outLen are mandatory ; outLen is always modified (set to 0 on error)
+	// - Caller should deal with special error VE_SOCK_WOULD_BLOCK, and retry with the same buffers.
+	// - Partial write is possible, as with Write() ; at most kCOALESCE_SIZE bytes are copied.
+
+	if(inBuffers==NULL || outLen==NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+	*outLen=0;
+
+	if(inCount==0)
+		return VE_OK;
+
+	if(inCount==1 || inBuffers[0].fLength>=kCOALESCE_SIZE)
+	{
+		uLONG len=inBuffers[0].fLength;
+
+		VError verr=Write(inBuffers[0].fData, &len);
+
+		*outLen=len;
+
+		return verr;
+	}
+
+	if(!fCoalesceBuffer.Reserve(kCOALESCE_SIZE))
+		return vThrowError(VE_MEMORY_FULL);
+
+	char* coalesced=reinterpret_cast<char*>(fCoalesceBuffer.GetDataPtr());
+	uLONG total=0;
+
+	for(uLONG i=0; i<inCount && total<kCOALESCE_SIZE; i++)
+	{
+		uLONG len=inBuffers[i].fLength;
+
+		if(len>kCOALESCE_SIZE-total)
+			len=kCOALESCE_SIZE-total;
+
+		if(len>0)
+			::memcpy(coalesced+total, inBuffers[i].fData, len);
+
+		total+=len;
+	}
+
+	VError verr=Write(coalesced, &total);
+
+	*outLen=total;
+
+	return verr;
+}
+
+
 VError VSslDelegate::Shutdown()
 {
 	SSLSTUB::ERR_clear_error();
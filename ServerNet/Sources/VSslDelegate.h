@@ -82,6 +82,10 @@ public :
 	
 	VError Read(void* outBuff, uLONG* ioLen);
 	VError Write(const void* inBuff, uLONG* ioLen);
+
+	//Same as Write(), but small buffers are coalesced into a single SSL record (one SSL_write() call)
+	//instead of one record each. A large first buffer is written directly, without copy.
+	VError WriteV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen);
 	VError Shutdown();
 
 	bool NeedHandshake()	{return fIOState==kNeedHandshake;}
@@ -96,6 +100,15 @@ public :
 	// Only to be used by VJSNet at SSL socket creation (SSJS implementation).
 	VError HandShake ();
 
+	//Client session resumption : RetainSession() gets the session of a connection (after the handshake),
+	//SetSession() offers it to the server on a new connection (before the handshake). Sessions are opaque
+	//(SSL_SESSION*) and must be freed with ReleaseSession(). IsSessionReused() tells, after the handshake, if
+	//the server accepted the offered session.
+	void* RetainSession();
+	VError SetSession(void* inSession);
+	bool IsSessionReused();
+	static void ReleaseSession(void** ioSession);
+
 
 private :
 
@@ -115,6 +128,12 @@ private :
 	XConnection* fConnection;
 	
 	VKeyCertChain* fKeyCertChain;
+
+	//Maximum plaintext size of an SSL record.
+	static const uLONG kCOALESCE_SIZE=16384;
+
+	//Allocated once so that retries after WOULD_BLOCK use the same buffer, as required by SSL_write().
+	VMemoryBuffer<> fCoalesceBuffer;
 };
 
 
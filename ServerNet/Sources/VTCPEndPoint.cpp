@@ -767,6 +767,116 @@ VError VTCPEndPoint::DoWriteExactly(const void *inBuff, uLONG* ioLen, sLONG inMs
 }
 
 
+VError VTCPEndPoint::DoWriteExactlyV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen, sLONG inMsTimeout)
+{
+	if (fSock==NULL)
+		return ReportError( VE_SRVR_NULL_ENDPOINT );
+
+	if(inBuffers==NULL || outLen==NULL)
+		return ReportError(VE_INVALID_PARAMETER);
+
+	if(inMsTimeout<0)
+		return ReportError(VE_INVALID_PARAMETER);
+
+	*outLen=0;
+
+	xbox_assert ( !fIsInAutoReconnect || ( fIsInAutoReconnect && fIsInUse ) );
+
+	//Sliding window on inBuffers : index/offset of the first byte not sent yet. Partially sent buffer
+	//is copied in a local array, so that caller's buffers are left untouched.
+	VWriteBuffer window[XTCPSock::kMAX_WRITE_BUFFERS];
+
+	uLONG index=0;
+	uLONG offset=0;
+
+	bool withTimeout=(inMsTimeout>0);
+
+	sLONG timeoutMs=inMsTimeout;
+
+	for(;;)
+	{
+		//Skip sent (or empty) buffers
+		while(index<inCount && offset>=inBuffers[index].fLength)
+		{
+			index++;
+			offset=0;
+		}
+
+		if(index>=inCount)
+			break;
+
+		uLONG count=0;
+
+		for(uLONG i=index; i<inCount && count<XTCPSock::kMAX_WRITE_BUFFERS; i++, count++)
+			window[count]=inBuffers[i];
+
+		window[0].fData=reinterpret_cast<const char*>(window[0].fData)+offset;
+		window[0].fLength-=offset;
+
+		uLONG len=0;
+
+		VError verr=VE_OK;
+
+		if(withTimeout)
+		{
+			sLONG spentMs=0;
+
+			verr=fSock->WriteVWithTimeout(window, count, &len, timeoutMs, &spentMs);
+
+			timeoutMs-=spentMs;
+		}
+		else
+			verr=fSock->WriteV(window, count, &len);
+
+		*outLen+=len;
+
+		if(verr==VE_SOCK_CONNECTION_BROKEN)
+			return ReportError(VE_SRVR_CONNECTION_BROKEN);
+
+		if(verr==VE_SOCK_TIMED_OUT)
+			return ReportError(VE_SRVR_WRITE_TIMED_OUT, false, false);
+
+		if(verr==VE_SOCK_WRITE_FAILED || verr==VE_SSL_WRITE_FAILED)
+			return ReportError(VE_SRVR_WRITE_FAILED);
+
+		xbox_assert(verr==VE_OK);	//No unhandled error !
+
+		if(verr!=VE_OK)
+			return ReportError(VE_SRVR_WRITE_FAILED);
+
+		//Advance index/offset by len bytes
+		while(len>0 && index<inCount)
+		{
+			uLONG remaining=inBuffers[index].fLength-offset;
+
+			if(len<remaining)
+			{
+				offset+=len;
+				len=0;
+			}
+			else
+			{
+				len-=remaining;
+				index++;
+				offset=0;
+			}
+		}
+
+		xbox_assert(len==0);
+
+		if(index>=inCount)
+			break;
+
+		if ( fShouldStop )
+			return ReportError(VE_SRVR_WRITE_FAILED, false, false);
+
+		VTask::Yield();
+	}
+
+	return VE_OK;
+}
+
+
 ReadNotificationMessage::ReadNotificationMessage(VTCPEndPoint* inEndPoint) : fEndPoint(inEndPoint)
 {
 	RetainRefCountable(fEndPoint);
@@ -1017,6 +1127,30 @@ bool VTCPEndPoint::IsPostponeTimedOut ( )
 	return bResult;
 }
 
+uLONG VTCPEndPoint::GetIdleTimeLeft ( )
+{
+	if ( fIdleTimeout == 0 )
+		return 0;
+
+	VTime				vtNow;
+	VTime::Now ( vtNow );
+	sLONG8				nElapsed = vtNow. GetMilliseconds ( ) - fIdleStart. GetMilliseconds ( );
+
+	return ( nElapsed >= fIdleTimeout ) ? 0 : ( uLONG ) ( fIdleTimeout - nElapsed );
+}
+
+uLONG VTCPEndPoint::GetPostponeTimeLeft ( )
+{
+	if ( fPostponeTimeout == 0 )
+		return 0;
+
+	VTime				vtNow;
+	VTime::Now ( vtNow );
+	sLONG8				nElapsed = vtNow. GetMilliseconds ( ) - fPostponeStart. GetMilliseconds ( );
+
+	return ( nElapsed >= fPostponeTimeout ) ? 0 : ( uLONG ) ( fPostponeTimeout - nElapsed );
+}
+
 bool VTCPEndPoint::TryToUse ( )
 {
 	bool				bResult = fUsageMutex. TryToLock ( );
@@ -1709,6 +1843,247 @@ VError VTCPEndPoint::WriteExactly(const void *inBuff, uLONG inLen, sLONG inMsTim
 }
 
 
+VError VTCPEndPoint::WriteExactlyV(const VWriteBuffer* inBuffers, uLONG inCount, sLONG inMsTimeout)
+{
+	if(inBuffers==NULL)
+		return ReportError(VE_INVALID_PARAMETER);
+
+	ILogger* logger=VProcess::Get()->GetLogger();
+
+	bool shouldTrace=(logger!=NULL) ? logger->ShouldLog(EML_Trace) : false;
+
+	VValueBag* tBag=NULL;
+
+	if(shouldTrace)
+		tBag=new VValueBag;
+
+	shouldTrace&=(tBag!=NULL);
+
+	if(shouldTrace)
+	{
+		uLONG8 totalLen=0;
+
+		for(uLONG i=0; i<inCount; i++)
+			totalLen+=inBuffers[i].fLength;
+
+		ILoggerBagKeys::level.Set(tBag, EML_Trace);
+
+		ILoggerBagKeys::component_signature.Set(tBag, kSERVER_NET_SIGNATURE);
+
+		ILoggerBagKeys::task_id.Set(tBag, VTask::GetCurrentID());
+
+		ILoggerBagKeys::message.Set(tBag, CVSTR("VTCPEndPoint::WriteExactlyV"));
+
+		ILoggerBagKeys::local_addr.Set(tBag, GetLocalIP(this));
+
+		ILoggerBagKeys::peer_addr.Set(tBag, GetPeerIP(this));
+
+		ILoggerBagKeys::local_port.Set(tBag, GetLocalPort(this));
+
+		ILoggerBagKeys::peer_port.Set(tBag, GetPeerPort(this));
+
+		ILoggerBagKeys::count_bytes_asked.Set(tBag, totalLen);
+
+		ILoggerBagKeys::ms_timeout.Set(tBag, inMsTimeout);
+
+		ILoggerBagKeys::socket.Set(tBag, GetRawSocket());
+
+		ILoggerBagKeys::is_blocking.Set(tBag, IsBlocking());
+
+		ILoggerBagKeys::is_select_io.Set(tBag, IsSelectIO());
+
+		ILoggerBagKeys::is_ssl.Set(tBag, IsSSL());
+	}
+
+	//Same as WriteExactly() : Non blocking and timeout zero really means blocking.
+
+	bool wasBlocking = fSock!=NULL ? fSock->IsBlocking() : true;
+
+	if(inMsTimeout<=0 && !wasBlocking)
+		fSock->SetBlocking(true);
+
+
+	uLONG partialWriteLen=0;
+
+	VError verr=DoWriteExactlyV(inBuffers, inCount, &partialWriteLen, inMsTimeout);
+
+
+	if(fSock!=NULL && fSock->IsBlocking()!=wasBlocking)
+		fSock->SetBlocking(wasBlocking);
+
+	if(shouldTrace)
+	{
+		ILoggerBagKeys::error_code.Set(tBag, verr);
+
+		ILoggerBagKeys::count_bytes_sent.Set(tBag, partialWriteLen);
+
+		logger->LogBag(tBag);
+	}
+
+	if(tBag!=NULL)
+		ReleaseRefCountable(&tBag);
+
+	bool shouldDump=(logger!=NULL) ? logger->ShouldLog(EML_Dump) : false;
+
+	if(shouldDump)
+	{
+		uLONG dumpLen=partialWriteLen;
+
+		for(uLONG i=0; i<inCount && dumpLen>0; i++)
+		{
+			uLONG bufferLen=(inBuffers[i].fLength<dumpLen) ? inBuffers[i].fLength : dumpLen;
+
+			dumpLen-=bufferLen;
+
+			sLONG offset=0;
+
+			while(offset<static_cast<sLONG>(bufferLen))
+			{
+				VValueBag* dBag=new VValueBag;
+
+				if(dBag==NULL)
+					break;
+
+				ILoggerBagKeys::level.Set(dBag, EML_Dump);
+
+				ILoggerBagKeys::component_signature.Set(dBag, kSERVER_NET_SIGNATURE);
+
+				ILoggerBagKeys::task_id.Set(dBag, VTask::GetCurrentID());
+
+				ILoggerBagKeys::message.Set(dBag, CVSTR("VTCPEndPoint::WriteExactlyV"));
+
+				offset=ServerNetTools::FillDumpBag(dBag, inBuffers[i].fData, bufferLen, offset);
+
+				logger->LogBag(dBag);
+
+				ReleaseRefCountable(&dBag);
+			}
+		}
+	}
+
+	return verr;
+}
+
+
+VError VTCPEndPoint::SendFile(VFileDesc* inFileDesc, sLONG8 inOffset, sLONG8 inLength, sLONG inMsTimeout)
+{
+	if(fSock==NULL)
+		return ReportError(VE_SRVR_NULL_ENDPOINT);
+
+	if(inFileDesc==NULL || inOffset<0 || inLength<0 || inMsTimeout<0)
+		return ReportError(VE_INVALID_PARAMETER);
+
+	if(inLength==0)
+		return VE_OK;
+
+	VError verr=VE_OK;
+
+#if VERSION_LINUX
+
+	if(!IsSSL())
+	{
+		//Zero copy path : Data go from page cache to socket, without user space buffer.
+
+		bool wasBlocking=fSock->IsBlocking();
+
+		if(inMsTimeout<=0 && !wasBlocking)
+			fSock->SetBlocking(true);
+
+		sLONG8 offset=inOffset;
+		sLONG8 past=inOffset+inLength;
+
+		//As on the generic path, the timeout applies to each chunk : It starts again each time something is sent.
+
+		sLONG timeoutMs=inMsTimeout;
+
+		while(offset<past && verr==VE_OK)
+		{
+			sLONG8 remaining=past-offset;
+
+			uLONG len=(remaining>kMAX_sLONG) ? kMAX_sLONG : static_cast<uLONG>(remaining);
+
+			sLONG spentMs=0;
+
+			verr=fSock->SendFile(inFileDesc->GetSystemRef(), &offset, &len, timeoutMs, &spentMs);
+
+			if(verr==VE_SOCK_WOULD_BLOCK)
+			{
+				//Socket buffer is full : Wait again for the socket to be writable, with what is left of the timeout.
+
+				verr=VE_OK;
+
+				if(inMsTimeout>0)
+				{
+					timeoutMs-=spentMs;
+
+					if(timeoutMs<=0)
+						verr=vThrowError(VE_SOCK_TIMED_OUT);
+				}
+			}
+			else if(verr==VE_OK)
+			{
+				if(len==0)
+					verr=VE_SOCK_WRITE_FAILED;	//Unexpected end of file
+
+				timeoutMs=inMsTimeout;
+			}
+
+			if(verr==VE_OK && offset<past)
+			{
+				if(fShouldStop)
+					verr=VE_SRVR_WRITE_FAILED;
+				else
+					VTask::Yield();
+			}
+		}
+
+		if(fSock->IsBlocking()!=wasBlocking)
+			fSock->SetBlocking(wasBlocking);
+
+		if(verr==VE_OK)
+			return VE_OK;
+
+		if(verr==VE_SOCK_CONNECTION_BROKEN)
+			return ReportError(VE_SRVR_CONNECTION_BROKEN);
+
+		if(verr==VE_SOCK_TIMED_OUT)
+			return ReportError(VE_SRVR_WRITE_TIMED_OUT, false, false);
+
+		return ReportError(VE_SRVR_WRITE_FAILED);
+	}
+
+#endif
+
+	//Generic path : Read file by chunks and write them.
+
+	const VSize kCHUNK_SIZE=64*1024;
+
+	VMemoryBuffer<> chunk;
+
+	if(!chunk.Reserve(kCHUNK_SIZE))
+		return ReportError(VE_MEMORY_FULL);
+
+	sLONG8 offset=inOffset;
+	sLONG8 past=inOffset+inLength;
+
+	while(offset<past && verr==VE_OK)
+	{
+		VSize len=(past-offset>(sLONG8)kCHUNK_SIZE) ? kCHUNK_SIZE : static_cast<VSize>(past-offset);
+
+		VSize readLen=0;
+
+		verr=inFileDesc->GetData(chunk.GetDataPtr(), len, offset, &readLen);
+
+		if(verr==VE_OK)
+			verr=WriteExactly(chunk.GetDataPtr(), static_cast<uLONG>(readLen), inMsTimeout);
+
+		offset+=readLen;
+	}
+
+	return verr;
+}
+
+
 VError VTCPEndPoint::NotifyReadWithMessage(VMessage* inMsg)
 {
 	if(fIsWatching)
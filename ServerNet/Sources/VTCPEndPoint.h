@@ -70,6 +70,15 @@ public:
 	virtual VError ReadExactly(void *outBuff, uLONG inLen, sLONG inTimeOutMillis=0);
 	virtual VError WriteExactly(const void *inBuff, uLONG inLen, sLONG inTimeOutMillis=0);
 
+	//Scatter/gather WriteExactly() : All buffers are sent in order, with as few system calls as possible
+	//(a single SSL record for small buffers on SSL end points). Buffers are not copied on plain TCP.
+	VError WriteExactlyV(const VWriteBuffer* inBuffers, uLONG inCount, sLONG inTimeOutMillis=0);
+
+	//Send inLength bytes of inFileDesc, starting at inOffset. Uses sendfile() when available (Linux, no SSL),
+	//else reads the file by chunks and calls WriteExactly(). inTimeOutMillis applies to each chunk : It is the longest
+	//wait for the socket to take more data, not a budget for the whole file.
+	VError SendFile(VFileDesc* inFileDesc, sLONG8 inOffset, sLONG8 inLength, sLONG inTimeOutMillis=0);
+
 	//Helps to wait (block) on message queue AND network read at the same time
 	virtual VError NotifyReadWithMessage(VMessage* inMsg=NULL);
 
@@ -104,10 +113,14 @@ public:
 	virtual uLONG GetIdleTimeout ( ) { return fIdleTimeout; }
 	virtual void SetIdleTimeout ( uLONG inIdleTimeout ) { fIdleTimeout = inIdleTimeout; }
 	virtual bool IsIdleTimedOut ( );
+	/* Milliseconds before IsIdleTimedOut ( ) returns true, 0 if it does or if there is no idle timeout. */
+	virtual uLONG GetIdleTimeLeft ( );
 	
 	virtual uLONG GetPostponeTimeout ( ) { return fPostponeTimeout; }
 	virtual void SetPostponeTimeout ( uLONG inPostponeTimeout ) { fPostponeTimeout = inPostponeTimeout; }
 	virtual bool IsPostponeTimedOut ( );
+	/* Milliseconds before IsPostponeTimedOut ( ) returns true, 0 if it does or if there is no postpone timeout. */
+	virtual uLONG GetPostponeTimeLeft ( );
 	
 	virtual bool TryToUse ( );
 	virtual VError Use ( );
@@ -152,6 +165,7 @@ private :
 	
 	virtual VError DoWrite(void *inBuff, uLONG *ioLen, sLONG inTimeoutMs=0, sLONG* outMsSpent=NULL, bool inWithEmptyTail=false);
 	virtual VError DoWriteExactly(const void *inBuff, uLONG* ioLen, sLONG inTimeOutMillis=0);
+	VError DoWriteExactlyV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen, sLONG inTimeOutMillis=0);
 
 	static bool DoNotifyReadCallback(Socket /*inRawSocket*/, VEndPoint* inEndPoint, void *inData, sLONG /*inErrorCode*/);
 
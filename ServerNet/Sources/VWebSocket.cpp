@@ -17,6 +17,14 @@
 
 #include "VWebSocket.h"
 
+#include <zlib.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
 USING_TOOLBOX_NAMESPACE
 
 // See section 4.2.2 of spec.
@@ -58,6 +66,12 @@ void VWebSocketFrame::ApplyMaskingKey (
 {
 	xbox_assert(inMaskedData != NULL && outUnmaskedData != NULL && !(inModuloIndex & ~0x3));
 
+	// Either fully distinct or identical (in-place) buffers, partial overlap is not supported.
+
+	xbox_assert(inMaskedData == outUnmaskedData 
+				|| inMaskedData + inDataLength <= outUnmaskedData 
+				|| outUnmaskedData + inDataLength <= inMaskedData);
+
 	uBYTE	maskingKey[4];
 
 	maskingKey[0] = inMaskingKey >> 24;
@@ -65,9 +79,82 @@ void VWebSocketFrame::ApplyMaskingKey (
 	maskingKey[2] = inMaskingKey >> 8;
 	maskingKey[3] = inMaskingKey;
 
-	for (VSize i = 0; i < inDataLength; i++, inModuloIndex = (inModuloIndex + 1) & 0x3)
+	// Unaligned head: Go byte per byte until output is aligned on a 16 bytes boundary.
+
+	while (inDataLength && ((uintptr_t) outUnmaskedData & 0xf)) {
+
+		*outUnmaskedData++ = *inMaskedData++ ^ maskingKey[inModuloIndex];
+		inModuloIndex = (inModuloIndex + 1) & 0x3;
+		inDataLength--;
+
+	}
+
+	if (inDataLength >= sizeof(uLONG8)) {
+
+		// Rotate key so that the first byte of the pattern matches current index. As all block sizes below are multiples 
+		// of 4, the index is left unchanged after each block. Patterns are built using memcpy() so byte order in memory is
+		// the same as the key whatever the endianness.
+
+		uBYTE	rotatedKey[8];
+		uLONG	key32;
+		uLONG8	key64;
+
+		for (uLONG i = 0; i < 8; i++)
+
+			rotatedKey[i] = maskingKey[(inModuloIndex + i) & 0x3];
+
+		::memcpy(&key32, rotatedKey, sizeof(key32));
+		::memcpy(&key64, rotatedKey, sizeof(key64));
+
+#if defined(__AVX2__)
+
+		__m256i	key256	= _mm256_set1_epi32((int) key32);
+
+		for ( ; inDataLength >= 32; inDataLength -= 32, inMaskedData += 32, outUnmaskedData += 32) {
+
+			__m256i	data	= _mm256_loadu_si256((const __m256i *) inMaskedData);
+
+			_mm256_storeu_si256((__m256i *) outUnmaskedData, _mm256_xor_si256(data, key256));
+
+		}
+
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+		// Output is aligned, but input may not be (it is usually a pointer into a frame with a variable length header).
+
+		__m128i	key128	= _mm_set1_epi32((int) key32);
+
+		for ( ; inDataLength >= 16; inDataLength -= 16, inMaskedData += 16, outUnmaskedData += 16) {
+
+			__m128i	data	= _mm_loadu_si128((const __m128i *) inMaskedData);
+
+			_mm_store_si128((__m128i *) outUnmaskedData, _mm_xor_si128(data, key128));
+
+		}
 
-		outUnmaskedData[i] = inMaskedData[i] ^ maskingKey[inModuloIndex];
+#endif
+
+		// Scalar fallback, also handles the remaining 8 bytes block of the SIMD versions.
+
+		for ( ; inDataLength >= sizeof(uLONG8); inDataLength -= sizeof(uLONG8), inMaskedData += sizeof(uLONG8), outUnmaskedData += sizeof(uLONG8)) {
+
+			uLONG8	data;
+
+			::memcpy(&data, inMaskedData, sizeof(data));
+			data ^= key64;
+			::memcpy(outUnmaskedData, &data, sizeof(data));
+
+		}
+
+	}
+
+	// Tail.
+
+	for ( ; inDataLength; inDataLength--, inModuloIndex = (inModuloIndex + 1) & 0x3)
+
+		*outUnmaskedData++ = *inMaskedData++ ^ maskingKey[inModuloIndex];
 }
 
 XBOX::VError VWebSocketFrame::Decode (const uBYTE *inFrame, VSize *ioFrameLength)
@@ -260,9 +347,9 @@ XBOX::VError VWebSocketFrame::Encode (XBOX::VMemoryBuffer<> *outFrame, VSize inD
 		maskingKey[3] = fMaskingKey;
 
 		maskedPayloadData = maskingKey + 4;
-		for (VSize i = 0; i < inDataLength; i++)
+		if (inDataLength)
 
-			maskedPayloadData[i] = fPayloadData[i] ^ maskingKey[i & 0x3];		
+			ApplyMaskingKey(fPayloadData, maskedPayloadData, fMaskingKey, inDataLength, 0);
 
 	} else 
 
@@ -296,12 +383,13 @@ XBOX::VError VWebSocketFrame::Encode (
 
 	} else {
 
-		uBYTE		opcode;
+		uBYTE		opcode, rsvFlags;
 		const uBYTE	*payloadData;
 		uLONG8		payloadDataLength;
 		VSize		maximumDataLength;
 
 		opcode = fOpcode;
+		rsvFlags = fRSVFlags;
 		payloadData = fPayloadData;
 		payloadDataLength = fPayloadDataLength;
 		maximumDataLength = GetMaximumDataLength(inGenerateMaskingKey || fMaskingKeyFlag, inMaximumFrameSize);
@@ -338,6 +426,7 @@ XBOX::VError VWebSocketFrame::Encode (
 				bytesLeft -= dataLength;
 
 				fOpcode = 0;	// Continuation frame.
+				fRSVFlags &= ~FLAG_RSV1;	// permessage-deflate sets it on first frame only.
 				fPayloadData += dataLength;
 
 			} else
@@ -347,6 +436,7 @@ XBOX::VError VWebSocketFrame::Encode (
 		}
 
 		fOpcode = opcode;
+		fRSVFlags = rsvFlags;
 		fPayloadData = payloadData;
 		fPayloadDataLength = payloadDataLength;
 
@@ -388,6 +478,671 @@ VSize VWebSocketFrame::GetMaximumDataLength (bool inUseMaskingKey, VSize inMaxim
 		return inMaximumFrameSize - smallHeaderSize;
 }
 
+const char	VWebSocketDeflateParameters::EXTENSION_NAME[]	= "permessage-deflate";
+
+// Parameters of a single permessage-deflate offer or response. Window bits are zero if absent, a client_max_window_bits 
+// without value is set to -1.
+
+typedef struct {
+
+	bool	fServerNoContextTakeover;
+	bool	fClientNoContextTakeover;
+	sLONG	fServerMaxWindowBits;
+	sLONG	fClientMaxWindowBits;
+
+} SDeflateExtensionParameters;
+
+static bool _ParseWindowBits (const XBOX::VString &inValue, sLONG *outWindowBits)
+{
+	XBOX::VString	value(inValue);
+
+	// Value may be a quoted-string (section 7.1 of RFC 7692).
+
+	if (value.GetLength() >= 2 && value[0] == '"' && value[value.GetLength() - 1] == '"')
+
+		value.SubString(2, value.GetLength() - 2);
+
+	if (value.IsEmpty() || value.GetLength() > 2)
+
+		return false;
+
+	for (VIndex i = 0; i < value.GetLength(); i++)
+
+		if (value[i] < '0' || value[i] > '9')
+
+			return false;
+
+	*outWindowBits = value.GetLong();
+
+	return *outWindowBits >= VWebSocketDeflateParameters::MINIMUM_WINDOW_BITS 
+		&& *outWindowBits <= VWebSocketDeflateParameters::MAXIMUM_WINDOW_BITS;
+}
+
+// Parse an extension element of a Sec-WebSocket-Extensions value. Return false if it isn't permessage-deflate or if 
+// it is invalid (unknown or duplicate parameter, incorrect value).
+
+static bool _ParseDeflateExtension (const XBOX::VString &inExtension, SDeflateExtensionParameters *outParameters)
+{
+	XBOX::VectorOfVString	parameters;
+
+	inExtension.GetSubStrings(';', parameters, true, true);
+	if (parameters.empty() || !parameters[0].EqualToUSASCIICString(VWebSocketDeflateParameters::EXTENSION_NAME))
+
+		return false;
+
+	::memset(outParameters, 0, sizeof(*outParameters));
+	for (size_t i = 1; i < parameters.size(); i++) {
+
+		XBOX::VString	name, value;
+		VIndex			equalPosition;
+		bool			hasValue;
+
+		if ((equalPosition = parameters[i].FindUniChar('=')) > 0) {
+
+			parameters[i].GetSubString(1, equalPosition - 1, name);
+			parameters[i].GetSubString(equalPosition + 1, parameters[i].GetLength() - equalPosition, value);
+			name.TrimeSpaces();
+			value.TrimeSpaces();
+			hasValue = true;
+
+		} else {
+
+			name = parameters[i];
+			hasValue = false;
+
+		}
+
+		if (name.EqualToUSASCIICString("server_no_context_takeover")) {
+
+			if (hasValue || outParameters->fServerNoContextTakeover)
+
+				return false;
+
+			outParameters->fServerNoContextTakeover = true;
+
+		} else if (name.EqualToUSASCIICString("client_no_context_takeover")) {
+
+			if (hasValue || outParameters->fClientNoContextTakeover)
+
+				return false;
+
+			outParameters->fClientNoContextTakeover = true;
+
+		} else if (name.EqualToUSASCIICString("server_max_window_bits")) {
+
+			if (!hasValue || outParameters->fServerMaxWindowBits
+			|| !_ParseWindowBits(value, &outParameters->fServerMaxWindowBits))
+
+				return false;
+
+		} else if (name.EqualToUSASCIICString("client_max_window_bits")) {
+
+			if (outParameters->fClientMaxWindowBits)
+
+				return false;
+
+			else if (!hasValue) 
+
+				outParameters->fClientMaxWindowBits = -1;
+
+			else if (!_ParseWindowBits(value, &outParameters->fClientMaxWindowBits))
+
+				return false;
+
+		} else
+
+			return false;
+
+	}
+
+	return true;
+}
+
+static void _AppendWindowBits (XBOX::VString *ioString, const char *inName, sLONG inWindowBits)
+{
+	ioString->AppendCString("; ");
+	ioString->AppendCString(inName);
+	if (inWindowBits > 0) {
+
+		ioString->AppendUniChar('=');
+		ioString->AppendLong(inWindowBits);
+
+	}
+}
+
+VWebSocketDeflateParameters::VWebSocketDeflateParameters ()
+{
+	fServerNoContextTakeover = fClientNoContextTakeover = false;
+	fServerMaxWindowBits = fClientMaxWindowBits = MAXIMUM_WINDOW_BITS;
+
+	fCompressionLevel = DEFAULT_COMPRESSION_LEVEL;
+	fMemoryLevel = DEFAULT_MEMORY_LEVEL;
+	fMinimumMessageSize = DEFAULT_MINIMUM_MESSAGE_SIZE;
+	fMaximumMessageSize = DEFAULT_MAXIMUM_MESSAGE_SIZE;
+}
+
+void VWebSocketDeflateParameters::GetOffer (XBOX::VString *outOffer) const
+{
+	xbox_assert(outOffer != NULL);
+
+	outOffer->FromCString(EXTENSION_NAME);
+	if (fServerNoContextTakeover)
+
+		outOffer->AppendCString("; server_no_context_takeover");
+
+	if (fClientNoContextTakeover)
+
+		outOffer->AppendCString("; client_no_context_takeover");
+
+	if (fServerMaxWindowBits < MAXIMUM_WINDOW_BITS)
+
+		_AppendWindowBits(outOffer, "server_max_window_bits", fServerMaxWindowBits);
+
+	// Always tell server that client_max_window_bits is supported. zlib can't compress with a 256 bytes window, 
+	// so never ask for less than 9.
+
+	_AppendWindowBits(
+		outOffer, 
+		"client_max_window_bits", 
+		fClientMaxWindowBits < MAXIMUM_WINDOW_BITS ? (fClientMaxWindowBits > 9 ? fClientMaxWindowBits : 9) : 0);
+}
+
+XBOX::VError VWebSocketDeflateParameters::ParseResponse (
+	const XBOX::VString &inResponse, 
+	bool *outIsAccepted, 
+	VWebSocketDeflateParameters *outAgreed) const
+{
+	xbox_assert(outIsAccepted != NULL && outAgreed != NULL);
+
+	XBOX::VectorOfVString	extensions;
+	bool					isFound;
+
+	inResponse.GetSubStrings(',', extensions, false, true);
+	*outIsAccepted = isFound = false;
+	for (size_t i = 0; i < extensions.size(); i++) {
+
+		XBOX::VectorOfVString	parameters;
+
+		extensions[i].GetSubStrings(';', parameters, true, true);
+		if (!parameters.empty() && parameters[0].EqualToUSASCIICString(EXTENSION_NAME)) {
+
+			// Server must select at most one permessage-deflate element.
+
+			if (isFound)
+
+				return VE_SRVR_WEBSOCKET_INVALID_SERVER_RESPONSE;
+
+			isFound = true;
+
+			SDeflateExtensionParameters	response;
+			sLONG						offeredClientMaxWindowBits;
+
+			offeredClientMaxWindowBits = fClientMaxWindowBits > 9 ? fClientMaxWindowBits : 9;
+			if (!_ParseDeflateExtension(extensions[i], &response)
+			|| response.fClientMaxWindowBits < 0
+			|| response.fClientMaxWindowBits > offeredClientMaxWindowBits
+			|| (response.fClientMaxWindowBits && response.fClientMaxWindowBits < 9)
+			|| (fServerMaxWindowBits < MAXIMUM_WINDOW_BITS && response.fServerMaxWindowBits > fServerMaxWindowBits))
+
+				return VE_SRVR_WEBSOCKET_INVALID_SERVER_RESPONSE;
+
+			*outAgreed = *this;
+			outAgreed->fServerNoContextTakeover = response.fServerNoContextTakeover;
+			outAgreed->fClientNoContextTakeover = fClientNoContextTakeover || response.fClientNoContextTakeover;
+			outAgreed->fServerMaxWindowBits = response.fServerMaxWindowBits ? response.fServerMaxWindowBits : MAXIMUM_WINDOW_BITS;
+			outAgreed->fClientMaxWindowBits = response.fClientMaxWindowBits ? response.fClientMaxWindowBits : offeredClientMaxWindowBits;
+			*outIsAccepted = true;
+
+		}
+
+	}
+
+	return XBOX::VE_OK;
+}
+
+bool VWebSocketDeflateParameters::Negotiate (
+	const XBOX::VString &inOffers, 
+	VWebSocketDeflateParameters *outAgreed, 
+	XBOX::VString *outResponse) const
+{
+	xbox_assert(outAgreed != NULL && outResponse != NULL);
+
+	XBOX::VectorOfVString	offers;
+
+	inOffers.GetSubStrings(',', offers, false, true);
+	for (size_t i = 0; i < offers.size(); i++) {
+
+		SDeflateExtensionParameters	offer;
+
+		// Skip invalid offers, as well as those asking for a 256 bytes window, which zlib doesn't support for compression.
+
+		if (!_ParseDeflateExtension(offers[i], &offer) 
+		|| offer.fServerMaxWindowBits == MINIMUM_WINDOW_BITS)
+
+			continue;
+
+		sLONG	serverMaxWindowBits, clientMaxWindowBits;
+
+		serverMaxWindowBits = fServerMaxWindowBits > 9 ? fServerMaxWindowBits : 9;
+		if (offer.fServerMaxWindowBits && offer.fServerMaxWindowBits < serverMaxWindowBits)
+
+			serverMaxWindowBits = offer.fServerMaxWindowBits;
+
+		// Client window can be limited only if client has said it supports it.
+
+		if (!offer.fClientMaxWindowBits)
+
+			clientMaxWindowBits = MAXIMUM_WINDOW_BITS;
+
+		else {
+
+			clientMaxWindowBits = offer.fClientMaxWindowBits < 0 ? MAXIMUM_WINDOW_BITS : offer.fClientMaxWindowBits;
+			if (fClientMaxWindowBits < clientMaxWindowBits)
+
+				clientMaxWindowBits = fClientMaxWindowBits > 9 ? fClientMaxWindowBits : 9;
+
+		}
+
+		*outAgreed = *this;
+		outAgreed->fServerNoContextTakeover = fServerNoContextTakeover || offer.fServerNoContextTakeover;
+		outAgreed->fClientNoContextTakeover = fClientNoContextTakeover || offer.fClientNoContextTakeover;
+		outAgreed->fServerMaxWindowBits = serverMaxWindowBits;
+		outAgreed->fClientMaxWindowBits = clientMaxWindowBits;
+
+		outResponse->FromCString(EXTENSION_NAME);
+		if (outAgreed->fServerNoContextTakeover)
+
+			outResponse->AppendCString("; server_no_context_takeover");
+
+		if (outAgreed->fClientNoContextTakeover)
+
+			outResponse->AppendCString("; client_no_context_takeover");
+
+		if (serverMaxWindowBits < MAXIMUM_WINDOW_BITS)
+
+			_AppendWindowBits(outResponse, "server_max_window_bits", serverMaxWindowBits);
+
+		if (offer.fClientMaxWindowBits && clientMaxWindowBits < MAXIMUM_WINDOW_BITS)
+
+			_AppendWindowBits(outResponse, "client_max_window_bits", clientMaxWindowBits);
+
+		return true;
+
+	}
+
+	return false;
+}
+
+BEGIN_TOOLBOX_NAMESPACE
+
+// permessage-deflate contexts of a connection. Compressed data is "raw" deflate, a message is terminated by a sync 
+// flush whose trailing 0x00 0x00 0xff 0xff is removed when sending and added back when receiving (section 7.2 of RFC).
+
+class VWebSocketDeflate : public VObject
+{
+public:
+
+					VWebSocketDeflate ();
+	virtual			~VWebSocketDeflate ();
+
+	XBOX::VError	Init (const VWebSocketDeflateParameters &inParameters, bool inIsServer);
+
+	VSize			GetMinimumMessageSize () const		{	return fMinimumMessageSize;	}
+
+	// Compress a message into outBuffer (previous content is discarded).
+
+	XBOX::VError	Compress (const uBYTE *inData, VSize inLength, XBOX::VMemoryBuffer<> *outBuffer);
+
+	// Decompress a received message, ioMessage content is replaced.
+
+	XBOX::VError	Decompress (XBOX::VMemoryBuffer<> *ioMessage);
+
+	void			GetStatistics (VWebSocketCompressionStatistics *outStatistics) const;
+
+private:
+
+	static const uBYTE				kTRAILER[4];
+	static const VSize				kMAX_CHUNK_SIZE	= 1 << 30;	// avail_in and avail_out are 32-bit.
+	static const VSize				kMAX_KEPT_SCRATCH_SIZE	= 64 * 1024;	// larger scratch buffers are freed after each message.
+
+	z_stream						fDeflateStream;
+	z_stream						fInflateStream;
+	bool							fIsDeflateInitialized;
+	bool							fIsInflateInitialized;
+	bool							fResetDeflate;
+	bool							fResetInflate;
+	VSize							fMinimumMessageSize;
+	VSize							fMaximumMessageSize;
+	XBOX::VMemoryBuffer<>			fInflateBuffer;
+	VWebSocketCompressionStatistics	fStatistics;
+
+	static bool		_Grow (XBOX::VMemoryBuffer<> *ioBuffer);
+};
+
+END_TOOLBOX_NAMESPACE
+
+const uBYTE	VWebSocketDeflate::kTRAILER[4]	= { 0x00, 0x00, 0xff, 0xff };
+
+VWebSocketDeflate::VWebSocketDeflate ()
+{
+	::memset(&fDeflateStream, 0, sizeof(fDeflateStream));
+	::memset(&fInflateStream, 0, sizeof(fInflateStream));
+	fIsDeflateInitialized = fIsInflateInitialized = false;
+	fResetDeflate = fResetInflate = false;
+	fMinimumMessageSize = fMaximumMessageSize = 0;
+	::memset(&fStatistics, 0, sizeof(fStatistics));
+}
+
+VWebSocketDeflate::~VWebSocketDeflate ()
+{
+	if (fIsDeflateInitialized)
+
+		deflateEnd(&fDeflateStream);
+
+	if (fIsInflateInitialized)
+
+		inflateEnd(&fInflateStream);
+}
+
+XBOX::VError VWebSocketDeflate::Init (const VWebSocketDeflateParameters &inParameters, bool inIsServer)
+{
+	xbox_assert(!fIsDeflateInitialized && !fIsInflateInitialized);
+
+	sLONG	ownWindowBits, peerWindowBits;
+
+	if (inIsServer) {
+
+		ownWindowBits = inParameters.fServerMaxWindowBits;
+		peerWindowBits = inParameters.fClientMaxWindowBits;
+		fResetDeflate = inParameters.fServerNoContextTakeover;
+		fResetInflate = inParameters.fClientNoContextTakeover;
+
+	} else {
+
+		ownWindowBits = inParameters.fClientMaxWindowBits;
+		peerWindowBits = inParameters.fServerMaxWindowBits;
+		fResetDeflate = inParameters.fClientNoContextTakeover;
+		fResetInflate = inParameters.fServerNoContextTakeover;
+
+	}
+	xbox_assert(ownWindowBits > VWebSocketDeflateParameters::MINIMUM_WINDOW_BITS);
+	xbox_assert(ownWindowBits <= VWebSocketDeflateParameters::MAXIMUM_WINDOW_BITS);
+	xbox_assert(peerWindowBits >= VWebSocketDeflateParameters::MINIMUM_WINDOW_BITS);
+	xbox_assert(peerWindowBits <= VWebSocketDeflateParameters::MAXIMUM_WINDOW_BITS);
+
+	fMinimumMessageSize = inParameters.fMinimumMessageSize;
+	fMaximumMessageSize = inParameters.fMaximumMessageSize;
+
+	// Negative window bits for raw deflate streams.
+
+	if (deflateInit2(&fDeflateStream, inParameters.fCompressionLevel, Z_DEFLATED, -ownWindowBits, inParameters.fMemoryLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+
+		return VE_SRVR_WEBSOCKET_COMPRESSION_ERROR;
+
+	fIsDeflateInitialized = true;
+	if (inflateInit2(&fInflateStream, -peerWindowBits) != Z_OK)
+
+		return VE_SRVR_WEBSOCKET_COMPRESSION_ERROR;
+
+	fIsInflateInitialized = true;
+
+	return XBOX::VE_OK;
+}
+
+XBOX::VError VWebSocketDeflate::Compress (const uBYTE *inData, VSize inLength, XBOX::VMemoryBuffer<> *outBuffer)
+{
+	xbox_assert(fIsDeflateInitialized);
+	xbox_assert(!(inData == NULL && inLength) && outBuffer != NULL);
+
+	XBOX::VMicrosecondsCounter	counter;
+	XBOX::VError				error;
+	VSize						messageLength, used;
+
+	counter.Start();
+	messageLength = inLength;
+
+	// Usually a single pass is enough.
+
+	if (!outBuffer->Reserve(deflateBound(&fDeflateStream, inLength < kMAX_CHUNK_SIZE ? (uLong) inLength : (uLong) kMAX_CHUNK_SIZE) + 16))
+
+		return XBOX::VE_MEMORY_FULL;
+
+	error = XBOX::VE_OK;
+	used = 0;
+	do {
+
+		VSize	chunkSize;
+		int		flush;
+
+		chunkSize = inLength < kMAX_CHUNK_SIZE ? inLength : kMAX_CHUNK_SIZE;
+		flush = chunkSize == inLength ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+
+		fDeflateStream.next_in = (Bytef *) inData;
+		fDeflateStream.avail_in = (uInt) chunkSize;
+		inData += chunkSize;
+		inLength -= chunkSize;
+
+		for ( ; ; ) {
+
+			VSize	available;
+
+			if (used == outBuffer->GetAllocatedSize() && !_Grow(outBuffer)) {
+
+				error = XBOX::VE_MEMORY_FULL;
+				break;
+
+			}
+
+			available = outBuffer->GetAllocatedSize() - used;
+			if (available > kMAX_CHUNK_SIZE)
+
+				available = kMAX_CHUNK_SIZE;
+
+			fDeflateStream.next_out = (Bytef *) outBuffer->GetDataPtr() + used;
+			fDeflateStream.avail_out = (uInt) available;
+			if (deflate(&fDeflateStream, flush) == Z_STREAM_ERROR) {
+
+				error = VE_SRVR_WEBSOCKET_COMPRESSION_ERROR;
+				break;
+
+			}
+			used += available - fDeflateStream.avail_out;
+
+			// When flushing, deflate() is done only if it hasn't filled the output buffer.
+
+			if (!fDeflateStream.avail_in && (flush == Z_NO_FLUSH || fDeflateStream.avail_out))
+
+				break;
+
+		}
+
+	} while (error == XBOX::VE_OK && inLength);
+
+	if (error == XBOX::VE_OK) {
+
+		xbox_assert(used >= sizeof(kTRAILER));
+		xbox_assert(!::memcmp((uBYTE *) outBuffer->GetDataPtr() + used - sizeof(kTRAILER), kTRAILER, sizeof(kTRAILER)));
+
+		used -= sizeof(kTRAILER);
+
+		void	*dataPtr		= outBuffer->GetDataPtr();
+		VSize	allocatedSize	= outBuffer->GetAllocatedSize();
+
+		outBuffer->ForgetData();
+		outBuffer->SetDataPtr(dataPtr, used, allocatedSize);
+
+	}
+
+	if (fResetDeflate || error != XBOX::VE_OK)
+
+		deflateReset(&fDeflateStream);
+
+	fStatistics.fCompressedMessageCount++;
+	fStatistics.fCompressInputBytes += messageLength;
+	fStatistics.fCompressOutputBytes += used;
+	fStatistics.fCompressTime += counter.Stop();
+
+	return error;
+}
+
+XBOX::VError VWebSocketDeflate::Decompress (XBOX::VMemoryBuffer<> *ioMessage)
+{
+	xbox_assert(fIsInflateInitialized);
+	xbox_assert(ioMessage != NULL);
+
+	XBOX::VMicrosecondsCounter	counter;
+	XBOX::VError				error;
+	VSize						inputSize, used;
+	const uBYTE					*input;
+
+	counter.Start();
+
+	inputSize = ioMessage->GetDataSize();
+	if (!ioMessage->AddData(kTRAILER, sizeof(kTRAILER)))
+
+		return XBOX::VE_MEMORY_FULL;
+
+	// Expect a ratio of about 4 for the first allocation. A small scratch buffer is kept from one message to another.
+
+	if (!fInflateBuffer.Reserve(4 * inputSize + 64))
+
+		return XBOX::VE_MEMORY_FULL;
+
+	input = (const uBYTE *) ioMessage->GetDataPtr();
+	inputSize += sizeof(kTRAILER);
+	error = XBOX::VE_OK;
+	used = 0;
+	do {
+
+		VSize	chunkSize;
+
+		chunkSize = inputSize < kMAX_CHUNK_SIZE ? inputSize : kMAX_CHUNK_SIZE;
+
+		fInflateStream.next_in = (Bytef *) input;
+		fInflateStream.avail_in = (uInt) chunkSize;
+		input += chunkSize;
+		inputSize -= chunkSize;
+
+		// Loop until input is consumed and output buffer is not full (nothing is left pending in zlib).
+
+		do {
+
+			VSize	available;
+			int		result;
+
+			if (fMaximumMessageSize && used > fMaximumMessageSize) {
+
+				error = VE_SRVR_WEBSOCKET_MESSAGE_TOO_BIG;
+				break;
+
+			}
+
+			if (used == fInflateBuffer.GetAllocatedSize() && !_Grow(&fInflateBuffer)) {
+
+				error = XBOX::VE_MEMORY_FULL;
+				break;
+
+			}
+
+			available = fInflateBuffer.GetAllocatedSize() - used;
+			if (available > kMAX_CHUNK_SIZE)
+
+				available = kMAX_CHUNK_SIZE;
+
+			fInflateStream.next_out = (Bytef *) fInflateBuffer.GetDataPtr() + used;
+			fInflateStream.avail_out = (uInt) available;
+			result = inflate(&fInflateStream, Z_SYNC_FLUSH);
+			used += available - fInflateStream.avail_out;
+
+			if (result == Z_STREAM_END) {
+
+				// Peer has sent a final block (BFINAL set), this is legal. Remaining input is the appended trailer.
+
+				inflateReset(&fInflateStream);
+				inputSize = 0;
+				break;
+
+			} else if (result == Z_BUF_ERROR) {
+
+				// No progress possible, output buffer was not full: nothing is pending.
+
+				break;
+
+			} else if (result != Z_OK) {
+
+				error = VE_SRVR_WEBSOCKET_COMPRESSION_ERROR;
+				break;
+
+			}
+
+		} while (fInflateStream.avail_in || !fInflateStream.avail_out);
+
+	} while (error == XBOX::VE_OK && inputSize);
+
+	if (error == XBOX::VE_OK && fMaximumMessageSize && used > fMaximumMessageSize)
+
+		error = VE_SRVR_WEBSOCKET_MESSAGE_TOO_BIG;
+
+	fStatistics.fDecompressedMessageCount++;
+	fStatistics.fDecompressInputBytes += ioMessage->GetDataSize() - sizeof(kTRAILER);
+	fStatistics.fDecompressOutputBytes += used;
+
+	if (error == XBOX::VE_OK) {
+
+		// Swap buffers, message's previous buffer becomes the scratch buffer.
+
+		void	*messagePtr, *inflatePtr;
+		VSize	messageAllocatedSize, inflateAllocatedSize;
+
+		messagePtr = ioMessage->GetDataPtr();
+		messageAllocatedSize = ioMessage->GetAllocatedSize();
+		inflatePtr = fInflateBuffer.GetDataPtr();
+		inflateAllocatedSize = fInflateBuffer.GetAllocatedSize();
+
+		ioMessage->ForgetData();
+		fInflateBuffer.ForgetData();
+		ioMessage->SetDataPtr(inflatePtr, used, inflateAllocatedSize);
+		fInflateBuffer.SetDataPtr(messagePtr, 0, messageAllocatedSize);
+
+	}
+
+	// Do not keep a big buffer for an idle connection, next large message will allocate it again.
+
+	if (fInflateBuffer.GetAllocatedSize() > kMAX_KEPT_SCRATCH_SIZE)
+
+		fInflateBuffer.Clear();
+
+	// After an error, the stream is out of sync with peer anyway, connection should be closed.
+
+	if (fResetInflate || error != XBOX::VE_OK)
+
+		inflateReset(&fInflateStream);
+
+	fStatistics.fDecompressTime += counter.Stop();
+
+	return error;
+}
+
+void VWebSocketDeflate::GetStatistics (VWebSocketCompressionStatistics *outStatistics) const
+{
+	xbox_assert(outStatistics != NULL);
+
+	*outStatistics = fStatistics;
+	outStatistics->fCompressionRatio = fStatistics.fCompressInputBytes 
+										? (Real) fStatistics.fCompressOutputBytes / (Real) fStatistics.fCompressInputBytes
+										: 1.0;
+	outStatistics->fDecompressionRatio = fStatistics.fDecompressOutputBytes 
+										? (Real) fStatistics.fDecompressInputBytes / (Real) fStatistics.fDecompressOutputBytes
+										: 1.0;
+}
+
+bool VWebSocketDeflate::_Grow (XBOX::VMemoryBuffer<> *ioBuffer)
+{
+	VSize	size	= ioBuffer->GetAllocatedSize();
+
+	return ioBuffer->Reserve(size < 1024 ? 1024 : 2 * size);
+}
+
 VWebSocket::VWebSocket (
 	XBOX::VTCPEndPoint *inEndPoint, bool inIsSynchronous, 
 	const void *inLeftOver, VSize inLeftOverSize, 
@@ -404,6 +1159,7 @@ VWebSocket::VWebSocket (
 	fState = STATE_OPEN;
 	fMessageStarted = false;
 	fLastFrameSize = 0;
+	fDeflate = NULL;
 
 	if (inLeftOverSize) 
 
@@ -415,6 +1171,10 @@ VWebSocket::~VWebSocket ()
 	if (fEndPoint != NULL) 
 
 		ForceClose();
+
+	if (fDeflate != NULL)
+
+		delete fDeflate;
 }
 
 void VWebSocket::SetMaximumFrameSize (VSize inMaximumFrameSize)
@@ -424,6 +1184,46 @@ void VWebSocket::SetMaximumFrameSize (VSize inMaximumFrameSize)
 	fMaximumFrameSize = inMaximumFrameSize;	
 }
 
+XBOX::VError VWebSocket::EnableCompression (const VWebSocketDeflateParameters &inParameters, bool inIsServer)
+{
+	XBOX::StLocker<XBOX::VCriticalSection>	lock(&fMutex);
+
+	xbox_assert(fDeflate == NULL);
+
+	XBOX::VError	error;
+
+	if ((fDeflate = new VWebSocketDeflate()) == NULL)
+
+		error = XBOX::VE_MEMORY_FULL;
+
+	else if ((error = fDeflate->Init(inParameters, inIsServer)) != XBOX::VE_OK) {
+
+		delete fDeflate;
+		fDeflate = NULL;
+
+	}
+
+	return error;
+}
+
+void VWebSocket::GetCompressionStatistics (VWebSocketCompressionStatistics *outStatistics)
+{
+	xbox_assert(outStatistics != NULL);
+
+	XBOX::StLocker<XBOX::VCriticalSection>	lock(&fMutex);
+
+	if (fDeflate != NULL)
+
+		fDeflate->GetStatistics(outStatistics);
+
+	else {
+
+		::memset(outStatistics, 0, sizeof(*outStatistics));
+		outStatistics->fCompressionRatio = outStatistics->fDecompressionRatio = 1.0;
+
+	}
+}
+
 XBOX::VError VWebSocket::ForceClose ()
 {
 	XBOX::StLocker<XBOX::VCriticalSection>	lock(&fMutex);
@@ -507,6 +1307,14 @@ XBOX::VError VWebSocket::HandleFrame (const uBYTE *inFrame, VSize *ioFrameLength
 
 	if ((error = fDecodingWebSocketFrame.Decode(inFrame, ioFrameLength)) == XBOX::VE_OK) {
 
+		// If the frame is in our own read buffer (ReadFrame()), unmask payload in place, this avoids a copy.
+
+		if (inFrame == (const uBYTE *) fReadBuffer.GetDataPtr() 
+		&& fDecodingWebSocketFrame.HasMaskingKey() 
+		&& fDecodingWebSocketFrame.GetPayloadLength())
+
+			_UnmaskPayloadDataInPlace();
+
 		// A complete frame has been successfully received and parsed. Control frames cannot be fragmented.
 
 		uBYTE	opcode;
@@ -612,6 +1420,19 @@ XBOX::VError VWebSocket::SendMessage (const uBYTE *inMessage, VSize inLength, bo
 	std::vector<XBOX::VMemoryBuffer<> > frames;
 
 	fEncodingWebSocketFrame.SetRSVFlags(0);
+	if (fDeflate != NULL && inLength && inLength >= fDeflate->GetMinimumMessageSize()) {
+
+		// Send compressed message (RSV1 set on first frame only, see Encode()).
+
+		if ((error = fDeflate->Compress(inMessage, inLength, &fCompressBuffer)) != XBOX::VE_OK)
+
+			return error;
+
+		fEncodingWebSocketFrame.SetRSVFlags(VWebSocketFrame::FLAG_RSV1);
+		inMessage = (const uBYTE *) fCompressBuffer.GetDataPtr();
+		inLength = fCompressBuffer.GetDataSize();
+
+	}
 	fEncodingWebSocketFrame.SetOpcode(inIsText ? VWebSocketFrame::OPCODE_TEXT_FRAME : VWebSocketFrame::OPCODE_BINARY_FRAME);
 	fEncodingWebSocketFrame.SetPayloadLength(inLength);
 	if (inLength)
@@ -624,13 +1445,23 @@ XBOX::VError VWebSocket::SendMessage (const uBYTE *inMessage, VSize inLength, bo
 
 		fEncodingWebSocketFrame.ClearMaskingKey();
 
-	if ((error = fEncodingWebSocketFrame.Encode(&frames, fMaximumFrameSize, fUseMaskingKey)) == XBOX::VE_OK)
-		
-		for (uLONG i = 0; i < frames.size(); i++) 
-	
-			if ((error = fEndPoint->WriteExactly(frames[i].GetDataPtr(), (uLONG) frames[i].GetDataSize(), DEFAULT_WRITE_TIMEOUT)) != XBOX::VE_OK)
+	if ((error = fEncodingWebSocketFrame.Encode(&frames, fMaximumFrameSize, fUseMaskingKey)) == XBOX::VE_OK) {
 
-				break;
+		// Send all fragments with a single gathered write.
+
+		std::vector<VWriteBuffer>	buffers(frames.size());
+
+		for (size_t i = 0; i < frames.size(); i++) {
+
+			buffers[i].fData = frames[i].GetDataPtr();
+			buffers[i].fLength = (uLONG) frames[i].GetDataSize();
+
+		}
+		if (!buffers.empty())
+
+			error = fEndPoint->WriteExactlyV(&buffers[0], (uLONG) buffers.size(), DEFAULT_WRITE_TIMEOUT);
+
+	}
 
 	return error;
 }
@@ -836,6 +1667,40 @@ XBOX::VError VWebSocket::_UnmaskPayloadData (XBOX::VMemoryBuffer<> *outBuffer)
 	}
 }
 
+void VWebSocket::_UnmaskPayloadDataInPlace ()
+{
+	xbox_assert(fDecodingWebSocketFrame.HasMaskingKey() && fDecodingWebSocketFrame.GetPayloadLength());				
+	xbox_assert(fDecodingWebSocketFrame.GetPayloadData() != NULL);
+
+	// Payload data points into fReadBuffer, which is owned by this object, so it is safe to write there.
+
+	uBYTE	*payloadData	= (uBYTE *) fDecodingWebSocketFrame.GetPayloadData();
+
+	VWebSocketFrame::ApplyMaskingKey(
+		payloadData, 
+		payloadData,
+		fDecodingWebSocketFrame.GetMaskingKey(),
+		fDecodingWebSocketFrame.GetPayloadLength(),
+		0);
+
+	fDecodingWebSocketFrame.ClearMaskingKey();
+}
+
+XBOX::VError VWebSocket::_DecompressMessage (XBOX::VMemoryBuffer<> *ioMessage)
+{
+	xbox_assert(ioMessage != NULL);
+
+	XBOX::StLocker<XBOX::VCriticalSection>	lock(&fMutex);
+
+	if (fDeflate == NULL)
+
+		return VE_SRVR_WEBSOCKET_PROTOCOL_ERROR;
+
+	else
+
+		return fDeflate->Decompress(ioMessage);
+}
+
 XBOX::VError VWebSocket::GenerateWebSocketKey (XBOX::VString *outWebSocketKey)
 {
 	xbox_assert(outWebSocketKey != NULL);
@@ -1033,21 +1898,53 @@ XBOX::VError VWebSocketMessage::Receive (bool *outHasReadFrame, bool *outIsCompl
 
 					return VE_SRVR_WEBSOCKET_PROTOCOL_ERROR;
 
+				// With permessage-deflate, RSV1 is set on first frame only.
+
+				if (fWebSocket->IsCompressionEnabled() && (frame->GetRSVFlags() & XBOX::VWebSocketFrame::FLAG_RSV1))
+
+					return VE_SRVR_WEBSOCKET_PROTOCOL_ERROR;
+
 				if ((error = _AppendToBuffer(frame)) != XBOX::VE_OK)
 
 					return error;
 
+				if (frame->GetFIN()) {
+
+					if ((error = _CompleteMessage()) != XBOX::VE_OK)
+
+						return error;
+
+					*outIsComplete = true;
+					break; 
+
+				}
+
 			} else if (frame->GetOpcode() == XBOX::VWebSocketFrame::OPCODE_BINARY_FRAME 
 			|| frame->GetOpcode() == XBOX::VWebSocketFrame::OPCODE_TEXT_FRAME) {
 
 				fFlags = FLAG_IS_TEXT;
+				if (frame->GetRSVFlags() & XBOX::VWebSocketFrame::FLAG_RSV1) {
+
+					// Compressed message, but permessage-deflate hasn't been negotiated.
+
+					if (!fWebSocket->IsCompressionEnabled())
+
+						return VE_SRVR_WEBSOCKET_PROTOCOL_ERROR;
+
+					fFlags |= FLAG_IS_COMPRESSED;
+
+				}
+
 				if ((error = _AppendToBuffer(frame)) != XBOX::VE_OK)
 
 					return error;
 
 				if (frame->GetFIN()) {
 
-					fFlags |= FLAG_IS_COMPLETE;
+					if ((error = _CompleteMessage()) != XBOX::VE_OK)
+
+						return error;
+
 					*outIsComplete = true;
 					break; 
 
@@ -1146,6 +2043,26 @@ XBOX::VError VWebSocketMessage::_AppendToBuffer (const XBOX::VWebSocketFrame *in
 	return XBOX::VE_OK;
 }
 
+XBOX::VError VWebSocketMessage::_CompleteMessage ()
+{
+	xbox_assert(!(fFlags & (FLAG_IS_EMPTY | FLAG_IS_COMPLETE)));
+
+	if (fFlags & FLAG_IS_COMPRESSED) {
+
+		XBOX::VError	error;
+
+		if ((error = fWebSocket->_DecompressMessage(&fBuffer)) != XBOX::VE_OK)
+
+			return error;
+
+		fFlags &= ~FLAG_IS_COMPRESSED;
+
+	}
+	fFlags |= FLAG_IS_COMPLETE;
+
+	return XBOX::VE_OK;
+}
+
 VWebSocketConnector::VWebSocketConnector (const XBOX::VString &inURL, sLONG inConnectionTimeOut)
 {
 	xbox_assert(IsValidURL(inURL));
@@ -1186,6 +2103,28 @@ void VWebSocketConnector::SetExtensions (const XBOX::VString &inExtensions)
 	fHTTPClient.AddHeader("Sec-WebSocket-Extensions", inExtensions);	
 }
 
+void VWebSocketConnector::SetDeflateParameters (const VWebSocketDeflateParameters &inParameters)
+{
+	XBOX::VString	offer;
+
+	fOfferDeflate = true;
+	fDeflateParameters = inParameters;
+
+	inParameters.GetOffer(&offer);
+	fHTTPClient.AddHeader("Sec-WebSocket-Extensions", offer);	
+}
+
+bool VWebSocketConnector::GetDeflateParameters (VWebSocketDeflateParameters *outAgreed) const
+{
+	xbox_assert(outAgreed != NULL);
+
+	if (fIsDeflateAccepted)
+
+		*outAgreed = fDeflateParameters;
+
+	return fIsDeflateAccepted;
+}
+
 XBOX::VError VWebSocketConnector::StartOpeningHandshake (XBOX::VTCPSelectIOPool *inSelectIOPool)
 {
 	XBOX::VError	error;
@@ -1265,6 +2204,8 @@ void VWebSocketConnector::_Init (const XBOX::VURL &inURL, sLONG inConnectionTime
 	fHTTPClient.SetAsUpgradeRequest();
 	fHTTPClient.SetUseProxy("", 0);
 	fHTTPClient.SetConnectionTimeout(inConnectionTimeOut);
+
+	fOfferDeflate = fIsDeflateAccepted = false;
 }
 
 XBOX::VError VWebSocketConnector::_IsResponseOk ()
@@ -1294,6 +2235,24 @@ XBOX::VError VWebSocketConnector::_IsResponseOk ()
 
 		return VE_SRVR_WEBSOCKET_WRONG_ACCEPTANCE_KEY;
 
+	// Check permessage-deflate response, if offered. Agreed parameters replace the offered ones.
+
+	fIsDeflateAccepted = false;
+	if (fOfferDeflate && fHTTPClient.GetResponseHeaderValue("Sec-WebSocket-Extensions", string)) {
+
+		VWebSocketDeflateParameters	agreed;
+		XBOX::VError				error;
+
+		if ((error = fDeflateParameters.ParseResponse(string, &fIsDeflateAccepted, &agreed)) != XBOX::VE_OK)
+
+			return error;
+
+		if (fIsDeflateAccepted)
+
+			fDeflateParameters = agreed;
+
+	}
+
 	return XBOX::VE_OK;
 }
 
@@ -1318,6 +2277,7 @@ VWebSocketListener::VWebSocketListener (bool inIsSSL)
 	fPort = 0;
 	fPath = "";
 	fSocketListener = NULL;
+	fOfferDeflate = fIsLastDeflateAccepted = false;
 }
 
 VWebSocketListener::~VWebSocketListener ()
@@ -1344,6 +2304,23 @@ void VWebSocketListener::SetKeyAndCertificate (const XBOX::VString inKey, const
 	fCertificate = inCertificate;
 }
 
+void VWebSocketListener::SetDeflateParameters (const VWebSocketDeflateParameters &inParameters)
+{
+	fOfferDeflate = true;
+	fDeflateParameters = inParameters;
+}
+
+bool VWebSocketListener::GetLastDeflateParameters (VWebSocketDeflateParameters *outAgreed) const
+{
+	xbox_assert(outAgreed != NULL);
+
+	if (fIsLastDeflateAccepted)
+
+		*outAgreed = fLastDeflateParameters;
+
+	return fIsLastDeflateAccepted;
+}
+
 XBOX::VError VWebSocketListener::StartListening ()
 {
 	xbox_assert(fSocketListener == NULL);
@@ -1391,6 +2368,8 @@ XBOX::VError VWebSocketListener::AcceptConnection (XBOX::VTCPEndPoint **outEndPo
 
 	XBOX::XTCPSock	*socket;
 
+	fIsLastDeflateAccepted = false;
+
 	if (!inTimeOut) {
 
 		// Unlimited wait, not recommended.
@@ -1479,7 +2458,10 @@ XBOX::VError VWebSocketListener::AcceptConnection (XBOX::VTCPEndPoint **outEndPo
 				error = VE_SRVR_WEBSOCKET_INVALID_CLIENT_REQUEST;
 
 			else if ((error = IsRequestOk(&header)) == XBOX::VE_OK
-			&& (error = SendOpeningHandshake(&header, endPoint)) == XBOX::VE_OK) {
+			&& (error = SendOpeningHandshake(
+							&header, endPoint, 
+							fOfferDeflate ? &fDeflateParameters : NULL, 
+							&fIsLastDeflateAccepted, &fLastDeflateParameters)) == XBOX::VE_OK) {
 
 				if (outLeftOver != NULL && requestSize < request.GetDataSize()) {
 
@@ -1537,14 +2519,31 @@ XBOX::VError VWebSocketListener::IsRequestOk (const VHTTPHeader *inHeader)
 }
 
 XBOX::VError VWebSocketListener::SendOpeningHandshake (const VHTTPHeader *inHeader, XBOX::VTCPEndPoint *inEndPoint)
+{
+	return SendOpeningHandshake(inHeader, inEndPoint, NULL, NULL, NULL);
+}
+
+XBOX::VError VWebSocketListener::SendOpeningHandshake (
+	const VHTTPHeader *inHeader, XBOX::VTCPEndPoint *inEndPoint,
+	const VWebSocketDeflateParameters *inDeflateParameters,
+	bool *outIsDeflateAccepted, VWebSocketDeflateParameters *outAgreed)
 {
 	xbox_assert(inHeader != NULL && inEndPoint != NULL);
+	xbox_assert(inDeflateParameters == NULL || (outIsDeflateAccepted != NULL && outAgreed != NULL));
 
-	XBOX::VString	clientKey, acceptanceKey;
+	XBOX::VString	clientKey, acceptanceKey, extensions, deflateResponse;
+	bool			isDeflateAccepted;
 
 	inHeader->GetHeaderValue("Sec-WebSocket-Key", clientKey);
 	VWebSocket::ComputeAcceptanceKey(clientKey, &acceptanceKey);
 
+	isDeflateAccepted = inDeflateParameters != NULL
+						&& inHeader->GetHeaderValue("Sec-WebSocket-Extensions", extensions)
+						&& inDeflateParameters->Negotiate(extensions, outAgreed, &deflateResponse);
+	if (outIsDeflateAccepted != NULL)
+
+		*outIsDeflateAccepted = isDeflateAccepted;
+
 	char			buffer[1 << 12];
 	uLONG			length;
 	XBOX::VError	error;
@@ -1561,9 +2560,24 @@ XBOX::VError VWebSocketListener::SendOpeningHandshake (const VHTTPHeader *inHead
 		length = (uLONG) ::strlen(buffer);
 		if ((error = inEndPoint->WriteExactly(buffer, length)) == XBOX::VE_OK) {
 
-			sprintf(buffer, "\r\n\r\n");
-			length = (uLONG) ::strlen(buffer);
-			error = inEndPoint->WriteExactly(buffer, length);
+			if (isDeflateAccepted) {
+
+				XBOX::VString	line("\r\nSec-WebSocket-Extensions: ");
+
+				line.AppendString(deflateResponse);
+				line.ToBlock(buffer, sizeof(buffer), VTC_US_ASCII, true, false);
+				length = (uLONG) ::strlen(buffer);
+				error = inEndPoint->WriteExactly(buffer, length);
+
+			}
+
+			if (error == XBOX::VE_OK) {
+
+				sprintf(buffer, "\r\n\r\n");
+				length = (uLONG) ::strlen(buffer);
+				error = inEndPoint->WriteExactly(buffer, length);
+
+			}
 
 		}
 
@@ -30,6 +30,9 @@
  *  * Interleaved fragmented messages are not supported. Section 5.4 of spec suggests that this is 
  *    allowed if an extension have been negotiated between peers, this is very complicated and probably 
  *    of no practical use.
+ *
+ *  * The only supported extension is permessage-deflate (http://tools.ietf.org/html/rfc7692). It must 
+ *    be negotiated during opening handshake, then enabled on VWebSocket using EnableCompression().
  */
 
 BEGIN_TOOLBOX_NAMESPACE
@@ -104,6 +107,8 @@ public:
 
 	// Key "masking" is "symmetric", same function is used to encode and decode. The key is 4 bytes long, it is indexed modulo 4.
 	// To make the method working on a stream of payload data, it is possible to specify the current key index [0..3].
+	// Masking is done by words (SSE2/AVX2 if available). It can be done in place (inMaskedData == outUnmaskedData),
+	// but buffers must not otherwise overlap.
 
 	static void		ApplyMaskingKey (
 						const uBYTE *inMaskedData, 
@@ -131,7 +136,7 @@ public:
 
 	// Encode a complete message: Fragment into frames of inMaximumFrameSize bytes (continuation frame opcode and FIN flag 
 	// are set as needed). Set inMaximumFrameSize to zero to never fragment. Note that there is no special handling for 
-	// extension data should fragmentation happens. If inGenerateMaskingKey is true, then generate a masking key for each 
+	// extension data should fragmentation happens, except that RSV1 (permessage-deflate) is set on first frame only. If inGenerateMaskingKey is true, then generate a masking key for each 
 	// frame (GenerateMaskingKey()). Otherwise, if a masking key has been set, then use it for all frame(s), otherwise don't 
 	// do masking.
 	
@@ -154,6 +159,82 @@ private:
 	uLONG8			fPayloadDataLength;
 };
 
+// permessage-deflate extension parameters. "Negotiated" parameters are exchanged in the Sec-WebSocket-Extensions header 
+// field, the others are local settings only. Window bits are the base-two logarithm of the LZ77 sliding window size. 
+// Along with memory level, they bound the zlib memory used per connection: About (1 << (window bits + 2)) + (1 << (memory
+// level + 9)) bytes for compression and (1 << window bits) bytes for decompression.
+
+class XTOOLBOX_API VWebSocketDeflateParameters
+{
+public:
+
+	static const char		EXTENSION_NAME[];	// "permessage-deflate"
+
+	static const sLONG		MINIMUM_WINDOW_BITS				= 8;
+	static const sLONG		MAXIMUM_WINDOW_BITS				= 15;
+
+	static const sLONG		DEFAULT_COMPRESSION_LEVEL		= -1;		// zlib's default, currently 6.
+	static const sLONG		DEFAULT_MEMORY_LEVEL			= 8;
+	static const VSize		DEFAULT_MINIMUM_MESSAGE_SIZE	= 64;
+	static const VSize		DEFAULT_MAXIMUM_MESSAGE_SIZE	= 1 << 24;
+
+							VWebSocketDeflateParameters ();
+
+	// Negotiated parameters. If "no context takeover" is set for a side, its compression context is reset after each 
+	// message. This costs compression ratio but saves memory in between messages.
+
+	bool					fServerNoContextTakeover;
+	bool					fClientNoContextTakeover;
+	sLONG					fServerMaxWindowBits;
+	sLONG					fClientMaxWindowBits;
+
+	// Local settings. Messages smaller than fMinimumMessageSize are sent uncompressed. Received messages bigger than 
+	// fMaximumMessageSize once decompressed are rejected (zero means no limit).
+
+	sLONG					fCompressionLevel;
+	sLONG					fMemoryLevel;
+	VSize					fMinimumMessageSize;
+	VSize					fMaximumMessageSize;
+
+	// Client side: Format the offer to set as Sec-WebSocket-Extensions value of the opening handshake request. Then parse 
+	// the value of the server response, *outIsAccepted is false if the server has declined the extension. Otherwise, 
+	// *outAgreed will be set with the parameters to use for the connection.
+
+	void					GetOffer (XBOX::VString *outOffer) const;
+	XBOX::VError			ParseResponse (
+								const XBOX::VString &inResponse, 
+								bool *outIsAccepted, 
+								VWebSocketDeflateParameters *outAgreed) const;
+
+	// Server side: Select first acceptable offer from the client's Sec-WebSocket-Extensions value, using this object as
+	// configuration. Return false if there is none, otherwise set agreed parameters and the value to send in response.
+
+	bool					Negotiate (
+								const XBOX::VString &inOffers, 
+								VWebSocketDeflateParameters *outAgreed, 
+								XBOX::VString *outResponse) const;
+};
+
+// Per connection counters of permessage-deflate. Ratios are compressed size over uncompressed size (smaller is better),
+// they are 1.0 if no message has been processed yet. Times are in microseconds.
+
+struct VWebSocketCompressionStatistics
+{
+	sLONG8	fCompressedMessageCount;
+	sLONG8	fCompressInputBytes;
+	sLONG8	fCompressOutputBytes;
+	sLONG8	fCompressTime;
+	Real	fCompressionRatio;
+
+	sLONG8	fDecompressedMessageCount;
+	sLONG8	fDecompressInputBytes;
+	sLONG8	fDecompressOutputBytes;
+	sLONG8	fDecompressTime;
+	Real	fDecompressionRatio;
+};
+
+class VWebSocketDeflate;
+
 // VWebSocket objects are to be instantied by VWebSocketConnector or VWebSocketListener only.
 
 class XTOOLBOX_API VWebSocket : public VObject 
@@ -214,6 +295,18 @@ public:
 	VSize						GetMaximumFrameSize () const					{	return fMaximumFrameSize;			}
 	void						SetMaximumFrameSize (VSize inMaximumFrameSize);
 
+	// Enable permessage-deflate with the parameters agreed during opening handshake, inIsServer selects which side of them
+	// applies to this end. Must be called before any message is exchanged. Only messages sent with SendMessage() are 
+	// compressed, StartMessage() and ContinueMessage() send data as is (set FLAG_RSV1 only if data is already compressed).
+	// Compressed messages are decompressed by VWebSocketMessage::Receive().
+
+	XBOX::VError				EnableCompression (const VWebSocketDeflateParameters &inParameters, bool inIsServer);
+	bool						IsCompressionEnabled () const					{	return fDeflate != NULL;			}
+
+	// Counters are all zero if compression is not enabled.
+
+	void						GetCompressionStatistics (VWebSocketCompressionStatistics *outStatistics);
+
 	// See comment for states definition.
 
 	STATES						GetState () const								{	return fState;						}
@@ -251,7 +344,8 @@ public:
 	XBOX::VError				HandleFrame (const uBYTE *inFrame, VSize *ioFrameLength);
 	XBOX::VError				ReadFrame ();
 
-	// Return the last decoded WebSocket frame, HandleFrame() must have been successfully called before.
+	// Return the last decoded WebSocket frame, HandleFrame() must have been successfully called before. Complete frames
+	// decoded by ReadFrame() are unmasked in place in the read buffer, their masking key is then cleared.
 
 	const VWebSocketFrame		*GetLastFrame ()								{	return &fDecodingWebSocketFrame;	}
 
@@ -309,8 +403,13 @@ friend class VWebSocketMessage;
 	VWebSocketFrame				fEncodingWebSocketFrame;
 	XBOX::VMemoryBuffer<>		fSendBuffer;				
 
+	VWebSocketDeflate			*fDeflate;
+	XBOX::VMemoryBuffer<>		fCompressBuffer;
+
 	XBOX::VError				_SendPingOrPong (uBYTE inRSVFlags, const uBYTE *inData, VSize inDataLength, bool inIsPing);
 	XBOX::VError				_UnmaskPayloadData (XBOX::VMemoryBuffer<> *outBuffer);
+	void						_UnmaskPayloadDataInPlace ();
+	XBOX::VError				_DecompressMessage (XBOX::VMemoryBuffer<> *ioMessage);
 };
 
 // Helper to receive WebSocket messages.
@@ -335,6 +434,8 @@ public:
 	// If the websocket is asynchronous, then VE_SOCK_WOULD_BLOCK means that zero data has been read (SSL may transmit 
 	// underlying protocol data but no user data). VE_SRVR_WEBSOCKET_FRAME_HEADER_TOO_SHORT and VE_SRVR_WEBSOCKET_FRAME_TOO_SHORT 
 	// also mean that data more is needed, but if *outHasReadFrame is true, then at least one frame has been read.
+	//
+	// If compression is enabled on the websocket, compressed messages are decompressed once complete. 
 
 	XBOX::VError			Receive (bool *outHasReadFrame, bool *outIsComplete);
 
@@ -358,7 +459,8 @@ private:
 
 		FLAG_IS_EMPTY		= 0x1,	// Has not started receiving a new message.
 		FLAG_IS_TEXT		= 0x2,	// Message is text or binary, relevant only if FLAG_IS_EMPTY isn't set.
-		FLAG_IS_COMPLETE	= 0x4	// Complete message has been received.
+		FLAG_IS_COMPLETE	= 0x4,	// Complete message has been received.
+		FLAG_IS_COMPRESSED	= 0x8	// First frame had RSV1 set (permessage-deflate), decompress once complete.
 
 	};
 
@@ -369,6 +471,10 @@ private:
 	// Append payload content to message buffer.
 
 	XBOX::VError			_AppendToBuffer (const XBOX::VWebSocketFrame *inFrame);
+
+	// Last frame of message has been appended, decompress if needed.
+
+	XBOX::VError			_CompleteMessage ();
 };
 
 // VWebSocketConnector objects are to be used by client to connect to a WebSocket server. 
@@ -395,6 +501,13 @@ public:
 	void				SetSubProtocols (const XBOX::VString &inSubProtocols);
 	void				SetExtensions (const XBOX::VString &inExtensions);
 
+	// Offer permessage-deflate extension, this sets "Sec-WebSocket-Extensions" so SetExtensions() must not be used too.
+	// Once opening handshake is complete, GetDeflateParameters() returns true if the server has accepted the offer, use 
+	// returned parameters with VWebSocket::EnableCompression().
+
+	void				SetDeflateParameters (const VWebSocketDeflateParameters &inParameters);
+	bool				GetDeflateParameters (VWebSocketDeflateParameters *outAgreed) const;
+
 	// Use StartOpeningHandshake() to initiate opening handshake. This will send the WebSocket HTTP upgrade request.
 	// If inSelectIOPool is non NULL, then reading response from server will be asynchronous.
 
@@ -427,6 +540,10 @@ private:
 	XBOX::VHTTPClient	fHTTPClient;
 	XBOX::VString		fAcceptanceKey;
 
+	bool							fOfferDeflate;
+	bool							fIsDeflateAccepted;
+	VWebSocketDeflateParameters		fDeflateParameters;		// Offered, then agreed if accepted.
+
 	void				_Init (const XBOX::VURL &inURL, sLONG inConnectionTimeOut);
 	XBOX::VError		_IsResponseOk ();
 };
@@ -467,9 +584,20 @@ public:
 	static XBOX::VError	IsRequestOk (const VHTTPHeader *inHeader);
 
 	// Accept from an already read request (IsRequestOk() should have been called before).
-	// Should add support for (sub-) protocol and extension.
+	// Should add support for (sub-) protocol. If inDeflateParameters is not NULL, then negotiate permessage-deflate 
+	// extension, *outIsDeflateAccepted and *outAgreed tell the result.
 
 	static XBOX::VError	SendOpeningHandshake (const VHTTPHeader *inHeader, XBOX::VTCPEndPoint *inEndPoint);	
+	static XBOX::VError	SendOpeningHandshake (
+							const VHTTPHeader *inHeader, XBOX::VTCPEndPoint *inEndPoint,
+							const VWebSocketDeflateParameters *inDeflateParameters,
+							bool *outIsDeflateAccepted, VWebSocketDeflateParameters *outAgreed);	
+
+	// Offer permessage-deflate to clients accepted by AcceptConnection(), use GetLastDeflateParameters() after each 
+	// successful AcceptConnection() to find out if it has been agreed. 
+
+	void				SetDeflateParameters (const VWebSocketDeflateParameters &inParameters);
+	bool				GetLastDeflateParameters (VWebSocketDeflateParameters *outAgreed) const;
 
 	sLONG				GetPort () const	{	return fPort;		}
 	XBOX::VString		GetAddress () const	{	return fAddress;	}
@@ -487,6 +615,11 @@ private:
 	XBOX::VString		fCertificate;
 
 	XBOX::VSockListener	*fSocketListener;
+
+	bool							fOfferDeflate;
+	bool							fIsLastDeflateAccepted;
+	VWebSocketDeflateParameters		fDeflateParameters;
+	VWebSocketDeflateParameters		fLastDeflateParameters;
 };
 
 END_TOOLBOX_NAMESPACE
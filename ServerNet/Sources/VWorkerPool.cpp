@@ -131,6 +131,7 @@ VWorkerPool::VWorkerPool (
 					unsigned short nExclusiveMaxCount ) :
 #if WITH_SHARED_WORKERS
 					m_vctrSharedWorkers ( ),
+					m_vSharedCHQueue ( ),
 #endif
 					m_vctrAllExclusiveWorkers ( ),
 					m_vctrExclusiveWorkersIdling ( ),
@@ -138,6 +139,8 @@ VWorkerPool::VWorkerPool (
 {
 #if WITH_SHARED_WORKERS
 	m_vcsSharedProtector = new VCriticalSection ( );
+	m_nSharedWorkerCount = 0;
+	m_bSharedDying = false;
 #endif
 	m_vcsExclusiveProtector = new VCriticalSection ( );
 
@@ -150,23 +153,15 @@ VWorkerPool::VWorkerPool (
 
 	m_vstrNameFoSpare = "Spare process";
 
-#if WITH_SHARED_WORKERS
-	VSharedWorker*			vsWorker = NULL;
-#endif
-	
 	VExclusiveWorker*		veWorker = NULL;
 	
 	//TODO : mettre dans une methode init()
 #if WITH_SHARED_WORKERS	
+	if ( m_nSharedMaxCount < m_nInitialSharedCount )
+		m_nSharedMaxCount = m_nInitialSharedCount;
+	m_vctrSharedWorkers. reserve ( m_nSharedMaxCount );
 	for ( unsigned short i = 0; i < m_nInitialSharedCount; i++ )
-	{
-		vsWorker = new VSharedWorker ( );
-		VString				vstrName ( "SHARED pool worker " );
-		vstrName. AppendLong ( i );
-		vsWorker-> SetName ( vstrName );
-		vsWorker-> Run ( );
-		m_vctrSharedWorkers. push_back ( vsWorker );
-	}
+		AddSharedWorker ( );
 #endif	
 	for ( unsigned short i = 0; i < m_nInitialExclusiveCount; i++ )
 	{
@@ -180,41 +175,45 @@ VWorkerPool::VWorkerPool (
 		m_vctrExclusiveWorkersIdling. push_back ( veWorker );
 		m_vctrAllExclusiveWorkers. push_back ( veWorker );
 	}
-
-#if WITH_SHARED_WORKERS
-	if ( m_nInitialSharedCount > 0 )
-	{
-		m_vSharedLoadBalancer = new VSharedLoadBalancer ( *this );
-		m_vSharedLoadBalancer-> SetName ( CVSTR ( "Shared Load Balancer" ) );
-		m_vSharedLoadBalancer-> Run ( );
-	}
-	else
-		m_vSharedLoadBalancer = 0;
-#endif
 }
 
 VWorkerPool::~VWorkerPool ( )
 {
 #if WITH_SHARED_WORKERS	
-	if ( m_vSharedLoadBalancer != 0 )
+	/* No worker is added once the pool is dying: the vector does not change any more and is walked without
+	lock, so that a worker blocked in AddSharedWorker ( ) gets the lock and can go on dying. */
+	m_vcsSharedProtector-> Lock ( );
+	m_bSharedDying = true;
+	m_vcsSharedProtector-> Unlock ( );
+
+	/* Workers use the pool until they are dead: stop them all before releasing any. */
+	std::vector<VSharedWorker*>::iterator					iterS = m_vctrSharedWorkers. begin ( );
+	while ( iterS != m_vctrSharedWorkers. end ( ) )
 	{
-		m_vSharedLoadBalancer-> Kill ( );
-		m_vSharedLoadBalancer-> WakeUpFromIdling ( );
+		( *iterS )-> Kill ( );
+		iterS++;
 	}
+	m_vSharedCHQueue. WakeUpAllWaiters ( );
 
-	m_vcsSharedProtector-> Lock ( );
-
-		std::vector<VSharedWorker*>::iterator				iterS = m_vctrSharedWorkers. begin ( );
-		while ( iterS != m_vctrSharedWorkers. end ( ) )
-		{
-			( *iterS )-> Kill ( );
-			( *iterS )-> WakeUpFromIdling ( );
+	bool													bAllDead = true;
+	iterS = m_vctrSharedWorkers. begin ( );
+	while ( iterS != m_vctrSharedWorkers. end ( ) )
+	{
+		if ( ( *iterS )-> WaitForDeath ( kSHARED_WORKER_STOP_TIMEOUT ) )
 			ReleaseRefCountable(&(*iterS));
-			iterS++;
-		}
+		else
+			bAllDead = false;
+		iterS++;
+	}
 
-	m_vcsSharedProtector-> Unlock ( );
-	delete m_vcsSharedProtector;
+	/* A worker stuck in a handler still uses the lock and the queued handlers: leak them rather than free them under its feet. */
+	if ( bAllDead )
+	{
+		delete m_vcsSharedProtector;
+		m_vSharedCHQueue. ReleaseAll ( );
+	}
+	else
+		xbox_assert ( false );
 #endif
 
 	m_vcsExclusiveProtector-> Lock ( );
@@ -274,52 +273,8 @@ VError VWorkerPool::AddConnectionHandler ( VConnectionHandler* inConnectionHandl
 		return AddExclusiveConnectionHandler ( inConnectionHandler );
 
 #if WITH_SHARED_WORKERS
-	short											nMinBusyness = 100;
-	short											nCurrentBusyness = 0;
-
-	if ( !m_vcsSharedProtector-> Lock ( ) )
-		return VE_SRVR_FAILED_TO_SYNC_LOCK;
-
-		std::vector<VSharedWorker*>::iterator		iter = m_vctrSharedWorkers. begin ( );
-		VSharedWorker*								vwLeastBusy = *iter;
-		while ( iter != m_vctrSharedWorkers. end ( ) )
-		{
-			nCurrentBusyness = ( *iter )-> GetBusyness ( );
-			if ( nCurrentBusyness == 0 )
-			{
-				/* Found a worker that does not do anything. */
-				vwLeastBusy = *iter;
-				nMinBusyness = 0;
-
-				break;
-			}
-
-			if ( nCurrentBusyness < nMinBusyness )
-			{
-				nMinBusyness = nCurrentBusyness;
-				vwLeastBusy = *iter;
-			}
-
-			iter++;
-		}
-
-		if ( nMinBusyness > m_nSharedMaxBusyness && m_vctrSharedWorkers. size ( ) < m_nSharedMaxCount )
-		{
-			/* All current workers are too busy and I'm allowed to create more workers.
-			Let's do just that. */
-			vwLeastBusy = new VSharedWorker ( );
-			VString				vstrName ( "SHARED pool worker " );
-			vstrName. AppendLong8 ( m_vctrSharedWorkers. size ( ) );
-			vwLeastBusy-> SetName ( vstrName );
-			vwLeastBusy-> Run ( );
-			m_vctrSharedWorkers. push_back ( vwLeastBusy );
-		}
-
-		vwLeastBusy-> AddConnectionHandler ( inConnectionHandler );
-
-	m_vcsSharedProtector-> Unlock ( );
-
-	return VE_OK;
+	/* Any idle worker takes it, the others will steal it if its worker gets too busy. */
+	return PushSharedConnectionHandler ( inConnectionHandler );
 #else
 	return VE_INVALID_PARAMETER;
 #endif
@@ -383,79 +338,99 @@ VError VWorkerPool::RemoveExclusiveIdlers ( unsigned short inCount )
 
 
 #if WITH_SHARED_WORKERS
-VError VWorkerPool::BalanceSharedLoad ( )
+VError VWorkerPool::AddSharedWorker ( )
 {
-	/* NOTEs: First, of course, I should look if I can create new workers. */
+	if ( !m_vcsSharedProtector-> Lock ( ) )
+		return VE_SRVR_FAILED_TO_SYNC_LOCK;
 
-	std::vector<VSharedWorker*>			vctrNonBusyWorkers;
-	VError								vError = GetNonBusySharedWorkers ( vctrNonBusyWorkers );
-	if ( vError != VE_OK )
-		return vError;
-	if ( vctrNonBusyWorkers. size ( ) == 0 )
-		return VE_OK;
+		VError						vError = VE_OK;
+		if ( !m_bSharedDying && m_vctrSharedWorkers. size ( ) < m_nSharedMaxCount )
+		{
+			VSharedWorker*			vsWorker = new VSharedWorker ( *this );
+			VString					vstrName ( "SHARED pool worker " );
+			vstrName. AppendLong8 ( m_vctrSharedWorkers. size ( ) );
+			vsWorker-> SetName ( vstrName );
+			vsWorker-> Run ( );
 
-	std::vector<VConnectionHandler*>	vctrStuckConnectionHandlers;
-	vError = ExtractStuckConnectionHandlers ( vctrStuckConnectionHandlers );
-	if ( vError != VE_OK )
-		/* TODO: Give back all the stuck connection handlers. */
-		return vError;
-	if ( vctrStuckConnectionHandlers. size ( ) == 0 )
-		return VE_OK;
+			/* No reallocation (see constructor): workers may read the vector while it grows. */
+			m_vctrSharedWorkers. push_back ( vsWorker );
+			VInterlocked::Increment ( &m_nSharedWorkerCount );
+		}
 
-	std::vector<VSharedWorker*>::iterator				iterSW = vctrNonBusyWorkers. begin ( );
-	VConnectionHandler*									vcHandler = NULL;
-	while ( vctrStuckConnectionHandlers. size ( ) > 0 )
-	{
-		vcHandler = vctrStuckConnectionHandlers. back ( );
-		vctrStuckConnectionHandlers. pop_back ( );
-		( *iterSW )-> AddConnectionHandler ( vcHandler );
-		iterSW++;
-		if ( iterSW == vctrNonBusyWorkers. end ( ) )
-			iterSW = vctrNonBusyWorkers. begin ( );
-	}
+	m_vcsSharedProtector-> Unlock ( );
 
-	return VE_UNIMPLEMENTED;
+	return vError;
 }
 
-VError VWorkerPool::GetNonBusySharedWorkers ( std::vector<VSharedWorker*>& outNonBusy )
+VConnectionHandler* VWorkerPool::PopSharedConnectionHandler ( )
 {
-	if ( !m_vcsSharedProtector-> Lock ( ) )
-		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+	VError							vError = VE_OK;
 
-		VError										vError = VE_OK;
+	return m_vSharedCHQueue. Pop ( &vError );
+}
 
-		std::vector<VSharedWorker*>::iterator		iter = m_vctrSharedWorkers. begin ( );
-		while ( iter != m_vctrSharedWorkers. end ( ) )
-		{
-			if ( ( *iter )-> GetBusyness ( ) < m_nSharedMaxBusyness )
-				outNonBusy. push_back ( *iter );
+VConnectionHandler* VWorkerPool::WaitForSharedConnectionHandler ( sLONG inTimeoutMilliseconds )
+{
+	VError							vError = VE_OK;
 
-			iter++;
-		}
+	return m_vSharedCHQueue. Pop ( &vError, inTimeoutMilliseconds );
+}
 
-	m_vcsSharedProtector-> Unlock ( );
+VError VWorkerPool::PushSharedConnectionHandler ( VConnectionHandler* inConnectionHandler )
+{
+	/* Push ( ) wakes up a waiting worker if any. */
+	bool							bIdleWorker = m_vSharedCHQueue. GetWaiterCount ( ) > 0;
+	VError							vError = m_vSharedCHQueue. Push ( inConnectionHandler );
+
+	/* Nobody is idle: add a worker if allowed, otherwise the handler waits for a worker to be done or to steal. */
+	if ( !bIdleWorker )
+		AddSharedWorker ( );
 
 	return vError;
 }
 
-VError VWorkerPool::ExtractStuckConnectionHandlers ( std::vector<VConnectionHandler*>& outStuckConnectionHandlers )
+void VWorkerPool::RequeueSharedConnectionHandlers ( std::vector<VConnectionHandler*>& ioConnectionHandlers )
 {
-	if ( !m_vcsSharedProtector-> Lock ( ) )
-		return VE_SRVR_FAILED_TO_SYNC_LOCK;
+	std::vector<VConnectionHandler*>::iterator		iterH = ioConnectionHandlers. begin ( );
+	while ( iterH != ioConnectionHandlers. end ( ) )
+	{
+		/* Full: the workers are emptying it. */
+		while ( m_vSharedCHQueue. Push ( *iterH ) != VE_OK )
+			VTask::Sleep ( kSHARED_REQUEUE_PAUSE );
+		iterH++;
+	}
+	ioConnectionHandlers. clear ( );
+}
 
-		VError										vError = VE_OK;
+VConnectionHandler* VWorkerPool::StealSharedConnectionHandler ( VSharedWorker* inThief, uLONG inSeed )
+{
+	sLONG							nCount = VInterlocked::AtomicGet ( &m_nSharedWorkerCount );
+	if ( nCount < 2 )
+		return NULL;
 
-		std::vector<VSharedWorker*>::iterator		iter = m_vctrSharedWorkers. begin ( );
-		while ( iter != m_vctrSharedWorkers. end ( ) )
-		{
-			( *iter )-> ExtractStuckConnectionHandlers ( outStuckConnectionHandlers );
+	sLONG							nStart = ( sLONG ) ( inSeed % ( uLONG ) nCount );
+	for ( sLONG i = 0; i < nCount; i++ )
+	{
+		VSharedWorker*				vsVictim = m_vctrSharedWorkers [ ( nStart + i ) % nCount ];
+		if ( vsVictim == inThief )
+			continue;
 
-			iter++;
-		}
+		VConnectionHandler*			vcHandler = vsVictim-> StealConnectionHandler ( );
+		if ( vcHandler )
+			return vcHandler;
+	}
 
-	m_vcsSharedProtector-> Unlock ( );
+	return NULL;
+}
 
-	return vError;
+void VWorkerPool::GetSharedWorkersStatistics ( std::vector<VSharedWorker::Statistics>& outStatistics )
+{
+	outStatistics. clear ( );
+
+	sLONG							nCount = VInterlocked::AtomicGet ( &m_nSharedWorkerCount );
+	outStatistics. resize ( nCount );
+	for ( sLONG i = 0; i < nCount; i++ )
+		m_vctrSharedWorkers [ i ]-> GetStatistics ( outStatistics [ i ] );
 }
 #endif
 
@@ -465,6 +440,20 @@ VError VWorkerPool::StopConnectionHandlers ( int inType, VTaskID inTaskID )
 	if ( !m_vcsSharedProtector-> Lock ( ) )
 		return VE_SRVR_FAILED_TO_SYNC_LOCK;
 
+		/* Handlers not taken by a worker yet belong to no task. */
+		std::vector<VConnectionHandler*>					vctrWaiting;
+		if ( inTaskID == NULL_TASK_ID )
+		{
+			VError											vError = VE_OK;
+			VConnectionHandler*								vcHandler = NULL;
+			while ( ( vcHandler = m_vSharedCHQueue. Pop ( &vError ) ) != NULL )
+			{
+				if ( vcHandler-> GetType ( ) == inType )
+					vcHandler-> Stop ( );
+				vctrWaiting. push_back ( vcHandler );
+			}
+		}
+
 		std::vector<VSharedWorker*>::iterator				iterS = m_vctrSharedWorkers. begin ( );
 		while ( iterS != m_vctrSharedWorkers. end ( ) )
 		{
@@ -473,6 +462,8 @@ VError VWorkerPool::StopConnectionHandlers ( int inType, VTaskID inTaskID )
 			iterS++;
 		}
 
+		RequeueSharedConnectionHandlers ( vctrWaiting );
+
 	m_vcsSharedProtector-> Unlock ( );
 #endif
 
@@ -19,6 +19,8 @@
 
 #include "VConnectionHandlerFactory.h"
 
+#include "VSharedWorkers.h"
+
 #include <queue>
 #include <vector>
 
@@ -94,24 +96,40 @@ class XTOOLBOX_API VWorkerPool : public VObject, public IRefCountable
 
 		VError UseAsIdling ( VExclusiveWorker* inWorker );
 
-		VError BalanceSharedLoad ( );
-
 		/* If inTaskID is NULL_TASK_ID then stops all connection handlers of a given type inType. Otherwise, stops
 		only a handler of a given type that's being executed by a task with a given ID. */
 		virtual VError StopConnectionHandlers ( int inType, VTaskID inTaskID = NULL_TASK_ID );
 
 		VError SetSpareTaskName ( VString const & inName );
 
+#if WITH_SHARED_WORKERS
+		/* One entry per shared worker, in creation order. */
+		void GetSharedWorkersStatistics ( std::vector<VSharedWorker::Statistics>& outStatistics );
+#endif
+
 	protected :
 
+#if WITH_SHARED_WORKERS
+		friend class VSharedWorker;
+
+		enum
+		{
+			kSHARED_WORKER_STOP_TIMEOUT = 5000,	/* Milliseconds. */
+			kSHARED_REQUEUE_PAUSE = 10			/* Milliseconds, while the pool queue is full. */
+		};
+#endif
+
 		/* Everything related to shared workers. */
 		unsigned short								m_nInitialSharedCount;
 		unsigned short								m_nSharedMaxCount;
-		unsigned short								m_nSharedMaxBusyness;
+		unsigned short								m_nSharedMaxBusyness;		/* Unused: idle shared workers steal handlers from busy ones. */
 
 #if WITH_SHARED_WORKERS
-		VCriticalSection*							m_vcsSharedProtector;
-		std::vector<VSharedWorker*>					m_vctrSharedWorkers;
+		VCriticalSection*							m_vcsSharedProtector;		/* Serializes the creation of shared workers. */
+		std::vector<VSharedWorker*>					m_vctrSharedWorkers;		/* Reserved to m_nSharedMaxCount: never reallocated, read without lock. */
+		sLONG										m_nSharedWorkerCount;		/* Entries of m_vctrSharedWorkers visible to the workers. */
+		VConnectionHandlerQueue						m_vSharedCHQueue;			/* New handlers, not taken by a worker yet. Idle workers wait on it. */
+		bool										m_bSharedDying;				/* Set under m_vcsSharedProtector by the destructor: no worker is added any more. */
 #endif
 	
 		/* Everything related to exclusive workers. */
@@ -126,10 +144,6 @@ class XTOOLBOX_API VWorkerPool : public VObject, public IRefCountable
 
 		VConnectionHandlerQueue						m_vExclusiveCHQueue;
 
-#if WITH_SHARED_WORKERS
-		VSharedLoadBalancer*						m_vSharedLoadBalancer;
-#endif
-
 		VString										m_vstrNameFoSpare;
 
 
@@ -137,8 +151,17 @@ class XTOOLBOX_API VWorkerPool : public VObject, public IRefCountable
 		VError RemoveExclusiveIdlers ( unsigned short inCount );
 
 #if WITH_SHARED_WORKERS
-		VError GetNonBusySharedWorkers ( std::vector<VSharedWorker*>& outNonBusy );
-		VError ExtractStuckConnectionHandlers ( std::vector<VConnectionHandler*>& outStuckConnectionHandlers );
+		/* Does nothing once m_nSharedMaxCount workers run. */
+		VError AddSharedWorker ( );
+
+		/* Called by the shared workers. */
+		VConnectionHandler* PopSharedConnectionHandler ( );
+		VConnectionHandler* WaitForSharedConnectionHandler ( sLONG inTimeoutMilliseconds );
+		VError PushSharedConnectionHandler ( VConnectionHandler* inConnectionHandler );
+		VConnectionHandler* StealSharedConnectionHandler ( VSharedWorker* inThief, uLONG inSeed );
+		/* Pushes back handlers taken from the queues to be stopped, waiting for room if needed. Clears ioConnectionHandlers. */
+		void RequeueSharedConnectionHandlers ( std::vector<VConnectionHandler*>& ioConnectionHandlers );
+		bool WakeUpSharedWorker ( ) { return m_vSharedCHQueue. WakeUpWaiter ( ); }
 #endif
 };
 
@@ -27,6 +27,11 @@
 #include <sys/socket.h>
 #include <net/if.h>
 #include <unistd.h>
+#include <sys/uio.h>
+
+#if VERSION_LINUX
+#include <sys/sendfile.h>
+#endif
 
 
 #define SNET_HAVE_GROUP_REQ 0
@@ -329,7 +334,7 @@ VError XBsdTCPSocket::Connect(const VNetAddress& inAddr, sLONG inMsTimeout)
 }
 
 
-VError XBsdTCPSocket::Listen (const VNetAddress& inAddr, bool inAlreadyBound, bool inReuseAddress)
+VError XBsdTCPSocket::Listen (const VNetAddress& inAddr, bool inAlreadyBound, bool inReuseAddress, bool inReusePort)
 {
 	xbox_assert(fProfile==NewSock);
 
@@ -355,6 +360,17 @@ VError XBsdTCPSocket::Listen (const VNetAddress& inAddr, bool inAlreadyBound, bo
 			if(err!=0)
 				return vThrowNativeError(errno);
 		}
+
+#ifdef SO_REUSEPORT
+		if (inReusePort)
+		{
+			int opt=true;
+			err=setsockopt(fSock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+			if(err!=0)
+				return vThrowNativeError(errno);
+		}
+#endif
 		
 		err=bind(fSock, inAddr.GetAddr(), inAddr.GetAddrLen());
 		
@@ -395,6 +411,26 @@ XBsdTCPSocket* XBsdTCPSocket::Accept(uLONG inMsTimeout)
 	if(verr!=VE_OK)
 		return NULL;
 
+	bool wouldBlock=false;
+
+	XBsdTCPSocket* xsock=TryAccept(&wouldBlock);
+
+	if(xsock==NULL && wouldBlock)
+		vThrowNativeError(EWOULDBLOCK);
+
+	return xsock;
+}
+
+
+XBsdTCPSocket* XBsdTCPSocket::TryAccept(bool* outWouldBlock)
+{
+	xbox_assert(fProfile==ServiceSock);
+
+	VError verr=VE_OK;
+
+	if(outWouldBlock!=NULL)
+		*outWouldBlock=false;
+
 	sockaddr_storage sa_storage;
 	socklen_t len=sizeof(sa_storage);
 	memset(&sa_storage, 0, len);
@@ -403,14 +439,28 @@ XBsdTCPSocket* XBsdTCPSocket::Accept(uLONG inMsTimeout)
 	
 	int sock=kBAD_SOCKET;
 	
+	//On Linux, accepted socket doesn't inherit O_NONBLOCK from listening socket, so it is already blocking.
 	do
+#if VERSION_LINUX
+		sock=accept4(GetRawSocket(), sa, &len, SOCK_CLOEXEC);
+#else
 		sock=accept(GetRawSocket(), sa, &len);
+#endif
 	while(sock==kBAD_SOCKET && errno==EINTR);
 
 	
 	if(sock==kBAD_SOCKET)
 	{
-		vThrowNativeError(errno);
+		if(errno==EAGAIN || errno==EWOULDBLOCK)
+		{
+			if(outWouldBlock!=NULL)
+				*outWouldBlock=true;
+		}
+		else
+		{
+			vThrowNativeError(errno);
+		}
+		
 		return NULL;
 	}
 		
@@ -460,7 +510,8 @@ XBsdTCPSocket* XBsdTCPSocket::Accept(uLONG inMsTimeout)
 
 	if(ok)
 		xsock->fProfile=ConnectedSock;
-		
+
+#if !VERSION_LINUX
 	if(ok)
 	{
 		verr=xsock->SetBlocking(true);
@@ -468,6 +519,7 @@ XBsdTCPSocket* XBsdTCPSocket::Accept(uLONG inMsTimeout)
 		if(verr!=VE_OK)
 			ok=false;
 	}
+#endif
 	
 	if(ok)
 	{
@@ -605,6 +657,93 @@ VError XBsdTCPSocket::DoWrite(const void* inBuff, uLONG* ioLen)
 }
 
 
+VError XBsdTCPSocket::WriteV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen)
+{
+	VError verr=DoWriteV(inBuffers, inCount, outLen);
+
+	return verr;
+}
+
+
+VError XBsdTCPSocket::DoWriteV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen)
+{
+	// - inBuffers and outLen are mandatory ; outLen is always modified (set to 0 on error)
+	// - Caller should deal with special error VE_SOCK_WOULD_BLOCK
+	// - Should be consistent with DoWrite()
+
+	if(inBuffers==NULL || outLen==NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+	*outLen=0;
+
+	if(inCount==0)
+		return VE_OK;
+
+	if(fSslDelegate!=NULL)
+		return fSslDelegate->WriteV(inBuffers, inCount, outLen);
+
+	if(inCount==1)
+	{
+		uLONG len=inBuffers[0].fLength;
+
+		VError verr=DoWrite(inBuffers[0].fData, &len);
+
+		*outLen=len;
+
+		return verr;
+	}
+
+	struct iovec iov[kMAX_WRITE_BUFFERS];
+
+	uLONG count=0;
+	uLONG total=0;
+
+	//Total must fit in *outLen.
+	for(; count<inCount && count<kMAX_WRITE_BUFFERS && total<kMAX_sLONG; count++)
+	{
+		uLONG len=inBuffers[count].fLength;
+
+		if(len>kMAX_sLONG-total)
+			len=kMAX_sLONG-total;
+
+		iov[count].iov_base=const_cast<void*>(inBuffers[count].fData);
+		iov[count].iov_len=len;
+
+		total+=len;
+	}
+
+	struct msghdr msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov=iov;
+	msg.msg_iovlen=count;
+
+    int flags=0;
+
+#if VERSION_LINUX
+    flags|=MSG_NOSIGNAL;
+#endif
+
+	ssize_t n=sendmsg(fSock, &msg, flags);
+
+	if(n>=0)
+	{
+		*outLen=static_cast<uLONG>(n);
+		return VE_OK;
+	}
+
+	//We have an error...
+
+	if(errno==EWOULDBLOCK)
+		return VE_SOCK_WOULD_BLOCK;
+
+	if(errno==ECONNRESET || errno==ENOTSOCK || errno==EBADF)
+		return vThrowNativeCombo(VE_SOCK_CONNECTION_BROKEN, errno);
+
+	return vThrowNativeCombo(VE_SOCK_WRITE_FAILED, errno);
+}
+
+
 VError XBsdTCPSocket::ReadWithTimeout(void* outBuff, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent)
 {
 	VError verr=DoReadWithTimeout(outBuff, ioLen, inMsTimeout, outMsSpent);
@@ -762,9 +901,92 @@ VError XBsdTCPSocket::WriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG i
 }
 
 
+VError XBsdTCPSocket::WriteVWithTimeout(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen, sLONG inMsTimeout, sLONG* outMsSpent)
+{
+	VError verr=DoWriteVWithTimeout(inBuffers, inCount, outLen, inMsTimeout, outMsSpent);
+
+	return verr;
+}
+
+
+#if VERSION_LINUX
+
+VError XBsdTCPSocket::SendFile(int inFd, sLONG8* ioOffset, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent)
+{
+	// - ioOffset and ioLen are mandatory ; ioLen is always modified (set to 0 on error)
+	// - With inMsTimeout > 0, wait for the socket to be writable, as DoWriteWithTimeout() does.
+	// - Partial send is not an error ; VE_OK means something was sent.
+	// - VE_SOCK_WOULD_BLOCK (not thrown) means nothing could be sent ; caller should wait again.
+
+	if(inFd<0 || ioOffset==NULL || ioLen==NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+	xbox_assert(fSslDelegate==NULL);
+
+	if(fSslDelegate!=NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+	uLONG len=*ioLen;
+
+	*ioLen=0;
+
+	if(outMsSpent!=NULL)
+		*outMsSpent=0;
+
+	if(len==0)
+		return VE_OK;
+
+	if(len>kMAX_sLONG)
+		len=kMAX_sLONG;
+
+	VError verr=VE_OK;
+
+	if(inMsTimeout>0)
+		verr=WaitForWrite(inMsTimeout, outMsSpent);
+
+	if(verr!=VE_OK)
+		return vThrowError(verr);
+
+	off_t offset=static_cast<off_t>(*ioOffset);
+
+	ssize_t n=sendfile(fSock, inFd, &offset, len);
+
+	if(n>=0)
+	{
+		*ioOffset=offset;
+		*ioLen=static_cast<uLONG>(n);
+
+		return VE_OK;
+	}
+
+	//We have an error...
+
+	if(errno==EWOULDBLOCK)
+		return VE_SOCK_WOULD_BLOCK;	//Writable, but the socket buffer filled meanwhile
+
+	if(errno==ECONNRESET || errno==ENOTSOCK || errno==EBADF || errno==EPIPE)
+		return vThrowNativeCombo(VE_SOCK_CONNECTION_BROKEN, errno);
+
+	return vThrowNativeCombo(VE_SOCK_WRITE_FAILED, errno);
+}
+
+#endif
+
+
 VError XBsdTCPSocket::DoWriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent)
 {
-	// - inBuff and ioLen are mandatory ; ioLen is always modified (set to 0 on error)
+	if(inBuff==NULL || ioLen==NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+	VWriteBuffer buffer={inBuff, *ioLen};
+
+	return DoWriteVWithTimeout(&buffer, 1, ioLen, inMsTimeout, outMsSpent);
+}
+
+
+VError XBsdTCPSocket::DoWriteVWithTimeout(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen, sLONG inMsTimeout, sLONG* outMsSpent)
+{
+	// - inBuffers and outLen are mandatory ; outLen is always modified (set to 0 on error)
 	// - inMsTimeout <= 0 results in some form of polling
 	// - outMsSpent is optional but always computed (on success and error) if not NULL. It may be > to inMsTimeout,
 	//   reflecting the fact that the call was (slightly) longer than the requested timeout.
@@ -772,13 +994,13 @@ VError XBsdTCPSocket::DoWriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG
 	// - Partial write before end of timeout is not an error ; VE_OK means something was sent.
 	// - this method might change and restore the socket blocking state
 	
-	if(inBuff==NULL || ioLen==NULL)
+	if(inBuffers==NULL || outLen==NULL)
 		return vThrowError(VE_INVALID_PARAMETER);
 	
 	
 	VError verr=VE_OK;
 	
-	uLONG len=*ioLen;
+	uLONG len=0;
 	
 	if(fSslDelegate!=NULL)
 	{
@@ -796,9 +1018,9 @@ VError XBsdTCPSocket::DoWriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG
 		
 		do
 		{
-			len=*ioLen;
+			len=0;
 			
-			verr=fSslDelegate->Write(inBuff, &len);
+			verr=DoWriteV(inBuffers, inCount, &len);
 			
 			if(len>0)	//We sent some data ; that's enough for now.
 				break;
@@ -828,14 +1050,14 @@ VError XBsdTCPSocket::DoWriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG
 
 		do
 		{
-			len=*ioLen;
+			len=0;
 
 			sLONG spentOnStep=0;
 
 			verr=WaitForWrite(timeout, &spentOnStep);
 
 			if(verr==VE_OK)
-				verr=DoWrite(inBuff, &len);
+				verr=DoWriteV(inBuffers, inCount, &len);
 			else
 				len=0;
 
@@ -847,7 +1069,7 @@ VError XBsdTCPSocket::DoWriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG
 			if(verr==VE_SOCK_WOULD_BLOCK)
 			{
 				//Although we wait for the socket to be ready, it may
-				//happen that DoWrite returns VE_SOCK_WOULD_BLOCK.
+				//happen that DoWriteV returns VE_SOCK_WOULD_BLOCK.
 				//Prevent a mad loop with a small sleep, and retry...
 				VTask::Sleep(100);
 				timeout-=100;
@@ -868,7 +1090,7 @@ VError XBsdTCPSocket::DoWriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG
 	xbox_assert(verr!=VE_SOCK_WOULD_BLOCK);
 	xbox_assert(verr!=VE_SOCK_PEER_OVER);
 	
-	*ioLen=len;
+	*outLen=len;
 	
 	return vThrowError(verr);	//might be VE_OK, which throws nothing.
 }
@@ -1055,7 +1277,7 @@ XBsdTCPSocket* XBsdTCPSocket::NewClientConnectedSock(const VString& inDnsName, P
 
 
 //static
-XBsdTCPSocket* XBsdTCPSocket::NewServerListeningSock(const VNetAddress& inAddr, Socket inBoundSock, bool inReuseAddress)
+XBsdTCPSocket* XBsdTCPSocket::NewServerListeningSock(const VNetAddress& inAddr, Socket inBoundSock, bool inReuseAddress, bool inReusePort)
 {
 	bool alreadyBound=(inBoundSock!=kBAD_SOCKET) ? true : false;
 	
@@ -1080,7 +1302,7 @@ XBsdTCPSocket* XBsdTCPSocket::NewServerListeningSock(const VNetAddress& inAddr,
 	{
 		xsock->SetServicePort(inAddr.GetPort());
 		
-		verr=xsock->Listen(inAddr, alreadyBound, inReuseAddress);
+		verr=xsock->Listen(inAddr, alreadyBound, inReuseAddress, inReusePort);
 	}
 	
 	if(verr==VE_OK)
@@ -1106,14 +1328,14 @@ XBsdTCPSocket* XBsdTCPSocket::NewServerListeningSock(const VNetAddress& inAddr,
 
 
 //static
-XBsdTCPSocket* XBsdTCPSocket::NewServerListeningSock(PortNumber inPort, Socket inBoundSock, bool inReuseAddress)
+XBsdTCPSocket* XBsdTCPSocket::NewServerListeningSock(PortNumber inPort, Socket inBoundSock, bool inReuseAddress, bool inReusePort)
 {
 	VNetAddress anyAddr;
 	VError verr=anyAddr.FromAnyIpAndPort(inPort);
 	
 	xbox_assert(verr==VE_OK);
 	
-	return NewServerListeningSock(anyAddr, inBoundSock, inReuseAddress);
+	return NewServerListeningSock(anyAddr, inBoundSock, inReuseAddress, inReusePort);
 }
 
 
@@ -1175,11 +1397,17 @@ XBsdAcceptIterator::XBsdAcceptIterator()
 	fSockIt=fSocks.end();
 	fReadSet=new fd_set;
 	FD_ZERO(fReadSet);
+
+	memset(&fStats, 0, sizeof(fStats));
+	fRateStartCount=0;
+	fRateStartTime=VSystem::GetCurrentTime();
 }
 
 
 XBsdAcceptIterator::~XBsdAcceptIterator()
 {
+	ClearAcceptedSockets();
+
 	delete fReadSet;
 }
 
@@ -1200,6 +1428,8 @@ VError XBsdAcceptIterator::AddServiceSocket(XBsdTCPSocket* inSock)
 
 VError XBsdAcceptIterator::ClearServiceSockets()
 {
+	ClearAcceptedSockets();
+
 	fSocks.clear();
 	
 	//clear will invalidate the collection iterator...
@@ -1213,6 +1443,24 @@ VError XBsdAcceptIterator::GetNewConnectedSocket(XBsdTCPSocket** outSock, sLONG
 {
 	if(outSock==NULL)
 		return vThrowError(VE_INVALID_PARAMETER);
+
+	uLONG now=VSystem::GetCurrentTime();
+
+	if(now-fRateStartTime>=1000)
+	{
+		fStats.fAcceptsPerSecond=(Real)(fStats.fAcceptCount-fRateStartCount)*1000.0/(Real)(now-fRateStartTime);
+		fRateStartCount=fStats.fAcceptCount;
+		fRateStartTime=now;
+	}
+
+	//Connections accepted on a previous wake up come first
+	if(!fAccepted.empty())
+	{
+		*outSock=fAccepted.front();
+		fAccepted.pop_front();
+		
+		return VE_OK;
+	}
 	
 	bool shouldRetry=false;
 	
@@ -1225,6 +1473,77 @@ VError XBsdAcceptIterator::GetNewConnectedSocket(XBsdTCPSocket** outSock, sLONG
 }
 
 
+void XBsdAcceptIterator::GetStatistics(VSockListenerStatistics* outStatistics)
+{
+	if(outStatistics!=NULL)
+		*outStatistics=fStats;
+}
+
+
+void XBsdAcceptIterator::DrainServiceSocket(XBsdTCPSocket* inSock)
+{
+	fStats.fWakeUpCount++;
+
+#if VERSION_LINUX
+	//For a listening socket, tcpi_unacked is the accept queue length and tcpi_sacked its maximum.
+	tcp_info info;
+	socklen_t len=sizeof(info);
+	memset(&info, 0, len);
+
+	if(getsockopt(inSock->GetRawSocket(), IPPROTO_TCP, TCP_INFO, &info, &len)==0 && info.tcpi_sacked>0 && info.tcpi_unacked>=info.tcpi_sacked)
+		fStats.fBacklogFullCount++;
+#endif
+
+	//Draining relies on a non blocking service socket, as Accept() does
+	if(inSock->SetBlocking(false)!=VE_OK)
+		return;
+
+	sLONG count=0;
+
+	for(sLONG attempt=0 ; attempt<kMaxAcceptBatch ; attempt++)
+	{
+		StTmpErrorContext errCtx;
+		
+		bool wouldBlock=false;
+		
+		XBsdTCPSocket* sock=inSock->TryAccept(&wouldBlock);
+		
+		if(sock==NULL)
+		{
+			if(wouldBlock)
+				break;
+
+			//An error on a single connection (aborted by peer, ...) shouldn't stop draining
+			continue;
+		}
+		
+		errCtx.Flush();
+
+		fAccepted.push_back(sock);
+		count++;
+	}
+
+	fStats.fAcceptCount+=count;
+
+	if(count>fStats.fMaxBatchSize)
+		fStats.fMaxBatchSize=count;
+}
+
+
+void XBsdAcceptIterator::ClearAcceptedSockets()
+{
+	while(!fAccepted.empty())
+	{
+		XBsdTCPSocket* sock=fAccepted.front();
+		
+		fAccepted.pop_front();
+		
+		sock->Close(false);
+		delete sock;
+	}
+}
+
+
 VError XBsdAcceptIterator::GetNewConnectedSocket(XBsdTCPSocket** outSock, sLONG inMsTimeout, bool* outShouldRetry)
 {
 	if(outSock==NULL || outShouldRetry==NULL)
@@ -1306,10 +1625,16 @@ VError XBsdAcceptIterator::GetNewConnectedSocket(XBsdTCPSocket** outSock, sLONG
 		
 		if(FD_ISSET(fd, fReadSet))
 		{
-			*outSock=(*fSockIt)->Accept(0 /*No timeout*/);
-						
+			DrainServiceSocket(*fSockIt);
+			
 			++fSockIt;	//move to next socket ; prefer equity over perf !
 			
+			if(fAccepted.empty())
+				continue;
+
+			*outSock=fAccepted.front();
+			fAccepted.pop_front();
+			
 			return VE_OK;
 		}
 		else
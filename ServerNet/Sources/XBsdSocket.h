@@ -20,6 +20,8 @@
 #include <sys/socket.h>
 #include <netdb.h>
 
+#include <deque>
+
 #include "ServerNetTypes.h"
 
 
@@ -37,9 +39,10 @@ class XTOOLBOX_API XBsdTCPSocket : public VObject
 	
 	static XBsdTCPSocket* NewClientConnectedSock(const VString& inDnsName, PortNumber inPort, sLONG inMsTimeout);	//Client specific !
 	//jmo - TODO : Mettre une VString pour l'adresse.
-	static XBsdTCPSocket* NewServerListeningSock(const VNetAddress& inAddr, Socket inBoundSock=kBAD_SOCKET, bool inReuseAddress=true);	//Server specific !
+	//With inReusePort, several sockets may listen on the same address and port (SO_REUSEPORT), kernel spreads connections among them.
+	static XBsdTCPSocket* NewServerListeningSock(const VNetAddress& inAddr, Socket inBoundSock=kBAD_SOCKET, bool inReuseAddress=true, bool inReusePort=false);	//Server specific !
 	
-	static XBsdTCPSocket* NewServerListeningSock(PortNumber inPorts, Socket inBoundSock=kBAD_SOCKET, bool inReuseAddress=true);	//Server specific !
+	static XBsdTCPSocket* NewServerListeningSock(PortNumber inPorts, Socket inBoundSock=kBAD_SOCKET, bool inReuseAddress=true, bool inReusePort=false);	//Server specific !
 
 	virtual ~XBsdTCPSocket();
 	
@@ -57,6 +60,9 @@ class XTOOLBOX_API XBsdTCPSocket : public VObject
 
 
 	XBsdTCPSocket* Accept(uLONG inMsTimeout);
+
+	//Accept a pending connection, if any, without waiting. Listening socket must be non blocking.
+	XBsdTCPSocket* TryAccept(bool* outWouldBlock);
 	
 	VError Read(void* outBuff, uLONG* ioLen);
 	VError Write(const void* inBuff, uLONG* ioLen, bool /*inWithEmptyTail*/);
@@ -64,6 +70,19 @@ class XTOOLBOX_API XBsdTCPSocket : public VObject
 	VError ReadWithTimeout(void* outBuff, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent=NULL);
 	VError WriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent=NULL, bool unusedWithEmptyTail=false);
 
+	//Scatter/gather versions of Write() and WriteWithTimeout() : A single sendmsg() (or SSL_write()) for several buffers.
+	//At most kMAX_WRITE_BUFFERS buffers are used per call ; as with Write(), *outLen may be less than the total length.
+	static const uLONG kMAX_WRITE_BUFFERS=64;
+
+	VError WriteV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen);
+	VError WriteVWithTimeout(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen, sLONG inMsTimeout, sLONG* outMsSpent=NULL);
+
+#if VERSION_LINUX
+	//Send file content using sendfile() ; plain TCP only (data would bypass SSL). *ioOffset is updated,
+	//*ioLen is set to the number of bytes sent. inMsTimeout <= 0 means a single attempt.
+	VError SendFile(int inFd, sLONG8* ioOffset, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent=NULL);
+#endif
+
 	XBOX::VError SetNoDelay (bool inYesNo);
 	
 	VError PromoteToSSL(VKeyCertChain* inKeyCertChain=NULL);
@@ -83,6 +102,9 @@ class XTOOLBOX_API XBsdTCPSocket : public VObject
 
 	VError DoWrite(const void* inBuff, uLONG* ioLen);
 	VError DoWriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent=NULL);
+
+	VError DoWriteV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen);
+	VError DoWriteVWithTimeout(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen, sLONG inMsTimeout, sLONG* outMsSpent=NULL);
 	
 	//Reads and discard data on Close with receive loop. Helps prevent TCP RST flag.
 	static void TrashWithTimeout(Socket inFd, sLONG inMsTimeout, sLONG* outMsSpent=NULL);
@@ -94,7 +116,7 @@ class XTOOLBOX_API XBsdTCPSocket : public VObject
 	PortNumber GetSockAddrPort() const;
 
 	VError Connect(const VNetAddress& inAddr, sLONG inMsTimeout);			//Client specific !
-	VError Listen(const VNetAddress& inAddr, bool inAlreadyBound=false, bool inReuseAddress=true);	//Server specific !
+	VError Listen(const VNetAddress& inAddr, bool inAlreadyBound=false, bool inReuseAddress=true, bool inReusePort=false);	//Server specific !
 
 	VError SetServicePort(PortNumber inServicePort);
 	
@@ -131,6 +153,8 @@ public :
 	VError AddServiceSocket(XBsdTCPSocket* inSock);
 	VError ClearServiceSockets();
 	VError GetNewConnectedSocket(XBsdTCPSocket** outSock, sLONG inMsTimeout);
+
+	void GetStatistics(VSockListenerStatistics* outStatistics);
 	
 private :
 
@@ -138,6 +162,11 @@ private :
 
 	//Needs special error handling, done in the corresponding public method
 	VError GetNewConnectedSocket(XBsdTCPSocket** outSock, sLONG inMsTimeout, bool* outShouldRetry);
+
+	//Accept all pending connections of a ready service socket (up to kMaxAcceptBatch), instead of one per select call.
+	void DrainServiceSocket(XBsdTCPSocket* inSock);
+
+	void ClearAcceptedSockets();
 	
 	typedef std::vector<XBsdTCPSocket*> SockPtrColl;
 	SockPtrColl fSocks;
@@ -146,6 +175,15 @@ private :
 
 	//Dynamic alloc to make sure we use ServerNet FD_SETSIZE
 	fd_set* fReadSet;
+
+	static const sLONG kMaxAcceptBatch=64;
+
+	//Connections accepted by DrainServiceSocket() and not yet returned
+	std::deque<XBsdTCPSocket*> fAccepted;
+
+	VSockListenerStatistics fStats;
+	sLONG8 fRateStartCount;
+	uLONG fRateStartTime;
 	
 };
 
@@ -573,6 +573,62 @@ VError XWinTCPSocket::Write(const void* inBuff, uLONG* ioLen, bool inWithEmptyTa
 }
 
 
+VError XWinTCPSocket::WriteV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen)
+{
+	if(inBuffers==NULL || outLen==NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+	*outLen=0;
+
+	if(inCount==0)
+		return VE_OK;
+
+	if(fSslDelegate!=NULL)
+		return fSslDelegate->WriteV(inBuffers, inCount, outLen);
+
+	WSABUF buffers[kMAX_WRITE_BUFFERS];
+
+	uLONG count=0;
+	uLONG total=0;
+
+	//Total must fit in *outLen.
+	for(; count<inCount && count<kMAX_WRITE_BUFFERS && total<kMAX_sLONG; count++)
+	{
+		uLONG len=inBuffers[count].fLength;
+
+		if(len>kMAX_sLONG-total)
+			len=kMAX_sLONG-total;
+
+		buffers[count].buf=reinterpret_cast<char*>(const_cast<void*>(inBuffers[count].fData));
+		buffers[count].len=len;
+
+		total+=len;
+	}
+
+	DWORD sent=0;
+
+	int res=WSASend(fSock, buffers, count, &sent, 0 /*flags*/, NULL, NULL);
+
+	if(res==0)
+	{
+		*outLen=sent;
+		return VE_OK;
+	}
+
+	//We have an error...
+
+	int	lastError	= WSAGetLastError();
+
+	if(lastError==WSAEWOULDBLOCK)
+		return VE_SOCK_WOULD_BLOCK;
+
+	if(lastError==WSAECONNRESET || lastError==WSAENOTSOCK || lastError==WSAEBADF)
+		return vThrowNativeCombo(VE_SOCK_CONNECTION_BROKEN, lastError);
+
+	return vThrowNativeCombo(VE_SOCK_WRITE_FAILED, lastError);
+}
+
+
 VError XWinTCPSocket::ReadWithTimeout(void* outBuff, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent)
 {
 	if(outBuff==NULL || ioLen==NULL)
@@ -810,6 +866,97 @@ VError XWinTCPSocket::WriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG i
 }
 
 
+VError XWinTCPSocket::WriteVWithTimeout(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen, sLONG inMsTimeout, sLONG* outMsSpent)
+{
+	//Same as WriteWithTimeout(), with WriteV() in place of Write().
+
+	if(inBuffers==NULL || outLen==NULL)
+		return vThrowError(VE_INVALID_PARAMETER);
+
+
+	VError verr=VE_OK;
+
+	uLONG len=0;
+
+	if(fSslDelegate!=NULL)
+	{
+		bool wasBlocking=false;
+
+		if(IsBlocking())
+		{
+			SetBlocking(false);
+			wasBlocking=true;
+		}
+
+		sLONG timeout=inMsTimeout;
+
+		do
+		{
+			len=0;
+
+			verr=WriteV(inBuffers, inCount, &len);
+
+			if(len>0)	//We sent some data ; that's enough for now.
+				break;
+
+			sLONG spentOnStep=0;
+
+			if(verr==VE_SOCK_WOULD_BLOCK && fSslDelegate->WantRead())
+				verr=WaitForRead(timeout, &spentOnStep);
+			else if(verr==VE_SOCK_WOULD_BLOCK && fSslDelegate->WantWrite())
+				verr=WaitForWrite(timeout, &spentOnStep);
+
+			timeout-=spentOnStep;
+		}
+		while(verr==VE_OK);
+
+		if(wasBlocking)
+			SetBlocking(true);
+	}
+	else
+	{
+		sLONG timeout=inMsTimeout;
+
+		do
+		{
+			len=0;
+
+			sLONG spentOnStep=0;
+
+			verr=WaitForWrite(timeout, &spentOnStep);
+
+			if(verr==VE_OK)
+				verr=WriteV(inBuffers, inCount, &len);
+			else
+				len=0;
+
+			if(len>0)	//We sent some data ; that's enough for now.
+				break;
+
+			if(verr==VE_SOCK_WOULD_BLOCK)
+			{
+				//See WriteWithTimeout()
+				VTask::Sleep(100);
+				timeout-=100;
+				verr=VE_OK;
+			}
+
+			timeout-=spentOnStep;
+		}
+		while(verr==VE_OK);
+	}
+
+	xbox_assert((len==0 && verr!=VE_OK) || (len>0 && verr==VE_OK));
+
+	xbox_assert(verr!=VE_SOCK_WOULD_BLOCK);
+	xbox_assert(verr!=VE_SOCK_PEER_OVER);
+
+	*outLen=len;
+
+	return vThrowError(verr);	//might be VE_OK, which throws nothing.
+}
+
+
 //static
 void XWinTCPSocket::TrashWithTimeout(Socket inFd, sLONG inMsTimeout, sLONG* outMsSpent)
 {
@@ -948,7 +1095,7 @@ XWinTCPSocket* XWinTCPSocket::NewClientConnectedSock(const VString& inDnsName, P
 
 
 //static
-XWinTCPSocket* XWinTCPSocket::NewServerListeningSock(const VNetAddress& inAddr, Socket inBoundSock, bool inReuseAddress)
+XWinTCPSocket* XWinTCPSocket::NewServerListeningSock(const VNetAddress& inAddr, Socket inBoundSock, bool inReuseAddress, bool /*inReusePort*/)
 {
 	bool alreadyBound=(inBoundSock!=kBAD_SOCKET) ? true : false;
 	
@@ -999,7 +1146,7 @@ XWinTCPSocket* XWinTCPSocket::NewServerListeningSock(const VNetAddress& inAddr,
 
 
 //static
-XWinTCPSocket* XWinTCPSocket::NewServerListeningSock(PortNumber inPort, Socket inBoundSock, bool inReuseAddress)
+XWinTCPSocket* XWinTCPSocket::NewServerListeningSock(PortNumber inPort, Socket inBoundSock, bool inReuseAddress, bool /*inReusePort*/)
 {
 	VNetAddress anyAddr;
 	VError verr=anyAddr.FromAnyIpAndPort(inPort);
@@ -1069,6 +1216,10 @@ XWinAcceptIterator::XWinAcceptIterator()
 	fSockIt=fSocks.end();	// sc 05/07/2012
 	fReadSet=new fd_set;
 	FD_ZERO(fReadSet);
+
+	memset(&fStats, 0, sizeof(fStats));
+	fRateStartCount=0;
+	fRateStartTime=VSystem::GetCurrentTime();
 }
 
 
@@ -1108,17 +1259,36 @@ VError XWinAcceptIterator::GetNewConnectedSocket(XWinTCPSocket** outSock, sLONG
 	if(outSock==NULL)
 		return vThrowError(VE_INVALID_PARAMETER);
 
+	uLONG now=VSystem::GetCurrentTime();
+
+	if(now-fRateStartTime>=1000)
+	{
+		fStats.fAcceptsPerSecond=(Real)(fStats.fAcceptCount-fRateStartCount)*1000.0/(Real)(now-fRateStartTime);
+		fRateStartCount=fStats.fAcceptCount;
+		fRateStartTime=now;
+	}
+
 	bool shouldRetry=false;
 	
 	VError verr=GetNewConnectedSocket(outSock, inMsTimeout, &shouldRetry);
 	
 	if(verr==VE_OK && *outSock==NULL && shouldRetry)
 		verr=GetNewConnectedSocket(outSock, inMsTimeout, &shouldRetry /*ignored*/);
+
+	if(*outSock!=NULL)
+		fStats.fAcceptCount++;
 		
 	return verr;
 }
 
 
+void XWinAcceptIterator::GetStatistics(VSockListenerStatistics* outStatistics)
+{
+	if(outStatistics!=NULL)
+		*outStatistics=fStats;
+}
+
+
 VError XWinAcceptIterator::GetNewConnectedSocket(XWinTCPSocket** outSock, sLONG inMsTimeout, bool* outShouldRetry)
 {
 	if(outSock==NULL || outShouldRetry==NULL)
@@ -1195,6 +1365,11 @@ VError XWinAcceptIterator::GetNewConnectedSocket(XWinTCPSocket** outSock, sLONG
 		if(FD_ISSET(fd, fReadSet))
 		{
 			*outSock=(*fSockIt)->Accept(0 /*No timeout*/);
+
+			//One connection per wake up on Windows
+			fStats.fWakeUpCount++;
+			if(fStats.fMaxBatchSize==0 && *outSock!=NULL)
+				fStats.fMaxBatchSize=1;
 			
 			++fSockIt;	//move to next socket ; prefer equity over perf !
 			
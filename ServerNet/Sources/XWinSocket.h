@@ -36,9 +36,10 @@ class XTOOLBOX_API XWinTCPSocket : public VObject
 	static XWinTCPSocket* NewClientConnectedSock(const VString& inDnsName, PortNumber inPort, sLONG inMsTimeout);
 
 	//jmo - TODO : Mettre une VString pour l'adresse.
-	static XWinTCPSocket* NewServerListeningSock(const VNetAddress& inAddr, Socket inBoundSock=kBAD_SOCKET, bool inReuseAddress=true);
+	//inReusePort is ignored, SO_REUSEPORT isn't available on Windows.
+	static XWinTCPSocket* NewServerListeningSock(const VNetAddress& inAddr, Socket inBoundSock=kBAD_SOCKET, bool inReuseAddress=true, bool inReusePort=false);
 
-	static XWinTCPSocket* NewServerListeningSock(PortNumber inPort, Socket inBoundSock=kBAD_SOCKET, bool inReuseAddress=true);
+	static XWinTCPSocket* NewServerListeningSock(PortNumber inPort, Socket inBoundSock=kBAD_SOCKET, bool inReuseAddress=true, bool inReusePort=false);
 
 	virtual ~XWinTCPSocket();
 
@@ -62,6 +63,13 @@ class XTOOLBOX_API XWinTCPSocket : public VObject
 	VError ReadWithTimeout(void* outBuff, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent=NULL);
 	VError WriteWithTimeout(const void* inBuff, uLONG* ioLen, sLONG inMsTimeout, sLONG* outMsSpent=NULL, bool unusedWithEmptyTail=false);
 
+	//Scatter/gather versions of Write() and WriteWithTimeout() : A single WSASend() (or SSL_write()) for several buffers.
+	//At most kMAX_WRITE_BUFFERS buffers are used per call ; as with Write(), *outLen may be less than the total length.
+	static const uLONG kMAX_WRITE_BUFFERS=64;
+
+	VError WriteV(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen);
+	VError WriteVWithTimeout(const VWriteBuffer* inBuffers, uLONG inCount, uLONG* outLen, sLONG inMsTimeout, sLONG* outMsSpent=NULL);
+
 	XBOX::VError SetNoDelay (bool inYesNo);
 	
 	VError PromoteToSSL(VKeyCertChain* inKeyCertChain=NULL);
@@ -126,6 +134,8 @@ public :
 	VError AddServiceSocket(XWinTCPSocket* inSock);
 	VError ClearServiceSockets();
 	VError GetNewConnectedSocket(XWinTCPSocket** outSock, sLONG inMsTimeout);
+
+	void GetStatistics(VSockListenerStatistics* outStatistics);
 	
 private :
 
@@ -141,6 +151,10 @@ private :
 
 	//Dynamic alloc to make sure we use ServerNet FD_SETSIZE
 	fd_set* fReadSet;
+
+	VSockListenerStatistics fStats;
+	sLONG8 fRateStartCount;
+	uLONG fRateStartTime;
 };
 
 